@@ -0,0 +1,72 @@
+#include "Bench.hpp"
+
+#include <libpx.hpp>
+
+#include <Json.hpp>
+
+namespace px {
+
+namespace bench {
+
+void Bench::writeJSON(std::ostream& stream) const
+{
+  stream << "{\"benchmarks\":[";
+
+  for (std::size_t i = 0; i < results.size(); i++) {
+
+    const auto& r = results[i];
+
+    stream << (i ? ",\n" : "\n");
+    stream << "{\"name\":\"" << escapeJSON(r.name) << "\"";
+    stream << ",\"iterations\":" << r.iterations;
+    stream << ",\"ns_per_op\":" << r.nsPerOp;
+    stream << ",\"mpixels_per_s\":" << r.mpixelsPerSecond;
+    stream << "}";
+  }
+
+  stream << "\n]}\n";
+}
+
+void Bench::print(const Result& result)
+{
+  if (result.mpixelsPerSecond > 0) {
+    std::printf("%-40s %14.1f ns/op %10.2f Mpixels/s\n", result.name.c_str(), result.nsPerOp, result.mpixelsPerSecond);
+  } else {
+    std::printf("%-40s %14.1f ns/op\n", result.name.c_str(), result.nsPerOp);
+  }
+}
+
+void renderBench(Bench& bench, const char* name, Document* doc)
+{
+  if (!bench.enabled(name)) {
+    closeDoc(doc);
+    return;
+  }
+
+  auto* image = createImage(0, 0);
+
+  auto* context = createRenderContext();
+
+  auto* stats = createRenderStats();
+
+  render(doc, image, context, stats);
+
+  // Clearing the canvas is counted too, since it is part of every render.
+  auto pixels = getPixelsBlended(stats) + (getDocWidth(doc) * getDocHeight(doc));
+
+  closeRenderStats(stats);
+
+  bench.run(name, pixels, [doc, image, context]() {
+    render(doc, image, context);
+  });
+
+  closeRenderContext(context);
+
+  closeImage(image);
+
+  closeDoc(doc);
+}
+
+} // namespace bench
+
+} // namespace px
@@ -0,0 +1,148 @@
+#ifndef LIBPX_BENCH_BENCH_HPP
+#define LIBPX_BENCH_BENCH_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdio>
+
+namespace px {
+
+struct Document;
+
+namespace bench {
+
+/// Contains the result of a single benchmark.
+struct Result final
+{
+  /// The name of the benchmark.
+  std::string name;
+  /// The number of times the benchmark was run.
+  std::size_t iterations = 0;
+  /// The average time of each run, in nanoseconds.
+  double nsPerOp = 0;
+  /// The number of pixels processed per second, in millions.
+  /// This is zero for benchmarks that don't process pixels.
+  double mpixelsPerSecond = 0;
+};
+
+/// Runs benchmarks and prints their results.
+class Bench final
+{
+  /// Only benchmarks with this string in their name are run.
+  std::string filter;
+  /// The minimum amount of time to spend on each benchmark, in seconds.
+  double minTime = 0.25;
+  /// The results of the benchmarks that were run.
+  std::vector<Result> results;
+public:
+  /// Constructs a new benchmark runner.
+  ///
+  /// @param f Only benchmarks containing this string in their name are run.
+  /// @param t The minimum amount of time to spend on each benchmark, in seconds.
+  Bench(const char* f = "", double t = 0.25) : filter(f), minTime(t) {}
+  /// Times a function.
+  /// The function is called until the minimum amount of time has
+  /// passed, and the average time of each call is then printed.
+  ///
+  /// @param name The name of the benchmark.
+  /// @param pixels The number of pixels processed by each call.
+  /// If this is zero, no pixel rate is printed.
+  /// @param functor The function to time.
+  template <typename Functor>
+  void run(const char* name, std::size_t pixels, Functor functor)
+  {
+    runWithSetup(name, pixels, []() {}, functor);
+  }
+  /// Times a function that needs to be prepared before each call.
+  /// Only the time spent in @p functor is measured.
+  ///
+  /// @param name The name of the benchmark.
+  /// @param pixels The number of pixels processed by each call.
+  /// @param setup Called before each call to @p functor.
+  /// @param functor The function to time.
+  template <typename Setup, typename Functor>
+  void runWithSetup(const char* name, std::size_t pixels, Setup setup, Functor functor)
+  {
+    if (!enabled(name)) {
+      return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches and any scratch memory.
+    setup();
+    functor();
+
+    std::size_t iterations = 0;
+
+    double elapsed = 0;
+
+    auto totalStart = Clock::now();
+
+    while (std::chrono::duration<double>(Clock::now() - totalStart).count() < minTime) {
+
+      setup();
+
+      auto start = Clock::now();
+
+      functor();
+
+      elapsed += std::chrono::duration<double>(Clock::now() - start).count();
+
+      iterations++;
+    }
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerOp = (elapsed * 1e9) / iterations;
+    result.mpixelsPerSecond = (double(pixels) * iterations) / (elapsed * 1e6);
+
+    print(result);
+
+    results.emplace_back(std::move(result));
+  }
+  /// Indicates whether or not a benchmark passes the filter.
+  bool enabled(const char* name) const
+  {
+    return std::string(name).find(filter) != std::string::npos;
+  }
+  /// Writes the results in JSON format.
+  ///
+  /// @param stream The stream to write the results to.
+  void writeJSON(std::ostream& stream) const;
+protected:
+  /// Prints a single result to the standard output.
+  static void print(const Result& result);
+};
+
+/// Times the rendering of a document.
+/// The document is rendered once with statistics enabled, so that
+/// the pixel rate is based on the number of pixels actually blended.
+///
+/// @param bench The benchmark runner.
+/// @param name The name of the benchmark.
+/// @param doc The document to render. This is closed by the function.
+void renderBench(Bench& bench, const char* name, Document* doc);
+
+/// Runs the blend mode benchmarks.
+void blendBenchmarks(Bench& bench);
+
+/// Runs the ellipse benchmarks.
+void ellipseBenchmarks(Bench& bench);
+
+/// Runs the flood fill benchmarks.
+void fillBenchmarks(Bench& bench);
+
+/// Runs the line benchmarks.
+void lineBenchmarks(Bench& bench);
+
+} // namespace bench
+
+} // namespace px
+
+#endif // LIBPX_BENCH_BENCH_HPP
@@ -0,0 +1,195 @@
+#include "Bench.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace px {
+
+namespace bench {
+
+namespace {
+
+/// The width and height of the canvas used for blending.
+constexpr int canvasSize() noexcept
+{
+  return 512;
+}
+
+/// Creates a document with a single pixel that covers the whole canvas.
+/// Nearly all of the render time is then spent blending that pixel.
+///
+/// @param mode The blend mode to give the pixel.
+/// @param alpha The alpha value to give the pixel.
+Document* makeCoveringPixel(BlendMode mode, float alpha)
+{
+  auto* doc = createDoc();
+
+  resizeDoc(doc, canvasSize(), canvasSize());
+
+  setBackground(doc, 0.5, 0.5, 0.5, 1);
+
+  auto* line = addLine(doc);
+  addPoint(line, canvasSize() - 1, canvasSize() - 1);
+  setPixelSize(line, canvasSize());
+  setColor(line, 0.25, 0.5, 0.75, alpha);
+  setBlendMode(line, mode);
+
+  return doc;
+}
+
+/// A color in the two forms that the blend modes use.
+struct SpanColor final
+{
+  /// The color with its alpha multiplied in, used by the normal blend mode.
+  float premultiplied[4];
+  /// The color as it was given, used by the subtract blend mode.
+  float original[4];
+};
+
+/// Clamps a channel value to the range of zero to one.
+inline float clampChannel(float value) noexcept
+{
+  return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+/// Blends a pixel with the normal blend mode.
+inline void normalPixel(float* dst, const SpanColor& c) noexcept
+{
+  float inv = 1.0f - c.premultiplied[3];
+
+  for (int i = 0; i < 4; i++) {
+    dst[i] = c.premultiplied[i] + (dst[i] * inv);
+  }
+}
+
+/// Blends a pixel with the subtract blend mode.
+inline void subtractPixel(float* dst, const SpanColor& c) noexcept
+{
+  for (int i = 0; i < 4; i++) {
+    dst[i] = clampChannel(dst[i] - c.original[i]);
+  }
+}
+
+/// The normal blend mode, as a type for @ref specializedSpan.
+struct NormalPixel final
+{
+  static inline void apply(float* dst, const SpanColor& c) noexcept { normalPixel(dst, c); }
+};
+
+/// The subtract blend mode, as a type for @ref specializedSpan.
+struct SubtractPixel final
+{
+  static inline void apply(float* dst, const SpanColor& c) noexcept { subtractPixel(dst, c); }
+};
+
+/// A span of pixels that is blended the way the painter did before its
+/// loops were specialized: the blend mode is kept next to the color
+/// and switched on for every pixel.
+struct GenericSpan final
+{
+  /// The blend mode of the span.
+  BlendMode mode = BlendMode::Normal;
+  /// The color to blend the span with.
+  SpanColor color;
+  /// Blends a single pixel.
+  void blendPixel(float* dst) const noexcept
+  {
+    switch (mode) {
+      case BlendMode::Normal:
+        normalPixel(dst, color);
+        break;
+      case BlendMode::Subtract:
+        subtractPixel(dst, color);
+        break;
+    }
+  }
+};
+
+/// Blends a span, switching on the blend mode for every pixel.
+void genericSpan(const GenericSpan& span, float* dst, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++, dst += 4) {
+    span.blendPixel(dst);
+  }
+}
+
+/// Blends a span with loops instantiated for a single blend mode,
+/// the way the painter does after one dispatch per node.
+template <typename Blender>
+void specializedSpan(const SpanColor& color, float* dst, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++, dst += 4) {
+    Blender::apply(dst, color);
+  }
+}
+
+/// Times the blending of a span of pixels, once with a switch on the
+/// blend mode for every pixel and once with loops instantiated for it.
+///
+/// @param name The name of the blend mode, which the benchmark names end with.
+template <typename Blender>
+void spanBench(Bench& bench, const std::string& name, BlendMode mode, float alpha)
+{
+  const std::size_t count = canvasSize() * canvasSize();
+
+  std::vector<float> pixels(count * 4);
+
+  GenericSpan span;
+  span.mode = mode;
+
+  for (int i = 0; i < 3; i++) {
+    span.color.original[i] = 0.25f * (i + 1);
+    span.color.premultiplied[i] = span.color.original[i] * alpha;
+  }
+
+  span.color.original[3] = alpha;
+  span.color.premultiplied[3] = alpha;
+
+  auto reset = [&pixels]() {
+    std::fill(pixels.begin(), pixels.end(), 0.5f);
+  };
+
+  bench.runWithSetup(("blend/generic/" + name).c_str(), count, reset, [&]() {
+    genericSpan(span, pixels.data(), count);
+  });
+
+  bench.runWithSetup(("blend/specialized/" + name).c_str(), count, reset, [&]() {
+    specializedSpan<Blender>(span.color, pixels.data(), count);
+  });
+}
+
+} // namespace
+
+void blendBenchmarks(Bench& bench)
+{
+  // The clear benchmark is the cost that the blend
+  // benchmarks have in common, since they clear first.
+
+  auto* empty = createDoc();
+
+  resizeDoc(empty, canvasSize(), canvasSize());
+
+  renderBench(bench, "clear", empty);
+
+  renderBench(bench, "blend/normal_opaque", makeCoveringPixel(BlendMode::Normal, 1));
+
+  renderBench(bench, "blend/normal_translucent", makeCoveringPixel(BlendMode::Normal, 0.5));
+
+  renderBench(bench, "blend/subtract", makeCoveringPixel(BlendMode::Subtract, 1));
+
+  // The span benchmarks compare the inner loops on their own, without
+  // the rest of the renderer, so that the per pixel switch is all that differs.
+
+  spanBench<NormalPixel>(bench, "normal_opaque", BlendMode::Normal, 1);
+
+  spanBench<NormalPixel>(bench, "normal_translucent", BlendMode::Normal, 0.5);
+
+  spanBench<SubtractPixel>(bench, "subtract", BlendMode::Subtract, 1);
+}
+
+} // namespace bench
+
+} // namespace px
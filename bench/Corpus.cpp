@@ -0,0 +1,283 @@
+#include "Corpus.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+#include <random>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace px {
+
+namespace bench {
+
+namespace {
+
+/// A color generated for a node.
+struct Color final
+{
+  float r;
+  float g;
+  float b;
+  float a;
+};
+
+/// A point generated for a node.
+struct Point final
+{
+  int x;
+  int y;
+};
+
+/// Generates the nodes of a document.
+/// Each random value is drawn in its own statement, since the
+/// order in which function arguments are evaluated is unspecified
+/// and would otherwise make documents differ between compilers.
+class Generator final
+{
+  /// The options of the document being generated.
+  const CorpusOptions& options;
+  /// The random number generator.
+  std::mt19937 rng;
+public:
+  /// Constructs a new generator.
+  ///
+  /// @param o The options of the document to generate.
+  Generator(const CorpusOptions& o) : options(o), rng(o.seed) {}
+  /// Generates the document.
+  Document* operator () ()
+  {
+    auto* doc = createDoc();
+
+    resizeDoc(doc, options.width, options.height);
+
+    auto bg = color();
+
+    setBackground(doc, bg.r, bg.g, bg.b, 1);
+
+    // A new document always has a single layer.
+
+    for (std::size_t i = 1; i < options.layerCount; i++) {
+      addLayer(doc);
+    }
+
+    for (std::size_t i = 0; i < options.layerCount; i++) {
+      for (std::size_t j = 0; j < options.nodesPerLayer; j++) {
+        addNode(doc, i);
+      }
+    }
+
+    return doc;
+  }
+protected:
+  /// Adds a random node to a layer.
+  void addNode(Document* doc, std::size_t layer)
+  {
+    if (real(0, 1) < options.fillDensity) {
+      auto* fill = addFill(doc, layer);
+      auto p = point();
+      auto c = color();
+      setFillOrigin(fill, p.x, p.y);
+      setColor(fill, c.r, c.g, c.b, c.a);
+      setBlendMode(fill, blendMode());
+      return;
+    }
+
+    switch (integer(0, 7)) {
+      case 0: {
+        auto* ellipse = addEllipse(doc, layer);
+        auto center = point();
+        int rx = integer(1, shapeSize());
+        int ry = integer(1, shapeSize());
+        auto c = color();
+        setCenter(ellipse, center.x, center.y);
+        setRadius(ellipse, rx, ry);
+        setPixelSize(ellipse, pixelSize());
+        setColor(ellipse, c.r, c.g, c.b, c.a);
+        setBlendMode(ellipse, blendMode());
+        break;
+      }
+      case 1: {
+        auto* quad = addQuad(doc, layer);
+        auto center = point();
+        for (std::size_t i = 0; i < 4; i++) {
+          int qx = center.x + integer(-shapeSize(), shapeSize());
+          int qy = center.y + integer(-shapeSize(), shapeSize());
+          setPoint(quad, i, qx, qy);
+        }
+        auto c = color();
+        setPixelSize(quad, pixelSize());
+        setColor(quad, c.r, c.g, c.b, c.a);
+        setBlendMode(quad, blendMode());
+        break;
+      }
+      default:
+        addStroke(doc, layer);
+        break;
+    }
+  }
+  /// Adds a line that is recorded like a mouse stroke.
+  void addStroke(Document* doc, std::size_t layer)
+  {
+    auto* line = addLine(doc, layer);
+
+    auto c = color();
+
+    setPixelSize(line, pixelSize());
+    setColor(line, c.r, c.g, c.b, c.a);
+    setBlendMode(line, blendMode());
+
+    auto count = std::size_t(integer(1, int(options.pointsPerLine * 2)));
+
+    auto p = point();
+
+    int px = p.x;
+    int py = p.y;
+
+    int dx = 0;
+    int dy = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+
+      // The direction only changes now and then, like a hand
+      // moving a mouse, and the mouse does not always move.
+
+      if (integer(0, 7) == 0) {
+        auto step = delta();
+        dx = step.x;
+        dy = step.y;
+      }
+
+      addPoint(line, px, py);
+
+      px = std::min(std::max(px + dx, 0), int(options.width) - 1);
+      py = std::min(std::max(py + dy, 0), int(options.height) - 1);
+    }
+  }
+  /// Generates a random color.
+  Color color()
+  {
+    Color c;
+    c.r = real(0, 1);
+    c.g = real(0, 1);
+    c.b = real(0, 1);
+    c.a = alpha();
+    return c;
+  }
+  /// Generates a point on the canvas.
+  Point point()
+  {
+    Point p;
+    p.x = integer(0, std::max(int(options.width) - 1, 0));
+    p.y = integer(0, std::max(int(options.height) - 1, 0));
+    return p;
+  }
+  /// Generates the direction of a stroke.
+  Point delta()
+  {
+    Point p;
+    p.x = integer(-2, 2);
+    p.y = integer(-2, 2);
+    return p;
+  }
+  /// Generates a blend mode, which is usually the normal blend mode.
+  BlendMode blendMode()
+  {
+    return (integer(0, 15) == 0) ? BlendMode::Subtract : BlendMode::Normal;
+  }
+  /// Generates an alpha value, which is usually opaque.
+  float alpha()
+  {
+    return (integer(0, 3) == 0) ? real(0.1f, 1) : 1;
+  }
+  /// Generates a pixel size within the range given by the options.
+  int pixelSize()
+  {
+    return integer(options.minPixelSize, std::max(options.minPixelSize, options.maxPixelSize));
+  }
+  /// Generates a shape size that is proportional to the canvas.
+  int shapeSize()
+  {
+    return std::max(1, int(std::min(options.width, options.height) / 8));
+  }
+  /// Generates an integer within an inclusive range.
+  int integer(int min, int max)
+  {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+  }
+  /// Generates a real number within a range.
+  float real(float min, float max)
+  {
+    return std::uniform_real_distribution<float>(min, max)(rng);
+  }
+};
+
+} // namespace
+
+Document* generateDoc(const CorpusOptions& options)
+{
+  return Generator(options)();
+}
+
+bool parseCorpusOption(int argc, char** argv, int& index, CorpusOptions& options)
+{
+  if ((index + 1) >= argc) {
+    return false;
+  }
+
+  const char* opt = argv[index];
+
+  const char* value = argv[index + 1];
+
+  auto size = std::size_t(std::strtoul(value, nullptr, 10));
+
+  if (std::strcmp(opt, "--seed") == 0) {
+    options.seed = (unsigned int) size;
+  } else if (std::strcmp(opt, "--width") == 0) {
+    options.width = size;
+  } else if (std::strcmp(opt, "--height") == 0) {
+    options.height = size;
+  } else if (std::strcmp(opt, "--size") == 0) {
+    options.width = size;
+    options.height = size;
+  } else if (std::strcmp(opt, "--layers") == 0) {
+    options.layerCount = std::max(size, std::size_t(1));
+  } else if (std::strcmp(opt, "--nodes") == 0) {
+    options.nodesPerLayer = size;
+  } else if (std::strcmp(opt, "--points") == 0) {
+    options.pointsPerLine = std::max(size, std::size_t(1));
+  } else if (std::strcmp(opt, "--min-pixel-size") == 0) {
+    options.minPixelSize = std::max(std::atoi(value), 1);
+  } else if (std::strcmp(opt, "--max-pixel-size") == 0) {
+    options.maxPixelSize = std::max(std::atoi(value), 1);
+  } else if (std::strcmp(opt, "--fill-density") == 0) {
+    options.fillDensity = float(std::atof(value));
+  } else {
+    return false;
+  }
+
+  index++;
+
+  return true;
+}
+
+void printCorpusHelp()
+{
+  std::fprintf(stderr, "Corpus options:\n");
+  std::fprintf(stderr, "  --seed <n>            The seed of the random number generator.\n");
+  std::fprintf(stderr, "  --width <n>           The width of the canvas.\n");
+  std::fprintf(stderr, "  --height <n>          The height of the canvas.\n");
+  std::fprintf(stderr, "  --size <n>            The width and height of the canvas.\n");
+  std::fprintf(stderr, "  --layers <n>          The number of layers.\n");
+  std::fprintf(stderr, "  --nodes <n>           The number of nodes per layer.\n");
+  std::fprintf(stderr, "  --points <n>          The average number of points per line.\n");
+  std::fprintf(stderr, "  --min-pixel-size <n>  The smallest pixel size of a node.\n");
+  std::fprintf(stderr, "  --max-pixel-size <n>  The largest pixel size of a node.\n");
+  std::fprintf(stderr, "  --fill-density <x>    The chance, from 0 to 1, that a node is a fill.\n");
+}
+
+} // namespace bench
+
+} // namespace px
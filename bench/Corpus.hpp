@@ -0,0 +1,65 @@
+#ifndef LIBPX_BENCH_CORPUS_HPP
+#define LIBPX_BENCH_CORPUS_HPP
+
+#include <cstddef>
+
+namespace px {
+
+struct Document;
+
+namespace bench {
+
+/// Describes the documents made by the corpus generator.
+/// With a given standard library, the same options
+/// and seed always make the same document.
+struct CorpusOptions final
+{
+  /// The seed of the random number generator.
+  unsigned int seed = 0;
+  /// The width of the canvas, in pixels.
+  std::size_t width = 256;
+  /// The height of the canvas, in pixels.
+  std::size_t height = 256;
+  /// The number of layers in the document.
+  std::size_t layerCount = 4;
+  /// The number of nodes in each layer.
+  std::size_t nodesPerLayer = 64;
+  /// The average number of points in each line.
+  std::size_t pointsPerLine = 64;
+  /// The smallest pixel size given to lines, ellipses and quads.
+  int minPixelSize = 1;
+  /// The largest pixel size given to lines, ellipses and quads.
+  int maxPixelSize = 4;
+  /// The chance, between zero and one, that a node is a fill.
+  float fillDensity = 0.02f;
+};
+
+/// Generates a document resembling one drawn by hand.
+/// Lines are recorded like mouse strokes, so they contain
+/// duplicate and collinear points, and shapes are scattered
+/// across the canvas with varying sizes and colors.
+///
+/// @param options Describes the document to generate.
+///
+/// @return A new document, which must be closed with @ref closeDoc.
+Document* generateDoc(const CorpusOptions& options);
+
+/// Parses a command line option that modifies the corpus options.
+///
+/// @param argc The number of command line arguments.
+/// @param argv The command line arguments.
+/// @param index The index of the option to parse. If the option
+/// has a value, this is moved to the index of the value.
+/// @param options The options to modify.
+///
+/// @return True if the option was recognized, false otherwise.
+bool parseCorpusOption(int argc, char** argv, int& index, CorpusOptions& options);
+
+/// Prints the help for the corpus command line options.
+void printCorpusHelp();
+
+} // namespace bench
+
+} // namespace px
+
+#endif // LIBPX_BENCH_CORPUS_HPP
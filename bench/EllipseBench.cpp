@@ -0,0 +1,49 @@
+#include "Bench.hpp"
+
+#include <libpx.hpp>
+
+namespace px {
+
+namespace bench {
+
+namespace {
+
+/// The width and height of the canvas that ellipses are drawn on.
+constexpr int canvasSize() noexcept
+{
+  return 256;
+}
+
+/// Creates a document of concentric ellipses.
+///
+/// @param pixelSize The pixel size to give the ellipses.
+Document* makeEllipses(int pixelSize)
+{
+  auto* doc = createDoc();
+
+  resizeDoc(doc, canvasSize(), canvasSize());
+
+  int center = canvasSize() / 2;
+
+  for (int r = 1; r < center; r++) {
+    auto* ellipse = addEllipse(doc);
+    setCenter(ellipse, center, center);
+    setRadius(ellipse, r, (r * 2) / 3);
+    setPixelSize(ellipse, pixelSize);
+    setColor(ellipse, 0.6, 0.3, 0.1, 1);
+  }
+
+  return doc;
+}
+
+} // namespace
+
+void ellipseBenchmarks(Bench& bench)
+{
+  renderBench(bench, "ellipse/pixel_size_1", makeEllipses(1));
+  renderBench(bench, "ellipse/pixel_size_4", makeEllipses(4));
+}
+
+} // namespace bench
+
+} // namespace px
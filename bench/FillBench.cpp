@@ -0,0 +1,142 @@
+#include "Bench.hpp"
+
+#include <libpx.hpp>
+
+#include <random>
+#include <vector>
+
+namespace px {
+
+namespace bench {
+
+namespace {
+
+/// The width and height of the canvas that fills are done on.
+constexpr int canvasSize() noexcept
+{
+  return 512;
+}
+
+/// Creates a document with a fill over an empty canvas.
+Document* makeOpenFill()
+{
+  auto* doc = createDoc();
+
+  resizeDoc(doc, canvasSize(), canvasSize());
+
+  auto* fill = addFill(doc);
+  setFillOrigin(fill, canvasSize() / 2, canvasSize() / 2);
+  setColor(fill, 0.1, 0.7, 0.3, 1);
+
+  return doc;
+}
+
+/// Creates a document with a fill inside of a maze.
+/// The maze is made of one pixel wide walls and corridors,
+/// which is the worst case for the number of fill spans.
+Document* makeMazeFill()
+{
+  auto* doc = createDoc();
+
+  resizeDoc(doc, canvasSize(), canvasSize());
+
+  // The cells of the maze are two pixels apart,
+  // so that there is a wall between each of them.
+
+  constexpr int cells = canvasSize() / 2;
+
+  std::vector<bool> visited(cells * cells);
+
+  std::vector<int> stack { 0 };
+
+  visited[0] = true;
+
+  std::mt19937 rng(42);
+
+  // Start with every wall in place and
+  // remove them while carving the maze.
+  std::vector<bool> open(canvasSize() * canvasSize());
+
+  open[0] = true;
+
+  while (!stack.empty()) {
+
+    int cell = stack.back();
+
+    int cx = cell % cells;
+    int cy = cell / cells;
+
+    int neighbors[4];
+    int neighborCount = 0;
+
+    const int dirs[4][2] { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    for (const auto& d : dirs) {
+      int nx = cx + d[0];
+      int ny = cy + d[1];
+      if ((nx >= 0) && (ny >= 0) && (nx < cells) && (ny < cells) && !visited[(ny * cells) + nx]) {
+        neighbors[neighborCount++] = (ny * cells) + nx;
+      }
+    }
+
+    if (!neighborCount) {
+      stack.pop_back();
+      continue;
+    }
+
+    int next = neighbors[std::uniform_int_distribution<int>(0, neighborCount - 1)(rng)];
+
+    int nx = next % cells;
+    int ny = next / cells;
+
+    open[((cy + ny) * canvasSize()) + (cx + nx)] = true;
+    open[((ny * 2) * canvasSize()) + (nx * 2)] = true;
+
+    visited[next] = true;
+
+    stack.push_back(next);
+  }
+
+  // Each row of walls becomes a line with a segment per wall run.
+
+  for (int y = 0; y < canvasSize(); y++) {
+
+    int x = 0;
+
+    while (x < canvasSize()) {
+
+      if (open[(y * canvasSize()) + x]) {
+        x++;
+        continue;
+      }
+
+      int begin = x;
+
+      while ((x < canvasSize()) && !open[(y * canvasSize()) + x]) {
+        x++;
+      }
+
+      auto* wall = addLine(doc);
+      addPoint(wall, begin, y);
+      addPoint(wall, x - 1, y);
+    }
+  }
+
+  auto* fill = addFill(doc);
+  setFillOrigin(fill, 0, 0);
+  setColor(fill, 0.1, 0.7, 0.3, 1);
+
+  return doc;
+}
+
+} // namespace
+
+void fillBenchmarks(Bench& bench)
+{
+  renderBench(bench, "fill/open", makeOpenFill());
+  renderBench(bench, "fill/maze", makeMazeFill());
+}
+
+} // namespace bench
+
+} // namespace px
@@ -0,0 +1,138 @@
+#include "Bench.hpp"
+
+#include <libpx.hpp>
+
+#include <random>
+#include <vector>
+
+namespace px {
+
+namespace bench {
+
+namespace {
+
+/// The width and height of the canvas that lines are drawn on.
+constexpr int canvasSize() noexcept
+{
+  return 256;
+}
+
+/// Creates a document containing lines in several directions.
+///
+/// @param pixelSize The pixel size to give the lines.
+Document* makeLines(int pixelSize)
+{
+  auto* doc = createDoc();
+
+  resizeDoc(doc, canvasSize(), canvasSize());
+
+  // Fewer lines are drawn at larger pixel sizes,
+  // so that each benchmark takes a similar amount of time.
+  int count = 256 / pixelSize;
+
+  int last = canvasSize() - 1;
+
+  for (int i = 0; i < count; i++) {
+
+    int offset = (i * last) / count;
+
+    auto* line = addLine(doc);
+    addPoint(line, 0, offset);
+    addPoint(line, last, last - offset);
+    addPoint(line, offset, 0);
+    setPixelSize(line, pixelSize);
+    setColor(line, 0.2, 0.4, 0.6, 0.8);
+  }
+
+  return doc;
+}
+
+/// Generates the points of a freehand stroke,
+/// as they would be recorded from a mouse.
+/// Many of the points are duplicates or lie on
+/// a straight line with their neighbors.
+///
+/// @param count The number of points to generate.
+std::vector<int> makeStroke(std::size_t count)
+{
+  std::mt19937 rng(1234);
+
+  std::uniform_int_distribution<int> direction(-1, 1);
+
+  std::uniform_int_distribution<int> runLength(1, 16);
+
+  std::vector<int> points;
+
+  int x = 0;
+  int y = 0;
+
+  while ((points.size() / 2) < count) {
+
+    int dx = direction(rng);
+    int dy = direction(rng);
+
+    for (int i = runLength(rng); (i > 0) && ((points.size() / 2) < count); i--) {
+      points.push_back(x);
+      points.push_back(y);
+      x += dx;
+      y += dy;
+    }
+  }
+
+  return points;
+}
+
+/// Times the removal of meaningless points from a stroke.
+///
+/// @param name The name of the benchmark.
+/// @param count The number of points in the stroke.
+void dissolveBench(Bench& bench, const char* name, std::size_t count)
+{
+  if (!bench.enabled(name)) {
+    return;
+  }
+
+  auto points = makeStroke(count);
+
+  auto* doc = createDoc();
+
+  auto* line = addLine(doc);
+
+  auto setup = [doc, &line, &points]() {
+
+    removeLayer(doc, 0);
+
+    addLayer(doc);
+
+    line = addLine(doc);
+
+    for (std::size_t i = 0; i < points.size(); i += 2) {
+      addPoint(line, points[i], points[i + 1]);
+    }
+  };
+
+  bench.runWithSetup(name, 0, setup, [&line]() {
+    dissolvePoints(line);
+  });
+
+  closeDoc(doc);
+}
+
+} // namespace
+
+void lineBenchmarks(Bench& bench)
+{
+  renderBench(bench, "line/pixel_size_1", makeLines(1));
+  renderBench(bench, "line/pixel_size_2", makeLines(2));
+  renderBench(bench, "line/pixel_size_4", makeLines(4));
+  renderBench(bench, "line/pixel_size_8", makeLines(8));
+  renderBench(bench, "line/pixel_size_16", makeLines(16));
+  renderBench(bench, "line/pixel_size_32", makeLines(32));
+
+  dissolveBench(bench, "dissolve/points_1k", 1024);
+  dissolveBench(bench, "dissolve/points_16k", 16384);
+}
+
+} // namespace bench
+
+} // namespace px
@@ -0,0 +1,65 @@
+#include "Bench.hpp"
+
+#include <fstream>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+bool isOpt(const char* arg, const char* s, const char* l) noexcept
+{
+  return (std::strcmp(arg, s) == 0) || (std::strcmp(arg, l) == 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  const char* filter = "";
+
+  const char* jsonPath = nullptr;
+
+  double minTime = 0.25;
+
+  for (int i = 1; i < argc; i++) {
+    if (isOpt(argv[i], "-h", "--help")) {
+      std::fprintf(stderr, "Usage: %s [options] [filter]\n", argv[0]);
+      std::fprintf(stderr, "Options:\n");
+      std::fprintf(stderr, "  -j, --json <path>      Write the results to <path> as JSON.\n");
+      std::fprintf(stderr, "  -t, --min-time <secs>  The minimum time to spend on each benchmark.\n");
+      return EXIT_FAILURE;
+    } else if (isOpt(argv[i], "-j", "--json") && ((i + 1) < argc)) {
+      jsonPath = argv[++i];
+    } else if (isOpt(argv[i], "-t", "--min-time") && ((i + 1) < argc)) {
+      minTime = std::atof(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      filter = argv[i];
+    } else {
+      std::fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  px::bench::Bench bench(filter, minTime);
+
+  px::bench::blendBenchmarks(bench);
+  px::bench::lineBenchmarks(bench);
+  px::bench::ellipseBenchmarks(bench);
+  px::bench::fillBenchmarks(bench);
+
+  if (jsonPath) {
+
+    std::ofstream file(jsonPath);
+
+    bench.writeJSON(file);
+
+    if (!file.good()) {
+      std::fprintf(stderr, "Failed to write '%s'\n", jsonPath);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
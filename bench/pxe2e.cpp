@@ -0,0 +1,435 @@
+#include "Corpus.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <cerrno>
+
+#if !defined(__linux__) && (defined(__unix__) || defined(__APPLE__))
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+/// The stages of the end-to-end benchmark, in the order they're run.
+enum class Stage : int
+{
+  Open,
+  Copy,
+  Render,
+  Save,
+  Close,
+  Count
+};
+
+const char* getStageName(Stage stage) noexcept
+{
+  switch (stage) {
+    case Stage::Open:
+      return "openDoc";
+    case Stage::Copy:
+      return "copyDoc";
+    case Stage::Render:
+      return "render";
+    case Stage::Save:
+      return "saveDoc";
+    case Stage::Close:
+      return "closeDoc";
+    case Stage::Count:
+      break;
+  }
+  return "";
+}
+
+/// Resets the peak memory usage of the process, if the platform allows it.
+void resetPeakMemory()
+{
+#if defined(__linux__)
+  std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+/// Gets the peak resident set size of the process, in bytes.
+/// On platforms where this can't be reset, it is the peak of the whole process.
+std::size_t getPeakMemory()
+{
+#if defined(__linux__)
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::size_t(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+    }
+  }
+  return 0;
+#elif defined(__APPLE__)
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return std::size_t(usage.ru_maxrss);
+#elif defined(__unix__)
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return std::size_t(usage.ru_maxrss) * 1024;
+#else
+  return 0;
+#endif
+}
+
+/// The measurements of a single stage.
+struct StageResult final
+{
+  /// The fastest time of the stage, in seconds.
+  double minTime = 0;
+  /// The average time of the stage, in seconds.
+  double meanTime = 0;
+  /// The peak resident set size during the stage, in bytes.
+  std::size_t peakMemory = 0;
+};
+
+/// The measurements of a single document.
+struct Result final
+{
+  /// The value of the swept option, or an empty string if there is no sweep.
+  std::string sweepValue;
+  /// The size of the saved document, in bytes.
+  std::size_t fileSize = 0;
+  /// The results of each stage.
+  StageResult stages[int(Stage::Count)];
+};
+
+/// Runs each stage of the end-to-end benchmark.
+class Runner final
+{
+  /// The path that the generated document is saved to.
+  std::string path;
+  /// The number of times each stage is run.
+  int iterations = 5;
+  /// Whether or not to render onto a tiled image.
+  bool tiled = false;
+  /// If non-zero, the document is rendered with
+  /// @ref px::renderRows using bands of this height.
+  std::size_t bandHeight = 0;
+  /// If non-zero, this many frames of the document
+  /// are rendered with @ref px::renderFrames.
+  std::size_t frameCount = 0;
+public:
+  Runner(const char* p, int i, bool t, std::size_t b, std::size_t f)
+    : path(p), iterations(std::max(i, 1)), tiled(t), bandHeight(b), frameCount(f) {}
+  /// Runs the benchmark on a generated document.
+  ///
+  /// @param options The options of the document to generate.
+  /// @param result The result to put the measurements into.
+  ///
+  /// @return True on success, false if the document couldn't be saved or opened.
+  bool run(const px::bench::CorpusOptions& options, Result& result)
+  {
+    auto* generated = px::bench::generateDoc(options);
+
+    std::size_t fileSize = 0;
+
+    void* data = nullptr;
+
+    px::saveDoc(generated, &data, &fileSize);
+
+    std::free(data);
+
+    bool saved = px::saveDoc(generated, path.c_str());
+
+    px::closeDoc(generated);
+
+    if (!saved) {
+      std::fprintf(stderr, "Failed to save '%s' (%s)\n", path.c_str(), std::strerror(errno));
+      return false;
+    }
+
+    result.fileSize = fileSize;
+
+    auto* context = px::createRenderContext();
+
+    auto* image = px::createImage(0, 0);
+
+    auto* tiledImage = px::createTiledImage(0, 0);
+
+    bool success = true;
+
+    for (int i = 0; (i < iterations) && success; i++) {
+      success = runOnce(context, image, tiledImage, result);
+    }
+
+    px::closeTiledImage(tiledImage);
+
+    px::closeImage(image);
+
+    px::closeRenderContext(context);
+
+    for (auto& stage : result.stages) {
+      stage.meanTime /= iterations;
+    }
+
+    return success;
+  }
+protected:
+  /// Runs each stage once.
+  bool runOnce(px::RenderContext* context, px::Image* image, px::TiledImage* tiledImage, Result& result)
+  {
+    px::Document* doc = nullptr;
+
+    px::Document* copy = nullptr;
+
+    int err = 0;
+
+    measure(Stage::Open, result, [this, &doc, &err]() {
+      doc = px::createDoc();
+      err = px::openDoc(doc, path.c_str());
+    });
+
+    if (err != 0) {
+      std::fprintf(stderr, "Failed to open '%s' (%s)\n", path.c_str(), std::strerror(err));
+      px::closeDoc(doc);
+      return false;
+    }
+
+    measure(Stage::Copy, result, [doc, &copy]() {
+      copy = px::copyDoc(doc);
+    });
+
+    measure(Stage::Render, result, [this, copy, context, image, tiledImage]() {
+      if (frameCount) {
+        px::renderFrames(copy, 0, frameCount - 1, [](void*, std::size_t, const float*, std::size_t, std::size_t) { return true; }, nullptr);
+      } else if (bandHeight) {
+        px::renderRows(copy, bandHeight, [](void*, std::size_t, std::size_t, const float*) { return true; }, nullptr, context);
+      } else if (tiled) {
+        px::render(copy, tiledImage, context);
+      } else {
+        px::render(copy, image, context);
+      }
+    });
+
+    measure(Stage::Save, result, [this, copy]() {
+      px::saveDoc(copy, path.c_str());
+    });
+
+    measure(Stage::Close, result, [doc, copy]() {
+      px::closeDoc(copy);
+      px::closeDoc(doc);
+    });
+
+    return true;
+  }
+  /// Measures the time and memory of a single stage.
+  template <typename Functor>
+  void measure(Stage stage, Result& result, Functor functor)
+  {
+    using Clock = std::chrono::steady_clock;
+
+    resetPeakMemory();
+
+    auto start = Clock::now();
+
+    functor();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    auto& s = result.stages[int(stage)];
+
+    s.minTime = (s.meanTime == 0) ? elapsed : std::min(s.minTime, elapsed);
+
+    s.meanTime += elapsed;
+
+    s.peakMemory = std::max(s.peakMemory, getPeakMemory());
+  }
+};
+
+void printResult(const Result& result, const char* sweepOption)
+{
+  if (sweepOption) {
+    std::printf("%s = %s (%zu bytes)\n", sweepOption, result.sweepValue.c_str(), result.fileSize);
+  } else {
+    std::printf("document (%zu bytes)\n", result.fileSize);
+  }
+
+  for (int i = 0; i < int(Stage::Count); i++) {
+
+    const auto& s = result.stages[i];
+
+    std::printf("  %-10s %12.3f ms min %12.3f ms mean %10.1f MiB peak RSS\n",
+                getStageName(Stage(i)),
+                s.minTime * 1e3,
+                s.meanTime * 1e3,
+                s.peakMemory / (1024.0 * 1024.0));
+  }
+}
+
+void writeJSON(std::ostream& stream, const std::vector<Result>& results, const char* sweepOption)
+{
+  stream << "{\"sweep\":\"" << (sweepOption ? sweepOption : "") << "\",\"results\":[";
+
+  for (std::size_t i = 0; i < results.size(); i++) {
+
+    const auto& r = results[i];
+
+    stream << (i ? ",\n" : "\n");
+    stream << "{\"value\":\"" << r.sweepValue << "\",\"file_size\":" << r.fileSize;
+
+    for (int j = 0; j < int(Stage::Count); j++) {
+      const auto& s = r.stages[j];
+      stream << ",\"" << getStageName(Stage(j)) << "\":{";
+      stream << "\"min_ns\":" << (s.minTime * 1e9);
+      stream << ",\"mean_ns\":" << (s.meanTime * 1e9);
+      stream << ",\"peak_rss\":" << s.peakMemory;
+      stream << "}";
+    }
+
+    stream << "}";
+  }
+
+  stream << "\n]}\n";
+}
+
+/// Splits a comma separated list of values.
+std::vector<std::string> split(const char* list)
+{
+  std::vector<std::string> values;
+
+  std::string value;
+
+  for (const char* c = list; *c; c++) {
+    if (*c == ',') {
+      values.emplace_back(std::move(value));
+      value.clear();
+    } else {
+      value.push_back(*c);
+    }
+  }
+
+  values.emplace_back(std::move(value));
+
+  return values;
+}
+
+bool isOpt(const char* arg, const char* s, const char* l) noexcept
+{
+  return (std::strcmp(arg, s) == 0) || (std::strcmp(arg, l) == 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  px::bench::CorpusOptions options;
+
+  const char* path = "px_e2e.px";
+
+  const char* jsonPath = nullptr;
+
+  const char* sweepOption = nullptr;
+
+  const char* sweepList = nullptr;
+
+  int iterations = 5;
+
+  bool tiled = false;
+
+  std::size_t bandHeight = 0;
+
+  std::size_t frameCount = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (isOpt(argv[i], "-h", "--help")) {
+      std::fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+      std::fprintf(stderr, "Options:\n");
+      std::fprintf(stderr, "  -f, --file <path>        Where to save the generated document.\n");
+      std::fprintf(stderr, "  -i, --iterations <n>     The number of times to run each stage.\n");
+      std::fprintf(stderr, "  -j, --json <path>        Write the results to <path> as JSON.\n");
+      std::fprintf(stderr, "  --tiled                  Render onto a tiled image instead of a dense one.\n");
+      std::fprintf(stderr, "  --band <rows>            Render bands of rows at a time, with renderRows.\n");
+      std::fprintf(stderr, "  --frames <count>         Render this many frames, with renderFrames.\n");
+      std::fprintf(stderr, "  --sweep <option> <list>  Run once for each comma separated value of a corpus option.\n");
+      std::fprintf(stderr, "                           Example: --sweep --nodes 100,1000,10000\n");
+      px::bench::printCorpusHelp();
+      return EXIT_FAILURE;
+    } else if (px::bench::parseCorpusOption(argc, argv, i, options)) {
+      continue;
+    } else if (isOpt(argv[i], "-f", "--file") && ((i + 1) < argc)) {
+      path = argv[++i];
+    } else if (isOpt(argv[i], "-i", "--iterations") && ((i + 1) < argc)) {
+      iterations = std::atoi(argv[++i]);
+    } else if (isOpt(argv[i], "-j", "--json") && ((i + 1) < argc)) {
+      jsonPath = argv[++i];
+    } else if (std::strcmp(argv[i], "--tiled") == 0) {
+      tiled = true;
+    } else if ((std::strcmp(argv[i], "--band") == 0) && ((i + 1) < argc)) {
+      bandHeight = std::size_t(std::strtoul(argv[++i], nullptr, 10));
+    } else if ((std::strcmp(argv[i], "--frames") == 0) && ((i + 1) < argc)) {
+      frameCount = std::size_t(std::strtoul(argv[++i], nullptr, 10));
+    } else if ((std::strcmp(argv[i], "--sweep") == 0) && ((i + 2) < argc)) {
+      sweepOption = argv[++i];
+      sweepList = argv[++i];
+    } else {
+      std::fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<std::string> sweepValues { "" };
+
+  if (sweepOption) {
+    sweepValues = split(sweepList);
+  }
+
+  Runner runner(path, iterations, tiled, bandHeight, frameCount);
+
+  std::vector<Result> results;
+
+  for (const auto& value : sweepValues) {
+
+    auto sweptOptions = options;
+
+    if (sweepOption) {
+
+      int index = 0;
+
+      char* sweepArgv[2] { const_cast<char*>(sweepOption), const_cast<char*>(value.c_str()) };
+
+      if (!px::bench::parseCorpusOption(2, sweepArgv, index, sweptOptions)) {
+        std::fprintf(stderr, "Unknown corpus option '%s'\n", sweepOption);
+        return EXIT_FAILURE;
+      }
+    }
+
+    Result result;
+
+    result.sweepValue = value;
+
+    if (!runner.run(sweptOptions, result)) {
+      return EXIT_FAILURE;
+    }
+
+    printResult(result, sweepOption);
+
+    results.emplace_back(std::move(result));
+  }
+
+  if (jsonPath) {
+
+    std::ofstream file(jsonPath);
+
+    writeJSON(file, results, sweepOption);
+
+    if (!file.good()) {
+      std::fprintf(stderr, "Failed to write '%s'\n", jsonPath);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
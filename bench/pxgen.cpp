@@ -0,0 +1,48 @@
+#include "Corpus.hpp"
+
+#include <libpx.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+  px::bench::CorpusOptions options;
+
+  const char* outputPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if ((std::strcmp(argv[i], "-h") == 0) || (std::strcmp(argv[i], "--help") == 0)) {
+      std::fprintf(stderr, "Usage: %s [options] <output.px>\n", argv[0]);
+      px::bench::printCorpusHelp();
+      return EXIT_FAILURE;
+    } else if (px::bench::parseCorpusOption(argc, argv, i, options)) {
+      continue;
+    } else if (argv[i][0] != '-') {
+      outputPath = argv[i];
+    } else {
+      std::fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!outputPath) {
+    std::fprintf(stderr, "No output path was given (see --help).\n");
+    return EXIT_FAILURE;
+  }
+
+  auto* doc = px::bench::generateDoc(options);
+
+  bool saved = px::saveDoc(doc, outputPath);
+
+  px::closeDoc(doc);
+
+  if (!saved) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", outputPath, std::strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
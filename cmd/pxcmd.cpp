@@ -1,8 +1,17 @@
 #include <libpx.hpp>
 
+#include <Animation.hpp>
+#include <Archive.hpp>
+#include <File.hpp>
+#include <Import.hpp>
+#include <Png.hpp>
+#include <Sink.hpp>
+#include <SpriteSheet.hpp>
+
 #include <string>
 #include <vector>
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -19,10 +28,306 @@ bool isOpt(const char* arg, const char* s, const char* l) noexcept
   return (std::strcmp(arg, s) == 0) || (std::strcmp(arg, l) == 0);
 }
 
-bool process(const char* filename)
+/// Contains the options passed from the command line.
+struct Options final
 {
-  px::Document* doc = px::createDoc();
+  /// Whether or not to render each document and print
+  /// the statistics of the render.
+  bool stats = false;
+  /// Whether or not to render each document into
+  /// a raw file of RGBA32F pixels, next to the document.
+  bool raw = false;
+  /// Whether or not to export a sprite
+  /// sheet of the layers in each document.
+  bool spriteSheet = false;
+  /// Describes how sprite sheets are built.
+  px::SpriteSheetOptions spriteSheetOptions;
+  /// Describes how PNG files are encoded.
+  px::PNGOptions pngOptions;
+  /// Whether or not to export each frame
+  /// of each document into a PNG file.
+  bool frames = false;
+  /// Whether or not to export each document, along
+  /// with its rendered layers, into a ZIP archive.
+  bool zip = false;
+  /// Describes how archives are exported.
+  px::ArchiveOptions archiveOptions;
+  /// Whether or not to export the frames of
+  /// each document into an animated GIF file.
+  bool gif = false;
+  /// Whether or not to export the frames of
+  /// each document into an animated PNG file.
+  bool apng = false;
+  /// Describes how animations are exported.
+  px::AnimationOptions animationOptions;
+  /// Whether or not to bake the layers of each document
+  /// and save it to '<file>-baked.px'.
+  bool bake = false;
+  /// The number of layers at the top of each
+  /// document that are left as they are when baking.
+  std::size_t unbakedLayers = 0;
+  /// Whether or not to save the documents
+  /// imported from PNG files as '.px' files.
+  bool import = false;
+  /// The path to save a trace of the program at.
+  /// If this is empty, no trace is recorded.
+  std::string tracePath;
+};
+
+/// Renders a document and prints the render statistics.
+///
+/// @param doc The document to render.
+/// @param filename The name of the file the document came from.
+void printStats(const px::Document* doc, const char* filename)
+{
+  px::Image* image = px::createImage(0, 0);
+
+  px::RenderContext* context = px::createRenderContext();
+
+  px::RenderStats* stats = px::createRenderStats();
+
+  px::render(doc, image, context, stats);
+
+  std::fprintf(stderr, "%s:\n", filename);
+
+  px::printRenderStatsToStderr(stats);
+
+  px::closeRenderStats(stats);
+  px::closeRenderContext(context);
+  px::closeImage(image);
+}
+
+/// Renders a document into a file of raw pixels.
+/// The image is mapped to the file, so the pixels
+/// are written straight into it by the render.
+///
+/// @param doc The document to render.
+/// @param filename The name of the file the document came from.
+/// The pixels are saved to this name with '.raw' appended.
+///
+/// @return True on success, false on failure.
+bool renderRaw(const px::Document* doc, const char* filename)
+{
+  std::string rawPath = std::string(filename) + ".raw";
+
+  px::Image* image = px::createImageMapped(rawPath.c_str(), 0, 0, px::PixelFormat::RGBA32F);
+  if (!image) {
+    std::fprintf(stderr, "Failed to map '%s' (%s)\n", rawPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  px::RenderContext* context = px::createRenderContext();
+
+  bool success = px::render(doc, image, context);
+  if (!success) {
+    std::fprintf(stderr, "Failed to resize '%s'\n", rawPath.c_str());
+  }
+
+  px::closeRenderContext(context);
+  px::closeImage(image);
+
+  return success;
+}
+
+/// Gets the name of a document file without the '.px' extension.
+std::string getBasePath(const char* filename)
+{
+  std::string base(filename);
+
+  if ((base.size() > 3) && (base.compare(base.size() - 3, 3, ".px") == 0)) {
+    base.resize(base.size() - 3);
+  }
+
+  return base;
+}
+
+/// Gets the part of a path after the last slash.
+std::string getFileName(const std::string& path)
+{
+  auto slash = path.find_last_of("/\\");
+
+  return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+/// Exports a sprite sheet of the layers in a document.
+/// The sheet is saved to '<file>.png' and its metadata
+/// is saved to '<file>.json', where '<file>' is the name
+/// of the document file without the '.px' extension.
+///
+/// @param doc The document to export the sprite sheet of.
+/// @param filename The name of the file the document came from.
+/// @param options Describes how to build the sprite sheet.
+/// @param pngOptions Describes how to encode the sprite sheet.
+///
+/// @return True on success, false on failure.
+bool exportSpriteSheet(const px::Document* doc,
+                       const char* filename,
+                       const px::SpriteSheetOptions& options,
+                       const px::PNGOptions& pngOptions)
+{
+  auto base = getBasePath(filename);
+
+  std::string pngPath = base + ".png";
+
+  std::string jsonPath = base + ".json";
+
+  auto sheet = px::buildSpriteSheet(doc, options);
+
+  px::FileSink pngSink;
+
+  if (!pngSink.open(pngPath.c_str())
+   || !px::writePNG(pngSink, sheet.colorBuffer.data(), sheet.width, sheet.height, pngOptions)
+   || !pngSink.close()) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", pngPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  // The image is referred to relative to the metadata file.
+  auto imageName = getFileName(pngPath);
+
+  if (!px::writeFile(jsonPath.c_str(), px::formatSpriteSheetJSON(sheet, imageName.c_str()))) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", jsonPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/// Writes the frames passed by @ref px::renderFrames to PNG files.
+struct FrameWriter final
+{
+  /// The path of the files, without the frame index and extension.
+  std::string base;
+  /// Describes how the frames are encoded.
+  px::PNGOptions pngOptions;
+};
+
+/// Writes a frame to '<base>-<frame>.png'.
+bool writeFrame(void* data, std::size_t frame, const float* colors, std::size_t w, std::size_t h)
+{
+  const auto* writer = static_cast<const FrameWriter*>(data);
+
+  char suffix[32];
+
+  std::snprintf(suffix, sizeof(suffix), "-%03lu.png", (unsigned long) frame);
+
+  std::string path = writer->base + suffix;
+
+  px::FileSink sink;
+
+  if (!sink.open(path.c_str())
+   || !px::writePNG(sink, colors, w, h, writer->pngOptions)
+   || !sink.close()) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/// Exports each frame of a document into a PNG file, which is saved
+/// to '<file>-<frame>.png'. The frames are rendered on several threads,
+/// while the finished ones are encoded on the calling thread.
+///
+/// @param doc The document to export the frames of.
+/// @param filename The name of the file the document came from.
+/// @param pngOptions Describes how to encode the frames.
+/// @param threadCount The number of threads to render the frames on.
+///
+/// @return True on success, false on failure.
+bool exportFrames(const px::Document* doc,
+                  const char* filename,
+                  const px::PNGOptions& pngOptions,
+                  std::size_t threadCount)
+{
+  FrameWriter writer { getBasePath(filename), pngOptions };
+
+  // The frames are encoded while others are rendered,
+  // so the encoder gets a thread of its own.
+  writer.pngOptions.threadCount = 1;
+
+  return px::renderFrames(doc, 0, px::getFrameCount(doc) - 1, writeFrame, &writer, nullptr, threadCount);
+}
+
+/// Exports a document into a ZIP archive, which is
+/// saved to '<file>.zip'. See @ref px::exportArchive
+/// for the contents of the archive.
+///
+/// @param doc The document to export.
+/// @param filename The name of the file the document came from.
+/// @param options Describes how the archive is exported.
+///
+/// @return True on success, false on failure.
+bool exportZip(const px::Document* doc, const char* filename, const px::ArchiveOptions& options)
+{
+  auto base = getBasePath(filename);
+
+  std::string zipPath = base + ".zip";
+
+  px::FileSink sink;
+
+  if (!sink.open(zipPath.c_str())) {
+    std::fprintf(stderr, "Failed to open '%s' (%s)\n", zipPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  if (!px::exportArchive(doc, getFileName(base), sink, options)) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", zipPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/// The type of function used to export an animation.
+using AnimationExporter = bool (*)(const px::Document*, px::Sink&, const px::AnimationOptions&);
 
+/// Exports the frames of a document into an
+/// animation, which is saved to '<file><extension>'.
+///
+/// @param doc The document to export.
+/// @param filename The name of the file the document came from.
+/// @param extension The extension of the animation file.
+/// @param exporter The function that encodes the animation.
+/// @param options Describes how the animation is exported.
+///
+/// @return True on success, false on failure.
+bool exportAnimation(const px::Document* doc,
+                     const char* filename,
+                     const char* extension,
+                     AnimationExporter exporter,
+                     const px::AnimationOptions& options)
+{
+  std::string path = getBasePath(filename) + extension;
+
+  px::FileSink sink;
+
+  if (!sink.open(path.c_str())) {
+    std::fprintf(stderr, "Failed to open '%s' (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  if (!exporter(doc, sink, options) || !sink.close()) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/// Indicates whether a file name ends with an extension.
+bool hasExtension(const std::string& filename, const char* extension)
+{
+  auto size = std::strlen(extension);
+
+  return (filename.size() > size) && (filename.compare(filename.size() - size, size, extension) == 0);
+}
+
+/// Opens a document file.
+///
+/// @return True on success, false on failure.
+bool openDocument(px::Document* doc, const char* filename)
+{
   px::ErrorList* errList = nullptr;
 
   int err = px::openDoc(doc, filename, &errList);
@@ -33,13 +338,133 @@ bool process(const char* filename)
     } else {
       std::fprintf(stderr, "Failed to open '%s' (%s)\n", filename, std::strerror(err));
     }
+    return false;
+  }
+
+  return true;
+}
+
+/// Imports a PNG file into a document the size of the image.
+///
+/// @param doc The document to import the image into.
+/// @param filename The name of the PNG file.
+/// @param save Whether or not to save the document
+/// next to the PNG file, with the '.px' extension.
+///
+/// @return True on success, false on failure.
+bool importImage(px::Document* doc, const char* filename, bool save)
+{
+  errno = 0;
+
+  px::Bitmap* bitmap = px::importPNG(doc, filename);
+  if (!bitmap) {
+    if (errno) {
+      std::fprintf(stderr, "Failed to open '%s' (%s)\n", filename, std::strerror(errno));
+    } else {
+      std::fprintf(stderr, "Failed to decode '%s'\n", filename);
+    }
+    return false;
+  }
+
+  px::resizeDoc(doc, px::getBitmapWidth(bitmap), px::getBitmapHeight(bitmap));
+
+  if (!save) {
+    return true;
+  }
+
+  std::string path(filename);
+
+  path.replace(path.size() - 4, 4, ".px");
+
+  if (!px::saveDoc(doc, path.c_str())) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/// Bakes every layer of a document but the top ones
+/// into bitmaps and saves it to '<file>-baked.px'.
+/// Layers that can't be baked are left as they are.
+///
+/// @param doc The document to bake the layers of.
+/// @param filename The name of the file the document came from.
+/// @param unbakedLayers The number of layers at the top to leave as they are.
+///
+/// @return True on success, false on failure.
+bool bakeLayers(px::Document* doc, const char* filename, std::size_t unbakedLayers)
+{
+  auto layerCount = px::getLayerCount(doc);
+
+  auto bakedCount = (layerCount > unbakedLayers) ? (layerCount - unbakedLayers) : 0;
+
+  for (std::size_t i = 0; i < bakedCount; i++) {
+    if (!px::bakeLayer(doc, i)) {
+      std::fprintf(stderr, "%s: Layer %lu could not be baked.\n", filename, (unsigned long) i);
+    }
+  }
+
+  std::string path = getBasePath(filename) + "-baked.px";
+
+  if (!px::saveDoc(doc, path.c_str())) {
+    std::fprintf(stderr, "Failed to save '%s' (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+bool process(const char* filename, const Options& options)
+{
+  px::Document* doc = px::createDoc();
+
+  auto opened = hasExtension(filename, ".png")
+    ? importImage(doc, filename, options.import)
+    : openDocument(doc, filename);
+
+  if (!opened) {
     px::closeDoc(doc);
     return false;
   }
 
+  auto success = true;
+
+  if (options.bake) {
+    success &= bakeLayers(doc, filename, options.unbakedLayers);
+  }
+
+  if (options.stats) {
+    printStats(doc, filename);
+  }
+
+  if (options.raw) {
+    success &= renderRaw(doc, filename);
+  }
+
+  if (options.spriteSheet) {
+    success &= exportSpriteSheet(doc, filename, options.spriteSheetOptions, options.pngOptions);
+  }
+
+  if (options.frames) {
+    success &= exportFrames(doc, filename, options.pngOptions, options.archiveOptions.threadCount);
+  }
+
+  if (options.zip) {
+    success &= exportZip(doc, filename, options.archiveOptions);
+  }
+
+  if (options.gif) {
+    success &= exportAnimation(doc, filename, ".gif", px::exportGIF, options.animationOptions);
+  }
+
+  if (options.apng) {
+    success &= exportAnimation(doc, filename, ".apng", px::exportAPNG, options.animationOptions);
+  }
+
   px::closeDoc(doc);
 
-  return true;
+  return success;
 }
 
 } // namespace
@@ -48,10 +473,80 @@ int main(int argc, char** argv)
 {
   std::vector<std::string> nonOpts;
 
+  Options options;
+
   for (int i = 1; i < argc; i++) {
     if (isOpt(argv[i], "-h", "--help")) {
       std::fprintf(stderr, "Usage: %s [options] <files>\n", argv[0]);
+      std::fprintf(stderr, "PNG files are imported into a document the size of the image.\n");
+      std::fprintf(stderr, "Options:\n");
+      std::fprintf(stderr, "  -a, --apng          Export the frames of each document to '<file>.apng'.\n");
+      std::fprintf(stderr, "  -b, --bake <n>      Bake all but the top <n> layers of each document and save it to '<file>-baked.px'.\n");
+      std::fprintf(stderr, "  -F, --frames        Export each frame of each document to '<file>-<frame>.png'.\n");
+      std::fprintf(stderr, "  -f, --sheet-frames  Make the sprites of sprite sheets the frames of each document, rather than its layers.\n");
+      std::fprintf(stderr, "  -g, --gif           Export the frames of each document to '<file>.gif'.\n");
+      std::fprintf(stderr, "  -I, --import        Save each imported PNG file '<file>.png' to '<file>.px'.\n");
+      std::fprintf(stderr, "  -i, --indexed       Write PNG files with a palette of up to 256 colors.\n");
+      std::fprintf(stderr, "  -j, --threads <n>   The number of threads to use (default: one per processor).\n");
+      std::fprintf(stderr, "  -l, --level <n>     The PNG compression level, from 0 (none) to 9 (default: 6).\n");
+      std::fprintf(stderr, "  -P, --palette       Share one palette between the frames of GIF files.\n");
+      std::fprintf(stderr, "  -p, --padding <n>   The number of pixels between sprites (default: 1).\n");
+      std::fprintf(stderr, "  -r, --raw           Render each document into '<file>.raw' as RGBA32F pixels.\n");
+      std::fprintf(stderr, "  -S, --sprite-sheet  Export the layers of each document to '<file>.png' and '<file>.json'.\n");
+      std::fprintf(stderr, "  -s, --stats         Render each document and print the render statistics.\n");
+      std::fprintf(stderr, "  -t, --trace <path>  Save a Chrome trace of the program at <path>.\n");
+      std::fprintf(stderr, "  -z, --zip           Export each document and its layers to '<file>.zip'.\n");
       return EXIT_FAILURE;
+    } else if (isOpt(argv[i], "-a", "--apng")) {
+      options.apng = true;
+    } else if (isOpt(argv[i], "-F", "--frames")) {
+      options.frames = true;
+    } else if (isOpt(argv[i], "-f", "--sheet-frames")) {
+      options.spriteSheetOptions.frames = true;
+    } else if (isOpt(argv[i], "-g", "--gif")) {
+      options.gif = true;
+    } else if (isOpt(argv[i], "-I", "--import")) {
+      options.import = true;
+    } else if (isOpt(argv[i], "-i", "--indexed")) {
+      options.pngOptions.indexed = true;
+    } else if (isOpt(argv[i], "-P", "--palette")) {
+      options.animationOptions.globalPalette = true;
+    } else if (isOpt(argv[i], "-r", "--raw")) {
+      options.raw = true;
+    } else if (isOpt(argv[i], "-S", "--sprite-sheet")) {
+      options.spriteSheet = true;
+    } else if (isOpt(argv[i], "-j", "--threads") || isOpt(argv[i], "-p", "--padding") || isOpt(argv[i], "-l", "--level") || isOpt(argv[i], "-b", "--bake")) {
+      if ((i + 1) >= argc) {
+        std::fprintf(stderr, "Option '%s' requires a number.\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+      auto value = std::size_t(std::strtoul(argv[i + 1], nullptr, 10));
+      if (isOpt(argv[i], "-j", "--threads")) {
+        options.spriteSheetOptions.threadCount = value;
+        options.archiveOptions.threadCount = value;
+        options.pngOptions.threadCount = value;
+        options.animationOptions.threadCount = value;
+      } else if (isOpt(argv[i], "-l", "--level")) {
+        options.pngOptions.level = int(value);
+        options.archiveOptions.level = int(value);
+        options.animationOptions.level = int(value);
+      } else if (isOpt(argv[i], "-b", "--bake")) {
+        options.bake = true;
+        options.unbakedLayers = value;
+      } else {
+        options.spriteSheetOptions.padding = value;
+      }
+      i++;
+    } else if (isOpt(argv[i], "-z", "--zip")) {
+      options.zip = true;
+    } else if (isOpt(argv[i], "-s", "--stats")) {
+      options.stats = true;
+    } else if (isOpt(argv[i], "-t", "--trace")) {
+      if ((i + 1) >= argc) {
+        std::fprintf(stderr, "Option '%s' requires a path.\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+      options.tracePath = argv[++i];
     } else if (isNonOpt(argv[i])) {
       nonOpts.emplace_back(argv[i]);
     } else {
@@ -65,10 +560,17 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
+  px::setTracingEnabled(!options.tracePath.empty());
+
   auto success = true;
 
   for (const auto& filename : nonOpts) {
-    success &= process(filename.c_str());
+    success &= process(filename.c_str(), options);
+  }
+
+  if (!options.tracePath.empty() && !px::saveTrace(options.tracePath.c_str())) {
+    std::fprintf(stderr, "Failed to save trace to '%s' (%s)\n", options.tracePath.c_str(), std::strerror(errno));
+    success = false;
   }
 
   return success ? EXIT_SUCCESS : EXIT_FAILURE;
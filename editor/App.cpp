@@ -19,6 +19,12 @@
 
 #include <libpx.hpp>
 
+#include <Animation.hpp>
+#include <Archive.hpp>
+#include <Png.hpp>
+#include <Sink.hpp>
+#include <SpriteSheet.hpp>
+
 #include <imgui.h>
 
 #include <glm/glm.hpp>
@@ -47,6 +53,9 @@ class AppImpl final : public App,
   /// A pointer to the image that the
   /// document is rendered to.
   Image* image = nullptr;
+  /// Holds the scratch memory used when
+  /// rendering the document each frame.
+  RenderContext* renderContext = nullptr;
   /// The stack of app states.
   /// The last element is the top of the stack.
   std::vector<std::unique_ptr<AppState>> stateStack;
@@ -64,13 +73,14 @@ class AppImpl final : public App,
   int documentID = -1;
 public:
   /// Constructs a new app instance.
-  AppImpl(Platform* p) : App(p), image(createImage(64, 64))
+  AppImpl(Platform* p) : App(p), image(createImage(64, 64)), renderContext(createRenderContext())
   {
     AppStorage::init(this);
   }
   /// Releases memory allocated by the app.
   ~AppImpl()
   {
+    closeRenderContext(renderContext);
     closeImage(image);
   }
   /// Gets a pointer the log.
@@ -108,6 +118,11 @@ public:
   {
     return image;
   }
+  /// Gets a pointer to the render context.
+  RenderContext* getRenderContext() noexcept override
+  {
+    return renderContext;
+  }
   /// Gets a pointer to the menu bar.
   const MenuBar* getMenuBar() const noexcept override
   {
@@ -249,22 +264,17 @@ public:
     AppStorage::removeDocument(id);
     AppStorage::syncToDevice(this);
   }
-  /// Resizes the currently opened document and image.
+  /// Resizes the currently opened document.
+  /// The image follows on the next render.
   void resizeDocument(std::size_t w, std::size_t h) override
   {
     // note : no stash or snapshot
 
     resizeDoc(getDocument(), w, h);
-
-    resizeImage(image, w, h);
   }
   /// Synchronizes all editor data with new document data.
   void syncDocument()
   {
-    const auto* doc = history.getDocument();
-
-    resizeImage(image, getDocWidth(doc), getDocHeight(doc));
-
     for (auto& state : stateStack) {
       state->syncDocument(getDocument());
     }
@@ -276,6 +286,8 @@ protected:
   /// Exceptions are checked by the calling function.
   void uncheckedFrame()
   {
+    beginTraceEvent("frame");
+
     const auto& bg = ImGui::GetStyleColorVec4(ImGuiCol_WindowBg);
 
     auto* renderer = getPlatform()->getRenderer();
@@ -306,6 +318,8 @@ protected:
         stateStack.pop_back();
       }
     }
+
+    endTraceEvent("frame");
   }
   /// Observes a menu bar event.
   void observe(MenuBar::Event event) override
@@ -324,11 +338,25 @@ protected:
         saveDocumentToLocalStorage();
         break;
       case MenuBar::Event::ClickedExportSpriteSheet:
+        exportSpriteSheet(false);
+        break;
+      case MenuBar::Event::ClickedExportFrameSheet:
+        exportSpriteSheet(true);
         break;
       case MenuBar::Event::ClickedExportZip:
+        exportZip();
         break;
       case MenuBar::Event::ClickedExportCurrentFrame:
-        exportCurrentFrame();
+        exportCurrentFrame(false);
+        break;
+      case MenuBar::Event::ClickedExportIndexedFrame:
+        exportCurrentFrame(true);
+        break;
+      case MenuBar::Event::ClickedExportGIF:
+        exportAnimation(".gif", exportGIF);
+        break;
+      case MenuBar::Event::ClickedExportAPNG:
+        exportAnimation(".apng", exportAPNG);
         break;
       case MenuBar::Event::ClickedRedo:
         redo();
@@ -418,12 +446,80 @@ protected:
     std::free(data);
   }
   /// Writes a PNG file containing the current frame.
-  void exportCurrentFrame()
+  ///
+  /// @param indexed Whether or not the file is written with a palette,
+  /// which makes it several times smaller for most pixel art.
+  void exportCurrentFrame(bool indexed)
   {
-    Blob blob = formatPNG(image);
+    PNGOptions options;
+
+    options.indexed = indexed;
+
+    Blob blob = formatPNG(image, options);
 
     LocalStorage::save("Untitled.png", blob.data(), blob.size());
   }
+  /// Writes a sprite sheet of the document layers or frames,
+  /// along with a JSON file describing the sprites.
+  ///
+  /// @param frames Whether the sprites are the frames of
+  /// the document, rather than its layers.
+  void exportSpriteSheet(bool frames)
+  {
+    SpriteSheetOptions options;
+
+    options.frames = frames;
+
+    std::string docName = AppStorage::getDocumentName(documentID);
+
+    std::string pngName = docName + ".png";
+
+    std::string jsonName = docName + ".json";
+
+    auto sheet = buildSpriteSheet(getDocument(), options);
+
+    auto pngSink = LocalStorage::open(pngName.c_str());
+
+    if (!pngSink
+     || !writePNG(*pngSink, sheet.colorBuffer.data(), sheet.width, sheet.height)
+     || !pngSink->close()) {
+      log.logError("Failed to export '", pngName, "'");
+      return;
+    }
+
+    auto json = formatSpriteSheetJSON(sheet, pngName.c_str());
+
+    LocalStorage::save(jsonName.c_str(), json.data(), json.size());
+  }
+  /// Writes a ZIP archive containing the document,
+  /// its rendered layers and a metadata file.
+  void exportZip()
+  {
+    std::string docName = AppStorage::getDocumentName(documentID);
+
+    std::string zipName = docName + ".zip";
+
+    auto sink = LocalStorage::open(zipName.c_str());
+
+    if (!sink || !exportArchive(getDocument(), docName, *sink)) {
+      log.logError("Failed to export '", zipName, "'");
+    }
+  }
+  /// Writes the frames of the document as an animation,
+  /// so that it can be shared as a preview.
+  ///
+  /// @param extension The file extension of the animation.
+  /// @param exporter The function that encodes the animation.
+  void exportAnimation(const char* extension, bool (*exporter)(const Document*, Sink&, const AnimationOptions&))
+  {
+    std::string fileName = AppStorage::getDocumentName(documentID) + extension;
+
+    auto sink = LocalStorage::open(fileName.c_str());
+
+    if (!sink || !exporter(getDocument(), *sink, AnimationOptions()) || !sink->close()) {
+      log.logError("Failed to export '", fileName, "'");
+    }
+  }
   /// Discards changes made to a document.
   ///
   /// This function will delete the stash for the opened
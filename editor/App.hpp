@@ -7,6 +7,7 @@ namespace px {
 
 struct Document;
 struct Image;
+struct RenderContext;
 
 struct KeyEvent;
 struct MouseButtonEvent;
@@ -54,6 +55,9 @@ public:
   virtual Image* getImage() noexcept = 0;
   /// Gets a pointer to the latest rendered image.
   virtual const Image* getImage() const noexcept = 0;
+  /// Gets a pointer to the render context that
+  /// the document is rendered with.
+  virtual RenderContext* getRenderContext() noexcept = 0;
   /// Gets a pointer to the platform hosting the app.
   ///
   /// @return A pointer to the platform for non-const access.
@@ -115,6 +115,10 @@ void DrawPanel::toolProperties(Observer* observer)
       observer->observe(Event::ChangedPixelSize);
     }
 
+    if (ImGui::Checkbox("Fill Shapes", &fillShapes)) {
+      observer->observe(Event::ChangedFillShapes);
+    }
+
     if (ImGui::ColorEdit4("Primary Color", primaryColor)) {
       observer->observe(Event::ChangedPrimaryColor);
     }
@@ -29,6 +29,7 @@ public:
     ChangedBlendMode,
     ChangedPrimaryColor,
     ChangedPixelSize,
+    ChangedFillShapes,
     ChangedTool
   };
   /// An interface to observe events from the draw panel.
@@ -49,6 +50,8 @@ private:
   int pixelSize = 1;
   /// How strokes should be blended.
   BlendMode blendMode = BlendMode::Normal;
+  /// Whether rectangles and ellipses are filled.
+  bool fillShapes = false;
 public:
   /// Renders the draw panel.
   ///
@@ -89,6 +92,11 @@ public:
   {
     return blendMode;
   }
+  /// Indicates whether rectangles and ellipses are filled.
+  inline bool getFillShapes() const noexcept
+  {
+    return fillShapes;
+  }
 protected:
   /// Renders the available tools.
   void availableTools(Observer*);
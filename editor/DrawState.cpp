@@ -19,6 +19,8 @@
 
 #include <libpx.hpp>
 
+#include <WorkerPool.hpp>
+
 #include <imgui.h>
 #include <imgui_stdlib.h>
 
@@ -27,9 +29,12 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 #include <cstdio>
+#include <cstring>
 
 namespace px {
 
@@ -146,6 +151,232 @@ protected:
   }
 };
 
+/// The panel below the image, used for choosing
+/// the frame being edited and for playing the frames.
+class TimelinePanel final
+{
+  /// The frame that is shown and edited.
+  std::size_t currentFrame = 0;
+  /// Whether or not the frames are being played.
+  bool playing = false;
+  /// The time that the current frame has been shown
+  /// for while playing, in seconds.
+  float frameTime = 0;
+  /// Whether or not the neighboring frames are shown under the current one.
+  bool onionSkinEnabled = false;
+  /// The number of frames shown on each side of the current one.
+  int onionSkinRange = 1;
+public:
+  /// Renders the timeline panel.
+  void operator () (App* app)
+  {
+    auto* doc = app->getDocument();
+
+    // The frame count may have changed from an undo.
+    currentFrame = std::min(currentFrame, getFrameCount(doc) - 1);
+
+    if (playing) {
+      advance(doc);
+    }
+
+    ImGui::Begin("##timeline", nullptr, windowFlags());
+
+    if (ImGui::Button(playing ? "Pause" : "Play")) {
+      playing = !playing;
+      frameTime = 0;
+    }
+
+    ImGui::SameLine();
+
+    auto frame = int(currentFrame);
+
+    if (ImGui::SliderInt("Frame", &frame, 0, int(getFrameCount(doc)) - 1)) {
+      currentFrame = std::size_t(std::max(frame, 0));
+    }
+
+    ImGui::Checkbox("Onion Skin", &onionSkinEnabled);
+
+    ImGui::SameLine();
+
+    ImGui::SliderInt("Onion Skin Range", &onionSkinRange, 1, 4);
+
+    auto frameCount = int(getFrameCount(doc));
+
+    if (ImGui::InputInt("Frame Count", &frameCount)) {
+      app->snapshotDocument();
+      setFrameCount(doc, std::size_t(std::max(frameCount, 1)));
+      app->stashDocument();
+    }
+
+    auto frameRate = int(getFrameRate(doc));
+
+    if (ImGui::InputInt("Frame Rate", &frameRate)) {
+      app->snapshotDocument();
+      setFrameRate(doc, std::size_t(std::max(frameRate, 1)));
+      app->stashDocument();
+    }
+
+    ImGui::End();
+  }
+  /// Gets the frame that is shown and edited.
+  std::size_t getFrame() const noexcept
+  {
+    return currentFrame;
+  }
+  /// Indicates whether or not the frames are being played.
+  bool isPlaying() const noexcept
+  {
+    return playing;
+  }
+  /// Gets the number of frames to show on each side of the current
+  /// one, which is zero if the onion skin is not shown.
+  /// It's not shown while playing, since it would only flicker.
+  std::size_t getOnionSkinRange() const noexcept
+  {
+    return (onionSkinEnabled && !playing) ? std::size_t(onionSkinRange) : 0;
+  }
+protected:
+  /// Moves the playback ahead by the time since the last GUI frame.
+  void advance(const Document* doc)
+  {
+    auto period = 1.0f / float(getFrameRate(doc));
+
+    frameTime += ImGui::GetIO().DeltaTime;
+
+    while (frameTime >= period) {
+      frameTime -= period;
+      currentFrame = (currentFrame + 1) % getFrameCount(doc);
+    }
+  }
+  /// Gets the window flags used to create
+  /// the timeline panel window.
+  static constexpr ImGuiWindowFlags windowFlags()
+  {
+    return ImGuiWindowFlags_AlwaysAutoResize;
+  }
+};
+
+/// The most memory used by the frames cached for playback and
+/// scrubbing, which is enough for a few hundred frames of a
+/// typical sprite.
+constexpr std::size_t frameCacheBudget() noexcept
+{
+  return std::size_t(256) * 1024 * 1024;
+}
+
+/// The number of frames rendered ahead of the
+/// current one while playing, when they aren't cached.
+constexpr std::size_t playbackLookahead() noexcept
+{
+  return 8;
+}
+
+/// The frame of a document to copy into the image shown by the editor.
+struct FrameCopy final
+{
+  /// The image to copy the frame into.
+  Image* image = nullptr;
+  /// The frame to copy.
+  std::size_t frame = 0;
+};
+
+/// Copies a frame passed by @ref renderFrames into the image of the editor.
+bool copyFrame(void* data, std::size_t, const float* colors, std::size_t w, std::size_t h)
+{
+  auto* frameCopy = static_cast<FrameCopy*>(data);
+
+  try {
+    resizeImage(frameCopy->image, w, h);
+  } catch (...) {
+    return false;
+  }
+
+  std::memcpy(getColorBuffer(frameCopy->image), colors, w * h * 4 * sizeof(float));
+
+  return true;
+}
+
+/// Discards the frames rendered ahead of time, which are only cached.
+bool ignoreFrame(void*, std::size_t, const float*, std::size_t, std::size_t)
+{
+  return true;
+}
+
+/// Renders the frames after the one being shown into the frame cache,
+/// on threads that last as long as the draw state, so that playing
+/// doesn't wait on frames that aren't cached yet.
+///
+/// The frames are rendered from a copy of the document, so that it
+/// can be edited while they're rendered. Frames that were already
+/// cached only cost their lookup.
+class FramePrefetcher final
+{
+  /// The cache that the frames are added to.
+  FrameCache* cache = nullptr;
+  /// The number of queued frames that haven't been rendered yet.
+  std::atomic<std::size_t> pending { 0 };
+  /// The frame that the last frames were queued after.
+  std::size_t queuedAfter = 0;
+  /// Whether or not any frames were queued yet.
+  bool queued = false;
+  /// The threads that render the frames. This is declared last, so
+  /// that its threads are stopped before the rest is destroyed.
+  WorkerPool pool;
+public:
+  /// Constructs a prefetcher.
+  ///
+  /// @param c The cache to add frames to,
+  /// which must outlive the prefetcher.
+  FramePrefetcher(FrameCache* c) : cache(c) {}
+  /// Queues the frames after the one being shown, wrapping around
+  /// to the first frame. Nothing is queued until the frames queued
+  /// before are rendered, so that the threads don't fall behind.
+  ///
+  /// @param doc The document being shown.
+  /// @param frame The frame being shown.
+  /// @param missed Whether the frame being shown wasn't cached,
+  /// which happens when the document was edited.
+  void prefetch(const Document* doc, std::size_t frame, bool missed)
+  {
+    if (pending.load() || (queued && !missed && (frame == queuedAfter))) {
+      return;
+    }
+
+    std::shared_ptr<Document> snapshot;
+
+    try {
+      snapshot.reset(copyDoc(doc), closeDoc);
+    } catch (...) {
+      return;
+    }
+
+    auto frameCount = getFrameCount(doc);
+
+    auto count = std::min(playbackLookahead(), frameCount - 1);
+
+    for (std::size_t i = 1; i <= count; i++) {
+
+      auto next = (frame + i) % frameCount;
+
+      pending++;
+
+      try {
+        pool.submit([this, snapshot, next](std::size_t) {
+          renderFrames(snapshot.get(), next, next, ignoreFrame, nullptr, cache, 1);
+          pending--;
+        });
+      } catch (...) {
+        pending--;
+        break;
+      }
+    }
+
+    queuedAfter = frame;
+
+    queued = true;
+  }
+};
+
 /// Represents the application when it is being used
 /// for drawing the artwork.
 class DrawStateImpl final : public DrawState,
@@ -162,11 +393,34 @@ class DrawStateImpl final : public DrawState,
   LeftPanel leftPanel;
   /// Contains the layers in the document.
   RightPanel rightPanel;
+  /// Used for choosing and playing the frames.
+  TimelinePanel timelinePanel;
+  /// Holds the frames that were recently shown, so that
+  /// playing and scrubbing through them doesn't render them again.
+  FrameCache* frameCache = nullptr;
+  /// Renders the frames ahead of the current one while playing.
+  std::unique_ptr<FramePrefetcher> prefetcher;
+  /// The neighboring frames shown under the current one.
+  OnionSkin* onionSkin = nullptr;
+  /// The range that the onion skin was last built for.
+  std::size_t onionSkinRange = 0;
 public:
-  DrawStateImpl(App* app) : DrawState(app)
+  DrawStateImpl(App* app)
+    : DrawState(app),
+      frameCache(createFrameCache(frameCacheBudget())),
+      prefetcher(new FramePrefetcher(frameCache)),
+      onionSkin(createOnionSkin())
   {
     currentTool.reset(new PenTool(this));
   }
+  /// Releases the frame cache and the onion skin.
+  ~DrawStateImpl()
+  {
+    // The prefetcher's threads use the cache until they're stopped.
+    prefetcher.reset();
+    closeOnionSkin(onionSkin);
+    closeFrameCache(frameCache);
+  }
   /// Renders the draw state windows.
   void frame() override
   {
@@ -175,6 +429,8 @@ public:
     leftPanel(getApp(), this, drawPanel);
 
     rightPanel(getApp(), layerPanel);
+
+    timelinePanel(getApp());
   }
   /// Handles a mouse button event.
   void mouseButton(const MouseButtonEvent& mouseButton) override
@@ -313,7 +569,34 @@ protected:
 
     auto* image = getApp()->getImage();
 
-    render(doc, image);
+    FrameCopy frameCopy { image, timelinePanel.getFrame() };
+
+    auto range = timelinePanel.getOnionSkinRange();
+
+    if (range) {
+
+      updateOnionSkin(range);
+
+      if (!renderOnionSkin(doc, frameCopy.frame, onionSkin, image, frameCache)) {
+        renderFrame(doc, frameCopy.frame, image, getApp()->getRenderContext());
+      }
+
+    } else {
+
+      // Only the current frame is rendered here, on one thread,
+      // so that a frame that isn't cached yet doesn't hold up the
+      // UI any longer than it takes to render it.
+
+      auto misses = getFrameCacheMisses(frameCache);
+
+      if (!renderFrames(doc, frameCopy.frame, frameCopy.frame, copyFrame, &frameCopy, frameCache, 1)) {
+        renderFrame(doc, frameCopy.frame, image, getApp()->getRenderContext());
+      }
+
+      if (timelinePanel.isPlaying()) {
+        prefetcher->prefetch(doc, frameCopy.frame, getFrameCacheMisses(frameCache) != misses);
+      }
+    }
 
     auto* color = getColorBuffer(image);
     auto w = getImageWidth(image);
@@ -321,6 +604,28 @@ protected:
 
     renderer->blit(color, w, h);
   }
+  /// Rebuilds the onion skin when its range changes. The previous
+  /// frames are tinted red and the next ones blue, and both fade
+  /// out with the distance from the current frame.
+  void updateOnionSkin(std::size_t range)
+  {
+    if (range == onionSkinRange) {
+      return;
+    }
+
+    clearOnionSkinFrames(onionSkin);
+
+    for (std::size_t i = 1; i <= range; i++) {
+
+      auto opacity = 0.5f / float(i);
+
+      addOnionSkinFrame(onionSkin, -int(i), 1.0f, 0.25f, 0.25f, opacity);
+
+      addOnionSkinFrame(onionSkin, int(i), 0.25f, 0.5f, 1.0f, opacity);
+    }
+
+    onionSkinRange = range;
+  }
   /// Observes an event from the draw panel.
   void observe(DrawPanel::Event event) override
   {
@@ -329,6 +634,8 @@ protected:
         break;
       case DrawPanel::Event::ChangedPixelSize:
         break;
+      case DrawPanel::Event::ChangedFillShapes:
+        break;
       case DrawPanel::Event::ChangedPrimaryColor:
         break;
       case DrawPanel::Event::ChangedTool:
@@ -46,6 +46,11 @@ BlendMode DrawTool::getBlendMode() const noexcept
   return drawState->getDrawPanel()->getBlendMode();
 }
 
+bool DrawTool::getFillShapes() const noexcept
+{
+  return drawState->getDrawPanel()->getFillShapes();
+}
+
 std::size_t DrawTool::requireCurrentLayer()
 {
   return drawState->requireCurrentLayer();
@@ -102,6 +102,8 @@ protected:
   int getPixelSize() const noexcept;
   /// Gets the current blend mode.
   BlendMode getBlendMode() const noexcept;
+  /// Indicates whether rectangles and ellipses are filled.
+  bool getFillShapes() const noexcept;
   /// Gets the index of the current layer.
   std::size_t requireCurrentLayer();
   /// Gets a pointer to the last rendered image.
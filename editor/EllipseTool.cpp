@@ -16,6 +16,7 @@ void EllipseTool::onBegin(const MouseButtonEvent&, int docX, int docY)
   setColor(ellipse, getPrimaryColor());
   setBlendMode(ellipse, getBlendMode());
   setPixelSize(ellipse, getPixelSize());
+  setFilled(ellipse, getFillShapes());
 }
 
 void EllipseTool::onDrag(const MouseMotionEvent&, int docX, int docY)
@@ -2,13 +2,9 @@
 
 #include <libpx.hpp>
 
-#include "Blob.hpp"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-
-#include <stb_image_write.h>
+#include <Sink.hpp>
 
-#include <vector>
+#include "Blob.hpp"
 
 #include <cstring>
 
@@ -16,64 +12,53 @@ namespace px {
 
 namespace {
 
-std::vector<unsigned char> toRGBA(const Image* image)
-{
-  auto w = getImageWidth(image);
-  auto h = getImageHeight(image);
-
-  std::vector<unsigned char> pixels(w * h * 4);
-
-  const auto* src = getColorBuffer(image);
-
-  for (std::size_t i = 0; i < (w * h * 4); i++) {
-    pixels[i] = src[i] * 255;
-  }
-
-  return pixels;
-}
-
 /// Writes data to a blob.
-/// This is used by the STB image library
-/// when formatting a PNG file.
-///
-/// @param blobPtr A pointer to the blob.
-/// @param data The data to write.
-/// @param size The number of bytes to write.
-void writeToBlob(void* blobPtr, void* data, int size)
+/// The PNG encoder writes whole chunks at
+/// a time, so the blob only grows per chunk.
+class BlobSink final : public Sink
 {
-  Blob* blob = (Blob*) blobPtr;
+  /// The blob to write to.
+  Blob& blob;
+public:
+  BlobSink(Blob& b) : blob(b) {}
+  bool write(const void* data, std::size_t size) override
+  {
+    auto writeLocation = blob.size();
 
-  auto writeLocation = blob->size();
+    blob.expand(size);
 
-  blob->expand(size);
+    std::memcpy(blob.data() + writeLocation, data, size);
 
-  std::memcpy(blob->data() + writeLocation, data, size);
-}
+    return true;
+  }
+};
 
 } // namespace
 
-Blob formatPNG(const Image* image)
+Blob formatPNG(const Image* image, const PNGOptions& options)
 {
   Blob blob;
 
-  auto w = getImageWidth(image);
-  auto h = getImageHeight(image);
+  BlobSink sink(blob);
 
-  auto pixels = toRGBA(image);
-
-  stbi_write_png_to_func(&writeToBlob, &blob, w, h, 4, pixels.data(), w * 4);
+  writePNG(sink, getColorBuffer(image), getImageWidth(image), getImageHeight(image), options);
 
   return blob;
 }
 
-bool savePNG(const char* path, const Image* image)
+bool savePNG(const char* path, const Image* image, const PNGOptions& options)
 {
-  auto w = getImageWidth(image);
-  auto h = getImageHeight(image);
+  FileSink sink;
+
+  if (!sink.open(path)) {
+    return false;
+  }
 
-  auto pixels = toRGBA(image);
+  if (!writePNG(sink, getColorBuffer(image), getImageWidth(image), getImageHeight(image), options)) {
+    return false;
+  }
 
-  return stbi_write_png(path, w, h, 4, pixels.data(), w * 4);
+  return sink.close();
 }
 
 } // namespace px
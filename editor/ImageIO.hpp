@@ -1,6 +1,8 @@
 #ifndef LIBPX_EDITOR_IMAGE_IO_HPP
 #define LIBPX_EDITOR_IMAGE_IO_HPP
 
+#include <Png.hpp>
+
 namespace px {
 
 class Blob;
@@ -11,17 +13,20 @@ struct Image;
 /// putting the file into a blob.
 ///
 /// @param image The image to format.
+/// @param options The options for encoding the file.
+/// A compression level of zero is much faster, for previews.
 ///
 /// @return The blob object containing the image data.
-Blob formatPNG(const Image* image);
+Blob formatPNG(const Image* image, const PNGOptions& options = PNGOptions());
 
 /// Saves an image to a PNG file.
 ///
 /// @param path The path to save the file at.
 /// @param image The image instance to be saved.
+/// @param options The options for encoding the file.
 ///
 /// @return True on success, false on failure.
-bool savePNG(const char* path, const Image* image);
+bool savePNG(const char* path, const Image* image, const PNGOptions& options = PNGOptions());
 
 } // namespace px
 
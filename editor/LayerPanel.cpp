@@ -3,10 +3,12 @@
 #include <libpx.hpp>
 
 #include "App.hpp"
+#include "Log.hpp"
 
 #include <imgui.h>
 #include <imgui_stdlib.h>
 
+#include <memory>
 #include <vector>
 
 namespace px {
@@ -95,6 +97,10 @@ class LayerPanelImpl final
     if (ImGui::IsItemDeactivatedAfterEdit()) {
       app->stashDocument();
     }
+
+    if (ImGui::Button("Bake")) {
+      bakeLayer(index, app);
+    }
   }
 protected:
   Layer* getLayer(App* app, std::size_t index)
@@ -205,6 +211,26 @@ protected:
 
     app->stashDocument();
   }
+  /// Replaces the nodes of a layer with a bitmap of them.
+  /// This can be undone, like any other change to the document.
+  void bakeLayer(std::size_t index, App* app)
+  {
+    // The layer is baked on a copy first, so that
+    // a layer that can't be baked leaves no snapshot.
+
+    std::unique_ptr<Document, void (*)(Document*)> trial(copyDoc(app->getDocument()), closeDoc);
+
+    if (!px::bakeLayer(trial.get(), index)) {
+      app->getLog()->logError("The layer could not be baked.");
+      return;
+    }
+
+    app->snapshotDocument();
+
+    px::bakeLayer(app->getDocument(), index);
+
+    app->stashDocument();
+  }
   // Detects if the 'enter' button is pressed.
   static bool isEnterPressed()
   {
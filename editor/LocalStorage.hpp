@@ -1,10 +1,14 @@
 #ifndef LIBPX_EDITOR_LOCAL_STORAGE_HPP
 #define LIBPX_EDITOR_LOCAL_STORAGE_HPP
 
+#include <memory>
+
 #include <cstddef>
 
 namespace px {
 
+class Sink;
+
 /// This is an interface to the local file system.
 /// It can have a very different underlying implementation
 /// depending on whether the program is running natively or
@@ -20,6 +24,13 @@ public:
   ///
   /// @return True on success, false on failure.
   static bool save(const char* filename, const void* data, std::size_t size);
+  /// Opens a file in local storage, so that it can be written
+  /// a piece at a time. The file is complete once the sink is closed.
+  ///
+  /// @param filename The name to give the file.
+  ///
+  /// @return A sink for the file on success, null on failure.
+  static std::unique_ptr<Sink> open(const char* filename);
 };
 
 } // namespace px
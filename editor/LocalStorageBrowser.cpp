@@ -1,9 +1,31 @@
 #include "LocalStorage.hpp"
 
+#include <Sink.hpp>
+
 #include <emscripten.h>
 
+#include <string>
+
 namespace px {
 
+namespace {
+
+/// Since the browser can only download whole files,
+/// the file is kept in memory until it is closed.
+class DownloadSink final : public BufferSink
+{
+  /// The name to give the downloaded file.
+  std::string filename;
+public:
+  DownloadSink(const char* f) : filename(f) {}
+  bool close() override
+  {
+    return LocalStorage::save(filename.c_str(), getBuffer().data(), getBuffer().size());
+  }
+};
+
+} // namespace
+
 bool LocalStorage::save(const char* filename, const void* data, std::size_t size)
 {
   EM_ASM_({ pxedit.download($0, $1, $2) }, filename, data, size);
@@ -11,4 +33,9 @@ bool LocalStorage::save(const char* filename, const void* data, std::size_t size
   return true;
 }
 
+std::unique_ptr<Sink> LocalStorage::open(const char* filename)
+{
+  return std::unique_ptr<Sink>(new DownloadSink(filename));
+}
+
 } // namespace px
@@ -2,6 +2,8 @@
 
 #include "Fs.hpp"
 
+#include <Sink.hpp>
+
 #include <cstdio>
 
 namespace px {
@@ -22,4 +24,17 @@ bool LocalStorage::save(const char* filename, const void* buf, std::size_t size)
   return writeSize == size;
 }
 
+std::unique_ptr<Sink> LocalStorage::open(const char* filename)
+{
+  std::string path = toUniquePath(filename);
+
+  std::unique_ptr<FileSink> sink(new FileSink());
+
+  if (!sink->open(path.c_str())) {
+    return nullptr;
+  }
+
+  return std::move(sink);
+}
+
 } // namespace px
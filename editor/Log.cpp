@@ -1,9 +1,12 @@
 #include "Log.hpp"
 
+#include <libpx.hpp>
+
 #include <chrono>
 #include <sstream>
 #include <iomanip>
 
+#include <cstdlib>
 #include <ctime>
 
 #include <imgui.h>
@@ -53,6 +56,21 @@ void Log::copyToClipboard()
   }
 }
 
+void Log::copyTraceToClipboard()
+{
+  void* data = nullptr;
+
+  std::size_t size = 0;
+
+  saveTrace(&data, &size);
+
+  std::string trace((const char*) data, size);
+
+  std::free(data);
+
+  ImGui::SetClipboardText(trace.c_str());
+}
+
 void Log::frame()
 {
   auto content = self->stream.str();
@@ -61,6 +79,24 @@ void Log::frame()
 
   ImGui::InputTextMultiline("", &content[0], content.size(), ImVec2(0, 0), ImGuiInputTextFlags_ReadOnly);
 
+  bool tracing = isTracingEnabled();
+
+  if (ImGui::Checkbox("Record Trace", &tracing)) {
+    setTracingEnabled(tracing);
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::Button("Copy Trace")) {
+    copyTraceToClipboard();
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::Button("Clear Trace")) {
+    clearTrace();
+  }
+
   ImGui::End();
 }
 
@@ -18,6 +18,9 @@ public:
   ~Log();
   /// Copies the log contents to the clipboard.
   void copyToClipboard();
+  /// Copies the recorded trace events to the clipboard,
+  /// in the Chrome trace event format.
+  void copyTraceToClipboard();
   /// Renders a frame of the log widget.
   void frame();
   /// Logs an error message.
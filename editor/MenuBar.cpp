@@ -54,11 +54,15 @@ void MenuBar::fileMenu(Observer* observer)
       observer->observe(Event::ClickedExportPx);
     }
 
-    if (ImGui::MenuItem("As Sprite Sheet", nullptr, false, false)) {
+    if (ImGui::MenuItem("As Sprite Sheet")) {
       observer->observe(Event::ClickedExportSpriteSheet);
     }
 
-    if (ImGui::MenuItem("As Zip", nullptr, false, false), false) {
+    if (ImGui::MenuItem("As Sprite Sheet (Frames)")) {
+      observer->observe(Event::ClickedExportFrameSheet);
+    }
+
+    if (ImGui::MenuItem("As Zip")) {
       observer->observe(Event::ClickedExportZip);
     }
 
@@ -66,6 +70,18 @@ void MenuBar::fileMenu(Observer* observer)
       observer->observe(Event::ClickedExportCurrentFrame);
     }
 
+    if (ImGui::MenuItem("Current Frame (PNG-8)")) {
+      observer->observe(Event::ClickedExportIndexedFrame);
+    }
+
+    if (ImGui::MenuItem("As GIF")) {
+      observer->observe(Event::ClickedExportGIF);
+    }
+
+    if (ImGui::MenuItem("As APNG")) {
+      observer->observe(Event::ClickedExportAPNG);
+    }
+
     ImGui::EndMenu();
   }
 
@@ -27,7 +27,11 @@ public:
   {
     ClickedClose,
     ClickedDiscardChanges,
+    ClickedExportAPNG,
     ClickedExportCurrentFrame,
+    ClickedExportFrameSheet,
+    ClickedExportGIF,
+    ClickedExportIndexedFrame,
     ClickedExportPx,
     ClickedExportSpriteSheet,
     ClickedExportZip,
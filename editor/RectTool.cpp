@@ -17,6 +17,7 @@ void RectTool::onBegin(const MouseButtonEvent&, int docX, int docY)
   setColor(rect, getPrimaryColor());
   setBlendMode(rect, getBlendMode());
   setPixelSize(rect, getPixelSize());
+  setFilled(rect, getFillShapes());
 }
 
 void RectTool::onDrag(const MouseMotionEvent&, int docX, int docY)
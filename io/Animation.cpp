@@ -0,0 +1,1034 @@
+#include "Animation.hpp"
+
+#include "Parallel.hpp"
+#include "Png.hpp"
+#include "Quantize.hpp"
+#include "Sink.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+namespace px {
+
+namespace {
+
+/// The colors of a frame, packed by @ref packColor.
+using PackedFrame = std::vector<std::uint32_t>;
+
+/// A rectangle of pixels within a frame.
+struct Rect final
+{
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t w = 0;
+  std::size_t h = 0;
+  /// Indicates whether or not the rectangle has no pixels.
+  bool empty() const noexcept
+  {
+    return !w || !h;
+  }
+};
+
+/// Creates a rectangle.
+Rect makeRect(std::size_t x, std::size_t y, std::size_t w, std::size_t h) noexcept
+{
+  Rect rect;
+  rect.x = x;
+  rect.y = y;
+  rect.w = w;
+  rect.h = h;
+  return rect;
+}
+
+/// Gets the smallest rectangle containing two others.
+Rect unite(const Rect& a, const Rect& b) noexcept
+{
+  if (a.empty()) {
+    return b;
+  } else if (b.empty()) {
+    return a;
+  }
+
+  auto x0 = std::min(a.x, b.x);
+  auto y0 = std::min(a.y, b.y);
+  auto x1 = std::max(a.x + a.w, b.x + b.w);
+  auto y1 = std::max(a.y + a.h, b.y + b.h);
+
+  return makeRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/// Finds the smallest rectangle containing the pixels that a predicate is true for.
+///
+/// @param w The width of the frame.
+/// @param h The height of the frame.
+/// @param predicate Is given the index of a pixel.
+///
+/// @return The rectangle, which is empty if the predicate is false for every pixel.
+template <typename Predicate>
+Rect findBounds(std::size_t w, std::size_t h, Predicate predicate)
+{
+  std::size_t x0 = w;
+  std::size_t x1 = 0;
+  std::size_t y0 = h;
+  std::size_t y1 = 0;
+
+  for (std::size_t y = 0; y < h; y++) {
+
+    auto row = y * w;
+
+    std::size_t left = 0;
+
+    while ((left < w) && !predicate(row + left)) {
+      left++;
+    }
+
+    if (left == w) {
+      continue;
+    }
+
+    // This stops at the left pixel, at the latest.
+
+    auto right = w;
+
+    while (!predicate(row + right - 1)) {
+      right--;
+    }
+
+    x0 = std::min(x0, left);
+    x1 = std::max(x1, right);
+    y0 = std::min(y0, y);
+    y1 = y + 1;
+  }
+
+  if (x0 >= x1) {
+    return Rect();
+  }
+
+  return makeRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/// Gets the time that a frame starts at.
+///
+/// Computing the delay of a frame as the difference between
+/// the start of the frame and the next one keeps the rounding
+/// of each delay from adding up over the frames.
+///
+/// @param frame The index of the frame.
+/// @param frameRate The number of frames per second.
+/// @param unitsPerSecond The number of units to get the time in, per second.
+std::size_t getFrameTime(std::size_t frame, std::size_t frameRate, std::size_t unitsPerSecond) noexcept
+{
+  frameRate = std::max(frameRate, std::size_t(1));
+
+  return ((frame * unitsPerSecond) + (frameRate / 2)) / frameRate;
+}
+
+/// The number of frames to encode at once, for each thread.
+/// Frames are queued until there are this many, which
+/// keeps threads busy while bounding the memory used.
+constexpr std::size_t framesPerThread() noexcept
+{
+  return 2;
+}
+
+/// Appends a 16-bit little endian integer to a buffer.
+void writeU16LE(std::vector<unsigned char>& out, std::size_t value)
+{
+  out.push_back((unsigned char) (value));
+  out.push_back((unsigned char) (value >> 8));
+}
+
+/// Appends a 32-bit big endian integer to a buffer.
+void writeU32BE(std::vector<unsigned char>& out, std::size_t value)
+{
+  out.push_back((unsigned char) (value >> 24));
+  out.push_back((unsigned char) (value >> 16));
+  out.push_back((unsigned char) (value >> 8));
+  out.push_back((unsigned char) (value));
+}
+
+/// Compresses the color indices of a GIF image with LZW.
+///
+/// The codes are written as sub-blocks of up to 255 bytes,
+/// preceded by the minimum code size and followed by an
+/// empty sub-block, which is how GIF files store them.
+///
+/// @param indices The color indices to compress.
+/// @param count The number of color indices.
+/// @param minCodeSize The number of bits in each color index, which is at least 2.
+/// @param out The buffer to append the compressed data to.
+void compressLZW(const unsigned char* indices, std::size_t count, int minCodeSize, std::vector<unsigned char>& out)
+{
+  // Codes are looked up by the code of the string before
+  // them and the index after it, in an open addressing table
+  // that has twice as many entries as there are codes.
+
+  constexpr std::size_t tableSize = 8192;
+
+  constexpr int maxCode = 4095;
+
+  std::vector<std::int32_t> keys(tableSize, -1);
+
+  std::vector<std::uint16_t> codes(tableSize);
+
+  const int clearCode = 1 << minCodeSize;
+
+  int codeSize = minCodeSize + 1;
+
+  int lastCode = clearCode + 1;
+
+  unsigned char block[255];
+
+  std::size_t blockSize = 0;
+
+  std::uint32_t bits = 0;
+
+  int bitCount = 0;
+
+  auto flushBlock = [&]() {
+    if (blockSize) {
+      out.push_back((unsigned char) blockSize);
+      out.insert(out.end(), block, block + blockSize);
+      blockSize = 0;
+    }
+  };
+
+  auto writeCode = [&](int code, int size) {
+
+    bits |= std::uint32_t(code) << bitCount;
+
+    bitCount += size;
+
+    while (bitCount >= 8) {
+
+      block[blockSize++] = (unsigned char) bits;
+
+      bits >>= 8;
+
+      bitCount -= 8;
+
+      if (blockSize == sizeof(block)) {
+        flushBlock();
+      }
+    }
+  };
+
+  out.push_back((unsigned char) minCodeSize);
+
+  writeCode(clearCode, codeSize);
+
+  if (count) {
+
+    int prefix = indices[0];
+
+    for (std::size_t i = 1; i < count; i++) {
+
+      int index = indices[i];
+
+      std::int32_t key = (prefix << 8) | index;
+
+      auto h = std::uint32_t(key) * std::uint32_t(0x9e3779b1);
+
+      auto slot = std::size_t(h >> 19) & (tableSize - 1);
+
+      while ((keys[slot] != -1) && (keys[slot] != key)) {
+        slot = (slot + 1) & (tableSize - 1);
+      }
+
+      if (keys[slot] == key) {
+        prefix = codes[slot];
+        continue;
+      }
+
+      writeCode(prefix, codeSize);
+
+      keys[slot] = key;
+
+      codes[slot] = std::uint16_t(++lastCode);
+
+      // The decoder adds its codes one step behind the
+      // encoder, so the code size grows once the last code
+      // added reaches it, rather than when it exceeds it.
+      if (lastCode >= (1 << codeSize)) {
+        codeSize++;
+      }
+
+      if (lastCode == maxCode) {
+        writeCode(clearCode, codeSize);
+        std::fill(keys.begin(), keys.end(), -1);
+        codeSize = minCodeSize + 1;
+        lastCode = clearCode + 1;
+      }
+
+      prefix = index;
+    }
+
+    writeCode(prefix, codeSize);
+  }
+
+  // The clear code resets the code size of the decoder,
+  // so that the end code is read with a known size.
+
+  writeCode(clearCode, codeSize);
+
+  writeCode(clearCode + 1, minCodeSize + 1);
+
+  if (bitCount > 0) {
+    block[blockSize++] = (unsigned char) bits;
+  }
+
+  flushBlock();
+
+  out.push_back(0);
+}
+
+/// Gets the number of bits needed for a color table of a GIF file.
+///
+/// @param colorCount The number of colors in the table, including the transparent one.
+int getTableBits(std::size_t colorCount) noexcept
+{
+  int bits = 1;
+
+  while ((std::size_t(1) << bits) < colorCount) {
+    bits++;
+  }
+
+  return bits;
+}
+
+/// Appends a color table to a GIF file. The table is padded
+/// with black, since its size must be a power of two.
+void writeColorTable(std::vector<unsigned char>& out, const std::vector<std::uint32_t>& palette, int bits)
+{
+  for (std::size_t i = 0; i < (std::size_t(1) << bits); i++) {
+
+    unsigned char rgba[4] { 0, 0, 0, 0 };
+
+    if (i < palette.size()) {
+      unpackColor(palette[i], rgba);
+    }
+
+    out.insert(out.end(), rgba, rgba + 3);
+  }
+}
+
+/// Counts the colors of a GIF frame, one run of pixels at a time.
+/// Pixels that are transparent are not counted.
+void countColors(const PackedFrame& pixels, ColorHistogram& histogram)
+{
+  std::size_t i = 0;
+
+  while (i < pixels.size()) {
+
+    auto color = pixels[i];
+
+    auto end = i + 1;
+
+    while ((end < pixels.size()) && (pixels[end] == color)) {
+      end++;
+    }
+
+    if (color) {
+      histogram.add(color, std::uint32_t(end - i));
+    }
+
+    i = end;
+  }
+}
+
+/// A frame of a GIF file.
+struct GIFFrame final
+{
+  /// The rectangle of the canvas that the frame draws to.
+  Rect rect;
+  /// The colors of the rectangle, where zero
+  /// leaves the pixel that's already there.
+  PackedFrame pixels;
+  /// The time that the frame is shown for, in hundredths of a second.
+  std::size_t delay = 0;
+  /// What is done with the rectangle once the frame has been shown.
+  /// One leaves it as it is, two clears it and three restores the
+  /// pixels that were under it.
+  int disposal = 1;
+  /// The frame once it's been quantized and compressed.
+  std::vector<unsigned char> data;
+};
+
+/// Quantizes and compresses a frame of a GIF file.
+///
+/// @param frame The frame to encode.
+/// @param globalPalette The palette shared by all frames, or a null
+/// pointer if the frame has its own palette.
+void encodeGIFFrame(GIFFrame& frame, const std::vector<std::uint32_t>* globalPalette)
+{
+  // One palette entry is kept for transparent pixels.
+
+  std::vector<std::uint32_t> localPalette;
+
+  const auto* palette = globalPalette;
+
+  if (!palette) {
+
+    ColorHistogram histogram;
+
+    countColors(frame.pixels, histogram);
+
+    localPalette = histogram.buildPalette(255);
+
+    palette = &localPalette;
+  }
+
+  auto transparent = palette->size();
+
+  auto tableBits = getTableBits(transparent + 1);
+
+  std::vector<unsigned char> indices(frame.pixels.size());
+
+  PaletteMap paletteMap(*palette);
+
+  std::uint32_t lastColor = 0;
+
+  std::size_t lastIndex = transparent;
+
+  for (std::size_t i = 0; i < frame.pixels.size(); i++) {
+
+    auto color = frame.pixels[i];
+
+    if (color != lastColor) {
+      lastColor = color;
+      lastIndex = color ? paletteMap.find(color) : transparent;
+    }
+
+    indices[i] = (unsigned char) lastIndex;
+  }
+
+  auto& out = frame.data;
+
+  // The graphic control extension, which has the
+  // delay, the disposal and the transparent index.
+
+  out.push_back(0x21);
+  out.push_back(0xf9);
+  out.push_back(0x04);
+  out.push_back((unsigned char) ((frame.disposal << 2) | 1));
+  writeU16LE(out, std::min(frame.delay, std::size_t(0xffff)));
+  out.push_back((unsigned char) transparent);
+  out.push_back(0x00);
+
+  // The image descriptor.
+
+  out.push_back(0x2c);
+  writeU16LE(out, frame.rect.x);
+  writeU16LE(out, frame.rect.y);
+  writeU16LE(out, frame.rect.w);
+  writeU16LE(out, frame.rect.h);
+
+  if (globalPalette) {
+    out.push_back(0x00);
+  } else {
+    out.push_back((unsigned char) (0x80 | (tableBits - 1)));
+    writeColorTable(out, localPalette, tableBits);
+  }
+
+  compressLZW(indices.data(), indices.size(), std::max(tableBits, 2), out);
+
+  frame.pixels = PackedFrame();
+}
+
+/// Writes the frames of a document to a GIF file.
+///
+/// Frames are compared as they are added, so that each one only
+/// draws the rectangle that changed. Since transparent pixels in
+/// a GIF frame leave the pixel underneath, a pixel that becomes
+/// transparent can only be drawn by clearing the rectangle of the
+/// frame before it, so that rectangle is grown to cover such pixels.
+class GIFWriter final
+{
+public:
+  GIFWriter(const Document* doc, Sink& s, const AnimationOptions& opts)
+    : sink(s),
+      options(opts),
+      width(getDocWidth(doc)),
+      height(getDocHeight(doc)),
+      frameRate(getFrameRate(doc)),
+      threadCount(getThreadCount(opts.threadCount)) {}
+  /// Indicates whether or not the document fits in a GIF file.
+  bool fits() const noexcept
+  {
+    return (width <= 0xffff) && (height <= 0xffff);
+  }
+  /// Packs the colors of a pixel, removing partial transparency.
+  static std::uint32_t pack(const unsigned char* rgba) noexcept
+  {
+    return (rgba[3] >= 128) ? (packColor(rgba) | 0xff000000) : 0;
+  }
+  /// Adds the next frame.
+  ///
+  /// @param frame The index of the frame.
+  /// @param colors The colors of the frame. This is swapped
+  /// with another buffer, whose contents are undefined.
+  ///
+  /// @return True on success, false if the sink could not be written to.
+  bool add(std::size_t frame, PackedFrame& colors)
+  {
+    auto delay = getFrameTime(frame + 1, frameRate, 100) - getFrameTime(frame, frameRate, 100);
+
+    // The first frame is drawn over a transparent canvas.
+
+    if (!hasPending) {
+      base.assign(colors.size(), 0);
+      startPending(colors, findChanges(colors, base), delay);
+      return true;
+    }
+
+    // A frame that's the same as the one before
+    // it only makes the frame before it longer.
+
+    if (colors == canvas) {
+      pending.delay += delay;
+      return true;
+    }
+
+    // Transparent pixels in a GIF frame leave the pixels underneath,
+    // so the frame before this one is disposed of in the way that
+    // leaves the least for this one to draw. It may be left as it
+    // is, restored to what was under it, which suits sprites moving
+    // over a background, or cleared, which is the only way to make
+    // opaque pixels transparent. Clearing its rectangle also clears
+    // whatever else it drew, so the rectangle is grown to cover the
+    // pixels that become transparent, and the frame redraws the rest.
+
+    auto disposal = 2;
+
+    auto cleared = unite(pending.rect, findBounds(width, height, [this, &colors](std::size_t i) {
+      return canvas[i] && !colors[i];
+    }));
+
+    auto rect = findBounds(width, height, [this, &colors, &cleared](std::size_t i) {
+      auto x = i % width;
+      auto y = i / width;
+      auto inside = (x >= cleared.x) && (x < (cleared.x + cleared.w)) && (y >= cleared.y) && (y < (cleared.y + cleared.h));
+      return colors[i] != (inside ? 0 : canvas[i]);
+    });
+
+    auto consider = [this, &rect, &disposal, &colors](int candidate, const PackedFrame& under) {
+
+      for (std::size_t i = 0; i < colors.size(); i++) {
+        if (under[i] && !colors[i]) {
+          return;
+        }
+      }
+
+      auto candidateRect = findChanges(colors, under);
+
+      if ((candidateRect.w * candidateRect.h) <= (rect.w * rect.h)) {
+        rect = candidateRect;
+        disposal = candidate;
+      }
+    };
+
+    consider(3, base);
+
+    consider(1, canvas);
+
+    pending.disposal = disposal;
+
+    if (disposal == 2) {
+      pending.rect = cleared;
+    }
+
+    queuePending();
+
+    if (disposal == 1) {
+      base.swap(canvas);
+    } else if (disposal == 2) {
+      base.swap(canvas);
+      for (auto y = cleared.y; y < (cleared.y + cleared.h); y++) {
+        auto* row = &base[(y * width) + cleared.x];
+        std::fill(row, row + cleared.w, 0);
+      }
+    }
+
+    startPending(colors, rect, delay);
+
+    if (!options.globalPalette && (queue.size() >= (threadCount * framesPerThread()))) {
+      return flush(nullptr);
+    }
+
+    return true;
+  }
+  /// Writes the remaining frames and the end of the file.
+  ///
+  /// @return True on success, false if the sink could not be written to.
+  bool finish()
+  {
+    if (hasPending) {
+      queuePending();
+    }
+
+    if (!options.globalPalette) {
+      return flush(nullptr) && writeTrailer();
+    }
+
+    std::vector<ColorHistogram> histograms(queue.size());
+
+    parallelFor(queue.size(), threadCount, [this, &histograms](std::size_t i, std::size_t) {
+      countColors(queue[i].pixels, histograms[i]);
+    });
+
+    ColorHistogram histogram;
+
+    for (const auto& frameHistogram : histograms) {
+      histogram.add(frameHistogram);
+    }
+
+    auto palette = histogram.buildPalette(255);
+
+    return writeHeader(&palette) && flush(&palette) && writeTrailer();
+  }
+private:
+  /// Finds the rectangle of a frame that differs from the pixels under it.
+  Rect findChanges(const PackedFrame& colors, const PackedFrame& under) const
+  {
+    return findBounds(width, height, [&colors, &under](std::size_t i) {
+      return colors[i] != under[i];
+    });
+  }
+  /// Makes a frame the pending one, once the pixels
+  /// that it's drawn over have been put into @ref GIFWriter::base.
+  ///
+  /// @param colors The colors of the frame, which are swapped into @ref GIFWriter::canvas.
+  /// @param rect The rectangle of the frame that differs from @ref GIFWriter::base.
+  /// @param delay The delay of the frame, in hundredths of a second.
+  void startPending(PackedFrame& colors, const Rect& rect, std::size_t delay)
+  {
+    canvas.swap(colors);
+
+    pending = GIFFrame();
+
+    pending.rect = rect;
+
+    // Every frame draws at least one pixel, to hold its delay.
+    if (pending.rect.empty()) {
+      pending.rect = makeRect(0, 0, 1, 1);
+    }
+
+    pending.delay = delay;
+
+    hasPending = true;
+  }
+  /// Queues the pending frame to be encoded, keeping
+  /// only the pixels that it changes.
+  void queuePending()
+  {
+    const auto& rect = pending.rect;
+
+    pending.pixels.resize(rect.w * rect.h);
+
+    for (std::size_t y = 0; y < rect.h; y++) {
+
+      auto src = ((rect.y + y) * width) + rect.x;
+
+      auto* dst = &pending.pixels[y * rect.w];
+
+      for (std::size_t x = 0; x < rect.w; x++) {
+        auto color = canvas[src + x];
+        dst[x] = (color != base[src + x]) ? color : 0;
+      }
+    }
+
+    queue.emplace_back(std::move(pending));
+
+    hasPending = false;
+  }
+  /// Encodes the queued frames and writes them in order.
+  ///
+  /// @param palette The palette shared by all frames, if there is one.
+  bool flush(const std::vector<std::uint32_t>* palette)
+  {
+    if (!headerWritten && !writeHeader(palette)) {
+      return false;
+    }
+
+    parallelFor(queue.size(), threadCount, [this, palette](std::size_t i, std::size_t) {
+      encodeGIFFrame(queue[i], palette);
+    });
+
+    for (const auto& frame : queue) {
+      if (!sink.write(frame.data.data(), frame.data.size())) {
+        return false;
+      }
+    }
+
+    queue.clear();
+
+    return true;
+  }
+  /// Writes the header of the file, along with the
+  /// extension that makes the animation loop.
+  bool writeHeader(const std::vector<std::uint32_t>* palette)
+  {
+    static const char signature[6] { 'G', 'I', 'F', '8', '9', 'a' };
+
+    std::vector<unsigned char> out(signature, signature + sizeof(signature));
+
+    writeU16LE(out, width);
+    writeU16LE(out, height);
+
+    if (palette) {
+      auto bits = getTableBits(palette->size() + 1);
+      out.push_back((unsigned char) (0x80 | ((bits - 1) << 4) | (bits - 1)));
+      out.push_back(0x00);
+      out.push_back(0x00);
+      writeColorTable(out, *palette, bits);
+    } else {
+      out.push_back(0x00);
+      out.push_back(0x00);
+      out.push_back(0x00);
+    }
+
+    // The loop count of this extension is the number of
+    // times the animation is repeated after it's first played.
+
+    if (options.loopCount != 1) {
+      static const char application[11] { 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0' };
+      out.push_back(0x21);
+      out.push_back(0xff);
+      out.push_back(0x0b);
+      out.insert(out.end(), application, application + sizeof(application));
+      out.push_back(0x03);
+      out.push_back(0x01);
+      writeU16LE(out, options.loopCount ? std::min(options.loopCount - 1, std::size_t(0xffff)) : 0);
+      out.push_back(0x00);
+    }
+
+    headerWritten = true;
+
+    return sink.write(out.data(), out.size());
+  }
+  /// Writes the byte that ends the file.
+  bool writeTrailer()
+  {
+    const unsigned char trailer = 0x3b;
+
+    return sink.write(&trailer, 1);
+  }
+  /// The sink to write the file to.
+  Sink& sink;
+  /// The options for the animation.
+  AnimationOptions options;
+  /// The width of the frames.
+  std::size_t width = 0;
+  /// The height of the frames.
+  std::size_t height = 0;
+  /// The number of frames per second.
+  std::size_t frameRate = 0;
+  /// The number of threads to encode frames on.
+  std::size_t threadCount = 1;
+  /// The colors of the last frame added.
+  PackedFrame canvas;
+  /// The colors that the last frame was drawn over.
+  PackedFrame base;
+  /// The last frame added, which isn't queued until the next frame is
+  /// added, since that decides its delay, disposal and rectangle.
+  GIFFrame pending;
+  /// Whether or not there is a pending frame.
+  bool hasPending = false;
+  /// The frames waiting to be encoded.
+  std::vector<GIFFrame> queue;
+  /// Whether or not the header has been written.
+  bool headerWritten = false;
+};
+
+/// A frame of an APNG file.
+struct APNGFrame final
+{
+  /// The rectangle of the canvas that the frame replaces.
+  Rect rect;
+  /// The 8-bit RGBA colors of the rectangle.
+  std::vector<unsigned char> rgba;
+  /// The frame once it's been filtered and compressed.
+  std::vector<unsigned char> data;
+};
+
+/// Writes the frames of a document to an APNG file.
+///
+/// Each frame replaces the rectangle that changed since the frame
+/// before it, rather than being blended over it, so that pixels
+/// becoming transparent need no special handling. The number of
+/// frames is written before the first one, so frames that are the
+/// same as the one before them are kept, but only draw one pixel.
+class APNGWriter final
+{
+public:
+  APNGWriter(const Document* doc, Sink& s, const AnimationOptions& opts)
+    : sink(s),
+      options(opts),
+      width(getDocWidth(doc)),
+      height(getDocHeight(doc)),
+      frameCount(getFrameCount(doc)),
+      frameRate(getFrameRate(doc)),
+      threadCount(getThreadCount(opts.threadCount)) {}
+  /// Indicates whether or not the document fits in an APNG file.
+  bool fits() const noexcept
+  {
+    return true;
+  }
+  /// Packs the colors of a pixel.
+  static std::uint32_t pack(const unsigned char* rgba) noexcept
+  {
+    return packColor(rgba);
+  }
+  /// Adds the next frame.
+  ///
+  /// @param colors The colors of the frame. This is swapped
+  /// with another buffer, whose contents are undefined.
+  ///
+  /// @return True on success, false if the sink could not be written to.
+  bool add(std::size_t frame, PackedFrame& colors)
+  {
+    APNGFrame next;
+
+    if (frame == 0) {
+      next.rect = makeRect(0, 0, width, height);
+    } else {
+
+      next.rect = findBounds(width, height, [this, &colors](std::size_t i) {
+        return colors[i] != previous[i];
+      });
+
+      if (next.rect.empty()) {
+        next.rect = makeRect(0, 0, 1, 1);
+      }
+    }
+
+    const auto& rect = next.rect;
+
+    next.rgba.resize(rect.w * rect.h * 4);
+
+    for (std::size_t y = 0; y < rect.h; y++) {
+
+      const auto* src = &colors[((rect.y + y) * width) + rect.x];
+
+      auto* dst = &next.rgba[y * rect.w * 4];
+
+      for (std::size_t x = 0; x < rect.w; x++) {
+        unpackColor(src[x], dst + (x * 4));
+      }
+    }
+
+    previous.swap(colors);
+
+    queue.emplace_back(std::move(next));
+
+    if (queue.size() >= (threadCount * framesPerThread())) {
+      return flush();
+    }
+
+    return true;
+  }
+  /// Writes the remaining frames and the end of the file.
+  ///
+  /// @return True on success, false if the sink could not be written to.
+  bool finish()
+  {
+    return flush() && writePNGChunk(sink, "IEND", nullptr, 0);
+  }
+private:
+  /// Compresses the queued frames and writes them in order.
+  bool flush()
+  {
+    auto level = options.level;
+
+    parallelFor(queue.size(), threadCount, [this, level](std::size_t i, std::size_t) {
+      auto& frame = queue[i];
+      frame.data = compressPNGData(frame.rgba.data(), frame.rect.w, frame.rect.h, level);
+      frame.rgba = std::vector<unsigned char>();
+    });
+
+    for (const auto& frame : queue) {
+      if (!writeFrame(frame)) {
+        return false;
+      }
+    }
+
+    queue.clear();
+
+    return true;
+  }
+  /// Writes a frame. The first frame is also the image
+  /// shown by programs that don't support animations.
+  bool writeFrame(const APNGFrame& frame)
+  {
+    if (!sequence) {
+
+      std::vector<unsigned char> control;
+
+      writeU32BE(control, frameCount);
+      writeU32BE(control, options.loopCount);
+
+      if (!writePNGHeader(sink, width, height)
+       || !writePNGChunk(sink, "acTL", control.data(), control.size())) {
+        return false;
+      }
+    }
+
+    // Each frame is shown for one frame period, and
+    // replaces the pixels under it (the "source" blend).
+
+    std::vector<unsigned char> control;
+
+    writeU32BE(control, sequence++);
+    writeU32BE(control, frame.rect.w);
+    writeU32BE(control, frame.rect.h);
+    writeU32BE(control, frame.rect.x);
+    writeU32BE(control, frame.rect.y);
+    control.push_back(0x00);
+    control.push_back(0x01);
+    control.push_back((unsigned char) (std::min(frameRate, std::size_t(0xffff)) >> 8));
+    control.push_back((unsigned char) (std::min(frameRate, std::size_t(0xffff))));
+    control.push_back(0x00);
+    control.push_back(0x00);
+
+    if (!writePNGChunk(sink, "fcTL", control.data(), control.size())) {
+      return false;
+    }
+
+    if (sequence == 1) {
+      return writePNGChunk(sink, "IDAT", frame.data.data(), frame.data.size());
+    }
+
+    std::vector<unsigned char> data;
+
+    data.reserve(frame.data.size() + 4);
+
+    writeU32BE(data, sequence++);
+
+    data.insert(data.end(), frame.data.begin(), frame.data.end());
+
+    return writePNGChunk(sink, "fdAT", data.data(), data.size());
+  }
+  /// The sink to write the file to.
+  Sink& sink;
+  /// The options for the animation.
+  AnimationOptions options;
+  /// The width of the frames.
+  std::size_t width = 0;
+  /// The height of the frames.
+  std::size_t height = 0;
+  /// The number of frames in the file.
+  std::size_t frameCount = 0;
+  /// The number of frames per second.
+  std::size_t frameRate = 0;
+  /// The number of threads to encode frames on.
+  std::size_t threadCount = 1;
+  /// The colors of the last frame added.
+  PackedFrame previous;
+  /// The frames waiting to be encoded.
+  std::vector<APNGFrame> queue;
+  /// The sequence number of the next chunk that needs one.
+  std::size_t sequence = 0;
+};
+
+/// Passes the frames of a document, as they
+/// are rendered, to the writer of a file.
+template <typename Writer>
+struct FrameExport final
+{
+  /// The writer to pass the frames to.
+  Writer* writer = nullptr;
+  /// The 8-bit colors of the frame being added.
+  std::vector<unsigned char> rgba;
+  /// The packed colors of the frame being added.
+  PackedFrame colors;
+  /// Whether or not the sink could not be written to.
+  bool writeFailed = false;
+  /// The exception thrown while adding a frame, which is
+  /// rethrown once the renderer returns, since exceptions
+  /// can't be thrown through it.
+  std::exception_ptr error;
+};
+
+/// Adds a frame passed by @ref renderFrames to a file.
+template <typename Writer>
+bool addFrame(void* data, std::size_t frame, const float* colors, std::size_t w, std::size_t h)
+{
+  auto* frameExport = static_cast<FrameExport<Writer>*>(data);
+
+  try {
+
+    auto& rgba = frameExport->rgba;
+
+    auto& packed = frameExport->colors;
+
+    rgba.resize(w * h * 4);
+
+    packed.resize(w * h);
+
+    convertToRGBA8(colors, w * h, rgba.data());
+
+    for (std::size_t i = 0; i < (w * h); i++) {
+      packed[i] = Writer::pack(&rgba[i * 4]);
+    }
+
+    if (!frameExport->writer->add(frame, packed)) {
+      frameExport->writeFailed = true;
+      return false;
+    }
+
+  } catch (...) {
+    frameExport->error = std::current_exception();
+    return false;
+  }
+
+  return true;
+}
+
+/// Renders the frames of a document and passes them to the writer of a file.
+template <typename Writer>
+bool exportAnimation(const Document* doc, Sink& sink, const AnimationOptions& options)
+{
+  Writer writer(doc, sink, options);
+
+  if (!writer.fits()) {
+    return false;
+  }
+
+  FrameExport<Writer> frameExport;
+
+  frameExport.writer = &writer;
+
+  if (!renderFrames(doc, 0, getFrameCount(doc) - 1, addFrame<Writer>, &frameExport, nullptr, options.threadCount)) {
+
+    if (frameExport.error) {
+      std::rethrow_exception(frameExport.error);
+    } else if (frameExport.writeFailed) {
+      return false;
+    }
+
+    throw std::bad_alloc();
+  }
+
+  return writer.finish();
+}
+
+} // namespace
+
+bool exportGIF(const Document* doc, Sink& sink, const AnimationOptions& options)
+{
+  return exportAnimation<GIFWriter>(doc, sink, options);
+}
+
+bool exportAPNG(const Document* doc, Sink& sink, const AnimationOptions& options)
+{
+  return exportAnimation<APNGWriter>(doc, sink, options);
+}
+
+} // namespace px
@@ -0,0 +1,74 @@
+#ifndef LIBPX_IO_ANIMATION_HPP
+#define LIBPX_IO_ANIMATION_HPP
+
+#include <cstddef>
+
+namespace px {
+
+struct Document;
+
+class Sink;
+
+/// Options for exporting the frames of a document as an animation.
+struct AnimationOptions final
+{
+  /// The number of threads to render, quantize and compress with.
+  /// If this is zero, one thread per processor is used.
+  std::size_t threadCount = 0;
+  /// The compression level of APNG frames, from 0 to 9.
+  /// GIF frames are always compressed with LZW.
+  int level = 6;
+  /// Whether the frames of a GIF file share one palette, built from
+  /// the colors of every frame, rather than each frame having its own.
+  /// A shared palette keeps colors from shifting between frames when
+  /// there are more than 255 of them, but every frame must be rendered
+  /// before the first one can be written.
+  bool globalPalette = false;
+  /// The number of times that the animation is played,
+  /// or zero to play it for as long as it's shown.
+  std::size_t loopCount = 0;
+};
+
+/// Exports the frames of a document as an animated GIF file.
+///
+/// Frames are rendered with @ref renderFrames. Each frame only stores
+/// the rectangle that changed since the frame before it, with pixels
+/// that didn't change left transparent, and frames that are the same
+/// as the one before them only lengthen its delay. Frames are quantized
+/// to a palette of up to 255 colors and compressed on several threads.
+/// If a frame has no more than 255 colors, its palette is exact.
+///
+/// Since GIF files don't support partial transparency, pixels
+/// that are less than half opaque are made transparent and the
+/// rest are made opaque.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to export the frames of.
+/// @param sink The sink to write the file to. This is not closed.
+/// @param options The options for the animation.
+///
+/// @return True on success, false if the sink could not be written to
+/// or the document is too large for the format.
+bool exportGIF(const Document* doc, Sink& sink, const AnimationOptions& options = AnimationOptions());
+
+/// Exports the frames of a document as an animated PNG (APNG) file.
+///
+/// Frames are rendered with @ref renderFrames. Each frame after the
+/// first one only stores the rectangle that changed since the frame
+/// before it, which replaces the pixels underneath it. Frames are
+/// filtered and compressed on several threads. Programs that don't
+/// support APNG files show the first frame.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to export the frames of.
+/// @param sink The sink to write the file to. This is not closed.
+/// @param options The options for the animation.
+///
+/// @return True on success, false if the sink could not be written to.
+bool exportAPNG(const Document* doc, Sink& sink, const AnimationOptions& options = AnimationOptions());
+
+} // namespace px
+
+#endif // LIBPX_IO_ANIMATION_HPP
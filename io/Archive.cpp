@@ -0,0 +1,214 @@
+#include "Archive.hpp"
+
+#include "Json.hpp"
+#include "LayerRenderer.hpp"
+#include "Png.hpp"
+#include "Zip.hpp"
+
+#include <libpx.hpp>
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace px {
+
+namespace {
+
+/// Gets the path of a rendered layer within the archive.
+std::string getLayerPath(std::size_t index)
+{
+  char buf[32];
+
+  std::snprintf(buf, sizeof(buf), "layers/%03lu.png", (unsigned long) index);
+
+  return buf;
+}
+
+/// Gets the path of a rendered frame within the archive.
+std::string getFramePath(std::size_t index)
+{
+  char buf[32];
+
+  std::snprintf(buf, sizeof(buf), "frames/%03lu.png", (unsigned long) index);
+
+  return buf;
+}
+
+/// Passes the frames of a document, as they are
+/// rendered, to the ZIP writer to be encoded.
+struct FrameExport final
+{
+  /// The writer to add the frames to.
+  ZipWriter* writer = nullptr;
+  /// The compression level of the frames.
+  int level = 6;
+  /// The exception thrown while adding a frame, which is
+  /// rethrown once the renderer returns, since exceptions
+  /// can't be thrown through it.
+  std::exception_ptr error;
+};
+
+/// Adds a frame passed by @ref renderFrames to the archive.
+/// The frame is copied, since it's only valid during the call,
+/// and is encoded on the threads of the writer.
+bool addFrame(void* data, std::size_t frame, const float* colors, std::size_t w, std::size_t h)
+{
+  auto* frameExport = static_cast<FrameExport*>(data);
+
+  auto level = frameExport->level;
+
+  try {
+
+    std::shared_ptr<std::vector<float>> copy(new std::vector<float>(colors, colors + (w * h * 4)));
+
+    frameExport->writer->add(getFramePath(frame), [copy, w, h, level](std::size_t) {
+      return encodePNG(copy->data(), w, h, level);
+    }, false);
+
+  } catch (...) {
+    frameExport->error = std::current_exception();
+    return false;
+  }
+
+  return true;
+}
+
+/// Describes the contents of the archive.
+std::string formatMetadata(const Document* doc, const std::string& name)
+{
+  std::ostringstream stream;
+
+  stream << "{\n";
+  stream << "  \"name\": \"" << escapeJSON(name) << "\",\n";
+  stream << "  \"width\": " << getDocWidth(doc) << ",\n";
+  stream << "  \"height\": " << getDocHeight(doc) << ",\n";
+  stream << "  \"document\": \"" << escapeJSON(name) << ".px\",\n";
+  stream << "  \"image\": \"" << escapeJSON(name) << ".png\",\n";
+  stream << "  \"layers\": [";
+
+  for (std::size_t i = 0; i < getLayerCount(doc); i++) {
+
+    const auto* layer = getLayer(doc, i);
+
+    stream << (i ? ",\n" : "\n");
+    stream << "    {";
+    stream << " \"name\": \"" << escapeJSON(getLayerName(layer)) << "\",";
+    stream << " \"file\": \"" << getLayerPath(i) << "\",";
+    stream << " \"visible\": " << (getLayerVisibility(layer) ? "true" : "false") << ",";
+    stream << " \"opacity\": " << getLayerOpacity(layer);
+    stream << " }";
+  }
+
+  stream << "\n  ]";
+
+  if (getFrameCount(doc) > 1) {
+
+    stream << ",\n  \"frameRate\": " << getFrameRate(doc) << ",\n";
+    stream << "  \"frames\": [";
+
+    for (std::size_t i = 0; i < getFrameCount(doc); i++) {
+      stream << (i ? ",\n" : "\n");
+      stream << "    \"" << getFramePath(i) << "\"";
+    }
+
+    stream << "\n  ]";
+  }
+
+  stream << "\n}\n";
+
+  return stream.str();
+}
+
+} // namespace
+
+bool exportArchive(const Document* doc, const std::string& name, Sink& sink, const ArchiveOptions& options)
+{
+  // The renderers must outlive the writer, since
+  // the writer waits for its threads when destroyed.
+
+  std::unique_ptr<LayerRenderer[]> renderers;
+
+  ZipWriter writer(sink, options.threadCount, options.level);
+
+  renderers.reset(new LayerRenderer[writer.getThreadCount()]);
+
+  void* docData = nullptr;
+
+  std::size_t docSize = 0;
+
+  saveDoc(doc, &docData, &docSize);
+
+  if (!docData && docSize) {
+    throw std::bad_alloc();
+  }
+
+  std::vector<unsigned char> docBytes((unsigned char*) docData, ((unsigned char*) docData) + docSize);
+
+  std::free(docData);
+
+  writer.add(name + ".px", std::move(docBytes));
+
+  writer.add("metadata.json", [doc, name](std::size_t) {
+    auto metadata = formatMetadata(doc, name);
+    return std::vector<unsigned char>(metadata.begin(), metadata.end());
+  });
+
+  auto level = options.level;
+
+  writer.add(name + ".png", [doc, level](std::size_t) {
+
+    std::unique_ptr<Image, decltype(&closeImage)> image(createImage(0, 0), closeImage);
+
+    std::unique_ptr<RenderContext, decltype(&closeRenderContext)> context(createRenderContext(), closeRenderContext);
+
+    if (!render(doc, image.get(), context.get())) {
+      throw std::bad_alloc();
+    }
+
+    return encodePNG(getColorBuffer(image.get()), getImageWidth(image.get()), getImageHeight(image.get()), level);
+  }, false);
+
+  auto* rendererArray = renderers.get();
+
+  for (std::size_t i = 0; i < getLayerCount(doc); i++) {
+
+    writer.add(getLayerPath(i), [doc, rendererArray, level, i](std::size_t threadIndex) {
+
+      auto& renderer = rendererArray[threadIndex];
+
+      if (!renderer.initialized()) {
+        renderer.init(doc);
+      }
+
+      const auto* image = renderer.renderLayer(i);
+
+      return encodePNG(getColorBuffer(image), getImageWidth(image), getImageHeight(image), level);
+    }, false);
+  }
+
+  if (getFrameCount(doc) > 1) {
+
+    FrameExport frameExport;
+    frameExport.writer = &writer;
+    frameExport.level = level;
+
+    if (!renderFrames(doc, 0, getFrameCount(doc) - 1, addFrame, &frameExport, nullptr, options.threadCount)) {
+
+      if (frameExport.error) {
+        std::rethrow_exception(frameExport.error);
+      }
+
+      throw std::bad_alloc();
+    }
+  }
+
+  return writer.finish();
+}
+
+} // namespace px
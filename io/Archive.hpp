@@ -0,0 +1,49 @@
+#ifndef LIBPX_IO_ARCHIVE_HPP
+#define LIBPX_IO_ARCHIVE_HPP
+
+#include <string>
+
+#include <cstddef>
+
+namespace px {
+
+struct Document;
+
+class Sink;
+
+/// Options for exporting a document archive.
+struct ArchiveOptions final
+{
+  /// The number of threads to render and compress with.
+  /// If this is zero, one thread per processor is used.
+  std::size_t threadCount = 0;
+  /// The compression level, from 0 to 9.
+  int level = 6;
+};
+
+/// Exports a document as a ZIP archive, which contains:
+///
+///  - The document itself, as "<name>.px"
+///  - The rendered document, as "<name>.png"
+///  - Each layer rendered on its own, as "layers/<index>.png"
+///  - Each frame, if there are several, as "frames/<index>.png"
+///  - A description of the contents, as "metadata.json"
+///
+/// Layers are rendered and compressed on worker threads and
+/// the archive is streamed to the sink as entries are finished.
+/// Frames are rendered with @ref renderFrames.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to export.
+/// @param name The name of the document, without a file extension.
+/// @param sink The sink to write the archive to.
+/// This is closed once the archive is written.
+/// @param options The options for the archive.
+///
+/// @return True on success, false if the sink could not be written to.
+bool exportArchive(const Document* doc, const std::string& name, Sink& sink, const ArchiveOptions& options = ArchiveOptions());
+
+} // namespace px
+
+#endif // LIBPX_IO_ARCHIVE_HPP
@@ -0,0 +1,101 @@
+#include "Checksum.hpp"
+
+namespace px {
+
+namespace {
+
+/// Contains the CRC-32 of every byte value.
+class CRCTable final
+{
+  /// The checksums, indexed by byte value.
+  std::uint32_t table[256];
+public:
+  CRCTable() noexcept
+  {
+    for (std::uint32_t i = 0; i < 256; i++) {
+
+      std::uint32_t c = i;
+
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+      }
+
+      table[i] = c;
+    }
+  }
+  /// Accesses the checksum of a byte value.
+  inline std::uint32_t operator [] (std::size_t i) const noexcept
+  {
+    return table[i];
+  }
+};
+
+} // namespace
+
+std::uint32_t updateCRC32(std::uint32_t crc, const unsigned char* data, std::size_t size) noexcept
+{
+  static const CRCTable table;
+
+  crc = ~crc;
+
+  for (std::size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+std::uint32_t updateAdler32(std::uint32_t adler, const unsigned char* data, std::size_t size) noexcept
+{
+  // The largest number of bytes that can be summed
+  // before the sums have to be reduced, to avoid overflow.
+  constexpr std::size_t maxRun = 5552;
+
+  constexpr std::uint32_t base = 65521;
+
+  std::uint32_t a = adler & 0xffff;
+  std::uint32_t b = adler >> 16;
+
+  while (size > 0) {
+
+    auto run = (size < maxRun) ? size : maxRun;
+
+    for (std::size_t i = 0; i < run; i++) {
+      a += data[i];
+      b += a;
+    }
+
+    a %= base;
+    b %= base;
+
+    data += run;
+    size -= run;
+  }
+
+  return (b << 16) | a;
+}
+
+std::uint32_t combineAdler32(std::uint32_t first, std::uint32_t second, std::size_t secondSize) noexcept
+{
+  constexpr std::uint64_t base = 65521;
+
+  // Each byte of the second piece adds the first
+  // sum of the first piece to the second sum once.
+
+  std::uint64_t rem = secondSize % base;
+
+  std::uint64_t a1 = first & 0xffff;
+  std::uint64_t b1 = first >> 16;
+
+  std::uint64_t a2 = second & 0xffff;
+  std::uint64_t b2 = second >> 16;
+
+  // Both pieces start their first sum at one, so one is taken away.
+  std::uint64_t a = (a1 + a2 + base - 1) % base;
+
+  std::uint64_t b = (b1 + b2 + ((rem * a1) % base) + base - rem) % base;
+
+  return std::uint32_t((b << 16) | a);
+}
+
+} // namespace px
@@ -0,0 +1,41 @@
+#ifndef LIBPX_IO_CHECKSUM_HPP
+#define LIBPX_IO_CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace px {
+
+/// Updates a CRC-32 checksum, as used by PNG, GZIP and ZIP files.
+///
+/// @param crc The checksum of the preceding data.
+/// This should be zero for the first call.
+/// @param data The data to add to the checksum.
+/// @param size The number of bytes in @p data.
+///
+/// @return The updated checksum.
+std::uint32_t updateCRC32(std::uint32_t crc, const unsigned char* data, std::size_t size) noexcept;
+
+/// Updates an Adler-32 checksum, as used by zlib streams.
+///
+/// @param adler The checksum of the preceding data.
+/// This should be one for the first call.
+/// @param data The data to add to the checksum.
+/// @param size The number of bytes in @p data.
+///
+/// @return The updated checksum.
+std::uint32_t updateAdler32(std::uint32_t adler, const unsigned char* data, std::size_t size) noexcept;
+
+/// Combines the Adler-32 checksums of two consecutive pieces of data,
+/// so that the pieces may be checksummed separately (such as in parallel.)
+///
+/// @param first The checksum of the first piece.
+/// @param second The checksum of the second piece.
+/// @param secondSize The number of bytes in the second piece.
+///
+/// @return The checksum of both pieces together.
+std::uint32_t combineAdler32(std::uint32_t first, std::uint32_t second, std::size_t secondSize) noexcept;
+
+} // namespace px
+
+#endif // LIBPX_IO_CHECKSUM_HPP
@@ -0,0 +1,1346 @@
+#include "Deflate.hpp"
+
+#include "Checksum.hpp"
+
+#include <algorithm>
+
+#include <cstdint>
+#include <cstring>
+
+namespace px {
+
+namespace {
+
+/// The number of bytes that a match may refer back to.
+constexpr std::size_t windowSize() noexcept
+{
+  return 32768;
+}
+
+/// The shortest match that can be encoded.
+constexpr std::size_t minMatch() noexcept
+{
+  return 3;
+}
+
+/// The longest match that can be encoded.
+constexpr std::size_t maxMatch() noexcept
+{
+  return 258;
+}
+
+/// The number of symbols buffered before a block is written.
+constexpr std::size_t blockSymbols() noexcept
+{
+  return 32768;
+}
+
+/// The number of literal and length codes.
+constexpr std::size_t litLenCodes() noexcept
+{
+  return 286;
+}
+
+/// The number of literal and length codes in the fixed code,
+/// which includes two codes that never appear in the data.
+constexpr std::size_t fixedLitLenCodes() noexcept
+{
+  return 288;
+}
+
+/// The number of distance codes.
+constexpr std::size_t distCodes() noexcept
+{
+  return 30;
+}
+
+/// The number of code length codes.
+constexpr std::size_t codeLengthCodes() noexcept
+{
+  return 19;
+}
+
+/// The number of bits used for the hash table.
+constexpr std::size_t hashBits() noexcept
+{
+  return 15;
+}
+
+const std::uint16_t lengthBase[29] {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const std::uint8_t lengthExtra[29] {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+const std::uint16_t distBase[30] {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+const std::uint8_t distExtra[30] {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/// The order that code length code lengths are written in.
+const std::uint8_t codeLengthOrder[19] {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/// Maps match lengths and distances to their codes.
+class CodeTables final
+{
+  /// The length code of each match length.
+  std::uint8_t lengthCodes[maxMatch() + 1];
+  /// The distance codes of distances up to 256, followed by
+  /// the distance codes of larger distances divided by 128.
+  std::uint8_t distanceCodes[512];
+public:
+  CodeTables() noexcept
+  {
+    for (std::uint8_t c = 0; c < 29; c++) {
+      for (unsigned i = 0; i < (1u << lengthExtra[c]); i++) {
+        if ((lengthBase[c] + i) <= maxMatch()) {
+          lengthCodes[lengthBase[c] + i] = c;
+        }
+      }
+    }
+
+    // Length 258 has its own code, instead of being the end of code 27.
+    lengthCodes[maxMatch()] = 28;
+
+    for (std::uint8_t c = 0; c < 30; c++) {
+      for (unsigned i = 0; i < (1u << distExtra[c]); i++) {
+        unsigned d = distBase[c] + i - 1;
+        if (d < 256) {
+          distanceCodes[d] = c;
+        } else {
+          distanceCodes[256 + (d >> 7)] = c;
+        }
+      }
+    }
+  }
+  /// Gets the code of a match length.
+  inline std::uint8_t lengthCode(std::size_t length) const noexcept
+  {
+    return lengthCodes[length];
+  }
+  /// Gets the code of a match distance.
+  inline std::uint8_t distanceCode(std::size_t distance) const noexcept
+  {
+    auto d = distance - 1;
+
+    return (d < 256) ? distanceCodes[d] : distanceCodes[256 + (d >> 7)];
+  }
+};
+
+const CodeTables& getCodeTables() noexcept
+{
+  static const CodeTables tables;
+
+  return tables;
+}
+
+/// Writes bits to a buffer, starting at the least significant bit.
+class BitWriter final
+{
+  /// The buffer being written to.
+  std::vector<unsigned char>& out;
+  /// The bits that have not been written yet.
+  std::uint64_t bits = 0;
+  /// The number of bits that have not been written yet.
+  int bitCount = 0;
+public:
+  BitWriter(std::vector<unsigned char>& o) : out(o) {}
+  /// Writes a number of bits.
+  ///
+  /// @param value The bits to write.
+  /// @param count The number of bits to write, up to 32.
+  inline void write(std::uint32_t value, int count)
+  {
+    bits |= std::uint64_t(value) << bitCount;
+
+    bitCount += count;
+
+    while (bitCount >= 8) {
+      out.push_back((unsigned char) bits);
+      bits >>= 8;
+      bitCount -= 8;
+    }
+  }
+  /// Pads the output to the next byte boundary.
+  void align()
+  {
+    if (bitCount > 0) {
+      out.push_back((unsigned char) bits);
+      bits = 0;
+      bitCount = 0;
+    }
+  }
+  /// Writes bytes, which must be on a byte boundary.
+  void writeBytes(const unsigned char* data, std::size_t size)
+  {
+    out.insert(out.end(), data, data + size);
+  }
+};
+
+/// Reverses the order of bits in a code,
+/// since deflate writes codes starting at their
+/// most significant bit.
+std::uint16_t reverseBits(std::uint16_t code, int length) noexcept
+{
+  std::uint16_t result = 0;
+
+  for (int i = 0; i < length; i++) {
+    result = std::uint16_t((result << 1) | (code & 1));
+    code >>= 1;
+  }
+
+  return result;
+}
+
+/// A Huffman code, made of the length of each
+/// symbol's code and the bit-reversed codes.
+struct HuffmanCode final
+{
+  /// The code length of each symbol.
+  std::uint8_t lengths[fixedLitLenCodes()] {};
+  /// The bit-reversed code of each symbol.
+  std::uint16_t codes[fixedLitLenCodes()] {};
+  /// Assigns canonical codes from the code lengths.
+  ///
+  /// @param count The number of symbols.
+  void assignCodes(std::size_t count) noexcept
+  {
+    std::uint16_t lengthCounts[16] {};
+
+    for (std::size_t i = 0; i < count; i++) {
+      lengthCounts[lengths[i]]++;
+    }
+
+    lengthCounts[0] = 0;
+
+    std::uint16_t nextCode[16] {};
+
+    std::uint16_t code = 0;
+
+    for (int bits = 1; bits < 16; bits++) {
+      code = std::uint16_t((code + lengthCounts[bits - 1]) << 1);
+      nextCode[bits] = code;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+      if (lengths[i]) {
+        codes[i] = reverseBits(nextCode[lengths[i]]++, lengths[i]);
+      }
+    }
+  }
+};
+
+/// Builds code lengths that are no longer than a limit,
+/// using the package-merge algorithm.
+///
+/// @param freqs The frequency of each symbol.
+/// @param count The number of symbols.
+/// @param limit The longest code length allowed.
+/// @param lengths Receives the code length of each symbol.
+void buildLengths(const std::uint32_t* freqs, std::size_t count, int limit, std::uint8_t* lengths)
+{
+  std::fill(lengths, lengths + count, 0);
+
+  /// Either a symbol or a package of two items from the previous level.
+  struct Item final
+  {
+    std::uint64_t weight;
+    int symbol;
+    int left;
+    int right;
+  };
+
+  std::vector<Item> leaves;
+
+  for (std::size_t i = 0; i < count; i++) {
+    if (freqs[i]) {
+      leaves.push_back(Item { freqs[i], int(i), -1, -1 });
+    }
+  }
+
+  if (leaves.empty()) {
+    return;
+  }
+
+  if (leaves.size() == 1) {
+    lengths[leaves[0].symbol] = 1;
+    return;
+  }
+
+  std::stable_sort(leaves.begin(), leaves.end(), [](const Item& a, const Item& b) {
+    return a.weight < b.weight;
+  });
+
+  std::vector<std::vector<Item>> levels(limit);
+
+  levels[0] = leaves;
+
+  for (int l = 1; l < limit; l++) {
+
+    const auto& prev = levels[l - 1];
+
+    std::vector<Item> packages;
+
+    for (std::size_t i = 0; (i + 1) < prev.size(); i += 2) {
+      packages.push_back(Item { prev[i].weight + prev[i + 1].weight, -1, int(i), int(i + 1) });
+    }
+
+    auto& level = levels[l];
+
+    level.resize(leaves.size() + packages.size());
+
+    std::merge(leaves.begin(), leaves.end(), packages.begin(), packages.end(), level.begin(), [](const Item& a, const Item& b) {
+      return a.weight < b.weight;
+    });
+  }
+
+  // Each time a symbol appears in the chosen items, its code gets a bit longer.
+
+  std::vector<std::pair<int, int>> stack;
+
+  for (std::size_t i = 0; i < ((leaves.size() * 2) - 2); i++) {
+    stack.emplace_back(limit - 1, int(i));
+  }
+
+  while (!stack.empty()) {
+
+    auto entry = stack.back();
+
+    stack.pop_back();
+
+    const auto& item = levels[entry.first][entry.second];
+
+    if (item.symbol >= 0) {
+      lengths[item.symbol]++;
+    } else {
+      stack.emplace_back(entry.first - 1, item.left);
+      stack.emplace_back(entry.first - 1, item.right);
+    }
+  }
+}
+
+/// A literal byte or a match, found by the match finder.
+struct Symbol final
+{
+  /// The literal byte, or the length of the match.
+  std::uint16_t value;
+  /// The distance of the match, or zero if this is a literal.
+  std::uint16_t distance;
+};
+
+/// Writes the blocks of a deflate stream.
+class BlockWriter final
+{
+  /// The bits being written.
+  BitWriter& writer;
+public:
+  BlockWriter(BitWriter& w) : writer(w) {}
+  /// Writes a block, choosing whichever of the block types is smallest.
+  ///
+  /// @param symbols The symbols of the block.
+  /// @param raw The bytes that the symbols represent.
+  /// @param rawSize The number of bytes that the symbols represent.
+  /// @param final Whether or not this is the last block of the stream.
+  void write(const std::vector<Symbol>& symbols, const unsigned char* raw, std::size_t rawSize, bool final)
+  {
+    const auto& tables = getCodeTables();
+
+    std::uint32_t litFreqs[litLenCodes()] {};
+    std::uint32_t distFreqs[distCodes()] {};
+
+    for (const auto& s : symbols) {
+      if (!s.distance) {
+        litFreqs[s.value]++;
+      } else {
+        litFreqs[257 + tables.lengthCode(s.value)]++;
+        distFreqs[tables.distanceCode(s.distance)]++;
+      }
+    }
+
+    litFreqs[256] = 1;
+
+    // Some decoders need at least two codes in each tree.
+    ensureTwoCodes(litFreqs, litLenCodes());
+    ensureTwoCodes(distFreqs, distCodes());
+
+    HuffmanCode litCode;
+    HuffmanCode distCode;
+
+    buildLengths(litFreqs, litLenCodes(), 15, litCode.lengths);
+    buildLengths(distFreqs, distCodes(), 15, distCode.lengths);
+
+    litCode.assignCodes(litLenCodes());
+    distCode.assignCodes(distCodes());
+
+    std::size_t litCount = litLenCodes();
+    while ((litCount > 257) && !litCode.lengths[litCount - 1]) {
+      litCount--;
+    }
+
+    std::size_t distCount = distCodes();
+    while ((distCount > 1) && !distCode.lengths[distCount - 1]) {
+      distCount--;
+    }
+
+    // The code lengths of both trees are run-length encoded together.
+
+    std::vector<std::uint8_t> allLengths(litCode.lengths, litCode.lengths + litCount);
+
+    allLengths.insert(allLengths.end(), distCode.lengths, distCode.lengths + distCount);
+
+    std::vector<Symbol> lengthSymbols;
+
+    runLengthEncode(allLengths, lengthSymbols);
+
+    std::uint32_t clFreqs[codeLengthCodes()] {};
+
+    for (const auto& s : lengthSymbols) {
+      clFreqs[s.value]++;
+    }
+
+    HuffmanCode clCode;
+
+    buildLengths(clFreqs, codeLengthCodes(), 7, clCode.lengths);
+
+    clCode.assignCodes(codeLengthCodes());
+
+    std::size_t clCount = codeLengthCodes();
+    while ((clCount > 4) && !clCode.lengths[codeLengthOrder[clCount - 1]]) {
+      clCount--;
+    }
+
+    // Compare the size of each block type.
+
+    std::uint64_t dynamicBits = 3 + 5 + 5 + 4 + (3 * clCount);
+
+    for (const auto& s : lengthSymbols) {
+      dynamicBits += clCode.lengths[s.value] + codeLengthExtraBits(s.value);
+    }
+
+    dynamicBits += dataBits(symbols, litCode, distCode);
+
+    HuffmanCode fixedLitCode;
+    HuffmanCode fixedDistCode;
+
+    makeFixedCodes(fixedLitCode, fixedDistCode);
+
+    std::uint64_t fixedBits = 3 + dataBits(symbols, fixedLitCode, fixedDistCode);
+
+    std::uint64_t storedBits = (((rawSize / 65535) + 1) * (3 + 7 + 32)) + (std::uint64_t(rawSize) * 8);
+
+    if ((storedBits <= fixedBits) && (storedBits <= dynamicBits)) {
+      writeStored(raw, rawSize, final);
+    } else if (fixedBits <= dynamicBits) {
+      writer.write(final ? 1 : 0, 1);
+      writer.write(1, 2);
+      writeData(symbols, fixedLitCode, fixedDistCode);
+    } else {
+      writer.write(final ? 1 : 0, 1);
+      writer.write(2, 2);
+      writer.write(std::uint32_t(litCount - 257), 5);
+      writer.write(std::uint32_t(distCount - 1), 5);
+      writer.write(std::uint32_t(clCount - 4), 4);
+
+      for (std::size_t i = 0; i < clCount; i++) {
+        writer.write(clCode.lengths[codeLengthOrder[i]], 3);
+      }
+
+      for (const auto& s : lengthSymbols) {
+        writer.write(clCode.codes[s.value], clCode.lengths[s.value]);
+        writer.write(s.distance, codeLengthExtraBits(s.value));
+      }
+
+      writeData(symbols, litCode, distCode);
+    }
+  }
+  /// Writes stored blocks containing raw bytes.
+  void writeStored(const unsigned char* raw, std::size_t rawSize, bool final)
+  {
+    do {
+
+      auto size = std::min(rawSize, std::size_t(65535));
+
+      bool last = final && (size == rawSize);
+
+      writer.write(last ? 1 : 0, 1);
+      writer.write(0, 2);
+      writer.align();
+      writer.write(std::uint32_t(size), 16);
+      writer.write(std::uint32_t(~size & 0xffff), 16);
+      writer.writeBytes(raw, size);
+
+      raw += size;
+      rawSize -= size;
+
+    } while (rawSize > 0);
+  }
+protected:
+  /// Writes the symbols of a block, followed by the end of block code.
+  void writeData(const std::vector<Symbol>& symbols, const HuffmanCode& litCode, const HuffmanCode& distCode)
+  {
+    const auto& tables = getCodeTables();
+
+    for (const auto& s : symbols) {
+
+      if (!s.distance) {
+        writer.write(litCode.codes[s.value], litCode.lengths[s.value]);
+        continue;
+      }
+
+      auto lc = tables.lengthCode(s.value);
+
+      writer.write(litCode.codes[257 + lc], litCode.lengths[257 + lc]);
+      writer.write(s.value - lengthBase[lc], lengthExtra[lc]);
+
+      auto dc = tables.distanceCode(s.distance);
+
+      writer.write(distCode.codes[dc], distCode.lengths[dc]);
+      writer.write(s.distance - distBase[dc], distExtra[dc]);
+    }
+
+    writer.write(litCode.codes[256], litCode.lengths[256]);
+  }
+  /// Counts the bits needed to write the symbols of a block.
+  static std::uint64_t dataBits(const std::vector<Symbol>& symbols, const HuffmanCode& litCode, const HuffmanCode& distCode) noexcept
+  {
+    const auto& tables = getCodeTables();
+
+    std::uint64_t bits = litCode.lengths[256];
+
+    for (const auto& s : symbols) {
+      if (!s.distance) {
+        bits += litCode.lengths[s.value];
+      } else {
+        auto lc = tables.lengthCode(s.value);
+        auto dc = tables.distanceCode(s.distance);
+        bits += litCode.lengths[257 + lc] + lengthExtra[lc];
+        bits += distCode.lengths[dc] + distExtra[dc];
+      }
+    }
+
+    return bits;
+  }
+  /// Makes the fixed codes defined by the deflate format.
+  static void makeFixedCodes(HuffmanCode& litCode, HuffmanCode& distCode) noexcept
+  {
+    for (std::size_t i = 0; i < fixedLitLenCodes(); i++) {
+      if (i < 144) {
+        litCode.lengths[i] = 8;
+      } else if (i < 256) {
+        litCode.lengths[i] = 9;
+      } else if (i < 280) {
+        litCode.lengths[i] = 7;
+      } else {
+        litCode.lengths[i] = 8;
+      }
+    }
+
+    for (std::size_t i = 0; i < distCodes(); i++) {
+      distCode.lengths[i] = 5;
+    }
+
+    litCode.assignCodes(fixedLitLenCodes());
+    distCode.assignCodes(distCodes());
+  }
+  /// Makes sure that at least two symbols have a non-zero frequency.
+  static void ensureTwoCodes(std::uint32_t* freqs, std::size_t count) noexcept
+  {
+    std::size_t used = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+      used += freqs[i] ? 1 : 0;
+    }
+
+    for (std::size_t i = 0; (i < count) && (used < 2); i++) {
+      if (!freqs[i]) {
+        freqs[i] = 1;
+        used++;
+      }
+    }
+  }
+  /// Gets the number of extra bits written after a code length symbol.
+  static int codeLengthExtraBits(std::uint16_t symbol) noexcept
+  {
+    switch (symbol) {
+      case 16:
+        return 2;
+      case 17:
+        return 3;
+      case 18:
+        return 7;
+    }
+    return 0;
+  }
+  /// Run-length encodes a sequence of code lengths.
+  /// The value of each symbol is the code length symbol and
+  /// the distance is the value of the extra bits, if there are any.
+  static void runLengthEncode(const std::vector<std::uint8_t>& lengths, std::vector<Symbol>& symbols)
+  {
+    std::size_t i = 0;
+
+    while (i < lengths.size()) {
+
+      auto length = lengths[i];
+
+      std::size_t run = 1;
+
+      while (((i + run) < lengths.size()) && (lengths[i + run] == length)) {
+        run++;
+      }
+
+      if (length == 0) {
+        while (run >= 11) {
+          auto n = std::min(run, std::size_t(138));
+          symbols.push_back(Symbol { 18, std::uint16_t(n - 11) });
+          run -= n;
+          i += n;
+        }
+        if (run >= 3) {
+          symbols.push_back(Symbol { 17, std::uint16_t(run - 3) });
+          i += run;
+          run = 0;
+        }
+      } else if (run >= 4) {
+        symbols.push_back(Symbol { length, 0 });
+        run--;
+        i++;
+        while (run >= 3) {
+          auto n = std::min(run, std::size_t(6));
+          symbols.push_back(Symbol { 16, std::uint16_t(n - 3) });
+          run -= n;
+          i += n;
+        }
+      }
+
+      for (; run > 0; run--, i++) {
+        symbols.push_back(Symbol { length, 0 });
+      }
+    }
+  }
+};
+
+/// The compression parameters of each level.
+struct LevelParams final
+{
+  /// The most matches to look at for each position.
+  std::size_t maxChain;
+  /// Once a match is this long, no longer one is looked for.
+  std::size_t niceLength;
+  /// Whether or not a match may be deferred for a longer one at the next byte.
+  bool lazy;
+};
+
+const LevelParams levelParams[10] {
+  { 0, 0, false },
+  { 4, 8, false },
+  { 8, 16, false },
+  { 16, 32, false },
+  { 16, 64, true },
+  { 32, 128, true },
+  { 128, 128, true },
+  { 256, 258, true },
+  { 1024, 258, true },
+  { 4096, 258, true }
+};
+
+/// Finds matches in the data being compressed.
+class MatchFinder final
+{
+  /// The data, including the dictionary.
+  const unsigned char* data;
+  /// The number of bytes in the data.
+  std::size_t size;
+  /// The most recent position of each hash.
+  std::vector<std::int32_t> head;
+  /// The previous position with the same hash as each
+  /// position, indexed by position modulo the window size.
+  std::vector<std::int32_t> prev;
+  /// The compression parameters.
+  const LevelParams& params;
+public:
+  MatchFinder(const unsigned char* d, std::size_t s, const LevelParams& p)
+    : data(d), size(s), head(std::size_t(1) << hashBits(), -1), prev(windowSize(), -1), params(p) {}
+  /// Adds a position to the hash chains.
+  inline void insert(std::size_t pos) noexcept
+  {
+    if ((pos + minMatch()) > size) {
+      return;
+    }
+
+    auto& h = head[hash(pos)];
+
+    prev[pos % windowSize()] = h;
+
+    h = std::int32_t(pos);
+  }
+  /// Finds the longest match for a position.
+  /// The position must not have been inserted yet.
+  ///
+  /// @param pos The position to find a match for.
+  /// @param distance Receives the distance of the match.
+  ///
+  /// @return The length of the match, which is
+  /// zero if there is no match long enough.
+  std::size_t find(std::size_t pos, std::size_t& distance) const noexcept
+  {
+    if ((pos + minMatch()) > size) {
+      return 0;
+    }
+
+    auto maxLength = std::min(maxMatch(), size - pos);
+
+    std::size_t best = minMatch() - 1;
+
+    auto candidate = head[hash(pos)];
+
+    for (std::size_t chain = params.maxChain; (chain > 0) && (candidate >= 0); chain--) {
+
+      auto c = std::size_t(candidate);
+
+      if ((c >= pos) || ((pos - c) > windowSize())) {
+        break;
+      }
+
+      // The byte after the best match is checked
+      // first, since most candidates fail there.
+      if (data[c + best] == data[pos + best]) {
+
+        std::size_t length = 0;
+
+        while ((length < maxLength) && (data[c + length] == data[pos + length])) {
+          length++;
+        }
+
+        if (length > best) {
+
+          best = length;
+
+          distance = pos - c;
+
+          if (length >= std::min(params.niceLength, maxLength)) {
+            break;
+          }
+        }
+      }
+
+      auto next = prev[c % windowSize()];
+
+      // Entries that were overwritten by newer positions point forward.
+      if (next >= candidate) {
+        break;
+      }
+
+      candidate = next;
+    }
+
+    return (best >= minMatch()) ? best : 0;
+  }
+protected:
+  /// Hashes the three bytes at a position.
+  inline std::size_t hash(std::size_t pos) const noexcept
+  {
+    std::uint32_t v = (std::uint32_t(data[pos]) << 16)
+                    | (std::uint32_t(data[pos + 1]) << 8)
+                    | (std::uint32_t(data[pos + 2]));
+
+    return (v * 2654435761u) >> (32 - hashBits());
+  }
+};
+
+} // namespace
+
+Deflater::Deflater(int l) : level(std::min(std::max(l, 0), 9)) {}
+
+void Deflater::setDictionary(const unsigned char* data, std::size_t size)
+{
+  auto used = std::min(size, windowSize());
+
+  dictionary.assign(data + (size - used), data + size);
+}
+
+void Deflater::compress(const unsigned char* data, std::size_t size, bool last, std::vector<unsigned char>& out)
+{
+  BitWriter writer(out);
+
+  BlockWriter blockWriter(writer);
+
+  if (level == 0) {
+
+    if (size || last) {
+      blockWriter.writeStored(data, size, last);
+    }
+
+  } else {
+
+    // The dictionary is placed in front of the data,
+    // so that matches can refer back into it.
+
+    std::vector<unsigned char> window;
+
+    window.reserve(dictionary.size() + size);
+    window.insert(window.end(), dictionary.begin(), dictionary.end());
+    window.insert(window.end(), data, data + size);
+
+    const auto& params = levelParams[level];
+
+    MatchFinder finder(window.data(), window.size(), params);
+
+    for (std::size_t i = 0; i < dictionary.size(); i++) {
+      finder.insert(i);
+    }
+
+    std::vector<Symbol> symbols;
+
+    symbols.reserve(blockSymbols());
+
+    std::size_t blockStart = dictionary.size();
+
+    std::size_t pos = dictionary.size();
+
+    // A match found for the next position, while looking for a lazy match.
+    std::size_t pendingLength = 0;
+    std::size_t pendingDistance = 0;
+    bool havePending = false;
+
+    while (pos < window.size()) {
+
+      std::size_t distance = 0;
+
+      std::size_t length = 0;
+
+      if (havePending) {
+        length = pendingLength;
+        distance = pendingDistance;
+        havePending = false;
+      } else {
+        length = finder.find(pos, distance);
+      }
+
+      finder.insert(pos);
+
+      if (length && params.lazy && (length < params.niceLength)) {
+
+        std::size_t nextDistance = 0;
+
+        auto nextLength = finder.find(pos + 1, nextDistance);
+
+        if (nextLength > length) {
+          pendingLength = nextLength;
+          pendingDistance = nextDistance;
+          havePending = true;
+          length = 0;
+        }
+      }
+
+      if (length) {
+
+        symbols.push_back(Symbol { std::uint16_t(length), std::uint16_t(distance) });
+
+        for (std::size_t i = 1; i < length; i++) {
+          finder.insert(pos + i);
+        }
+
+        pos += length;
+
+      } else {
+
+        symbols.push_back(Symbol { window[pos], 0 });
+
+        pos++;
+      }
+
+      if ((symbols.size() >= blockSymbols()) && !havePending) {
+
+        bool final = last && (pos == window.size());
+
+        blockWriter.write(symbols, window.data() + blockStart, pos - blockStart, final);
+
+        symbols.clear();
+
+        blockStart = pos;
+      }
+    }
+
+    if (!symbols.empty() || last) {
+      blockWriter.write(symbols, window.data() + blockStart, pos - blockStart, last);
+    }
+
+    setDictionary(window.data(), window.size());
+  }
+
+  if (!last) {
+    // A sync flush is an empty stored block, which leaves the output on a byte boundary.
+    blockWriter.writeStored(nullptr, 0, false);
+  }
+
+  writer.align();
+}
+
+void writeZlibHeader(int level, std::vector<unsigned char>& out)
+{
+  unsigned cmf = 0x78;
+
+  unsigned flevel = (level < 2) ? 0 : ((level < 6) ? 1 : ((level == 6) ? 2 : 3));
+
+  unsigned flg = flevel << 6;
+
+  flg += 31 - (((cmf << 8) | flg) % 31);
+
+  out.push_back((unsigned char) cmf);
+  out.push_back((unsigned char) flg);
+}
+
+std::vector<unsigned char> compressZlib(const unsigned char* data, std::size_t size, int level)
+{
+  std::vector<unsigned char> out;
+
+  writeZlibHeader(level, out);
+
+  Deflater deflater(level);
+
+  deflater.compress(data, size, true, out);
+
+  auto adler = updateAdler32(1, data, size);
+
+  out.push_back((unsigned char) (adler >> 24));
+  out.push_back((unsigned char) (adler >> 16));
+  out.push_back((unsigned char) (adler >> 8));
+  out.push_back((unsigned char) (adler));
+
+  return out;
+}
+
+namespace {
+
+/// Reads the bits of a deflate stream, least significant bit first.
+class BitReader final
+{
+  /// The stream being read.
+  const unsigned char* data = nullptr;
+  /// The number of bytes in the stream.
+  std::size_t size = 0;
+  /// The position of the next byte to put into the bit buffer.
+  std::size_t pos = 0;
+  /// The bits that have been read ahead.
+  std::uint64_t bits = 0;
+  /// The number of bits in the bit buffer.
+  unsigned count = 0;
+  /// The number of bytes past the end of the stream that were read as
+  /// zeros, so that codes near the end can be looked up in whole.
+  std::size_t overrun = 0;
+public:
+  BitReader(const unsigned char* d, std::size_t s) noexcept : data(d), size(s) {}
+  /// Gets bits without consuming them.
+  inline unsigned peek(unsigned n) noexcept
+  {
+    while (count < n) {
+
+      std::uint64_t byte = 0;
+
+      if (pos < size) {
+        byte = data[pos++];
+      } else {
+        overrun++;
+      }
+
+      bits |= byte << count;
+
+      count += 8;
+    }
+
+    return unsigned(bits & ((std::uint64_t(1) << n) - 1));
+  }
+  /// Consumes bits that were peeked at.
+  inline void skip(unsigned n) noexcept
+  {
+    bits >>= n;
+    count -= n;
+  }
+  /// Reads bits.
+  inline unsigned read(unsigned n) noexcept
+  {
+    auto value = peek(n);
+    skip(n);
+    return value;
+  }
+  /// Skips to the start of the next byte.
+  inline void align() noexcept
+  {
+    skip(count % 8);
+  }
+  /// Indicates whether more bits were read than the stream has.
+  inline bool exhausted() const noexcept
+  {
+    return (overrun * 8) > count;
+  }
+  /// Gets the number of bytes consumed, after aligning to a byte.
+  inline std::size_t consumed() const noexcept
+  {
+    return pos - (count / 8);
+  }
+};
+
+/// Decodes the symbols of a canonical Huffman code, with a table
+/// indexed by as many bits as the longest code. Each entry holds
+/// the symbol and the length of the code that its index starts with.
+class HuffmanDecoder final
+{
+  /// The symbol in the high bits and the code length in the low four.
+  /// An entry of zero is not the start of any code.
+  std::vector<std::uint16_t> entries;
+  /// The length of the longest code.
+  unsigned maxLength = 0;
+public:
+  /// Builds the table from the code length of each symbol.
+  ///
+  /// @return True on success, false if the lengths don't form a code.
+  bool build(const std::uint8_t* lengths, std::size_t symbolCount)
+  {
+    unsigned lengthCounts[16] {};
+
+    maxLength = 0;
+
+    for (std::size_t i = 0; i < symbolCount; i++) {
+      lengthCounts[lengths[i]]++;
+      maxLength = std::max(maxLength, unsigned(lengths[i]));
+    }
+
+    // Codes may be incomplete, such as a single distance code,
+    // but they may not have more codes than their lengths allow.
+
+    int left = 1;
+
+    for (unsigned length = 1; length < 16; length++) {
+      left = (left * 2) - int(lengthCounts[length]);
+      if (left < 0) {
+        return false;
+      }
+    }
+
+    unsigned nextCode[16] {};
+
+    for (unsigned length = 1, code = 0; length < 16; length++) {
+      code = (code + lengthCounts[length - 1]) << 1;
+      nextCode[length] = code;
+    }
+
+    entries.assign(std::size_t(1) << maxLength, 0);
+
+    for (std::size_t symbol = 0; symbol < symbolCount; symbol++) {
+
+      unsigned length = lengths[symbol];
+
+      if (!length) {
+        continue;
+      }
+
+      auto code = reverseBits(std::uint16_t(nextCode[length]++), int(length));
+
+      auto entry = std::uint16_t((symbol << 4) | length);
+
+      for (std::size_t i = code; i < entries.size(); i += (std::size_t(1) << length)) {
+        entries[i] = entry;
+      }
+    }
+
+    return true;
+  }
+  /// Decodes a symbol.
+  ///
+  /// @return The symbol, or -1 if the bits are not a code.
+  inline int decode(BitReader& reader) const noexcept
+  {
+    if (!maxLength) {
+      return -1;
+    }
+
+    auto entry = entries[reader.peek(maxLength)];
+
+    if (!entry) {
+      return -1;
+    }
+
+    reader.skip(entry & 15);
+
+    return int(entry >> 4);
+  }
+};
+
+/// Decompresses a deflate stream.
+class Inflater final
+{
+  /// The stream being read.
+  BitReader reader;
+  /// The decompressed data.
+  std::vector<unsigned char>& out;
+  /// The most bytes that may be decompressed.
+  std::size_t maxSize = 0;
+  /// The code of literals and lengths of the current block.
+  HuffmanDecoder litLenDecoder;
+  /// The code of distances of the current block.
+  HuffmanDecoder distDecoder;
+public:
+  Inflater(const unsigned char* data, std::size_t size, std::vector<unsigned char>& o, std::size_t m) noexcept
+    : reader(data, size), out(o), maxSize(m) {}
+  /// Decompresses every block of the stream.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @return True on success, false if the stream is not valid.
+  bool inflate()
+  {
+    for (;;) {
+
+      auto last = reader.read(1);
+
+      auto type = reader.read(2);
+
+      auto success = false;
+
+      switch (type) {
+        case 0:
+          success = inflateStored();
+          break;
+        case 1:
+          success = readFixedCodes() && inflateCodes();
+          break;
+        case 2:
+          success = readDynamicCodes() && inflateCodes();
+          break;
+      }
+
+      if (!success || reader.exhausted()) {
+        return false;
+      } else if (last) {
+        return true;
+      }
+    }
+  }
+  /// Gets the number of bytes of the stream that were read.
+  inline std::size_t consumed() const noexcept
+  {
+    return reader.consumed();
+  }
+protected:
+  /// Copies a block that is not compressed.
+  bool inflateStored()
+  {
+    reader.align();
+
+    auto length = reader.read(16);
+
+    auto check = reader.read(16);
+
+    if ((length ^ 0xffff) != check) {
+      return false;
+    }
+
+    if (length > (maxSize - out.size())) {
+      return false;
+    }
+
+    for (unsigned i = 0; i < length; i++) {
+      out.push_back((unsigned char) reader.read(8));
+    }
+
+    return true;
+  }
+  /// Uses the fixed codes, which are defined by the format.
+  bool readFixedCodes()
+  {
+    std::uint8_t lengths[fixedLitLenCodes() + distCodes()];
+
+    std::size_t i = 0;
+
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < fixedLitLenCodes(); i++) lengths[i] = 8;
+    for (; i < (fixedLitLenCodes() + distCodes()); i++) lengths[i] = 5;
+
+    return litLenDecoder.build(lengths, fixedLitLenCodes())
+        && distDecoder.build(lengths + fixedLitLenCodes(), distCodes());
+  }
+  /// Reads the codes of a block from the start of the block.
+  bool readDynamicCodes()
+  {
+    auto litLenCount = reader.read(5) + 257;
+    auto distCount = reader.read(5) + 1;
+    auto codeLengthCount = reader.read(4) + 4;
+
+    if ((litLenCount > litLenCodes()) || (distCount > distCodes())) {
+      return false;
+    }
+
+    std::uint8_t codeLengthLengths[codeLengthCodes()] {};
+
+    for (unsigned i = 0; i < codeLengthCount; i++) {
+      codeLengthLengths[codeLengthOrder[i]] = std::uint8_t(reader.read(3));
+    }
+
+    HuffmanDecoder codeLengthDecoder;
+
+    if (!codeLengthDecoder.build(codeLengthLengths, codeLengthCodes())) {
+      return false;
+    }
+
+    // The lengths of both codes are one sequence,
+    // and a repeat may continue from one to the other.
+
+    std::uint8_t lengths[litLenCodes() + distCodes()] {};
+
+    unsigned count = litLenCount + distCount;
+
+    for (unsigned i = 0; i < count; ) {
+
+      auto symbol = codeLengthDecoder.decode(reader);
+
+      if (symbol < 0) {
+        return false;
+      } else if (symbol < 16) {
+        lengths[i++] = std::uint8_t(symbol);
+        continue;
+      }
+
+      std::uint8_t value = 0;
+
+      unsigned repeat = 0;
+
+      if (symbol == 16) {
+        if (i == 0) {
+          return false;
+        }
+        value = lengths[i - 1];
+        repeat = 3 + reader.read(2);
+      } else if (symbol == 17) {
+        repeat = 3 + reader.read(3);
+      } else {
+        repeat = 11 + reader.read(7);
+      }
+
+      if (repeat > (count - i)) {
+        return false;
+      }
+
+      while (repeat--) {
+        lengths[i++] = value;
+      }
+    }
+
+    // Without an end of block code, the block would never end.
+    if (!lengths[256]) {
+      return false;
+    }
+
+    return litLenDecoder.build(lengths, litLenCount)
+        && distDecoder.build(lengths + litLenCount, distCount);
+  }
+  /// Decodes the literals and matches of a compressed block.
+  bool inflateCodes()
+  {
+    for (;;) {
+
+      auto symbol = litLenDecoder.decode(reader);
+
+      if (symbol < 0) {
+        return false;
+      } else if (symbol < 256) {
+
+        if (out.size() >= maxSize) {
+          return false;
+        }
+
+        out.push_back((unsigned char) symbol);
+
+        continue;
+
+      } else if (symbol == 256) {
+        return true;
+      }
+
+      auto lengthCode = std::size_t(symbol - 257);
+
+      if (lengthCode >= 29) {
+        return false;
+      }
+
+      std::size_t length = lengthBase[lengthCode] + reader.read(lengthExtra[lengthCode]);
+
+      auto distCode = distDecoder.decode(reader);
+
+      if ((distCode < 0) || (distCode >= 30)) {
+        return false;
+      }
+
+      std::size_t distance = distBase[distCode] + reader.read(distExtra[distCode]);
+
+      if ((distance > out.size()) || (length > (maxSize - out.size()))) {
+        return false;
+      }
+
+      // The match may overlap the bytes that it produces,
+      // so it's copied one byte at a time.
+
+      auto from = out.size() - distance;
+
+      for (std::size_t i = 0; i < length; i++) {
+        out.push_back(out[from + i]);
+      }
+
+      if (reader.exhausted()) {
+        return false;
+      }
+    }
+  }
+};
+
+} // namespace
+
+bool decompressZlib(const unsigned char* data, std::size_t size, std::vector<unsigned char>& out, std::size_t maxSize)
+{
+  if (size < 6) {
+    return false;
+  }
+
+  unsigned cmf = data[0];
+  unsigned flg = data[1];
+
+  // Deflate, a window of at most 32 KiB and no preset dictionary.
+  if (((cmf & 0x0f) != 8) || ((cmf >> 4) > 7) || (((cmf << 8) | flg) % 31) || (flg & 0x20)) {
+    return false;
+  }
+
+  auto first = out.size();
+
+  Inflater inflater(data + 2, size - 2, out, first + std::min(maxSize, SIZE_MAX - first));
+
+  if (!inflater.inflate()) {
+    return false;
+  }
+
+  auto end = 2 + inflater.consumed();
+
+  if ((size - end) < 4) {
+    return false;
+  }
+
+  std::uint32_t adler = (std::uint32_t(data[end]) << 24)
+                      | (std::uint32_t(data[end + 1]) << 16)
+                      | (std::uint32_t(data[end + 2]) << 8)
+                      | (std::uint32_t(data[end + 3]));
+
+  return adler == updateAdler32(1, out.data() + first, out.size() - first);
+}
+
+} // namespace px
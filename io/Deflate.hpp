@@ -0,0 +1,90 @@
+#ifndef LIBPX_IO_DEFLATE_HPP
+#define LIBPX_IO_DEFLATE_HPP
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace px {
+
+/// Compresses data into the deflate format (RFC 1951.)
+///
+/// Data may be compressed over several calls to @ref Deflater::compress.
+/// Every call but the last one ends with a sync flush, which leaves the
+/// output on a byte boundary, so the output of each call can simply be
+/// appended to the output of the previous one. The last 32 KiB of each
+/// call is kept as the dictionary of the next call.
+///
+/// Since the output of each call is independent apart from the
+/// dictionary, separate chunks of data may also be compressed in
+/// parallel by separate instances, with @ref Deflater::setDictionary
+/// given the end of the preceding chunk.
+class Deflater final
+{
+public:
+  /// Constructs a new deflater.
+  ///
+  /// @param level The compression level, from 0 to 9. Zero stores the
+  /// data without compressing it, one is the fastest and nine compresses
+  /// the most. Levels outside of this range are clamped.
+  explicit Deflater(int level = 6);
+  /// Sets the data that the next call to @ref Deflater::compress may
+  /// refer back to. Only the last 32 KiB of the data is used.
+  ///
+  /// @param data The data that precedes the data to be compressed.
+  /// @param size The number of bytes in @p data.
+  void setDictionary(const unsigned char* data, std::size_t size);
+  /// Compresses data and appends it to a buffer.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param data The data to compress.
+  /// @param size The number of bytes in @p data.
+  /// @param last Whether or not this is the end of the stream.
+  /// If this is false, the output ends with a sync flush.
+  /// @param out The buffer to append the compressed data to.
+  void compress(const unsigned char* data, std::size_t size, bool last, std::vector<unsigned char>& out);
+private:
+  /// The compression level.
+  int level = 6;
+  /// The data that may be referred to by the next call.
+  std::vector<unsigned char> dictionary;
+};
+
+/// Compresses data into a complete zlib stream (RFC 1950.)
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param data The data to compress.
+/// @param size The number of bytes in @p data.
+/// @param level The compression level, from 0 to 9.
+/// See @ref Deflater::Deflater for more information.
+///
+/// @return The zlib stream.
+std::vector<unsigned char> compressZlib(const unsigned char* data, std::size_t size, int level = 6);
+
+/// Writes the two byte header of a zlib stream.
+///
+/// @param level The compression level that the stream was made with.
+/// @param out The buffer to append the header to.
+void writeZlibHeader(int level, std::vector<unsigned char>& out);
+
+/// Decompresses a complete zlib stream (RFC 1950.)
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param data The zlib stream.
+/// @param size The number of bytes in @p data.
+/// @param out The buffer to append the decompressed data to.
+/// @param maxSize The most bytes that may be decompressed, such as
+/// the size of an image, so that a damaged or hostile stream can't
+/// use up the memory of the process.
+///
+/// @return True on success, false if the stream is not valid,
+/// its checksum doesn't match or it decompresses to too many bytes.
+bool decompressZlib(const unsigned char* data, std::size_t size, std::vector<unsigned char>& out, std::size_t maxSize = SIZE_MAX);
+
+} // namespace px
+
+#endif // LIBPX_IO_DEFLATE_HPP
@@ -0,0 +1,50 @@
+#include "File.hpp"
+
+#include <cstdio>
+
+namespace px {
+
+bool writeFile(const char* path, const void* data, std::size_t size)
+{
+  FILE* file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  auto written = std::fwrite(data, 1, size, file);
+
+  auto closed = (std::fclose(file) == 0);
+
+  return (written == size) && closed;
+}
+
+bool readFile(const char* path, std::vector<unsigned char>& data)
+{
+  FILE* file = std::fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+
+  data.clear();
+
+  unsigned char buffer[65536];
+
+  for (;;) {
+
+    auto count = std::fread(buffer, 1, sizeof(buffer), file);
+
+    data.insert(data.end(), buffer, buffer + count);
+
+    if (count < sizeof(buffer)) {
+      break;
+    }
+  }
+
+  auto failed = std::ferror(file) != 0;
+
+  std::fclose(file);
+
+  return !failed;
+}
+
+} // namespace px
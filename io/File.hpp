@@ -0,0 +1,50 @@
+#ifndef LIBPX_IO_FILE_HPP
+#define LIBPX_IO_FILE_HPP
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+namespace px {
+
+/// Writes bytes to a file, replacing the file if it exists.
+///
+/// @param path The path of the file to write.
+/// @param data The bytes to write.
+/// @param size The number of bytes to write.
+///
+/// @return True on success, false on failure.
+/// On failure, errno is set to indicate the error.
+bool writeFile(const char* path, const void* data, std::size_t size);
+
+/// Writes bytes to a file, replacing the file if it exists.
+///
+/// @return True on success, false on failure.
+inline bool writeFile(const char* path, const std::vector<unsigned char>& data)
+{
+  return writeFile(path, data.data(), data.size());
+}
+
+/// Writes text to a file, replacing the file if it exists.
+///
+/// @return True on success, false on failure.
+inline bool writeFile(const char* path, const std::string& text)
+{
+  return writeFile(path, text.data(), text.size());
+}
+
+/// Reads the whole contents of a file.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param path The path of the file to read.
+/// @param data Receives the bytes of the file.
+///
+/// @return True on success, false on failure.
+/// On failure, errno is set to indicate the error.
+bool readFile(const char* path, std::vector<unsigned char>& data);
+
+} // namespace px
+
+#endif // LIBPX_IO_FILE_HPP
@@ -0,0 +1,41 @@
+#include "Import.hpp"
+
+#include "File.hpp"
+#include "Png.hpp"
+
+#include <libpx.hpp>
+
+#include <vector>
+
+namespace px {
+
+Bitmap* importPNG(Document* doc, const unsigned char* data, std::size_t size, std::size_t layer)
+{
+  std::vector<unsigned char> rgba;
+
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+  if (!decodePNG(data, size, rgba, width, height) || (width > maxBitmapSize) || (height > maxBitmapSize)) {
+    return nullptr;
+  }
+
+  Bitmap* bitmap = addBitmap(doc, layer);
+
+  setPixels(bitmap, rgba.data(), width, height);
+
+  return bitmap;
+}
+
+Bitmap* importPNG(Document* doc, const char* path, std::size_t layer)
+{
+  std::vector<unsigned char> data;
+
+  if (!readFile(path, data)) {
+    return nullptr;
+  }
+
+  return importPNG(doc, data.data(), data.size(), layer);
+}
+
+} // namespace px
@@ -0,0 +1,41 @@
+#ifndef LIBPX_IO_IMPORT_HPP
+#define LIBPX_IO_IMPORT_HPP
+
+#include <cstddef>
+
+namespace px {
+
+struct Bitmap;
+struct Document;
+
+/// Decodes a PNG file and adds it to a document as a bitmap,
+/// with its top left corner at the origin of the document.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to add the bitmap to.
+/// @param data The contents of the PNG file.
+/// @param size The number of bytes in @p data.
+/// @param layer The index of the layer to add the bitmap to.
+///
+/// @return The new bitmap, or a null pointer if the file could not
+/// be decoded or is more than @ref maxBitmapSize pixels across. The
+/// document is not changed in that case.
+Bitmap* importPNG(Document* doc, const unsigned char* data, std::size_t size, std::size_t layer = 0);
+
+/// Reads a PNG file and adds it to a document as a bitmap.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to add the bitmap to.
+/// @param path The path of the PNG file.
+/// @param layer The index of the layer to add the bitmap to.
+///
+/// @return The new bitmap, or a null pointer if the file could not be
+/// read or decoded. If it could not be read, errno is set to indicate
+/// the error.
+Bitmap* importPNG(Document* doc, const char* path, std::size_t layer = 0);
+
+} // namespace px
+
+#endif // LIBPX_IO_IMPORT_HPP
@@ -0,0 +1,43 @@
+#include "Json.hpp"
+
+#include <cstdio>
+
+namespace px {
+
+std::string escapeJSON(const std::string& str)
+{
+  std::string out;
+
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if ((unsigned char) c < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+          out += buf;
+        } else {
+          out += c;
+        }
+        break;
+    }
+  }
+
+  return out;
+}
+
+} // namespace px
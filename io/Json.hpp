@@ -0,0 +1,13 @@
+#ifndef LIBPX_IO_JSON_HPP
+#define LIBPX_IO_JSON_HPP
+
+#include <string>
+
+namespace px {
+
+/// Escapes a string so that it can be put between quotes in JSON.
+std::string escapeJSON(const std::string& str);
+
+} // namespace px
+
+#endif // LIBPX_IO_JSON_HPP
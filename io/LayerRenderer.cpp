@@ -0,0 +1,48 @@
+#include "LayerRenderer.hpp"
+
+#include <libpx.hpp>
+
+#include <new>
+
+namespace px {
+
+LayerRenderer::~LayerRenderer()
+{
+  closeRenderContext(context);
+  closeImage(image);
+  closeDoc(doc);
+}
+
+void LayerRenderer::init(const Document* original)
+{
+  doc = copyDoc(original);
+  image = createImage(0, 0);
+  context = createRenderContext();
+
+  setBackground(doc, 0, 0, 0, 0);
+
+  for (std::size_t i = 0; i < getLayerCount(doc); i++) {
+    setLayerVisibility(getLayer(doc, i), false);
+  }
+
+  visibleLayer = getLayerCount(doc);
+}
+
+const Image* LayerRenderer::renderLayer(std::size_t layer)
+{
+  if (visibleLayer < getLayerCount(doc)) {
+    setLayerVisibility(getLayer(doc, visibleLayer), false);
+  }
+
+  setLayerVisibility(getLayer(doc, layer), true);
+
+  visibleLayer = layer;
+
+  if (!render(doc, image, context)) {
+    throw std::bad_alloc();
+  }
+
+  return image;
+}
+
+} // namespace px
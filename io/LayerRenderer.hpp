@@ -0,0 +1,54 @@
+#ifndef LIBPX_IO_LAYER_RENDERER_HPP
+#define LIBPX_IO_LAYER_RENDERER_HPP
+
+#include <cstddef>
+
+namespace px {
+
+struct Document;
+struct Image;
+struct RenderContext;
+
+/// Renders the layers of a document one at a time,
+/// each onto a transparent background.
+///
+/// The renderer works on its own copy of the document, so
+/// one renderer per thread may render layers in parallel.
+class LayerRenderer final
+{
+  /// A copy of the document, in which only
+  /// the layer being rendered is visible.
+  Document* doc = nullptr;
+  /// The image the layers are rendered onto.
+  Image* image = nullptr;
+  /// The scratch memory of the renderer.
+  RenderContext* context = nullptr;
+  /// The layer that is currently visible.
+  std::size_t visibleLayer = 0;
+public:
+  LayerRenderer() = default;
+  LayerRenderer(const LayerRenderer&) = delete;
+  ~LayerRenderer();
+  /// Indicates whether or not @ref LayerRenderer::init has been called.
+  inline bool initialized() const noexcept { return doc != nullptr; }
+  /// Prepares the renderer for a document.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param doc The document to render the layers of.
+  void init(const Document* doc);
+  /// Renders a single layer, whether or not it is visible
+  /// in the document. The opacity of the layer is applied.
+  ///
+  /// @exception std::bad_alloc If the image could not be resized.
+  ///
+  /// @param layer The index of the layer to render.
+  ///
+  /// @return The image containing the layer.
+  /// This is reused by the next call.
+  const Image* renderLayer(std::size_t layer);
+};
+
+} // namespace px
+
+#endif // LIBPX_IO_LAYER_RENDERER_HPP
@@ -0,0 +1,98 @@
+#ifndef LIBPX_IO_PARALLEL_HPP
+#define LIBPX_IO_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace px {
+
+/// Gets the number of threads to run work on.
+///
+/// @param requested The number of threads that were asked for.
+/// If this is zero, one thread per processor is used.
+///
+/// @return The number of threads to use, which is at least one.
+inline std::size_t getThreadCount(std::size_t requested) noexcept
+{
+  if (requested) {
+    return requested;
+  }
+
+  return std::max(std::size_t(std::thread::hardware_concurrency()), std::size_t(1));
+}
+
+/// Calls a function once for each index in a range, spread over threads.
+///
+/// Indices are handed out one at a time, so work items of different
+/// sizes are balanced between the threads. The calling thread does
+/// work as well, and if threads can't be started (such as on platforms
+/// without thread support), it does all of the work by itself.
+///
+/// If the function throws an exception, the remaining indices are
+/// skipped and the first exception is rethrown on the calling thread.
+///
+/// @param count The number of indices to call the function with.
+/// @param threadCount The number of threads to use, including the calling thread.
+/// @param functor The function to call. It is given the index and the
+/// index of the thread calling it, which is less than @p threadCount.
+template <typename Functor>
+void parallelFor(std::size_t count, std::size_t threadCount, Functor functor)
+{
+  std::atomic<std::size_t> next(0);
+
+  std::exception_ptr error;
+
+  std::mutex errorMutex;
+
+  auto work = [&](std::size_t threadIndex) {
+    try {
+      for (;;) {
+
+        auto i = next++;
+
+        if (i >= count) {
+          break;
+        }
+
+        functor(i, threadIndex);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next = count;
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (std::size_t i = 1; i < std::min(threadCount, count); i++) {
+    try {
+      threads.emplace_back(work, i);
+    } catch (const std::system_error&) {
+      break;
+    }
+  }
+
+  work(0);
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace px
+
+#endif // LIBPX_IO_PARALLEL_HPP
@@ -0,0 +1,1163 @@
+#include "Png.hpp"
+
+#include "Checksum.hpp"
+#include "Deflate.hpp"
+#include "Parallel.hpp"
+#include "Quantize.hpp"
+#include "Sink.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIBPX_IO_HAVE_SSE2 1
+#endif
+
+namespace px {
+
+namespace {
+
+/// The number of bytes in each pixel.
+constexpr std::size_t bytesPerPixel() noexcept
+{
+  return 4;
+}
+
+/// The most colors that the palette of a PNG file may have.
+constexpr std::size_t maxPaletteSize() noexcept
+{
+  return 256;
+}
+
+/// Describes the rows of an image being encoded.
+struct RowFormat final
+{
+  /// The number of bytes in each row, before it is filtered.
+  std::size_t rowSize = 0;
+  /// The number of bytes that filters look back by, which is the
+  /// size of a pixel, or one byte if pixels are smaller than that.
+  std::size_t filterStride = bytesPerPixel();
+  /// Whether or not rows are filtered. Indexed rows are not, as the
+  /// PNG specification recommends, since the difference between two
+  /// indices says nothing about the difference between their colors.
+  bool filtered = true;
+};
+
+/// Appends a 32-bit big endian integer to a buffer.
+void writeU32(std::vector<unsigned char>& out, std::uint32_t value)
+{
+  out.push_back((unsigned char) (value >> 24));
+  out.push_back((unsigned char) (value >> 16));
+  out.push_back((unsigned char) (value >> 8));
+  out.push_back((unsigned char) (value));
+}
+
+/// The Paeth predictor defined by the PNG format.
+inline unsigned char paeth(int a, int b, int c) noexcept
+{
+  int p = a + b - c;
+  int pa = std::abs(p - a);
+  int pb = std::abs(p - b);
+  int pc = std::abs(p - c);
+
+  if ((pa <= pb) && (pa <= pc)) {
+    return (unsigned char) a;
+  } else if (pb <= pc) {
+    return (unsigned char) b;
+  } else {
+    return (unsigned char) c;
+  }
+}
+
+/// Applies a filter to a row.
+///
+/// @param type The filter type, from 0 to 4.
+/// @param row The row to filter.
+/// @param prev The row above, which is all zeros for the first row.
+/// @param size The number of bytes in each row.
+/// @param bpp The number of bytes that the filter looks back by.
+/// @param out Receives the filtered row.
+void filterRow(int type, const unsigned char* row, const unsigned char* prev, std::size_t size, std::size_t bpp, unsigned char* out) noexcept
+{
+  for (std::size_t i = 0; i < size; i++) {
+
+    int a = (i >= bpp) ? row[i - bpp] : 0;
+    int b = prev[i];
+    int c = (i >= bpp) ? prev[i - bpp] : 0;
+
+    switch (type) {
+      case 0:
+        out[i] = row[i];
+        break;
+      case 1:
+        out[i] = (unsigned char) (row[i] - a);
+        break;
+      case 2:
+        out[i] = (unsigned char) (row[i] - b);
+        break;
+      case 3:
+        out[i] = (unsigned char) (row[i] - ((a + b) / 2));
+        break;
+      case 4:
+        out[i] = (unsigned char) (row[i] - paeth(a, b, c));
+        break;
+    }
+  }
+}
+
+/// Scores a filtered row, where a lower score usually compresses better.
+std::size_t scoreRow(const unsigned char* row, std::size_t size) noexcept
+{
+  std::size_t sum = 0;
+
+  for (std::size_t i = 0; i < size; i++) {
+    sum += std::size_t(std::abs(int((signed char) row[i])));
+  }
+
+  return sum;
+}
+
+/// The number of bytes of filtered rows in each band,
+/// which is the unit of work given to each thread.
+constexpr std::size_t bandSize() noexcept
+{
+  return 256 * 1024;
+}
+
+/// The number of bytes that deflate can refer back to.
+constexpr std::size_t windowSize() noexcept
+{
+  return 32 * 1024;
+}
+
+/// Converts a row of the image to the bytes that are filtered,
+/// such as 8-bit RGBA colors or packed palette indices.
+using RowConverter = std::function<void (std::size_t y, unsigned char* dst)>;
+
+/// A band of rows, once it has been filtered and compressed.
+struct Band final
+{
+  /// The compressed rows.
+  std::vector<unsigned char> data;
+  /// The checksum of the filtered rows.
+  std::uint32_t adler = 1;
+  /// The number of bytes of filtered rows.
+  std::size_t size = 0;
+};
+
+/// Filters and compresses a band of rows.
+///
+/// Deflate may refer back to the rows before the band, so these
+/// are filtered again and given to the deflater as its dictionary.
+/// Filtering only depends on the row and the one above it, so this
+/// gives the same bytes as filtering the image from the top.
+///
+/// @param convert The function converting rows to bytes.
+/// @param format The format of the converted rows.
+/// @param height The height of the image.
+/// @param y0 The first row of the band.
+/// @param y1 The row after the last one in the band.
+/// @param level The compression level.
+/// @param band Receives the compressed band.
+void encodeBand(const RowConverter& convert,
+                const RowFormat& format,
+                std::size_t height,
+                std::size_t y0,
+                std::size_t y1,
+                int level,
+                Band& band)
+{
+  std::size_t rowSize = format.rowSize;
+
+  std::size_t filteredRowSize = rowSize + 1;
+
+  std::size_t dictRows = 0;
+
+  if (level > 0) {
+    dictRows = std::min(y0, (windowSize() + filteredRowSize - 1) / filteredRowSize);
+  }
+
+  std::size_t firstRow = y0 - dictRows;
+
+  std::vector<unsigned char> rows(rowSize * 2, 0);
+
+  auto* prev = rows.data();
+
+  auto* row = prev + rowSize;
+
+  if (firstRow > 0) {
+    convert(firstRow - 1, prev);
+  }
+
+  std::vector<unsigned char> filtered(filteredRowSize * (y1 - firstRow));
+
+  std::vector<unsigned char> candidate(rowSize);
+
+  for (std::size_t y = firstRow; y < y1; y++) {
+
+    convert(y, row);
+
+    auto* dst = &filtered[(y - firstRow) * filteredRowSize];
+
+    if ((level == 0) || !format.filtered) {
+      // When the data isn't compressed,
+      // filtering it would only cost time.
+      dst[0] = 0;
+      std::memcpy(dst + 1, row, rowSize);
+    } else {
+
+      // The filter with the smallest sum of
+      // differences is usually the most compressible.
+
+      std::size_t bestScore = SIZE_MAX;
+
+      for (int type = 0; type < 5; type++) {
+
+        filterRow(type, row, prev, rowSize, format.filterStride, candidate.data());
+
+        auto score = scoreRow(candidate.data(), rowSize);
+
+        if (score < bestScore) {
+          bestScore = score;
+          dst[0] = (unsigned char) type;
+          std::memcpy(dst + 1, candidate.data(), rowSize);
+        }
+      }
+    }
+
+    std::swap(prev, row);
+  }
+
+  auto dictSize = dictRows * filteredRowSize;
+
+  const auto* data = filtered.data() + dictSize;
+
+  band.size = filtered.size() - dictSize;
+
+  band.adler = updateAdler32(1, data, band.size);
+
+  Deflater deflater(level);
+
+  deflater.setDictionary(filtered.data(), dictSize);
+
+  deflater.compress(data, band.size, y1 == height, band.data);
+}
+
+/// Writes the signature and the header of a PNG file.
+///
+/// @param bitDepth The number of bits in each channel or palette index.
+/// @param colorType The color type, as defined by the PNG format.
+bool writeHeader(Sink& sink, std::size_t width, std::size_t height, int bitDepth, int colorType)
+{
+  static const unsigned char signature[8] { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+  if (!sink.write(signature, sizeof(signature))) {
+    return false;
+  }
+
+  unsigned char header[13];
+  header[0] = (unsigned char) (width >> 24);
+  header[1] = (unsigned char) (width >> 16);
+  header[2] = (unsigned char) (width >> 8);
+  header[3] = (unsigned char) (width);
+  header[4] = (unsigned char) (height >> 24);
+  header[5] = (unsigned char) (height >> 16);
+  header[6] = (unsigned char) (height >> 8);
+  header[7] = (unsigned char) (height);
+  // Deflate, adaptive filtering, no interlacing.
+  header[8] = (unsigned char) bitDepth;
+  header[9] = (unsigned char) colorType;
+  header[10] = 0;
+  header[11] = 0;
+  header[12] = 0;
+
+  return writePNGChunk(sink, "IHDR", header, sizeof(header));
+}
+
+/// Writes the image data and the end of a PNG file,
+/// with the rows of the image given by a function.
+bool writeImageData(Sink& sink, const RowConverter& convert, const RowFormat& format, std::size_t height, const PNGOptions& options)
+{
+  auto level = std::min(std::max(options.level, 0), 9);
+
+  std::size_t filteredRowSize = format.rowSize + 1;
+
+  std::size_t rowsPerBand = std::max(bandSize() / filteredRowSize, std::size_t(1));
+
+  // An empty image still needs a (final) band.
+  std::size_t bandCount = std::max((height + rowsPerBand - 1) / rowsPerBand, std::size_t(1));
+
+  auto threadCount = std::min(getThreadCount(options.threadCount), bandCount);
+
+  // The bands are encoded a few at a time, so
+  // that the image isn't kept in memory at once.
+
+  std::vector<Band> bands(threadCount * 2);
+
+  std::uint32_t adler = 1;
+
+  for (std::size_t first = 0; first < bandCount; first += bands.size()) {
+
+    auto count = std::min(bands.size(), bandCount - first);
+
+    parallelFor(count, threadCount, [&](std::size_t i, std::size_t) {
+
+      auto y0 = (first + i) * rowsPerBand;
+
+      auto y1 = std::min(y0 + rowsPerBand, height);
+
+      bands[i] = Band();
+
+      encodeBand(convert, format, height, std::min(y0, y1), y1, level, bands[i]);
+    });
+
+    for (std::size_t i = 0; i < count; i++) {
+
+      auto& band = bands[i];
+
+      adler = combineAdler32(adler, band.adler, band.size);
+
+      if ((first + i) == 0) {
+        std::vector<unsigned char> zlibHeader;
+        writeZlibHeader(level, zlibHeader);
+        band.data.insert(band.data.begin(), zlibHeader.begin(), zlibHeader.end());
+      }
+
+      if ((first + i + 1) == bandCount) {
+        band.data.push_back((unsigned char) (adler >> 24));
+        band.data.push_back((unsigned char) (adler >> 16));
+        band.data.push_back((unsigned char) (adler >> 8));
+        band.data.push_back((unsigned char) (adler));
+      }
+
+      if (!writePNGChunk(sink, "IDAT", band.data.data(), band.data.size())) {
+        return false;
+      }
+    }
+  }
+
+  return writePNGChunk(sink, "IEND", nullptr, 0);
+}
+
+/// Builds the palette of an indexed PNG file.
+///
+/// The colors are counted in a hash table, so if there are no more
+/// than 256 of them, they are found exactly. Otherwise, the image is
+/// quantized. Translucent colors are put first, so that the
+/// transparency chunk only needs to cover those.
+///
+/// @param rgba The 8-bit RGBA colors of the image.
+/// @param pixelCount The number of pixels in the image.
+/// @param threadCount The number of threads to count colors with.
+///
+/// @return The packed colors of the palette, which has at least one color.
+std::vector<std::uint32_t> buildPNGPalette(const unsigned char* rgba, std::size_t pixelCount, std::size_t threadCount)
+{
+  std::vector<ColorHistogram> histograms(threadCount);
+
+  parallelFor(threadCount, threadCount, [&](std::size_t i, std::size_t) {
+
+    auto first = (pixelCount * i) / threadCount;
+    auto last = (pixelCount * (i + 1)) / threadCount;
+
+    // Pixel art has long runs of one color, which are counted
+    // with one lookup, rather than one lookup per pixel.
+
+    while (first < last) {
+
+      auto color = packColor(rgba + (first * 4));
+
+      auto end = first + 1;
+
+      while ((end < last) && (packColor(rgba + (end * 4)) == color)) {
+        end++;
+      }
+
+      histograms[i].add(color, std::uint32_t(end - first));
+
+      first = end;
+    }
+  });
+
+  for (std::size_t i = 1; i < threadCount; i++) {
+    histograms[0].add(histograms[i]);
+  }
+
+  auto palette = histograms[0].buildPalette(maxPaletteSize());
+
+  if (palette.empty()) {
+    palette.emplace_back(0);
+  }
+
+  std::stable_partition(palette.begin(), palette.end(), [](std::uint32_t color) {
+    return (color >> 24) != 0xff;
+  });
+
+  return palette;
+}
+
+/// Writes a PNG file with a palette, with up to 8 bits per pixel.
+bool writeIndexedPNG(Sink& sink, const unsigned char* rgba, std::size_t width, std::size_t height, const PNGOptions& options)
+{
+  auto pixelCount = width * height;
+
+  auto threadCount = getThreadCount(options.threadCount);
+
+  auto palette = buildPNGPalette(rgba, pixelCount, threadCount);
+
+  // The pixels are mapped before the rows are encoded,
+  // since each thread needs its own palette map.
+
+  std::vector<unsigned char> indices(pixelCount);
+
+  parallelFor(threadCount, threadCount, [&](std::size_t i, std::size_t) {
+
+    PaletteMap map(palette);
+
+    auto first = (pixelCount * i) / threadCount;
+    auto last = (pixelCount * (i + 1)) / threadCount;
+
+    for (auto j = first; j < last; j++) {
+      indices[j] = (unsigned char) map.find(packColor(rgba + (j * 4)));
+    }
+  });
+
+  // Small palettes pack several pixels into each byte.
+
+  int bitDepth = 8;
+
+  if (palette.size() <= 2) {
+    bitDepth = 1;
+  } else if (palette.size() <= 4) {
+    bitDepth = 2;
+  } else if (palette.size() <= 16) {
+    bitDepth = 4;
+  }
+
+  RowFormat format;
+  format.rowSize = ((width * std::size_t(bitDepth)) + 7) / 8;
+  format.filterStride = 1;
+  format.filtered = false;
+
+  std::vector<unsigned char> plte;
+  std::vector<unsigned char> trns;
+
+  for (auto color : palette) {
+
+    unsigned char c[4];
+
+    unpackColor(color, c);
+
+    plte.insert(plte.end(), c, c + 3);
+
+    if (c[3] != 0xff) {
+      trns.push_back(c[3]);
+    }
+  }
+
+  auto convert = [&indices, width, bitDepth](std::size_t y, unsigned char* dst) {
+
+    const auto* src = indices.data() + (y * width);
+
+    if (bitDepth == 8) {
+      std::memcpy(dst, src, width);
+      return;
+    }
+
+    auto pixelsPerByte = std::size_t(8 / bitDepth);
+
+    std::memset(dst, 0, ((width * std::size_t(bitDepth)) + 7) / 8);
+
+    for (std::size_t x = 0; x < width; x++) {
+      // The leftmost pixel is in the highest bits.
+      auto shift = 8 - (bitDepth * int((x % pixelsPerByte) + 1));
+      dst[x / pixelsPerByte] |= (unsigned char) (src[x] << shift);
+    }
+  };
+
+  return writeHeader(sink, width, height, bitDepth, 3)
+      && writePNGChunk(sink, "PLTE", plte.data(), plte.size())
+      && (trns.empty() || writePNGChunk(sink, "tRNS", trns.data(), trns.size()))
+      && writeImageData(sink, RowConverter(convert), format, height, options);
+}
+
+} // namespace
+
+bool writePNGHeader(Sink& sink, std::size_t width, std::size_t height)
+{
+  // 8 bits per channel and RGBA.
+  return writeHeader(sink, width, height, 8, 6);
+}
+
+bool writePNGChunk(Sink& sink, const char* type, const unsigned char* data, std::size_t size)
+{
+  // The chunk is put together first, so that
+  // the sink is written to once per chunk.
+
+  std::vector<unsigned char> chunk;
+
+  chunk.reserve(size + 12);
+
+  writeU32(chunk, std::uint32_t(size));
+
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data, data + size);
+
+  writeU32(chunk, updateCRC32(0, &chunk[4], size + 4));
+
+  return sink.write(chunk.data(), chunk.size());
+}
+
+std::vector<unsigned char> compressPNGData(const unsigned char* rgba, std::size_t width, std::size_t height, int level)
+{
+  RowFormat format;
+
+  format.rowSize = width * bytesPerPixel();
+
+  auto convert = [rgba, &format](std::size_t y, unsigned char* dst) {
+    std::memcpy(dst, rgba + (y * format.rowSize), format.rowSize);
+  };
+
+  level = std::min(std::max(level, 0), 9);
+
+  Band band;
+
+  encodeBand(RowConverter(convert), format, height, 0, height, level, band);
+
+  std::vector<unsigned char> data;
+
+  data.reserve(band.data.size() + 6);
+
+  writeZlibHeader(level, data);
+
+  data.insert(data.end(), band.data.begin(), band.data.end());
+
+  writeU32(data, band.adler);
+
+  return data;
+}
+
+void convertToRGBA8(const float* src, std::size_t pixelCount, unsigned char* dst) noexcept
+{
+  std::size_t i = 0;
+
+#ifdef LIBPX_IO_HAVE_SSE2
+
+  // Four pixels at a time. Each pixel is un-premultiplied in its
+  // own register, then the four are packed down to 16 bytes.
+
+  const auto zero = _mm_setzero_ps();
+  const auto one = _mm_set1_ps(1.0f);
+  const auto scale = _mm_set1_ps(255.0f);
+  const auto half = _mm_set1_ps(0.5f);
+  // Selects the alpha channel.
+  const auto alphaMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+  auto convertPixel = [&](const float* pixel) {
+
+    auto color = _mm_loadu_ps(pixel);
+
+    auto alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+
+    // Transparent pixels are black, rather than the result of 1 / 0.
+    auto k = _mm_and_ps(_mm_div_ps(one, alpha), _mm_cmpgt_ps(alpha, zero));
+
+    color = _mm_or_ps(_mm_andnot_ps(alphaMask, _mm_mul_ps(color, k)), _mm_and_ps(alphaMask, alpha));
+
+    color = _mm_min_ps(_mm_max_ps(color, zero), one);
+
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, scale), half));
+  };
+
+  for (; (i + 4) <= pixelCount; i += 4, src += 16, dst += 16) {
+
+    auto p0 = convertPixel(src);
+    auto p1 = convertPixel(src + 4);
+    auto p2 = convertPixel(src + 8);
+    auto p3 = convertPixel(src + 12);
+
+    auto packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+
+    _mm_storeu_si128((__m128i*) dst, packed);
+  }
+
+#endif // LIBPX_IO_HAVE_SSE2
+
+  auto toByte = [](float v) {
+    v = (v < 0) ? 0 : ((v > 1) ? 1 : v);
+    return (unsigned char) ((v * 255.0f) + 0.5f);
+  };
+
+  for (; i < pixelCount; i++, src += 4, dst += 4) {
+
+    float a = src[3];
+
+    float k = (a > 0) ? (1.0f / a) : 0.0f;
+
+    dst[0] = toByte(src[0] * k);
+    dst[1] = toByte(src[1] * k);
+    dst[2] = toByte(src[2] * k);
+    dst[3] = toByte(a);
+  }
+}
+
+bool writePNG(Sink& sink, const PNGRowSource& rows, std::size_t width, std::size_t height, const PNGOptions& options)
+{
+  if (options.indexed) {
+
+    // The palette is built from every color, so the rows are gathered first.
+
+    std::vector<unsigned char> rgba(width * height * 4);
+
+    auto threadCount = getThreadCount(options.threadCount);
+
+    parallelFor(height, threadCount, [&](std::size_t y, std::size_t) {
+      rows(y, rgba.data() + (y * width * 4));
+    });
+
+    return writeIndexedPNG(sink, rgba.data(), width, height, options);
+  }
+
+  RowFormat format;
+
+  format.rowSize = width * bytesPerPixel();
+
+  return writePNGHeader(sink, width, height) && writeImageData(sink, rows, format, height, options);
+}
+
+bool writePNG(Sink& sink, const unsigned char* rgba, std::size_t width, std::size_t height, const PNGOptions& options)
+{
+  if (options.indexed) {
+    return writeIndexedPNG(sink, rgba, width, height, options);
+  }
+
+  std::size_t rowSize = width * bytesPerPixel();
+
+  auto convert = [rgba, rowSize](std::size_t y, unsigned char* dst) {
+    std::memcpy(dst, rgba + (y * rowSize), rowSize);
+  };
+
+  return writePNG(sink, RowConverter(convert), width, height, options);
+}
+
+bool writePNG(Sink& sink, const float* color, std::size_t width, std::size_t height, const PNGOptions& options)
+{
+  if (options.indexed) {
+
+    // Every color has to be counted before the palette is known,
+    // so the image is converted all at once, in bands of rows.
+
+    std::vector<unsigned char> rgba(width * height * 4);
+
+    auto threadCount = getThreadCount(options.threadCount);
+
+    parallelFor(threadCount, threadCount, [&](std::size_t i, std::size_t) {
+      auto y0 = (height * i) / threadCount;
+      auto y1 = (height * (i + 1)) / threadCount;
+      convertToRGBA8(color + (y0 * width * 4), (y1 - y0) * width, rgba.data() + (y0 * width * 4));
+    });
+
+    return writeIndexedPNG(sink, rgba.data(), width, height, options);
+  }
+
+  auto convert = [color, width](std::size_t y, unsigned char* dst) {
+    convertToRGBA8(color + (y * width * 4), width, dst);
+  };
+
+  return writePNG(sink, RowConverter(convert), width, height, options);
+}
+
+std::vector<unsigned char> encodePNG(const unsigned char* rgba, std::size_t width, std::size_t height, int level)
+{
+  BufferSink sink;
+
+  PNGOptions options;
+
+  options.level = level;
+  options.threadCount = 1;
+
+  writePNG(sink, rgba, width, height, options);
+
+  return sink.getBuffer();
+}
+
+std::vector<unsigned char> encodePNG(const float* color, std::size_t width, std::size_t height, int level)
+{
+  BufferSink sink;
+
+  PNGOptions options;
+
+  options.level = level;
+  options.threadCount = 1;
+
+  writePNG(sink, color, width, height, options);
+
+  return sink.getBuffer();
+}
+
+namespace {
+
+/// The most pixels that a decoded image may have, so that
+/// a damaged header can't make the decoder allocate more
+/// memory than any sprite could reasonably need.
+constexpr std::size_t maxDecodedPixels() noexcept
+{
+  return std::size_t(1) << 28;
+}
+
+/// Reads a 32-bit big endian integer.
+inline std::uint32_t readU32(const unsigned char* in) noexcept
+{
+  return (std::uint32_t(in[0]) << 24)
+       | (std::uint32_t(in[1]) << 16)
+       | (std::uint32_t(in[2]) << 8)
+       | (std::uint32_t(in[3]));
+}
+
+/// The header of a PNG file being decoded.
+struct PNGHeader final
+{
+  std::size_t width = 0;
+  std::size_t height = 0;
+  unsigned bitDepth = 0;
+  unsigned colorType = 0;
+  bool interlaced = false;
+  /// The number of samples in each pixel.
+  std::size_t channels = 0;
+  /// Parses the data of an IHDR chunk.
+  ///
+  /// @return True on success, false if the header is not valid.
+  bool parse(const unsigned char* data, std::size_t size) noexcept
+  {
+    if (size != 13) {
+      return false;
+    }
+
+    width = readU32(data);
+    height = readU32(data + 4);
+    bitDepth = data[8];
+    colorType = data[9];
+    interlaced = data[12] == 1;
+
+    // The compression and filter methods only have one value each.
+    if (data[10] || data[11] || (data[12] > 1)) {
+      return false;
+    }
+
+    if (!width || !height || (width > (maxDecodedPixels() / height))) {
+      return false;
+    }
+
+    switch (colorType) {
+      case 0:
+        channels = 1;
+        return (bitDepth == 1) || (bitDepth == 2) || (bitDepth == 4) || (bitDepth == 8) || (bitDepth == 16);
+      case 3:
+        channels = 1;
+        return (bitDepth == 1) || (bitDepth == 2) || (bitDepth == 4) || (bitDepth == 8);
+      case 2:
+        channels = 3;
+        break;
+      case 4:
+        channels = 2;
+        break;
+      case 6:
+        channels = 4;
+        break;
+      default:
+        return false;
+    }
+
+    return (bitDepth == 8) || (bitDepth == 16);
+  }
+  /// Gets the number of bytes in a row, without its filter type.
+  inline std::size_t getRowSize(std::size_t w) const noexcept
+  {
+    return ((w * channels * bitDepth) + 7) / 8;
+  }
+  /// Gets the number of bytes that filters look back by.
+  inline std::size_t getFilterStride() const noexcept
+  {
+    return std::max(std::size_t(1), (channels * bitDepth) / 8);
+  }
+};
+
+/// Describes one of the passes of an image.
+/// Images that are not interlaced have one pass over every pixel.
+struct PNGPass final
+{
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t dx = 1;
+  std::size_t dy = 1;
+  /// Gets the number of pixels the pass has across an image size.
+  inline std::size_t count(std::size_t start, std::size_t step, std::size_t size) const noexcept
+  {
+    return (size > start) ? (((size - start) + (step - 1)) / step) : 0;
+  }
+  inline std::size_t getWidth(std::size_t imageWidth) const noexcept
+  {
+    return count(x, dx, imageWidth);
+  }
+  inline std::size_t getHeight(std::size_t imageHeight) const noexcept
+  {
+    return count(y, dy, imageHeight);
+  }
+};
+
+/// Gets the passes of an image.
+std::vector<PNGPass> getPasses(bool interlaced)
+{
+  if (!interlaced) {
+    return std::vector<PNGPass>(1);
+  }
+
+  // Adam7
+  return std::vector<PNGPass> {
+    { 0, 0, 8, 8 },
+    { 4, 0, 8, 8 },
+    { 0, 4, 4, 8 },
+    { 2, 0, 4, 4 },
+    { 0, 2, 2, 4 },
+    { 1, 0, 2, 2 },
+    { 0, 1, 1, 2 }
+  };
+}
+
+/// Reverses the filter of a row, in place.
+///
+/// @param type The filter type, from 0 to 4.
+/// @param row The row to unfilter.
+/// @param prev The unfiltered row above, which is all zeros for the first row.
+/// @param size The number of bytes in the row.
+/// @param bpp The number of bytes that the filter looks back by.
+///
+/// @return True on success, false if the filter type is not valid.
+bool unfilterRow(int type, unsigned char* row, const unsigned char* prev, std::size_t size, std::size_t bpp) noexcept
+{
+  switch (type) {
+    case 0:
+      break;
+    case 1:
+      for (std::size_t i = bpp; i < size; i++) {
+        row[i] = (unsigned char) (row[i] + row[i - bpp]);
+      }
+      break;
+    case 2:
+      for (std::size_t i = 0; i < size; i++) {
+        row[i] = (unsigned char) (row[i] + prev[i]);
+      }
+      break;
+    case 3:
+      for (std::size_t i = 0; i < size; i++) {
+        int a = (i >= bpp) ? row[i - bpp] : 0;
+        row[i] = (unsigned char) (row[i] + ((a + prev[i]) / 2));
+      }
+      break;
+    case 4:
+      for (std::size_t i = 0; i < size; i++) {
+        int a = (i >= bpp) ? row[i - bpp] : 0;
+        int c = (i >= bpp) ? prev[i - bpp] : 0;
+        row[i] = (unsigned char) (row[i] + paeth(a, prev[i], c));
+      }
+      break;
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+/// Converts the unfiltered rows of a PNG file to 8-bit RGBA colors.
+class PNGPixelReader final
+{
+  /// The header of the image.
+  const PNGHeader& header;
+  /// The colors of the palette. Indices past the
+  /// end of the palette are opaque black.
+  unsigned char palette[256][4] {};
+  /// The raw samples of the color that is transparent,
+  /// for images that have no alpha channel or palette.
+  unsigned transparentKey[3] {};
+  /// Whether or not there is a transparent color.
+  bool hasTransparentKey = false;
+public:
+  explicit PNGPixelReader(const PNGHeader& h) noexcept : header(h)
+  {
+    for (auto& color : palette) {
+      color[3] = 255;
+    }
+  }
+  /// Sets the palette from a PLTE chunk.
+  ///
+  /// @return True on success, false if the chunk is not valid.
+  bool setPalette(const unsigned char* data, std::size_t size) noexcept
+  {
+    if (!size || (size % 3) || (size > (256 * 3))) {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < (size / 3); i++) {
+      palette[i][0] = data[(i * 3) + 0];
+      palette[i][1] = data[(i * 3) + 1];
+      palette[i][2] = data[(i * 3) + 2];
+    }
+
+    return true;
+  }
+  /// Sets the transparency from a tRNS chunk.
+  ///
+  /// @return True on success, false if the chunk is not valid.
+  bool setTransparency(const unsigned char* data, std::size_t size) noexcept
+  {
+    switch (header.colorType) {
+      case 0:
+        if (size != 2) {
+          return false;
+        }
+        transparentKey[0] = (unsigned(data[0]) << 8) | data[1];
+        hasTransparentKey = true;
+        return true;
+      case 2:
+        if (size != 6) {
+          return false;
+        }
+        for (int c = 0; c < 3; c++) {
+          transparentKey[c] = (unsigned(data[c * 2]) << 8) | data[(c * 2) + 1];
+        }
+        hasTransparentKey = true;
+        return true;
+      case 3:
+        if (size > 256) {
+          return false;
+        }
+        for (std::size_t i = 0; i < size; i++) {
+          palette[i][3] = data[i];
+        }
+        return true;
+    }
+
+    return false;
+  }
+  /// Converts a row of pixels.
+  ///
+  /// @param row The unfiltered row.
+  /// @param count The number of pixels in the row.
+  /// @param dst Receives the color of the first pixel.
+  /// @param step The number of pixels between each color written to @p dst.
+  void read(const unsigned char* row, std::size_t count, unsigned char* dst, std::size_t step) const noexcept
+  {
+    unsigned samples[4] {};
+
+    for (std::size_t x = 0; x < count; x++, dst += step * 4) {
+
+      for (std::size_t c = 0; c < header.channels; c++) {
+        samples[c] = getSample(row, (x * header.channels) + c);
+      }
+
+      switch (header.colorType) {
+        case 0:
+          dst[0] = dst[1] = dst[2] = scale(samples[0]);
+          dst[3] = (hasTransparentKey && (samples[0] == transparentKey[0])) ? 0 : 255;
+          break;
+        case 2:
+          dst[0] = scale(samples[0]);
+          dst[1] = scale(samples[1]);
+          dst[2] = scale(samples[2]);
+          dst[3] = (hasTransparentKey
+                 && (samples[0] == transparentKey[0])
+                 && (samples[1] == transparentKey[1])
+                 && (samples[2] == transparentKey[2])) ? 0 : 255;
+          break;
+        case 3:
+          std::memcpy(dst, palette[samples[0] & 0xff], 4);
+          break;
+        case 4:
+          dst[0] = dst[1] = dst[2] = scale(samples[0]);
+          dst[3] = scale(samples[1]);
+          break;
+        case 6:
+          dst[0] = scale(samples[0]);
+          dst[1] = scale(samples[1]);
+          dst[2] = scale(samples[2]);
+          dst[3] = scale(samples[3]);
+          break;
+      }
+    }
+  }
+protected:
+  /// Gets one of the samples of a row, as it's stored in the file.
+  inline unsigned getSample(const unsigned char* row, std::size_t i) const noexcept
+  {
+    switch (header.bitDepth) {
+      case 16:
+        return (unsigned(row[i * 2]) << 8) | row[(i * 2) + 1];
+      case 8:
+        return row[i];
+    }
+
+    // Samples smaller than a byte start at its most significant bit.
+
+    auto bit = i * header.bitDepth;
+
+    auto shift = 8 - header.bitDepth - (bit % 8);
+
+    return (row[bit / 8] >> shift) & ((1u << header.bitDepth) - 1);
+  }
+  /// Scales a sample to 8 bits.
+  inline unsigned char scale(unsigned sample) const noexcept
+  {
+    switch (header.bitDepth) {
+      case 16:
+        return (unsigned char) (sample >> 8);
+      case 8:
+        return (unsigned char) sample;
+    }
+
+    return (unsigned char) ((sample * 255) / ((1u << header.bitDepth) - 1));
+  }
+};
+
+} // namespace
+
+bool decodePNG(const unsigned char* data, std::size_t size, std::vector<unsigned char>& rgba, std::size_t& width, std::size_t& height)
+{
+  static const unsigned char signature[8] { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+  if ((size < 8) || (std::memcmp(data, signature, 8) != 0)) {
+    return false;
+  }
+
+  PNGHeader header;
+
+  PNGPixelReader reader(header);
+
+  std::vector<unsigned char> compressed;
+
+  auto hasHeader = false;
+  auto hasPalette = false;
+  auto ended = false;
+
+  for (std::size_t pos = 8; !ended; ) {
+
+    if ((size - pos) < 12) {
+      return false;
+    }
+
+    std::size_t length = readU32(data + pos);
+
+    if (length > (size - pos - 12)) {
+      return false;
+    }
+
+    const unsigned char* type = data + pos + 4;
+
+    const unsigned char* chunk = type + 4;
+
+    if (readU32(chunk + length) != updateCRC32(0, type, length + 4)) {
+      return false;
+    }
+
+    pos += length + 12;
+
+    auto isType = [type](const char* name) {
+      return std::memcmp(type, name, 4) == 0;
+    };
+
+    if (!hasHeader) {
+      if (!isType("IHDR") || !header.parse(chunk, length)) {
+        return false;
+      }
+      hasHeader = true;
+    } else if (isType("PLTE")) {
+      if (!reader.setPalette(chunk, length)) {
+        return false;
+      }
+      hasPalette = true;
+    } else if (isType("tRNS")) {
+      if (!reader.setTransparency(chunk, length)) {
+        return false;
+      }
+    } else if (isType("IDAT")) {
+      compressed.insert(compressed.end(), chunk, chunk + length);
+    } else if (isType("IEND")) {
+      ended = true;
+    } else if (!(type[0] & 0x20)) {
+      // An unknown chunk that is critical to decoding the image.
+      return false;
+    }
+  }
+
+  if ((header.colorType == 3) && !hasPalette) {
+    return false;
+  }
+
+  auto passes = getPasses(header.interlaced);
+
+  std::size_t expectedSize = 0;
+
+  for (const auto& pass : passes) {
+
+    auto w = pass.getWidth(header.width);
+    auto h = pass.getHeight(header.height);
+
+    if (w && h) {
+      expectedSize += (header.getRowSize(w) + 1) * h;
+    }
+  }
+
+  std::vector<unsigned char> filtered;
+
+  if (!decompressZlib(compressed.data(), compressed.size(), filtered, expectedSize) || (filtered.size() != expectedSize)) {
+    return false;
+  }
+
+  rgba.assign(header.width * header.height * 4, 0);
+
+  std::vector<unsigned char> zeros(header.getRowSize(header.width));
+
+  auto bpp = header.getFilterStride();
+
+  auto* row = filtered.data();
+
+  for (const auto& pass : passes) {
+
+    auto w = pass.getWidth(header.width);
+    auto h = pass.getHeight(header.height);
+
+    if (!w || !h) {
+      continue;
+    }
+
+    auto rowSize = header.getRowSize(w);
+
+    const unsigned char* prev = zeros.data();
+
+    for (std::size_t y = 0; y < h; y++) {
+
+      if (!unfilterRow(row[0], row + 1, prev, rowSize, bpp)) {
+        return false;
+      }
+
+      auto* dst = rgba.data() + ((((pass.y + (y * pass.dy)) * header.width) + pass.x) * 4);
+
+      reader.read(row + 1, w, dst, pass.dx);
+
+      prev = row + 1;
+
+      row += rowSize + 1;
+    }
+  }
+
+  width = header.width;
+  height = header.height;
+
+  return true;
+}
+
+} // namespace px
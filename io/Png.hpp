@@ -0,0 +1,179 @@
+#ifndef LIBPX_IO_PNG_HPP
+#define LIBPX_IO_PNG_HPP
+
+#include <functional>
+#include <vector>
+
+#include <cstddef>
+
+namespace px {
+
+class Sink;
+
+/// Options for encoding PNG files.
+struct PNGOptions final
+{
+  /// The compression level, from 0 to 9. Zero stores the image
+  /// without compressing or filtering it, which is the fastest
+  /// and is meant for previews and other temporary files.
+  int level = 6;
+  /// The number of threads to filter and compress the image with.
+  /// If this is zero, one thread per processor is used.
+  std::size_t threadCount = 0;
+  /// Whether or not the image is written with a palette and one
+  /// byte per pixel or less, rather than four bytes per pixel.
+  /// If the image has no more than 256 colors, the palette holds
+  /// them exactly. Otherwise, the image is quantized.
+  bool indexed = false;
+};
+
+/// Converts premultiplied floating point colors,
+/// as rendered by libpx, to 8-bit RGBA colors that
+/// are not premultiplied, as stored in image files.
+///
+/// @param src The colors to convert, with four floats per pixel.
+/// @param pixelCount The number of pixels to convert.
+/// @param dst Receives four bytes per pixel.
+void convertToRGBA8(const float* src, std::size_t pixelCount, unsigned char* dst) noexcept;
+
+/// Produces one row of an image as 8-bit RGBA colors, for @ref writePNG.
+/// Rows may be asked for more than once and in any order, and rows
+/// of different bands are asked for by several threads at once.
+using PNGRowSource = std::function<void (std::size_t y, unsigned char* rgba)>;
+
+/// Encodes an image as a PNG file and writes it to a sink, asking for
+/// its rows as they're needed, so that the image doesn't have to be in
+/// memory at once. Indexed images are the exception, since the palette
+/// is built from every row before the first one can be written.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param sink The sink to write the file to. This is not closed.
+/// @param rows Produces the rows of the image.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param options The options for encoding the file.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writePNG(Sink& sink, const PNGRowSource& rows, std::size_t width, std::size_t height, const PNGOptions& options = PNGOptions());
+
+/// Encodes an image as a PNG file and writes it to a sink.
+///
+/// The image is filtered and compressed in bands of rows, so
+/// only a few bands are kept in memory at a time, and the bands
+/// may be compressed on several threads. Each band is written
+/// to the sink as soon as the bands before it are written.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param sink The sink to write the file to. This is not closed.
+/// @param rgba The 8-bit RGBA colors of the image, in rows from top to bottom.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param options The options for encoding the file.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writePNG(Sink& sink, const unsigned char* rgba, std::size_t width, std::size_t height, const PNGOptions& options = PNGOptions());
+
+/// Encodes a color buffer rendered by libpx as a PNG file and
+/// writes it to a sink. The colors of each band are converted
+/// just before the band is filtered, so the image is never
+/// converted all at once.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param sink The sink to write the file to. This is not closed.
+/// @param color The premultiplied RGBA colors, with four floats per pixel.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param options The options for encoding the file.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writePNG(Sink& sink, const float* color, std::size_t width, std::size_t height, const PNGOptions& options = PNGOptions());
+
+/// Encodes an image as a PNG file, on the calling thread.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param rgba The 8-bit RGBA colors of the image, in rows from top to bottom.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param level The compression level, from 0 to 9.
+///
+/// @return The contents of the PNG file.
+std::vector<unsigned char> encodePNG(const unsigned char* rgba, std::size_t width, std::size_t height, int level = 6);
+
+/// Encodes a color buffer rendered by libpx as a PNG file, on the calling thread.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param color The premultiplied RGBA colors, with four floats per pixel.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param level The compression level, from 0 to 9.
+///
+/// @return The contents of the PNG file.
+std::vector<unsigned char> encodePNG(const float* color, std::size_t width, std::size_t height, int level = 6);
+
+/// Decodes a PNG file into 8-bit RGBA colors.
+///
+/// Every color type and bit depth of the format is supported, along
+/// with interlaced images and the transparency of the tRNS chunk.
+/// Samples with 16 bits are reduced to 8 bits and ancillary chunks,
+/// such as gamma and color profiles, are ignored. Every chunk's
+/// checksum and the checksum of the image data are verified.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param data The contents of the PNG file.
+/// @param size The number of bytes in @p data.
+/// @param rgba Receives the colors of the image, in rows from top
+/// to bottom, with four bytes per pixel. The RGB components are not
+/// premultiplied.
+/// @param width Receives the width of the image, in pixels.
+/// @param height Receives the height of the image, in pixels.
+///
+/// @return True on success, false if the file is damaged,
+/// is not a PNG file or has more than 2^28 pixels.
+bool decodePNG(const unsigned char* data, std::size_t size, std::vector<unsigned char>& rgba, std::size_t& width, std::size_t& height);
+
+/// Writes the signature and the header of a PNG file
+/// for an image with 8-bit RGBA colors. This is used by
+/// encoders that write the rest of the chunks themselves.
+///
+/// @param sink The sink to write to.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writePNGHeader(Sink& sink, std::size_t width, std::size_t height);
+
+/// Writes a chunk of a PNG file, computing its checksum.
+///
+/// @param sink The sink to write the chunk to.
+/// @param type The four letter type of the chunk.
+/// @param data The data of the chunk.
+/// @param size The number of bytes in @p data.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writePNGChunk(Sink& sink, const char* type, const unsigned char* data, std::size_t size);
+
+/// Filters and compresses an image into a zlib stream, which is
+/// the data stored in the IDAT chunks of a PNG file. This is done
+/// on the calling thread, so that callers encoding many small
+/// images (such as the frames of an APNG file) can encode them
+/// in parallel instead.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param rgba The 8-bit RGBA colors of the image, in rows from top to bottom.
+/// @param width The width of the image, in pixels.
+/// @param height The height of the image, in pixels.
+/// @param level The compression level, from 0 to 9.
+///
+/// @return The compressed image data.
+std::vector<unsigned char> compressPNGData(const unsigned char* rgba, std::size_t width, std::size_t height, int level = 6);
+
+} // namespace px
+
+#endif // LIBPX_IO_PNG_HPP
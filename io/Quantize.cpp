@@ -0,0 +1,342 @@
+#include "Quantize.hpp"
+
+#include <algorithm>
+
+namespace px {
+
+namespace {
+
+/// Gets the position in a hash table to start looking for a color at.
+///
+/// @param color The packed color to look for.
+/// @param mask The size of the table, minus one.
+inline std::size_t hashColor(std::uint32_t color, std::size_t mask) noexcept
+{
+  auto h = color * std::uint32_t(0x9e3779b1);
+
+  return std::size_t(h ^ (h >> 15)) & mask;
+}
+
+/// Gets one of the channels of a packed color.
+inline int getChannel(std::uint32_t color, int channel) noexcept
+{
+  return int((color >> (channel * 8)) & 0xff);
+}
+
+/// A color of a histogram and the number of pixels with it.
+struct ColorCount final
+{
+  std::uint32_t color = 0;
+  std::uint32_t count = 0;
+};
+
+/// A range of the colors of a histogram,
+/// which becomes one entry of the palette.
+struct ColorBox final
+{
+  /// The index of the first color in the box.
+  std::size_t begin = 0;
+  /// The index after the last color in the box.
+  std::size_t end = 0;
+  /// The channel with the widest range of values.
+  int channel = 0;
+  /// The range of the values of the widest channel.
+  int range = 0;
+  /// The number of pixels with colors in the box.
+  std::uint64_t pixels = 0;
+};
+
+/// Finds the channel of a box with the widest range of values.
+void measureBox(const std::vector<ColorCount>& colors, ColorBox& box) noexcept
+{
+  int lo[4] { 255, 255, 255, 255 };
+  int hi[4] { 0, 0, 0, 0 };
+
+  box.pixels = 0;
+
+  for (auto i = box.begin; i < box.end; i++) {
+
+    for (int c = 0; c < 4; c++) {
+      auto v = getChannel(colors[i].color, c);
+      lo[c] = std::min(lo[c], v);
+      hi[c] = std::max(hi[c], v);
+    }
+
+    box.pixels += colors[i].count;
+  }
+
+  box.channel = 0;
+  box.range = hi[0] - lo[0];
+
+  for (int c = 1; c < 4; c++) {
+    if ((hi[c] - lo[c]) > box.range) {
+      box.channel = c;
+      box.range = hi[c] - lo[c];
+    }
+  }
+}
+
+/// Computes the average color of a box, weighted by the number of pixels.
+std::uint32_t averageBox(const std::vector<ColorCount>& colors, const ColorBox& box) noexcept
+{
+  std::uint64_t sums[4] { 0, 0, 0, 0 };
+
+  for (auto i = box.begin; i < box.end; i++) {
+    for (int c = 0; c < 4; c++) {
+      sums[c] += std::uint64_t(getChannel(colors[i].color, c)) * colors[i].count;
+    }
+  }
+
+  std::uint32_t color = 0;
+
+  auto pixels = std::max(box.pixels, std::uint64_t(1));
+
+  for (int c = 0; c < 4; c++) {
+    color |= std::uint32_t((sums[c] + (pixels / 2)) / pixels) << (c * 8);
+  }
+
+  return color;
+}
+
+} // namespace
+
+std::uint32_t& ColorTable::operator [] (std::uint32_t color)
+{
+  // The table is kept at most half full, so that probes stay short.
+  if (((count + 1) * 2) > entries.size()) {
+    grow();
+  }
+
+  auto mask = entries.size() - 1;
+
+  for (auto i = hashColor(color, mask); ; i = (i + 1) & mask) {
+
+    auto& entry = entries[i];
+
+    if (!entry.used) {
+      entry.color = color;
+      entry.used = true;
+      count++;
+      return entry.value;
+    } else if (entry.color == color) {
+      return entry.value;
+    }
+  }
+}
+
+const std::uint32_t* ColorTable::find(std::uint32_t color) const noexcept
+{
+  if (entries.empty()) {
+    return nullptr;
+  }
+
+  auto mask = entries.size() - 1;
+
+  for (auto i = hashColor(color, mask); ; i = (i + 1) & mask) {
+
+    const auto& entry = entries[i];
+
+    if (!entry.used) {
+      return nullptr;
+    } else if (entry.color == color) {
+      return &entry.value;
+    }
+  }
+}
+
+void ColorTable::grow()
+{
+  std::vector<Entry> old(std::max(entries.size() * 2, std::size_t(256)));
+
+  std::swap(old, entries);
+
+  auto mask = entries.size() - 1;
+
+  for (const auto& entry : old) {
+
+    if (!entry.used) {
+      continue;
+    }
+
+    auto i = hashColor(entry.color, mask);
+
+    while (entries[i].used) {
+      i = (i + 1) & mask;
+    }
+
+    entries[i] = entry;
+  }
+}
+
+void ColorHistogram::add(std::uint32_t color, std::uint32_t count)
+{
+  counts[color] += count;
+}
+
+void ColorHistogram::add(const ColorHistogram& other)
+{
+  other.counts.forEach([this](std::uint32_t color, std::uint32_t count) {
+    counts[color] += count;
+  });
+}
+
+std::vector<std::uint32_t> ColorHistogram::buildPalette(std::size_t maxColors) const
+{
+  std::vector<ColorCount> colors;
+
+  colors.reserve(counts.size());
+
+  counts.forEach([&colors](std::uint32_t color, std::uint32_t count) {
+    ColorCount entry;
+    entry.color = color;
+    entry.count = count;
+    colors.emplace_back(entry);
+  });
+
+  // The colors are sorted first, since the order of the
+  // hash table depends on the order the colors were added in.
+
+  if (colors.size() <= maxColors) {
+
+    std::sort(colors.begin(), colors.end(), [](const ColorCount& a, const ColorCount& b) {
+      return (a.count != b.count) ? (a.count > b.count) : (a.color < b.color);
+    });
+
+    std::vector<std::uint32_t> palette;
+
+    palette.reserve(colors.size());
+
+    for (const auto& entry : colors) {
+      palette.emplace_back(entry.color);
+    }
+
+    return palette;
+  }
+
+  std::sort(colors.begin(), colors.end(), [](const ColorCount& a, const ColorCount& b) {
+    return a.color < b.color;
+  });
+
+  std::vector<ColorBox> boxes(1);
+
+  boxes[0].end = colors.size();
+
+  measureBox(colors, boxes[0]);
+
+  while (boxes.size() < maxColors) {
+
+    // The box split next is the one with the widest range,
+    // weighted by its pixels, so that common colors get more
+    // of the palette than a few stray pixels.
+
+    ColorBox* widest = nullptr;
+
+    std::uint64_t widestScore = 0;
+
+    for (auto& box : boxes) {
+
+      auto score = std::uint64_t(box.range) * box.pixels;
+
+      if (((box.end - box.begin) > 1) && (score > widestScore)) {
+        widest = &box;
+        widestScore = score;
+      }
+    }
+
+    if (!widest) {
+      break;
+    }
+
+    auto channel = widest->channel;
+
+    std::sort(colors.begin() + widest->begin, colors.begin() + widest->end, [channel](const ColorCount& a, const ColorCount& b) {
+      auto va = getChannel(a.color, channel);
+      auto vb = getChannel(b.color, channel);
+      return (va != vb) ? (va < vb) : (a.color < b.color);
+    });
+
+    // Split at the median pixel, leaving at least one color on each side.
+
+    std::uint64_t half = widest->pixels / 2;
+
+    std::uint64_t sum = 0;
+
+    auto split = widest->begin + 1;
+
+    for (auto i = widest->begin; i < (widest->end - 1); i++) {
+
+      sum += colors[i].count;
+
+      split = i + 1;
+
+      if (sum >= half) {
+        break;
+      }
+    }
+
+    ColorBox upper;
+    upper.begin = split;
+    upper.end = widest->end;
+
+    widest->end = split;
+
+    measureBox(colors, *widest);
+
+    measureBox(colors, upper);
+
+    boxes.emplace_back(upper);
+  }
+
+  std::vector<std::uint32_t> palette;
+
+  palette.reserve(boxes.size());
+
+  for (const auto& box : boxes) {
+    palette.emplace_back(averageBox(colors, box));
+  }
+
+  return palette;
+}
+
+PaletteMap::PaletteMap(const std::vector<std::uint32_t>& p) : palette(p)
+{
+  // Added in reverse, so that if a color is in
+  // the palette twice, the first entry is used.
+  for (std::size_t i = palette.size(); i > 0; i--) {
+    indices[palette[i - 1]] = std::uint32_t(i - 1);
+  }
+}
+
+std::size_t PaletteMap::find(std::uint32_t color)
+{
+  const auto* cached = indices.find(color);
+
+  if (cached) {
+    return *cached;
+  }
+
+  std::size_t nearest = 0;
+
+  int nearestDistance = 0x7fffffff;
+
+  for (std::size_t i = 0; i < palette.size(); i++) {
+
+    int distance = 0;
+
+    for (int c = 0; c < 4; c++) {
+      auto d = getChannel(color, c) - getChannel(palette[i], c);
+      distance += d * d;
+    }
+
+    if (distance < nearestDistance) {
+      nearest = i;
+      nearestDistance = distance;
+    }
+  }
+
+  indices[color] = std::uint32_t(nearest);
+
+  return nearest;
+}
+
+} // namespace px
@@ -0,0 +1,150 @@
+#ifndef LIBPX_IO_QUANTIZE_HPP
+#define LIBPX_IO_QUANTIZE_HPP
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace px {
+
+/// Packs an 8-bit RGBA color into 32 bits,
+/// with red in the lowest byte and alpha in the highest.
+inline std::uint32_t packColor(const unsigned char* rgba) noexcept
+{
+  return std::uint32_t(rgba[0])
+      | (std::uint32_t(rgba[1]) << 8)
+      | (std::uint32_t(rgba[2]) << 16)
+      | (std::uint32_t(rgba[3]) << 24);
+}
+
+/// Unpacks a color packed by @ref packColor.
+inline void unpackColor(std::uint32_t color, unsigned char* rgba) noexcept
+{
+  rgba[0] = (unsigned char) (color);
+  rgba[1] = (unsigned char) (color >> 8);
+  rgba[2] = (unsigned char) (color >> 16);
+  rgba[3] = (unsigned char) (color >> 24);
+}
+
+/// Maps packed colors to 32-bit values.
+///
+/// This is an open addressing hash table, since quantizing an image
+/// looks up a color for every run of pixels and the allocations made
+/// by a node based map would take longer than the lookups themselves.
+class ColorTable final
+{
+public:
+  /// Finds the value of a color, adding
+  /// the color with a value of zero if it's not in the table.
+  ///
+  /// @exception std::bad_alloc If the table could not be grown.
+  std::uint32_t& operator [] (std::uint32_t color);
+  /// Finds the value of a color.
+  ///
+  /// @return A pointer to the value, or a null pointer if the color is not in the table.
+  const std::uint32_t* find(std::uint32_t color) const noexcept;
+  /// Gets the number of colors in the table.
+  inline std::size_t size() const noexcept { return count; }
+  /// Calls a function with each color and its value, in no particular order.
+  template <typename Functor>
+  void forEach(Functor functor) const
+  {
+    for (const auto& entry : entries) {
+      if (entry.used) {
+        functor(entry.color, entry.value);
+      }
+    }
+  }
+private:
+  /// An entry of the table.
+  struct Entry final
+  {
+    /// The color of the entry.
+    std::uint32_t color = 0;
+    /// The value that the color maps to.
+    std::uint32_t value = 0;
+    /// Whether or not the entry holds a color.
+    bool used = false;
+  };
+  /// Doubles the size of the table.
+  void grow();
+  /// The entries of the table, which
+  /// is a power of two in size, or empty.
+  std::vector<Entry> entries;
+  /// The number of entries that are used.
+  std::size_t count = 0;
+};
+
+/// Counts how often each color occurs in one or more images,
+/// so that a palette can be built that represents them well.
+class ColorHistogram final
+{
+public:
+  /// Counts a color.
+  ///
+  /// @param color The packed color to count.
+  /// @param count The number of pixels with this color,
+  /// which lets callers count a run of pixels at once.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  void add(std::uint32_t color, std::uint32_t count = 1);
+  /// Adds the counts of another histogram,
+  /// such as one built on another thread.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  void add(const ColorHistogram& other);
+  /// Gets the number of distinct colors that were counted.
+  inline std::size_t getColorCount() const noexcept { return counts.size(); }
+  /// Builds a palette for the colors that were counted.
+  ///
+  /// If there are no more distinct colors than the palette may
+  /// hold, the palette holds exactly those colors, with the most
+  /// frequent first. Otherwise, the colors are divided with the
+  /// median cut algorithm, weighted by how often each occurs,
+  /// and the palette holds the average color of each division.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param maxColors The most colors that the palette may hold.
+  ///
+  /// @return The packed colors of the palette.
+  std::vector<std::uint32_t> buildPalette(std::size_t maxColors) const;
+private:
+  /// The number of pixels of each color.
+  ColorTable counts;
+};
+
+/// Finds the palette entries used to represent colors.
+///
+/// The nearest entry to each color is only searched for once,
+/// so that images with few distinct colors, such as pixel art,
+/// are mapped at about the speed of a hash table lookup.
+/// Since the searches are cached, each thread needs its own map.
+class PaletteMap final
+{
+public:
+  /// Prepares to map colors to a palette.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param palette The packed colors of the palette.
+  explicit PaletteMap(const std::vector<std::uint32_t>& palette);
+  /// Finds the palette entry that is nearest to a color.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param color The packed color to find the entry for.
+  ///
+  /// @return The index of the palette entry.
+  std::size_t find(std::uint32_t color);
+private:
+  /// The packed colors of the palette.
+  std::vector<std::uint32_t> palette;
+  /// The index of the entry found for each color.
+  ColorTable indices;
+};
+
+} // namespace px
+
+#endif // LIBPX_IO_QUANTIZE_HPP
@@ -0,0 +1,50 @@
+#include "Sink.hpp"
+
+namespace px {
+
+FileSink::~FileSink()
+{
+  close();
+}
+
+bool FileSink::open(const char* path)
+{
+  close();
+
+  file = std::fopen(path, "wb");
+
+  return file != nullptr;
+}
+
+bool FileSink::write(const void* data, std::size_t size)
+{
+  if (!file) {
+    return false;
+  }
+
+  return std::fwrite(data, 1, size, file) == size;
+}
+
+bool FileSink::close()
+{
+  if (!file) {
+    return true;
+  }
+
+  auto result = (std::fclose(file) == 0);
+
+  file = nullptr;
+
+  return result;
+}
+
+bool BufferSink::write(const void* data, std::size_t size)
+{
+  const auto* bytes = static_cast<const unsigned char*>(data);
+
+  buffer.insert(buffer.end(), bytes, bytes + size);
+
+  return true;
+}
+
+} // namespace px
@@ -0,0 +1,65 @@
+#ifndef LIBPX_IO_SINK_HPP
+#define LIBPX_IO_SINK_HPP
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdio>
+
+namespace px {
+
+/// Receives bytes as they are written by an encoder,
+/// so that large files don't have to be kept in memory.
+class Sink
+{
+public:
+  /// Just a stub.
+  virtual ~Sink() {}
+  /// Writes bytes to the sink.
+  ///
+  /// @param data The bytes to write.
+  /// @param size The number of bytes to write.
+  ///
+  /// @return True on success, false on failure.
+  virtual bool write(const void* data, std::size_t size) = 0;
+  /// Finishes writing to the sink.
+  ///
+  /// @return True if all of the bytes were written, false otherwise.
+  virtual bool close() { return true; }
+};
+
+/// A sink that writes to a file.
+class FileSink final : public Sink
+{
+  /// The file being written to.
+  std::FILE* file = nullptr;
+public:
+  FileSink() = default;
+  FileSink(const FileSink&) = delete;
+  /// Closes the file, if it is still open.
+  ~FileSink();
+  /// Opens a file for writing, replacing it if it exists.
+  ///
+  /// @param path The path of the file to open.
+  ///
+  /// @return True on success, false on failure.
+  /// On failure, errno is set to indicate the error.
+  bool open(const char* path);
+  bool write(const void* data, std::size_t size) override;
+  bool close() override;
+};
+
+/// A sink that keeps the bytes in memory.
+class BufferSink : public Sink
+{
+  /// The bytes that were written.
+  std::vector<unsigned char> buffer;
+public:
+  bool write(const void* data, std::size_t size) override;
+  /// Accesses the bytes that were written.
+  inline const std::vector<unsigned char>& getBuffer() const noexcept { return buffer; }
+};
+
+} // namespace px
+
+#endif // LIBPX_IO_SINK_HPP
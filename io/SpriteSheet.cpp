@@ -0,0 +1,397 @@
+#include "SpriteSheet.hpp"
+
+#include "Json.hpp"
+#include "LayerRenderer.hpp"
+#include "Parallel.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <sstream>
+
+#include <cstdint>
+#include <cstring>
+
+namespace px {
+
+namespace {
+
+/// Contains the pixels of a sprite until it is put into the sheet.
+struct SpritePixels final
+{
+  /// The premultiplied colors of the trimmed sprite.
+  std::vector<float> colorBuffer;
+};
+
+/// Trims a rendered sprite to the bounding box of its visible pixels.
+///
+/// @param color The premultiplied colors of the rendered sprite.
+/// @param w The width of the rendered sprite.
+/// @param h The height of the rendered sprite.
+/// @param trim Whether or not to trim the sprite.
+/// @param sprite Receives the size and offset of the sprite.
+/// @param pixels Receives the trimmed pixels.
+void trimSprite(const float* color, std::size_t w, std::size_t h, bool trim, Sprite& sprite, SpritePixels& pixels)
+{
+  std::size_t x0 = 0;
+  std::size_t y0 = 0;
+  std::size_t x1 = w;
+  std::size_t y1 = h;
+
+  if (trim) {
+
+    x0 = w;
+    y0 = h;
+    x1 = 0;
+    y1 = 0;
+
+    for (std::size_t y = 0; y < h; y++) {
+      for (std::size_t x = 0; x < w; x++) {
+        if (color[(((y * w) + x) * 4) + 3] > 0) {
+          x0 = std::min(x0, x);
+          y0 = std::min(y0, y);
+          x1 = std::max(x1, x + 1);
+          y1 = std::max(y1, y + 1);
+        }
+      }
+    }
+
+    if (x0 >= x1) {
+      x0 = x1 = y0 = y1 = 0;
+    }
+  }
+
+  sprite.offsetX = x0;
+  sprite.offsetY = y0;
+  sprite.width = x1 - x0;
+  sprite.height = y1 - y0;
+  sprite.sourceWidth = w;
+  sprite.sourceHeight = h;
+
+  pixels.colorBuffer.resize(sprite.width * sprite.height * 4);
+
+  for (std::size_t y = 0; y < sprite.height; y++) {
+
+    const float* src = color + ((((y0 + y) * w) + x0) * 4);
+
+    float* dst = &pixels.colorBuffer[y * sprite.width * 4];
+
+    std::memcpy(dst, src, sprite.width * 4 * sizeof(float));
+  }
+}
+
+/// Packs rectangles with the skyline bottom-left heuristic.
+///
+/// The skyline is the outline of the top edges of the rectangles
+/// that have been placed. Each rectangle is placed where it rests
+/// lowest on the skyline, and the skyline is raised to its top.
+class SkylinePacker final
+{
+  /// A horizontal segment of the skyline.
+  struct Segment final
+  {
+    std::size_t x;
+    std::size_t y;
+    std::size_t width;
+  };
+  /// The segments of the skyline, from left to right.
+  std::vector<Segment> skyline;
+  /// The width of the area being packed.
+  std::size_t width;
+public:
+  SkylinePacker(std::size_t w) : skyline { Segment { 0, 0, w } }, width(w) {}
+  /// Places a rectangle.
+  ///
+  /// @param w The width of the rectangle.
+  /// @param h The height of the rectangle.
+  /// @param x Receives the X coordinate of the rectangle.
+  /// @param y Receives the Y coordinate of the rectangle.
+  void place(std::size_t w, std::size_t h, std::size_t& x, std::size_t& y)
+  {
+    std::size_t bestIndex = 0;
+    std::size_t bestY = SIZE_MAX;
+
+    for (std::size_t i = 0; i < skyline.size(); i++) {
+
+      std::size_t top = 0;
+
+      if (fits(i, w, top) && (top < bestY)) {
+        bestIndex = i;
+        bestY = top;
+      }
+    }
+
+    x = skyline[bestIndex].x;
+    y = bestY;
+
+    raise(bestIndex, w, bestY + h);
+  }
+protected:
+  /// Checks whether a rectangle fits with its left edge on a segment.
+  ///
+  /// @param index The index of the segment.
+  /// @param w The width of the rectangle.
+  /// @param top Receives the Y coordinate the rectangle rests at.
+  bool fits(std::size_t index, std::size_t w, std::size_t& top) const noexcept
+  {
+    if ((skyline[index].x + w) > width) {
+      return false;
+    }
+
+    top = 0;
+
+    std::size_t covered = 0;
+
+    for (std::size_t i = index; (i < skyline.size()) && (covered < w); i++) {
+      top = std::max(top, skyline[i].y);
+      covered += skyline[i].width;
+    }
+
+    return true;
+  }
+  /// Raises the skyline under a placed rectangle.
+  void raise(std::size_t index, std::size_t w, std::size_t top)
+  {
+    auto x = skyline[index].x;
+
+    auto end = x + w;
+
+    std::vector<Segment> next(skyline.begin(), skyline.begin() + index);
+
+    next.push_back(Segment { x, top, w });
+
+    for (std::size_t i = index; i < skyline.size(); i++) {
+
+      auto segEnd = skyline[i].x + skyline[i].width;
+
+      if (segEnd <= end) {
+        continue;
+      }
+
+      auto segX = std::max(skyline[i].x, end);
+
+      next.push_back(Segment { segX, skyline[i].y, segEnd - segX });
+    }
+
+    // Neighboring segments at the same height are merged.
+
+    skyline.clear();
+
+    for (const auto& seg : next) {
+      if (!skyline.empty() && (skyline.back().y == seg.y)) {
+        skyline.back().width += seg.width;
+      } else {
+        skyline.push_back(seg);
+      }
+    }
+  }
+};
+
+/// Renders the visible layers of a document into sprites, in parallel.
+void renderLayerSprites(const Document* doc, const SpriteSheetOptions& options, SpriteSheet& sheet, std::vector<SpritePixels>& pixels)
+{
+  std::vector<std::size_t> layers;
+
+  for (std::size_t i = 0; i < getLayerCount(doc); i++) {
+    if (getLayerVisibility(getLayer(doc, i))) {
+      layers.push_back(i);
+    }
+  }
+
+  sheet.sprites.resize(layers.size());
+
+  for (std::size_t i = 0; i < layers.size(); i++) {
+    sheet.sprites[i].name = getLayerName(getLayer(doc, layers[i]));
+  }
+
+  auto threadCount = std::min(getThreadCount(options.threadCount), std::max(layers.size(), std::size_t(1)));
+
+  std::unique_ptr<LayerRenderer[]> renderers(new LayerRenderer[threadCount]);
+
+  pixels.resize(layers.size());
+
+  parallelFor(layers.size(), threadCount, [&](std::size_t i, std::size_t thread) {
+
+    auto& renderer = renderers[thread];
+
+    if (!renderer.initialized()) {
+      renderer.init(doc);
+    }
+
+    const auto* image = renderer.renderLayer(layers[i]);
+
+    trimSprite(getColorBuffer(image), getImageWidth(image), getImageHeight(image), options.trim, sheet.sprites[i], pixels[i]);
+  });
+}
+
+/// Trims the frames passed by @ref renderFrames into sprites.
+struct FrameSpriteSink final
+{
+  /// The sheet to add the sprites to.
+  SpriteSheet* sheet = nullptr;
+  /// Receives the trimmed pixels of each sprite.
+  std::vector<SpritePixels>* pixels = nullptr;
+  /// Whether or not to trim the sprites.
+  bool trim = true;
+  /// Whether memory could not be allocated for a sprite.
+  bool outOfMemory = false;
+};
+
+/// Trims a frame into the next sprite of the sheet.
+bool addFrameSprite(void* data, std::size_t frame, const float* colors, std::size_t w, std::size_t h)
+{
+  auto* sink = static_cast<FrameSpriteSink*>(data);
+
+  try {
+
+    Sprite sprite;
+
+    sprite.name = std::to_string(frame);
+
+    SpritePixels pixels;
+
+    trimSprite(colors, w, h, sink->trim, sprite, pixels);
+
+    sink->sheet->sprites.emplace_back(std::move(sprite));
+
+    sink->pixels->emplace_back(std::move(pixels));
+
+  } catch (...) {
+    sink->outOfMemory = true;
+    return false;
+  }
+
+  return true;
+}
+
+/// Renders the frames of a document into sprites.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+void renderFrameSprites(const Document* doc, const SpriteSheetOptions& options, SpriteSheet& sheet, std::vector<SpritePixels>& pixels)
+{
+  auto frameCount = getFrameCount(doc);
+
+  sheet.sprites.reserve(frameCount);
+
+  pixels.reserve(frameCount);
+
+  FrameSpriteSink sink;
+  sink.sheet = &sheet;
+  sink.pixels = &pixels;
+  sink.trim = options.trim;
+
+  // The sink only fails when it runs out of memory, and
+  // renderFrames only fails otherwise when it does too.
+
+  if (!renderFrames(doc, 0, frameCount - 1, addFrameSprite, &sink, nullptr, options.threadCount)) {
+    throw std::bad_alloc();
+  }
+}
+
+} // namespace
+
+SpriteSheet buildSpriteSheet(const Document* doc, const SpriteSheetOptions& options)
+{
+  SpriteSheet sheet;
+
+  std::vector<SpritePixels> pixels;
+
+  if (options.frames) {
+    renderFrameSprites(doc, options, sheet, pixels);
+  } else {
+    renderLayerSprites(doc, options, sheet, pixels);
+  }
+
+  // Pack the sprites, tallest first.
+
+  std::vector<std::size_t> order(sheet.sprites.size());
+
+  for (std::size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&sheet](std::size_t a, std::size_t b) {
+    return sheet.sprites[a].height > sheet.sprites[b].height;
+  });
+
+  std::size_t packWidth = options.maxWidth;
+
+  for (const auto& sprite : sheet.sprites) {
+    packWidth = std::max(packWidth, sprite.width + options.padding);
+  }
+
+  SkylinePacker packer(packWidth);
+
+  for (auto i : order) {
+
+    auto& sprite = sheet.sprites[i];
+
+    if (!sprite.width || !sprite.height) {
+      continue;
+    }
+
+    packer.place(sprite.width + options.padding, sprite.height + options.padding, sprite.x, sprite.y);
+
+    sheet.width = std::max(sheet.width, sprite.x + sprite.width);
+    sheet.height = std::max(sheet.height, sprite.y + sprite.height);
+  }
+
+  // Copy the sprites into the sheet in parallel.
+
+  sheet.colorBuffer.resize(sheet.width * sheet.height * 4);
+
+  parallelFor(sheet.sprites.size(), getThreadCount(options.threadCount), [&sheet, &pixels](std::size_t i, std::size_t) {
+
+    const auto& sprite = sheet.sprites[i];
+
+    for (std::size_t y = 0; y < sprite.height; y++) {
+
+      const float* src = &pixels[i].colorBuffer[y * sprite.width * 4];
+
+      float* dst = &sheet.colorBuffer[(((sprite.y + y) * sheet.width) + sprite.x) * 4];
+
+      std::memcpy(dst, src, sprite.width * 4 * sizeof(float));
+    }
+  });
+
+  return sheet;
+}
+
+std::string formatSpriteSheetJSON(const SpriteSheet& sheet, const char* imageName)
+{
+  std::ostringstream stream;
+
+  stream << "{\n  \"frames\": [";
+
+  for (std::size_t i = 0; i < sheet.sprites.size(); i++) {
+
+    const auto& s = sheet.sprites[i];
+
+    bool trimmed = (s.width != s.sourceWidth) || (s.height != s.sourceHeight);
+
+    stream << (i ? ",\n" : "\n");
+    stream << "    {\n";
+    stream << "      \"filename\": \"" << escapeJSON(s.name) << "\",\n";
+    stream << "      \"frame\": { \"x\": " << s.x << ", \"y\": " << s.y << ", \"w\": " << s.width << ", \"h\": " << s.height << " },\n";
+    stream << "      \"rotated\": false,\n";
+    stream << "      \"trimmed\": " << (trimmed ? "true" : "false") << ",\n";
+    stream << "      \"spriteSourceSize\": { \"x\": " << s.offsetX << ", \"y\": " << s.offsetY << ", \"w\": " << s.width << ", \"h\": " << s.height << " },\n";
+    stream << "      \"sourceSize\": { \"w\": " << s.sourceWidth << ", \"h\": " << s.sourceHeight << " }\n";
+    stream << "    }";
+  }
+
+  stream << "\n  ],\n";
+  stream << "  \"meta\": {\n";
+  stream << "    \"image\": \"" << escapeJSON(imageName) << "\",\n";
+  stream << "    \"format\": \"RGBA8888\",\n";
+  stream << "    \"size\": { \"w\": " << sheet.width << ", \"h\": " << sheet.height << " },\n";
+  stream << "    \"scale\": \"1\"\n";
+  stream << "  }\n";
+  stream << "}\n";
+
+  return stream.str();
+}
+
+} // namespace px
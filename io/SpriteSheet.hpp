@@ -0,0 +1,101 @@
+#ifndef LIBPX_IO_SPRITE_SHEET_HPP
+#define LIBPX_IO_SPRITE_SHEET_HPP
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+namespace px {
+
+struct Document;
+
+/// Describes how a sprite sheet is built.
+struct SpriteSheetOptions final
+{
+  /// The number of transparent pixels between sprites.
+  std::size_t padding = 1;
+  /// Whether or not sprites are trimmed to the
+  /// bounding box of their non-transparent pixels.
+  bool trim = true;
+  /// The widest that the sheet may be, in pixels.
+  /// A sprite wider than this widens the sheet to fit it.
+  std::size_t maxWidth = 4096;
+  /// The number of threads to render sprites on.
+  /// If this is zero, one thread per processor is used.
+  std::size_t threadCount = 0;
+  /// Whether the sprites are the frames of the document, rather
+  /// than its visible layers, so that an animation can be played
+  /// from the sheet.
+  bool frames = false;
+};
+
+/// Describes one sprite in a sprite sheet.
+struct Sprite final
+{
+  /// The name of the sprite, taken from its layer,
+  /// or the index of its frame.
+  std::string name;
+  /// The X coordinate of the sprite within the sheet.
+  std::size_t x = 0;
+  /// The Y coordinate of the sprite within the sheet.
+  std::size_t y = 0;
+  /// The width of the sprite within the sheet.
+  /// This is zero if the sprite is fully transparent and trimmed.
+  std::size_t width = 0;
+  /// The height of the sprite within the sheet.
+  /// This is zero if the sprite is fully transparent and trimmed.
+  std::size_t height = 0;
+  /// The X offset of the trimmed pixels within the untrimmed sprite.
+  std::size_t offsetX = 0;
+  /// The Y offset of the trimmed pixels within the untrimmed sprite.
+  std::size_t offsetY = 0;
+  /// The width of the sprite before it was trimmed.
+  std::size_t sourceWidth = 0;
+  /// The height of the sprite before it was trimmed.
+  std::size_t sourceHeight = 0;
+};
+
+/// A set of sprites packed into one image.
+struct SpriteSheet final
+{
+  /// The sprites, in the order of the layers or frames they came from.
+  std::vector<Sprite> sprites;
+  /// The width of the sheet, in pixels.
+  std::size_t width = 0;
+  /// The height of the sheet, in pixels.
+  std::size_t height = 0;
+  /// The premultiplied RGBA colors of the sheet.
+  std::vector<float> colorBuffer;
+};
+
+/// Builds a sprite sheet with one sprite for each visible layer,
+/// or for each frame of the document.
+///
+/// The layers are rendered in parallel onto a transparent background.
+/// The frames are rendered with @ref renderFrames, which renders them
+/// in parallel and reuses the frames that don't change. The sprites are
+/// then trimmed and packed into the sheet with a skyline packer.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param doc The document to build the sprite sheet from.
+/// @param options Describes how to build the sprite sheet.
+///
+/// @return The sprite sheet.
+SpriteSheet buildSpriteSheet(const Document* doc, const SpriteSheetOptions& options = SpriteSheetOptions());
+
+/// Formats the metadata of a sprite sheet as JSON.
+///
+/// The format is the JSON array format of TexturePacker, which
+/// most game engines and sprite sheet tools are able to read.
+///
+/// @param sheet The sprite sheet to format the metadata of.
+/// @param imageName The file name of the sheet image.
+///
+/// @return The JSON text.
+std::string formatSpriteSheetJSON(const SpriteSheet& sheet, const char* imageName);
+
+} // namespace px
+
+#endif // LIBPX_IO_SPRITE_SHEET_HPP
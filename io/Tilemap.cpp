@@ -0,0 +1,338 @@
+#include "Tilemap.hpp"
+
+#include "File.hpp"
+#include "Parallel.hpp"
+#include "Png.hpp"
+#include "Sink.hpp"
+
+#include <libpx.hpp>
+
+#include <algorithm>
+
+#include <cstring>
+
+namespace px {
+
+namespace {
+
+/// Hashes the contents of a tile's file, along with the size it's
+/// rendered at, with 64-bit FNV-1a. This identifies the rendered tile,
+/// so 64 bits are used to make collisions between tiles unlikely.
+std::uint64_t hashTile(const std::vector<unsigned char>& data, std::size_t w, std::size_t h) noexcept
+{
+  std::uint64_t hash = 14695981039346656037ULL;
+
+  auto add = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+
+  for (std::size_t i = 0; i < sizeof(std::size_t); i++) {
+    add((unsigned char) (w >> (i * 8)));
+    add((unsigned char) (h >> (i * 8)));
+  }
+
+  for (auto byte : data) {
+    add(byte);
+  }
+
+  return hash;
+}
+
+/// The scratch objects of a thread rendering tiles.
+struct TileRenderer final
+{
+  /// The document that the tile files are opened into.
+  Document* doc = nullptr;
+  /// The scratch memory for rendering.
+  RenderContext* context = nullptr;
+  /// The premultiplied colors of the tile being rendered.
+  std::vector<float> color;
+  TileRenderer() = default;
+  TileRenderer(const TileRenderer&) = delete;
+  TileRenderer(TileRenderer&& other) noexcept : doc(other.doc), context(other.context), color(std::move(other.color))
+  {
+    other.doc = nullptr;
+    other.context = nullptr;
+  }
+  ~TileRenderer()
+  {
+    closeRenderContext(context);
+    closeDoc(doc);
+  }
+  /// Opens the contents of a tile file and renders it.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @return True on success, false if the file could not be opened.
+  bool render(const std::vector<unsigned char>& data, std::size_t w, std::size_t h, std::vector<unsigned char>& rgba)
+  {
+    if (!doc) {
+      doc = createDoc();
+      context = createRenderContext();
+    }
+
+    if (openDoc(doc, data.data(), data.size()) != 0) {
+      return false;
+    }
+
+    color.resize(w * h * 4);
+
+    px::render(doc, color.data(), w, h, context, nullptr);
+
+    rgba.resize(w * h * 4);
+
+    convertToRGBA8(color.data(), w * h, rgba.data());
+
+    return true;
+  }
+};
+
+} // namespace
+
+void Tilemap::resize(std::size_t c, std::size_t r)
+{
+  std::vector<std::uint32_t> resized(c * r, 0);
+
+  for (std::size_t y = 0; y < std::min(r, rows); y++) {
+    for (std::size_t x = 0; x < std::min(c, columns); x++) {
+      resized[(y * c) + x] = cells[(y * columns) + x];
+    }
+  }
+
+  cells.swap(resized);
+
+  columns = c;
+  rows = r;
+}
+
+void Tilemap::setTileSize(std::size_t w, std::size_t h) noexcept
+{
+  tileWidth = w;
+  tileHeight = h;
+}
+
+bool Tilemap::setTile(std::size_t column, std::size_t row, const char* path)
+{
+  if ((column >= columns) || (row >= rows)) {
+    return false;
+  }
+
+  auto it = pathIndices.find(path);
+
+  if (it == pathIndices.end()) {
+    paths.emplace_back(path);
+    it = pathIndices.emplace(path, std::uint32_t(paths.size() - 1)).first;
+  }
+
+  cells[(row * columns) + column] = it->second + 1;
+
+  return true;
+}
+
+void Tilemap::clearTile(std::size_t column, std::size_t row) noexcept
+{
+  if ((column < columns) && (row < rows)) {
+    cells[(row * columns) + column] = 0;
+  }
+}
+
+const char* Tilemap::getTile(std::size_t column, std::size_t row) const noexcept
+{
+  if ((column >= columns) || (row >= rows)) {
+    return nullptr;
+  }
+
+  auto cell = getCell(column, row);
+
+  return cell ? paths[cell - 1].c_str() : nullptr;
+}
+
+bool TileCache::update(const Tilemap& tilemap, std::size_t threadCount)
+{
+  const auto& paths = tilemap.getPaths();
+
+  auto w = tilemap.getTileWidth();
+  auto h = tilemap.getTileHeight();
+
+  // Paths that are no longer in any cell aren't read.
+
+  std::vector<char> used(paths.size(), 0);
+
+  for (std::size_t row = 0; row < tilemap.getRowCount(); row++) {
+    for (std::size_t column = 0; column < tilemap.getColumnCount(); column++) {
+      if (auto cell = tilemap.getCell(column, row)) {
+        used[cell - 1] = 1;
+      }
+    }
+  }
+
+  threadCount = getThreadCount(threadCount);
+
+  // Every file is read and hashed, since that's the only way to
+  // tell whether it changed. The contents are only kept for the
+  // files that aren't in the cache, which need to be rendered.
+
+  std::vector<std::uint64_t> keys(paths.size(), 0);
+
+  std::vector<char> readable(paths.size(), 0);
+
+  std::vector<std::vector<unsigned char>> contents(paths.size());
+
+  parallelFor(paths.size(), threadCount, [&](std::size_t i, std::size_t) {
+
+    if (!used[i] || !readFile(paths[i].c_str(), contents[i])) {
+      return;
+    }
+
+    readable[i] = 1;
+
+    keys[i] = hashTile(contents[i], w, h);
+
+    if (tiles.find(keys[i]) != tiles.end()) {
+      std::vector<unsigned char>().swap(contents[i]);
+    }
+  });
+
+  // Files with the same contents are only rendered once.
+
+  std::vector<std::size_t> misses;
+
+  std::unordered_map<std::uint64_t, std::size_t> missIndices;
+
+  for (std::size_t i = 0; i < paths.size(); i++) {
+    if (readable[i] && (tiles.find(keys[i]) == tiles.end()) && missIndices.emplace(keys[i], misses.size()).second) {
+      misses.push_back(i);
+    }
+  }
+
+  std::vector<std::shared_ptr<Tile>> rendered(misses.size());
+
+  std::vector<TileRenderer> renderers(std::min(threadCount, std::max(misses.size(), std::size_t(1))));
+
+  parallelFor(misses.size(), renderers.size(), [&](std::size_t i, std::size_t thread) {
+
+    std::shared_ptr<Tile> tile(new Tile());
+
+    if (renderers[thread].render(contents[misses[i]], w, h, tile->rgba)) {
+      rendered[i] = std::move(tile);
+    }
+  });
+
+  // Tiles that aren't used anymore are released, so that
+  // editing a tile over and over doesn't grow the cache.
+
+  std::unordered_map<std::uint64_t, std::shared_ptr<const Tile>> updated;
+
+  pathTiles.assign(paths.size(), nullptr);
+
+  bool success = true;
+
+  for (std::size_t i = 0; i < paths.size(); i++) {
+
+    if (!used[i]) {
+      continue;
+    }
+
+    std::shared_ptr<const Tile> tile;
+
+    auto found = tiles.find(keys[i]);
+
+    if (!readable[i]) {
+      success = false;
+    } else if (found != tiles.end()) {
+      tile = found->second;
+    } else {
+      tile = rendered[missIndices[keys[i]]];
+    }
+
+    if (!tile) {
+      success = false;
+      continue;
+    }
+
+    updated.emplace(keys[i], tile);
+
+    pathTiles[i] = tile;
+  }
+
+  tiles.swap(updated);
+
+  renderCount = misses.size();
+
+  return success;
+}
+
+const unsigned char* TileCache::getColors(std::size_t path) const noexcept
+{
+  if ((path >= pathTiles.size()) || !pathTiles[path]) {
+    return nullptr;
+  }
+
+  return pathTiles[path]->rgba.data();
+}
+
+void composeTilemap(const Tilemap& tilemap,
+                    const TileCache& cache,
+                    std::size_t x,
+                    std::size_t y,
+                    std::size_t w,
+                    std::size_t h,
+                    unsigned char* rgba) noexcept
+{
+  std::memset(rgba, 0, w * h * 4);
+
+  auto tileWidth = tilemap.getTileWidth();
+  auto tileHeight = tilemap.getTileHeight();
+
+  if (!tileWidth || !tileHeight) {
+    return;
+  }
+
+  auto x1 = std::min(x + w, tilemap.getWidth());
+  auto y1 = std::min(y + h, tilemap.getHeight());
+
+  for (auto mapY = y; mapY < y1; mapY++) {
+
+    auto row = mapY / tileHeight;
+
+    auto tileY = mapY % tileHeight;
+
+    auto* dst = rgba + ((mapY - y) * w * 4);
+
+    // The rows of the tiles are copied a span at a time,
+    // from the first column the span covers to the last.
+
+    for (auto mapX = x; mapX < x1; ) {
+
+      auto column = mapX / tileWidth;
+
+      auto tileX = mapX % tileWidth;
+
+      auto span = std::min(tileWidth - tileX, x1 - mapX);
+
+      auto cell = tilemap.getCell(column, row);
+
+      const auto* colors = cell ? cache.getColors(cell - 1) : nullptr;
+
+      if (colors) {
+        std::memcpy(dst + ((mapX - x) * 4), colors + (((tileY * tileWidth) + tileX) * 4), span * 4);
+      }
+
+      mapX += span;
+    }
+  }
+}
+
+bool writeTilemapPNG(Sink& sink, const Tilemap& tilemap, const TileCache& cache, const PNGOptions& options)
+{
+  auto width = tilemap.getWidth();
+
+  auto rows = [&tilemap, &cache, width](std::size_t y, unsigned char* rgba) {
+    composeTilemap(tilemap, cache, 0, y, width, 1, rgba);
+  };
+
+  return writePNG(sink, PNGRowSource(rows), width, tilemap.getHeight(), options);
+}
+
+} // namespace px
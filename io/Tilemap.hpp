@@ -0,0 +1,180 @@
+#ifndef LIBPX_IO_TILEMAP_HPP
+#define LIBPX_IO_TILEMAP_HPP
+
+#include "Png.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace px {
+
+class Sink;
+
+/// A grid of tiles, such as the map of a game level,
+/// where each tile shows a document stored in its own file.
+///
+/// The grid only refers to the files by their paths. The files
+/// are read and rendered by a @ref TileCache.
+class Tilemap final
+{
+  /// The number of tiles in each row of the grid.
+  std::size_t columns = 0;
+  /// The number of rows of tiles in the grid.
+  std::size_t rows = 0;
+  /// The width of each tile, in pixels.
+  std::size_t tileWidth = 16;
+  /// The height of each tile, in pixels.
+  std::size_t tileHeight = 16;
+  /// The paths of the files that the cells have referred to.
+  std::vector<std::string> paths;
+  /// The index of each path in @ref Tilemap::paths.
+  std::unordered_map<std::string, std::uint32_t> pathIndices;
+  /// The tile of each cell, in rows from top to bottom. This is one
+  /// plus the index of the tile's path, or zero if the cell is empty.
+  std::vector<std::uint32_t> cells;
+public:
+  /// Resizes the grid. Cells that are still within the
+  /// grid keep their tiles and new cells are empty.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  void resize(std::size_t columns, std::size_t rows);
+  /// Sets the size of the tiles, in pixels. Documents are rendered
+  /// at this size, so larger documents are cut off at the edge of
+  /// the tile.
+  void setTileSize(std::size_t width, std::size_t height) noexcept;
+  /// Places a tile in a cell.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param column The column of the cell.
+  /// @param row The row of the cell.
+  /// @param path The path of the document file to show in the cell.
+  ///
+  /// @return True on success, false if the cell is outside of the grid.
+  bool setTile(std::size_t column, std::size_t row, const char* path);
+  /// Removes the tile of a cell, leaving it transparent.
+  void clearTile(std::size_t column, std::size_t row) noexcept;
+  /// Gets the path of the tile in a cell.
+  ///
+  /// @return The path of the tile, or a null pointer if
+  /// the cell is empty or outside of the grid.
+  const char* getTile(std::size_t column, std::size_t row) const noexcept;
+  /// Gets the number of tiles in each row of the grid.
+  inline std::size_t getColumnCount() const noexcept { return columns; }
+  /// Gets the number of rows of tiles in the grid.
+  inline std::size_t getRowCount() const noexcept { return rows; }
+  /// Gets the width of each tile, in pixels.
+  inline std::size_t getTileWidth() const noexcept { return tileWidth; }
+  /// Gets the height of each tile, in pixels.
+  inline std::size_t getTileHeight() const noexcept { return tileHeight; }
+  /// Gets the width of the whole map, in pixels.
+  inline std::size_t getWidth() const noexcept { return columns * tileWidth; }
+  /// Gets the height of the whole map, in pixels.
+  inline std::size_t getHeight() const noexcept { return rows * tileHeight; }
+  /// Gets the paths of the files that tiles have referred to,
+  /// including those that are no longer in any cell.
+  inline const std::vector<std::string>& getPaths() const noexcept { return paths; }
+  /// Gets the tile of a cell, as one plus the index of its path
+  /// in @ref Tilemap::getPaths, or zero if the cell is empty.
+  ///
+  /// @note This function does not perform bounds checking.
+  inline std::uint32_t getCell(std::size_t column, std::size_t row) const noexcept
+  {
+    return cells[(row * columns) + column];
+  }
+};
+
+/// Holds the tiles of a tilemap after they're rendered.
+///
+/// Tiles are kept by a hash of the contents of their files, rather
+/// than by their paths. Updating the cache reads the files again, and
+/// only renders the ones that changed, or that are new to the cache.
+/// Files with the same contents are rendered once, wherever they're
+/// used. The rendered tiles are kept as 8-bit colors, which is what
+/// the map is composed of.
+class TileCache final
+{
+  /// The colors of a rendered tile.
+  struct Tile final
+  {
+    /// The 8-bit RGBA colors of the tile,
+    /// which are not premultiplied.
+    std::vector<unsigned char> rgba;
+  };
+  /// The tiles that have been rendered, by their keys.
+  std::unordered_map<std::uint64_t, std::shared_ptr<const Tile>> tiles;
+  /// The tile of each path of the tilemap, as of the last update.
+  /// This is null for paths that aren't used or couldn't be opened.
+  std::vector<std::shared_ptr<const Tile>> pathTiles;
+  /// The number of tiles rendered by the last update.
+  std::size_t renderCount = 0;
+public:
+  /// Reads the files of the tiles in a tilemap and renders each
+  /// one that isn't in the cache. Tiles that are no longer in the
+  /// tilemap are released. The map may then be composed with the
+  /// tiles, until the tilemap or the cache is updated again.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param tilemap The tilemap to update the tiles of.
+  /// @param threadCount The number of threads to read and render
+  /// the files on. If this is zero, one thread per processor is used.
+  ///
+  /// @return True if every file was read and opened, false otherwise.
+  /// Tiles whose files could not be opened are left transparent.
+  bool update(const Tilemap& tilemap, std::size_t threadCount = 0);
+  /// Gets the number of tiles rendered by the last update.
+  inline std::size_t getRenderCount() const noexcept { return renderCount; }
+  /// Gets the number of rendered tiles in the cache.
+  inline std::size_t getTileCount() const noexcept { return tiles.size(); }
+  /// Gets the colors of a tile.
+  ///
+  /// @param path The index of the tile's path in @ref Tilemap::getPaths.
+  ///
+  /// @return The 8-bit RGBA colors of the tile, or a null pointer
+  /// if the tile is transparent or wasn't updated.
+  const unsigned char* getColors(std::size_t path) const noexcept;
+};
+
+/// Composes a rectangle of a tilemap from the tiles in a cache,
+/// which must have been updated with the tilemap. Since tiles don't
+/// overlap, each row of a tile is copied onto the rectangle as it is.
+///
+/// @param tilemap The tilemap to compose.
+/// @param cache The cache holding the tiles of the tilemap.
+/// @param x The X coordinate of the rectangle, in pixels.
+/// @param y The Y coordinate of the rectangle, in pixels.
+/// @param w The width of the rectangle, in pixels.
+/// @param h The height of the rectangle, in pixels.
+/// @param rgba Receives the 8-bit RGBA colors of the rectangle, which
+/// are not premultiplied. Pixels outside of the map are transparent.
+void composeTilemap(const Tilemap& tilemap,
+                    const TileCache& cache,
+                    std::size_t x,
+                    std::size_t y,
+                    std::size_t w,
+                    std::size_t h,
+                    unsigned char* rgba) noexcept;
+
+/// Composes a tilemap and writes it as a PNG file. Each row is composed
+/// as it's compressed, so the whole map is never kept in memory, unless
+/// the file is indexed.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param sink The sink to write the file to. This is not closed.
+/// @param tilemap The tilemap to compose.
+/// @param cache The cache holding the tiles of the tilemap.
+/// @param options The options for encoding the file.
+///
+/// @return True on success, false if the sink could not be written to.
+bool writeTilemapPNG(Sink& sink, const Tilemap& tilemap, const TileCache& cache, const PNGOptions& options = PNGOptions());
+
+} // namespace px
+
+#endif // LIBPX_IO_TILEMAP_HPP
@@ -0,0 +1,97 @@
+#include "WorkerPool.hpp"
+
+#include "Parallel.hpp"
+
+#include <system_error>
+
+namespace px {
+
+WorkerPool::WorkerPool(std::size_t threadCount)
+{
+  threadCount = px::getThreadCount(threadCount);
+
+  for (std::size_t i = 0; i < threadCount; i++) {
+    try {
+      threads.emplace_back(&WorkerPool::work, this, i);
+    } catch (const std::system_error&) {
+      break;
+    }
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  taskReady.notify_all();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+std::size_t WorkerPool::getThreadCount() const noexcept
+{
+  return threads.empty() ? 1 : threads.size();
+}
+
+void WorkerPool::submit(Task task)
+{
+  if (threads.empty()) {
+    task(0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.emplace_back(std::move(task));
+    unfinished++;
+  }
+
+  taskReady.notify_one();
+}
+
+void WorkerPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  taskDone.wait(lock, [this]() { return unfinished == 0; });
+}
+
+void WorkerPool::work(std::size_t threadIndex)
+{
+  for (;;) {
+
+    Task task;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      taskReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+      if (tasks.empty()) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+
+      tasks.pop_front();
+    }
+
+    task(threadIndex);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      unfinished--;
+    }
+
+    taskDone.notify_all();
+  }
+}
+
+} // namespace px
@@ -0,0 +1,64 @@
+#ifndef LIBPX_IO_WORKER_POOL_HPP
+#define LIBPX_IO_WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace px {
+
+/// A fixed set of threads that run tasks from a queue.
+///
+/// If no threads can be started, such as on platforms without
+/// thread support, tasks are run by @ref WorkerPool::submit instead.
+class WorkerPool final
+{
+public:
+  /// The type of function run by the pool.
+  /// It is given the index of the thread running it,
+  /// which is less than @ref WorkerPool::getThreadCount.
+  using Task = std::function<void (std::size_t threadIndex)>;
+  /// Starts the threads of the pool.
+  ///
+  /// @param threadCount The number of threads to start.
+  /// If this is zero, one thread per processor is started.
+  explicit WorkerPool(std::size_t threadCount = 0);
+  WorkerPool(const WorkerPool&) = delete;
+  /// Waits for the queued tasks and stops the threads.
+  ~WorkerPool();
+  /// Gets the number of threads that tasks may run on.
+  /// This is at least one, even if no threads were started.
+  std::size_t getThreadCount() const noexcept;
+  /// Queues a task to be run by one of the threads.
+  ///
+  /// @param task The task to run. It must not throw exceptions.
+  void submit(Task task);
+  /// Waits for every queued task to finish.
+  void wait();
+private:
+  /// Takes tasks from the queue until the pool is stopped.
+  void work(std::size_t threadIndex);
+  /// The threads of the pool.
+  std::vector<std::thread> threads;
+  /// The tasks that haven't been started yet.
+  std::deque<Task> tasks;
+  /// The number of tasks that are queued or running.
+  std::size_t unfinished = 0;
+  /// Set when the threads should stop.
+  bool stopping = false;
+  /// Protects the members shared with the threads.
+  std::mutex mutex;
+  /// Signaled when a task is queued or the pool is stopped.
+  std::condition_variable taskReady;
+  /// Signaled when a task finishes.
+  std::condition_variable taskDone;
+};
+
+} // namespace px
+
+#endif // LIBPX_IO_WORKER_POOL_HPP
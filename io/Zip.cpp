@@ -0,0 +1,286 @@
+#include "Zip.hpp"
+
+#include "Checksum.hpp"
+#include "Deflate.hpp"
+#include "Sink.hpp"
+
+#include <ctime>
+
+namespace px {
+
+namespace {
+
+/// The largest value that fits in the 32-bit fields of the archive.
+constexpr std::uint64_t maxField32 = 0xffffffffu;
+
+/// The largest number of entries that fits in the end of central directory record.
+constexpr std::size_t maxEntries = 0xffffu;
+
+/// The version needed to extract deflated entries (2.0).
+constexpr std::uint16_t versionNeeded = 20;
+
+/// Indicates that entry names are encoded as UTF-8.
+constexpr std::uint16_t utf8Flag = 0x0800;
+
+void put16(std::vector<unsigned char>& out, std::uint32_t value)
+{
+  out.push_back(value & 0xff);
+  out.push_back((value >> 8) & 0xff);
+}
+
+void put32(std::vector<unsigned char>& out, std::uint32_t value)
+{
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+void putName(std::vector<unsigned char>& out, const std::string& name)
+{
+  out.insert(out.end(), name.begin(), name.end());
+}
+
+} // namespace
+
+ZipWriter::ZipWriter(Sink& s, std::size_t threadCount, int l)
+  : sink(s), level(l), pool(threadCount)
+{
+  auto now = std::time(nullptr);
+
+  const auto* local = std::localtime(&now);
+
+  if (local && (local->tm_year >= 80)) {
+    dosTime = (local->tm_hour << 11) | (local->tm_min << 5) | (local->tm_sec / 2);
+    dosDate = ((local->tm_year - 80) << 9) | ((local->tm_mon + 1) << 5) | local->tm_mday;
+  } else {
+    // January 1st, 1980
+    dosDate = (1 << 5) | 1;
+  }
+}
+
+ZipWriter::~ZipWriter()
+{
+  pool.wait();
+}
+
+std::size_t ZipWriter::getThreadCount() const noexcept
+{
+  return pool.getThreadCount();
+}
+
+void ZipWriter::add(const std::string& name, std::vector<unsigned char> data, bool compress)
+{
+  auto shared = std::make_shared<std::vector<unsigned char>>(std::move(data));
+
+  add(name, [shared](std::size_t) { return std::move(*shared); }, compress);
+}
+
+void ZipWriter::add(const std::string& name, Producer producer, bool compress)
+{
+  auto entry = std::make_shared<Entry>();
+
+  entry->name = name;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(entry);
+  }
+
+  auto lvl = level;
+
+  pool.submit([this, entry, producer, compress, lvl](std::size_t threadIndex) {
+
+    try {
+
+      auto data = producer(threadIndex);
+
+      entry->crc = updateCRC32(0, data.data(), data.size());
+
+      entry->size = data.size();
+
+      if (compress && (lvl > 0) && !data.empty()) {
+
+        std::vector<unsigned char> deflated;
+
+        Deflater deflater(lvl);
+
+        deflater.compress(data.data(), data.size(), true, deflated);
+
+        if (deflated.size() < data.size()) {
+          entry->method = 8;
+          data.swap(deflated);
+        }
+      }
+
+      entry->compressedSize = data.size();
+
+      entry->data.swap(data);
+
+    } catch (...) {
+      entry->error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      entry->done = true;
+    }
+
+    entryDone.notify_all();
+  });
+
+  writeReady(false);
+
+  // Keep enough entries in flight to keep the
+  // workers busy, without buffering the archive.
+
+  auto maxPending = pool.getThreadCount() * 2;
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending.size() <= maxPending) {
+        break;
+      }
+    }
+    writeReady(true);
+  }
+}
+
+bool ZipWriter::finish()
+{
+  pool.wait();
+
+  writeReady(false);
+
+  auto directoryOffset = offset;
+
+  std::vector<unsigned char> directory;
+
+  for (const auto& entry : written) {
+    put32(directory, 0x02014b50);
+    put16(directory, versionNeeded);
+    put16(directory, versionNeeded);
+    put16(directory, utf8Flag);
+    put16(directory, entry.method);
+    put16(directory, dosTime);
+    put16(directory, dosDate);
+    put32(directory, entry.crc);
+    put32(directory, std::uint32_t(entry.compressedSize));
+    put32(directory, std::uint32_t(entry.size));
+    put16(directory, entry.name.size());
+    // Extra field length, comment length,
+    // disk number and internal attributes.
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, 0);
+    // External attributes
+    put32(directory, 0);
+    put32(directory, std::uint32_t(entry.offset));
+    putName(directory, entry.name);
+  }
+
+  auto directorySize = std::uint64_t(directory.size());
+
+  if ((written.size() > maxEntries)
+   || (directoryOffset > maxField32)
+   || (directorySize > maxField32)) {
+    failed = true;
+  }
+
+  put32(directory, 0x06054b50);
+  // Disk numbers
+  put16(directory, 0);
+  put16(directory, 0);
+  put16(directory, written.size());
+  put16(directory, written.size());
+  put32(directory, std::uint32_t(directorySize));
+  put32(directory, std::uint32_t(directoryOffset));
+  // Comment length
+  put16(directory, 0);
+
+  write(directory);
+
+  if (!sink.close()) {
+    failed = true;
+  }
+
+  return !failed;
+}
+
+void ZipWriter::writeReady(bool block)
+{
+  for (;;) {
+
+    std::shared_ptr<Entry> entry;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      if (pending.empty()) {
+        return;
+      }
+
+      if (block) {
+        entryDone.wait(lock, [this]() { return pending.front()->done; });
+      } else if (!pending.front()->done) {
+        return;
+      }
+
+      entry = pending.front();
+
+      pending.pop_front();
+    }
+
+    block = false;
+
+    writeEntry(*entry);
+  }
+}
+
+void ZipWriter::writeEntry(Entry& entry)
+{
+  if (entry.error) {
+    std::rethrow_exception(entry.error);
+  }
+
+  if ((entry.size > maxField32) || (entry.compressedSize > maxField32) || (offset > maxField32)) {
+    failed = true;
+  }
+
+  entry.offset = offset;
+
+  std::vector<unsigned char> header;
+
+  put32(header, 0x04034b50);
+  put16(header, versionNeeded);
+  put16(header, utf8Flag);
+  put16(header, entry.method);
+  put16(header, dosTime);
+  put16(header, dosDate);
+  put32(header, entry.crc);
+  put32(header, std::uint32_t(entry.compressedSize));
+  put32(header, std::uint32_t(entry.size));
+  put16(header, entry.name.size());
+  // Extra field length
+  put16(header, 0);
+  putName(header, entry.name);
+
+  write(header);
+
+  write(entry.data);
+
+  entry.data = std::vector<unsigned char>();
+
+  written.emplace_back(std::move(entry));
+}
+
+void ZipWriter::write(const std::vector<unsigned char>& bytes)
+{
+  if (!failed && !bytes.empty() && !sink.write(bytes.data(), bytes.size())) {
+    failed = true;
+  }
+
+  offset += bytes.size();
+}
+
+} // namespace px
@@ -0,0 +1,135 @@
+#ifndef LIBPX_IO_ZIP_HPP
+#define LIBPX_IO_ZIP_HPP
+
+#include "WorkerPool.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace px {
+
+class Sink;
+
+/// Writes a ZIP archive to a sink, one entry at a time.
+///
+/// Entries are produced and compressed on worker threads,
+/// and written to the sink in the order they were added as
+/// soon as they are ready. Only the entries that are still
+/// in flight are kept in memory, so the archive as a whole
+/// is never buffered. The central directory is written by
+/// @ref ZipWriter::finish.
+///
+/// ZIP64 is not supported, so archives are limited to
+/// 65535 entries and 4 GiB.
+class ZipWriter final
+{
+public:
+  /// The type of function that produces the contents of an entry.
+  /// It is called on a worker thread and is given the index of
+  /// that thread, so that per-thread resources may be used.
+  using Producer = std::function<std::vector<unsigned char> (std::size_t threadIndex)>;
+  /// Constructs a new ZIP writer.
+  ///
+  /// @param sink The sink to write the archive to.
+  /// This must outlive the writer.
+  /// @param threadCount The number of worker threads.
+  /// If this is zero, one thread per processor is used.
+  /// @param level The compression level, from 0 to 9.
+  ZipWriter(Sink& sink, std::size_t threadCount = 0, int level = 6);
+  ZipWriter(const ZipWriter&) = delete;
+  /// Waits for the entries still being compressed.
+  ~ZipWriter();
+  /// Gets the number of worker threads.
+  std::size_t getThreadCount() const noexcept;
+  /// Adds an entry with known contents.
+  ///
+  /// @param name The path of the entry within the archive.
+  /// @param data The contents of the entry.
+  /// @param compress Whether or not to deflate the entry.
+  /// This should be false for data that is already compressed, such as PNG files.
+  void add(const std::string& name, std::vector<unsigned char> data, bool compress = true);
+  /// Adds an entry whose contents are produced on a worker thread.
+  ///
+  /// This may block, writing the entries that are ready,
+  /// if too many entries are already in flight.
+  ///
+  /// @param name The path of the entry within the archive.
+  /// @param producer The function that produces the contents of the entry.
+  /// If it throws, the exception is rethrown by a later call to
+  /// @ref ZipWriter::add or @ref ZipWriter::finish.
+  /// @param compress Whether or not to deflate the entry.
+  void add(const std::string& name, Producer producer, bool compress = true);
+  /// Writes the remaining entries and the central directory,
+  /// and closes the sink.
+  ///
+  /// @return True on success, false if the sink could not
+  /// be written to or the archive is too large.
+  bool finish();
+private:
+  /// An entry that has been added to the archive.
+  struct Entry final
+  {
+    /// The path of the entry within the archive.
+    std::string name;
+    /// The compression method, which is either stored (0) or deflated (8).
+    std::uint16_t method = 0;
+    /// The checksum of the uncompressed contents.
+    std::uint32_t crc = 0;
+    /// The size of the contents before compression.
+    std::uint64_t size = 0;
+    /// The size of the contents after compression.
+    std::uint64_t compressedSize = 0;
+    /// The offset of the local header in the archive.
+    std::uint64_t offset = 0;
+    /// The compressed contents, until they're written.
+    std::vector<unsigned char> data;
+    /// Set once the contents are ready to be written.
+    bool done = false;
+    /// The exception thrown while producing the entry, if any.
+    std::exception_ptr error;
+  };
+  /// Writes the entries at the front of the queue that are ready.
+  ///
+  /// @param block Whether or not to wait for the first entry.
+  void writeReady(bool block);
+  /// Writes an entry once its contents are ready.
+  void writeEntry(Entry& entry);
+  /// Writes bytes to the sink, keeping track of the offset.
+  void write(const std::vector<unsigned char>& bytes);
+  /// The sink the archive is written to.
+  Sink& sink;
+  /// The compression level.
+  int level;
+  /// The modification time of the entries, in MS-DOS format.
+  std::uint16_t dosTime = 0;
+  /// The modification date of the entries, in MS-DOS format.
+  std::uint16_t dosDate = 0;
+  /// The number of bytes written so far.
+  std::uint64_t offset = 0;
+  /// Set when writing to the sink fails.
+  bool failed = false;
+  /// The entries that have been written.
+  std::vector<Entry> written;
+  /// The entries that are being produced or compressed, in order.
+  std::deque<std::shared_ptr<Entry>> pending;
+  /// Protects the state of the pending entries.
+  std::mutex mutex;
+  /// Signaled when a pending entry is done.
+  std::condition_variable entryDone;
+  /// The threads that produce and compress the entries.
+  /// Declared last so that it stops before the rest is destroyed.
+  WorkerPool pool;
+};
+
+} // namespace px
+
+#endif // LIBPX_IO_ZIP_HPP
@@ -1,14 +1,40 @@
 #include "libpx.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIBPX_HAVE_MMAP 1
+#endif
+
 namespace px {
 
 namespace {
@@ -214,14 +240,479 @@ inline constexpr Vector<T, dims> max(const Vector<T, dims>& a, const Vector<T, d
 /// integer vector.
 using Vec2 = Vector<int, 2>;
 
+/// A 2D vector of floats, which is used for scale factors.
+using Vec2f = Vector<float, 2>;
+
 /// Indicates if two integer vectors are equal.
 inline bool operator == (const Vec2& a, const Vec2& b) noexcept
 {
   return (a[0] == b[0]) && (a[1] == b[1]);
 }
 
+/// An axis-aligned box of pixels.
+/// Both corners of the box are inclusive.
+struct Box final
+{
+  /// The top left corner of the box.
+  Vec2 min { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
+  /// The bottom right corner of the box.
+  Vec2 max { std::numeric_limits<int>::min(), std::numeric_limits<int>::min() };
+  /// Creates a box that contains every pixel.
+  static constexpr Box unbounded() noexcept
+  {
+    return Box {
+      Vec2 { std::numeric_limits<int>::min(), std::numeric_limits<int>::min() },
+      Vec2 { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() }
+    };
+  }
+  /// Indicates whether or not the box contains any pixels.
+  inline constexpr bool empty() const noexcept
+  {
+    return (max[0] < min[0]) || (max[1] < min[1]);
+  }
+  /// Extends the box so that it contains a point.
+  inline void include(const Vec2& p) noexcept
+  {
+    min = px::min(min, p);
+    max = px::max(max, p);
+  }
+  /// Indicates whether or not two boxes share any pixels.
+  inline constexpr bool intersects(const Box& other) const noexcept
+  {
+    return !empty()
+        && !other.empty()
+        && (min[0] <= other.max[0]) && (other.min[0] <= max[0])
+        && (min[1] <= other.max[1]) && (other.min[1] <= max[1]);
+  }
+};
+
+} // namespace
+
+//==================//
+// Section: Tracing //
+//==================//
+
+namespace {
+
+/// A single event recorded by the tracer.
+struct TraceEvent final
+{
+  /// The name of the event.
+  /// This must point to a string with a static lifetime.
+  const char* name = "";
+  /// The name of the numeric argument, which may be null.
+  const char* argName = nullptr;
+  /// The value of the numeric argument.
+  double argValue = 0;
+  /// The time of the event, in nanoseconds since the tracer was created.
+  std::uint64_t time = 0;
+  /// Either 'B' for the beginning of an event or 'E' for the end of one.
+  char phase = 'B';
+};
+
+/// The number of events each thread can hold
+/// before the oldest events are overwritten.
+constexpr std::size_t traceBufferSize() noexcept
+{
+  return 16384;
+}
+
+/// A slot of a trace buffer that holds one event.
+///
+/// Since the owning thread may overwrite a slot while another thread
+/// reads it, every field is atomic, and the slot carries the position
+/// of the event in it. The position is cleared before the event is
+/// written and set once it's written, so a reader can tell when the
+/// event it read was overwritten part of the way through.
+struct TraceSlot final
+{
+  /// One plus the position of the event in the slot, or zero
+  /// if the slot is empty or the event is being written.
+  std::atomic<std::size_t> sequence { 0 };
+  /// The fields of the event, as in @ref TraceEvent.
+  std::atomic<const char*> name { "" };
+  std::atomic<const char*> argName { nullptr };
+  std::atomic<double> argValue { 0 };
+  std::atomic<std::uint64_t> time { 0 };
+  std::atomic<char> phase { 'B' };
+};
+
+/// A ring buffer of the events recorded by a single thread.
+///
+/// Only the thread that owns the buffer writes events to it.
+/// The position of the next event is published after the event is
+/// written, so that other threads can read the events without a lock.
+struct TraceBuffer final
+{
+  /// The ID given to the thread in the trace.
+  std::size_t threadID = 0;
+  /// The total number of events ever written to the buffer.
+  std::atomic<std::size_t> head { 0 };
+  /// The number of events that were cleared from the buffer.
+  std::atomic<std::size_t> tail { 0 };
+  /// The event storage.
+  std::vector<TraceSlot> events;
+  /// Whether or not a running thread owns the buffer. Once its
+  /// thread exits, the buffer is handed to the next thread that
+  /// records an event, along with the events already in it.
+  bool owned = true;
+  /// Constructs a new trace buffer.
+  ///
+  /// @param id The ID to give the thread in the trace.
+  TraceBuffer(std::size_t id) : threadID(id), events(traceBufferSize()) {}
+  /// Writes an event to the buffer.
+  inline void push(const TraceEvent& event) noexcept
+  {
+    auto pos = head.load(std::memory_order_relaxed);
+
+    auto& slot = events[pos % traceBufferSize()];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.argName.store(event.argName, std::memory_order_relaxed);
+    slot.argValue.store(event.argValue, std::memory_order_relaxed);
+    slot.time.store(event.time, std::memory_order_relaxed);
+    slot.phase.store(event.phase, std::memory_order_relaxed);
+
+    slot.sequence.store(pos + 1, std::memory_order_release);
+
+    head.store(pos + 1, std::memory_order_release);
+  }
+  /// Reads an event from the buffer.
+  ///
+  /// @param pos The position of the event to read.
+  /// @param event Is assigned the event.
+  ///
+  /// @return True on success, false if the event
+  /// was overwritten before or while it was read.
+  inline bool read(std::size_t pos, TraceEvent& event) const noexcept
+  {
+    const auto& slot = events[pos % traceBufferSize()];
+
+    if (slot.sequence.load(std::memory_order_acquire) != (pos + 1)) {
+      return false;
+    }
+
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.argName = slot.argName.load(std::memory_order_relaxed);
+    event.argValue = slot.argValue.load(std::memory_order_relaxed);
+    event.time = slot.time.load(std::memory_order_relaxed);
+    event.phase = slot.phase.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return slot.sequence.load(std::memory_order_relaxed) == (pos + 1);
+  }
+};
+
+/// Writes a string to a stream as a JSON string, escaping
+/// the characters that can't appear in one as they are.
+void writeJSONString(std::ostream& stream, const char* str)
+{
+  stream << '"';
+
+  for (; *str; str++) {
+    switch (*str) {
+      case '"':
+        stream << "\\\"";
+        break;
+      case '\\':
+        stream << "\\\\";
+        break;
+      case '\n':
+        stream << "\\n";
+        break;
+      case '\r':
+        stream << "\\r";
+        break;
+      case '\t':
+        stream << "\\t";
+        break;
+      default:
+        if ((unsigned char) *str < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(*str));
+          stream << buf;
+        } else {
+          stream << *str;
+        }
+        break;
+    }
+  }
+
+  stream << '"';
+}
+
+/// Keeps track of the trace buffers of every thread.
+class Tracer final
+{
+  /// Guards the list of buffers. This is only locked when
+  /// a thread records its first event and when exporting.
+  std::mutex mutex;
+  /// The buffers of every thread that recorded an event.
+  /// These outlive their threads, so that their events can still be
+  /// exported, and are reused by later threads, so that there are never
+  /// more buffers than threads that recorded events at the same time.
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  /// The time that event times are relative to.
+  std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+public:
+  /// Whether or not events are being recorded.
+  std::atomic<bool> enabled { false };
+  /// Gets the one and only tracer.
+  static Tracer& get() noexcept
+  {
+    static Tracer tracer;
+    return tracer;
+  }
+  /// Records an event on the calling thread.
+  void record(char phase, const char* name, const char* argName, double argValue) noexcept
+  {
+    auto* buffer = getThreadBuffer();
+    if (!buffer) {
+      return;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - epoch;
+
+    TraceEvent event;
+    event.name = name;
+    event.argName = argName;
+    event.argValue = argValue;
+    event.time = std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    event.phase = phase;
+
+    buffer->push(event);
+  }
+  /// Discards the events recorded so far.
+  void clear() noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& buffer : buffers) {
+      buffer->tail.store(buffer->head.load(std::memory_order_acquire));
+    }
+  }
+  /// Writes the recorded events in the Chrome trace event format.
+  ///
+  /// @param stream The stream to write the events to.
+  void write(std::ostream& stream)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    stream << "{\"traceEvents\":[";
+
+    auto first = true;
+
+    for (const auto& buffer : buffers) {
+
+      auto head = buffer->head.load(std::memory_order_acquire);
+
+      auto begin = buffer->tail.load();
+
+      if ((head - begin) > traceBufferSize()) {
+        begin = head - traceBufferSize();
+      }
+
+      for (auto i = begin; i < head; i++) {
+
+        // Events that the thread overwrites while
+        // they're being written out are left out.
+
+        TraceEvent event;
+
+        if (!buffer->read(i, event)) {
+          continue;
+        }
+
+        stream << (first ? "\n" : ",\n");
+
+        first = false;
+
+        stream << "{\"name\":";
+        writeJSONString(stream, event.name);
+        stream << ",\"ph\":\"" << event.phase << "\"";
+        stream << ",\"ts\":" << (event.time / 1000) << '.' << std::setw(3) << std::setfill('0') << (event.time % 1000);
+        stream << ",\"pid\":1";
+        stream << ",\"tid\":" << buffer->threadID;
+
+        if (event.argName) {
+          stream << ",\"args\":{";
+          writeJSONString(stream, event.argName);
+          stream << ":";
+          // JSON has no representation of infinity or NaN.
+          if (std::isfinite(event.argValue)) {
+            stream << event.argValue;
+          } else {
+            stream << "null";
+          }
+          stream << "}";
+        }
+
+        stream << "}";
+      }
+    }
+
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+  /// Releases the buffer of a thread that has exited.
+  void release(TraceBuffer* buffer) noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    buffer->owned = false;
+  }
+protected:
+  /// Gets the buffer of the calling thread. If this is the first event
+  /// of the thread, the buffer of a thread that exited is reused, or a
+  /// new buffer is created if every buffer is owned.
+  ///
+  /// @return A pointer to the buffer of the calling thread.
+  /// If the buffer could not be allocated, a null pointer is returned.
+  TraceBuffer* getThreadBuffer() noexcept;
+};
+
+/// Hands the trace buffer of a thread back to the
+/// tracer when the thread exits.
+class TraceBufferOwner final
+{
+  /// The buffer owned by the thread.
+  TraceBuffer* buffer = nullptr;
+public:
+  TraceBufferOwner() = default;
+  TraceBufferOwner(const TraceBufferOwner&) = delete;
+  ~TraceBufferOwner()
+  {
+    if (buffer) {
+      Tracer::get().release(buffer);
+    }
+  }
+  /// Gets the buffer owned by the thread, which may be null.
+  inline TraceBuffer* get() noexcept { return buffer; }
+  /// Takes ownership of a buffer.
+  inline void reset(TraceBuffer* b) noexcept { buffer = b; }
+};
+
+TraceBuffer* Tracer::getThreadBuffer() noexcept
+{
+  thread_local TraceBufferOwner owner;
+
+  if (owner.get()) {
+    return owner.get();
+  }
+
+  try {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& buffer : buffers) {
+      if (!buffer->owned) {
+        buffer->owned = true;
+        owner.reset(buffer.get());
+        return owner.get();
+      }
+    }
+
+    buffers.emplace_back(std::make_shared<TraceBuffer>(buffers.size() + 1));
+
+    owner.reset(buffers.back().get());
+
+  } catch (...) {
+    return nullptr;
+  }
+
+  return owner.get();
+}
+
+/// Traces the lifetime of a scope.
+/// Nothing is recorded if tracing was disabled when the scope began.
+class TraceScope final
+{
+  /// The name of the event, or null if it is not being recorded.
+  const char* name = nullptr;
+public:
+  /// Begins an event.
+  ///
+  /// @param n The name of the event.
+  /// This must point to a string with a static lifetime.
+  /// @param argName An optional name of a numeric argument.
+  /// @param argValue The value of the numeric argument.
+  TraceScope(const char* n, const char* argName = nullptr, double argValue = 0) noexcept
+  {
+    if (Tracer::get().enabled.load(std::memory_order_relaxed)) {
+      name = n;
+      Tracer::get().record('B', name, argName, argValue);
+    }
+  }
+  /// Ends the event.
+  ~TraceScope()
+  {
+    if (name) {
+      Tracer::get().record('E', name, nullptr, 0);
+    }
+  }
+};
+
 } // namespace
 
+void setTracingEnabled(bool enabled) noexcept
+{
+  Tracer::get().enabled.store(enabled);
+}
+
+bool isTracingEnabled() noexcept
+{
+  return Tracer::get().enabled.load(std::memory_order_relaxed);
+}
+
+void beginTraceEvent(const char* name, const char* argName, double argValue) noexcept
+{
+  if (isTracingEnabled()) {
+    Tracer::get().record('B', name, argName, argValue);
+  }
+}
+
+void endTraceEvent(const char* name) noexcept
+{
+  if (isTracingEnabled()) {
+    Tracer::get().record('E', name, nullptr, 0);
+  }
+}
+
+void clearTrace() noexcept
+{
+  Tracer::get().clear();
+}
+
+bool saveTrace(const char* filename)
+{
+  std::ofstream file(filename);
+  if (!file.good()) {
+    return false;
+  }
+
+  Tracer::get().write(file);
+
+  return file.good();
+}
+
+void saveTrace(void** data, std::size_t* size)
+{
+  std::ostringstream stream;
+
+  Tracer::get().write(stream);
+
+  auto tmp = stream.str();
+
+  *data = std::malloc(tmp.size());
+  *size = tmp.size();
+
+  std::memcpy(*data, tmp.data(), tmp.size());
+}
+
 //================//
 // Section: Color //
 //================//
@@ -292,6 +783,9 @@ struct Color final
   RGBA original;
   /// The premultiplied color.
   RGBA premultiplied;
+  /// The index of the palette entry that the color came from,
+  /// or -1 if it did not come from the palette.
+  int index = -1;
   /// Constructs a new color instance.
   ///
   /// @param rgba The original color values.
@@ -299,6 +793,17 @@ struct Color final
     : original(rgba), premultiplied(premultiply(rgba)) { }
 };
 
+/// Contains the colors that nodes may refer to by index.
+using Palette = std::vector<RGBA>;
+
+/// The most entries that a palette may have.
+/// One less than what a byte can index, so that
+/// indexed pixels have a value left for transparency.
+constexpr std::size_t maxPaletteSize() noexcept
+{
+  return 255;
+}
+
 inline constexpr RGBA normalBlend(const RGBA& bg, const Color& fg) noexcept
 {
   return fg.premultiplied + (bg * (1.0f - fg.premultiplied[3]));
@@ -309,60 +814,634 @@ inline constexpr RGBA subtractionBlend(const RGBA& bg, const Color& fg) noexcept
   return clip(bg - fg.original);
 }
 
-inline constexpr RGBA blend(BlendMode mode, const RGBA& bg, const Color& fg) noexcept
+/// Implements the normal blend mode.
+/// The blend mode types are used to instantiate
+/// the rasterization loops once per blend mode.
+struct NormalBlend final
 {
-  switch (mode) {
-    case BlendMode::Normal:
-      return normalBlend(bg, fg);
-    case BlendMode::Subtract:
-      return subtractionBlend(bg, fg);
-  }
+  /// Blends a color onto a pixel.
+  ///
+  /// @param dst The RGBA pixel to blend onto.
+  /// @param fg The color to blend onto the pixel.
+  static inline void apply(float* dst, const Color& fg) noexcept
+  {
+    // Same as @ref normalBlend, but written per channel
+    // so that the span loops are easier to vectorize.
 
-  return bg;
-}
+    float inv = 1.0f - fg.premultiplied[3];
+
+    for (std::size_t i = 0; i < 4; i++) {
+      dst[i] = fg.premultiplied[i] + (dst[i] * inv);
+    }
+  }
+  /// Blends a color onto an indexed pixel.
+  /// Since an indexed pixel can't be partially covered,
+  /// it is replaced if the color is at least half opaque.
+  ///
+  /// @param dst The indexed pixel to blend onto.
+  /// @param index The palette index of the color.
+  /// @param fg The color to blend onto the pixel.
+  static inline void applyIndex(unsigned char* dst, unsigned char index, const Color& fg) noexcept
+  {
+    if (fg.premultiplied[3] >= 0.5f) {
+      *dst = index;
+    }
+  }
+};
 
-inline constexpr RGBA blend(BlendMode mode, const float* bg, const Color& fg) noexcept
+/// Implements the subtraction blend mode.
+struct SubtractBlend final
 {
-  RGBA tmp { bg[0], bg[1], bg[2], bg[3] };
+  /// Subtracts a color from a pixel.
+  ///
+  /// @param dst The RGBA pixel to subtract from.
+  /// @param fg The color to subtract from the pixel.
+  static inline void apply(float* dst, const Color& fg) noexcept
+  {
+    // Same as @ref subtractionBlend, written per channel.
+
+    for (std::size_t i = 0; i < 4; i++) {
+      dst[i] = clip(dst[i] - fg.original[i]);
+    }
+  }
+  /// Subtracts a color from an indexed pixel, which
+  /// erases it if the color is at least half opaque.
+  static inline void applyIndex(unsigned char* dst, unsigned char, const Color& fg) noexcept
+  {
+    if (fg.original[3] >= 0.5f) {
+      *dst = transparentIndex;
+    }
+  }
+};
 
-  return blend(mode, tmp, fg);
+/// Calls a functor with the type that implements a blend mode.
+/// This is meant to be done once per draw operation, so that
+/// the blend mode is not examined again for every pixel.
+///
+/// @param mode The blend mode to get the implementation of.
+/// @param functor The functor to pass the implementation to.
+/// This is usually a generic lambda, which is instantiated
+/// once for each of the blend mode types.
+template <typename Functor>
+void dispatchBlendMode(BlendMode mode, Functor functor)
+{
+  switch (mode) {
+    case BlendMode::Normal:
+      functor(NormalBlend());
+      break;
+    case BlendMode::Subtract:
+      functor(SubtractBlend());
+      break;
+  }
 }
 
 } // namespace
 
-//===================//
-// Section: Geometry //
-//===================//
+//====================//
+// Section: Animation //
+//====================//
 
 namespace {
 
-//constexpr RGBA white() noexcept { return RGBA { 1, 1, 1, 1 }; }
-constexpr RGBA black() noexcept { return RGBA { 0, 0, 0, 1 }; }
-constexpr RGBA transparent() noexcept { return RGBA { 0, 0, 0, 0 }; }
+/// Rounds a float to the nearest integer.
+inline int roundToInt(float value) noexcept
+{
+  return int(std::lround(value));
+}
 
-/// Used for visiting nodes in the scene graph.
-class NodeAccessor
+/// Applies an easing curve to the progress between two keyframes.
+///
+/// @param easing The easing curve to apply.
+/// @param t The progress between the keyframes, from 0 to 1.
+///
+/// @return The eased progress, from 0 to 1.
+float ease(Easing easing, float t) noexcept
 {
-public:
-  /// Just a stub.
-  virtual ~NodeAccessor() {}
-  virtual void access(const Ellipse& ellipse) noexcept = 0;
-  virtual void access(const Fill& fill) noexcept = 0;
-  virtual void access(const Line& line) noexcept = 0;
-  virtual void access(const Quad& quad) noexcept = 0;
-};
+  switch (easing) {
+    case Easing::Linear:
+      break;
+    case Easing::Step:
+      return 0;
+    case Easing::EaseIn:
+      return t * t;
+    case Easing::EaseOut:
+      return 1 - ((1 - t) * (1 - t));
+    case Easing::EaseInOut:
+      return t * t * (3 - (2 * t));
+  }
 
-/// This is the base of any
-/// class that appears in the scene graph.
-struct Node
+  return t;
+}
+
+/// The values of a layer or node at a certain frame.
+struct Keyframe final
 {
-  /// Just a stub.
-  virtual ~Node() {}
-  /// Allows a node accessor class access
-  /// to the derived node type.
-  virtual void accept(NodeAccessor& accessor) const noexcept = 0;
-  /// Copies the derived node.
-  virtual Node* copy() const = 0;
+  /// The frame that the keyframe is placed on.
+  std::size_t frame = 0;
+  /// The curve followed to the next keyframe.
+  Easing easing = Easing::Linear;
+  /// The distance to move the points by.
+  Vec2 translation { 0, 0 };
+  /// The factors to scale the points by, about the pivot.
+  Vec2f scale { 1, 1 };
+  /// The offsets of each point, which are applied before
+  /// scaling. Points beyond this array have no offset.
+  std::vector<Vec2> pointOffsets;
+  /// Gets the offset of a point.
+  inline Vec2 getPointOffset(std::size_t index) const noexcept
+  {
+    return (index < pointOffsets.size()) ? pointOffsets[index] : Vec2 { 0, 0 };
+  }
+};
+
+/// The most frames that a document may have. Keyframes must be placed
+/// before this frame, which bounds the size of the interpolation tables.
+constexpr std::size_t maxFrameCount() noexcept
+{
+  return 65536;
+}
+
+/// One entry of an interpolation table,
+/// for a frame between two keyframes.
+struct FrameSample final
+{
+  /// The interpolated translation.
+  Vec2 translation { 0, 0 };
+  /// The interpolated scale.
+  Vec2f scale { 1, 1 };
+  /// The eased progress between the keyframes,
+  /// which is used to interpolate the point offsets.
+  float weight = 0;
+};
+
+/// The transform of a layer or node at a certain frame.
+struct AnimationState final
+{
+  /// Whether or not there are keyframes. When this is false,
+  /// the state leaves every point where it is.
+  bool animated = false;
+  /// The point that the scale is applied about.
+  Vec2 pivot { 0, 0 };
+  /// The distance to move the points by.
+  Vec2 translation { 0, 0 };
+  /// The factors to scale the points by.
+  Vec2f scale { 1, 1 };
+  /// The keyframe at or before the frame.
+  const Keyframe* from = nullptr;
+  /// The keyframe after the frame, which is the
+  /// same as @ref AnimationState::from outside of
+  /// the range of the keyframes.
+  const Keyframe* to = nullptr;
+  /// The eased progress from one keyframe to the next.
+  float weight = 0;
+  /// Gets the interpolated offset of a point.
+  Vec2 getPointOffset(std::size_t index) const noexcept
+  {
+    if (!animated) {
+      return Vec2 { 0, 0 };
+    }
+
+    auto a = from->getPointOffset(index);
+    auto b = to->getPointOffset(index);
+
+    return Vec2 {
+      a[0] + roundToInt(float(b[0] - a[0]) * weight),
+      a[1] + roundToInt(float(b[1] - a[1]) * weight)
+    };
+  }
+  /// Scales and translates a point.
+  Vec2 apply(const Vec2& p) const noexcept
+  {
+    if (!animated) {
+      return p;
+    }
+
+    auto d = p - pivot;
+
+    return Vec2 {
+      pivot[0] + roundToInt(float(d[0]) * scale[0]) + translation[0],
+      pivot[1] + roundToInt(float(d[1]) * scale[1]) + translation[1]
+    };
+  }
+  /// Scales a size, such as the radius of an ellipse.
+  Vec2 applyToSize(const Vec2& size) const noexcept
+  {
+    if (!animated) {
+      return size;
+    }
+
+    return Vec2 {
+      roundToInt(float(size[0]) * std::fabs(scale[0])),
+      roundToInt(float(size[1]) * std::fabs(scale[1]))
+    };
+  }
+  /// Indicates whether or not two states move every point to the same place.
+  /// States of the same animation are compared, so keyframes are compared by address.
+  bool sameAs(const AnimationState& other) const noexcept
+  {
+    return (animated == other.animated)
+        && (translation == other.translation)
+        && (scale[0] == other.scale[0])
+        && (scale[1] == other.scale[1])
+        && (from == other.from)
+        && (to == other.to)
+        && (weight == other.weight);
+  }
+};
+
+} // namespace
+
+/// Contains the keyframes of a layer or node.
+struct Animation final
+{
+  /// The point that the scale is applied about.
+  Vec2 pivot { 0, 0 };
+  /// The keyframes, sorted by their frames.
+  std::vector<Keyframe> keyframes;
+  /// One table for each pair of neighboring keyframes,
+  /// with one sample for every frame from the first
+  /// keyframe up to (but not including) the second.
+  std::vector<std::vector<FrameSample>> tables;
+  /// Finds the index of the last keyframe at or before a frame.
+  /// The frame must not be before the first keyframe.
+  std::size_t findKeyframe(std::size_t frame) const noexcept
+  {
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frame, [](std::size_t f, const Keyframe& k) {
+      return f < k.frame;
+    });
+
+    return std::size_t(it - keyframes.begin()) - 1;
+  }
+  /// Gets the state of the animation at a frame.
+  AnimationState evaluate(std::size_t frame) const noexcept
+  {
+    AnimationState state;
+
+    if (keyframes.empty()) {
+      return state;
+    }
+
+    state.animated = true;
+    state.pivot = pivot;
+
+    const Keyframe* held = nullptr;
+
+    if (frame <= keyframes.front().frame) {
+      held = &keyframes.front();
+    } else if (frame >= keyframes.back().frame) {
+      held = &keyframes.back();
+    }
+
+    if (held) {
+      state.translation = held->translation;
+      state.scale = held->scale;
+      state.from = held;
+      state.to = held;
+      return state;
+    }
+
+    auto index = findKeyframe(frame);
+
+    const auto& sample = tables[index][frame - keyframes[index].frame];
+
+    state.translation = sample.translation;
+    state.scale = sample.scale;
+    state.from = &keyframes[index];
+    state.to = &keyframes[index + 1];
+    state.weight = sample.weight;
+
+    return state;
+  }
+  /// Recomputes the table between a keyframe and the next one.
+  /// The table must already have the right size.
+  void updateTable(std::size_t index) noexcept
+  {
+    if ((index + 1) >= keyframes.size()) {
+      return;
+    }
+
+    const auto& a = keyframes[index];
+    const auto& b = keyframes[index + 1];
+
+    auto& table = tables[index];
+
+    for (std::size_t i = 0; i < table.size(); i++) {
+
+      auto w = ease(a.easing, float(i) / float(table.size()));
+
+      auto& sample = table[i];
+
+      sample.translation = Vec2 {
+        a.translation[0] + roundToInt(float(b.translation[0] - a.translation[0]) * w),
+        a.translation[1] + roundToInt(float(b.translation[1] - a.translation[1]) * w)
+      };
+
+      sample.scale = Vec2f {
+        a.scale[0] + ((b.scale[0] - a.scale[0]) * w),
+        a.scale[1] + ((b.scale[1] - a.scale[1]) * w)
+      };
+
+      sample.weight = w;
+    }
+  }
+  /// Updates the tables next to a keyframe, after its values changed.
+  void updateTablesAround(std::size_t index) noexcept
+  {
+    if (index > 0) {
+      updateTable(index - 1);
+    }
+
+    updateTable(index);
+  }
+  /// Rebuilds all of the tables, after keyframes were added or removed.
+  /// If this throws, the animation is left as it was.
+  void rebuildTables()
+  {
+    std::vector<std::vector<FrameSample>> newTables(keyframes.empty() ? 0 : (keyframes.size() - 1));
+
+    for (std::size_t i = 0; i < newTables.size(); i++) {
+      newTables[i].resize(keyframes[i + 1].frame - keyframes[i].frame);
+    }
+
+    tables = std::move(newTables);
+
+    for (std::size_t i = 0; i < tables.size(); i++) {
+      updateTable(i);
+    }
+  }
+  /// Sorts keyframes that were added in any order, such as by the
+  /// parser, and rebuilds the tables. Of several keyframes on the
+  /// same frame, the last one is kept.
+  void sortKeyframes()
+  {
+    std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) {
+      return a.frame < b.frame;
+    });
+
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < keyframes.size(); i++) {
+      if (count && (keyframes[count - 1].frame == keyframes[i].frame)) {
+        keyframes[count - 1] = std::move(keyframes[i]);
+      } else {
+        if (count != i) {
+          keyframes[count] = std::move(keyframes[i]);
+        }
+        count++;
+      }
+    }
+
+    keyframes.resize(count);
+
+    rebuildTables();
+  }
+};
+
+namespace {
+
+/// Owns the animation of a layer or a node.
+///
+/// Most layers and nodes aren't animated, so the animation
+/// is only allocated once it's accessed and an animation
+/// without keyframes costs nothing while rendering.
+class AnimationPtr final
+{
+  /// The animation, which is null until it's accessed.
+  std::unique_ptr<Animation> animation;
+public:
+  AnimationPtr() = default;
+  AnimationPtr(AnimationPtr&&) noexcept = default;
+  /// Copies the animation of another layer or node.
+  AnimationPtr(const AnimationPtr& other)
+    : animation(other.animation ? new Animation(*other.animation) : nullptr) {}
+  AnimationPtr& operator = (AnimationPtr&&) noexcept = default;
+  AnimationPtr& operator = (const AnimationPtr& other)
+  {
+    AnimationPtr tmp(other);
+    animation = std::move(tmp.animation);
+    return *this;
+  }
+  /// Accesses the animation, allocating it if needed.
+  Animation& get()
+  {
+    if (!animation) {
+      animation.reset(new Animation());
+    }
+
+    return *animation;
+  }
+  /// Indicates whether or not there are any keyframes.
+  inline bool animated() const noexcept
+  {
+    return animation && !animation->keyframes.empty();
+  }
+  /// Accesses the animation, which must be allocated.
+  inline const Animation& operator * () const noexcept
+  {
+    return *animation;
+  }
+  /// Gets the state of the animation at a frame.
+  inline AnimationState evaluate(std::size_t frame) const noexcept
+  {
+    return animation ? animation->evaluate(frame) : AnimationState();
+  }
+};
+
+} // namespace
+
+void setPivot(Animation* animation, int x, int y) noexcept
+{
+  animation->pivot = Vec2 { x, y };
+}
+
+std::size_t addKeyframe(Animation* animation, std::size_t frame)
+{
+  if (frame >= maxFrameCount()) {
+    throw std::out_of_range("Keyframe frame is out of range");
+  }
+
+  auto& keyframes = animation->keyframes;
+
+  std::size_t index = 0;
+
+  if (!keyframes.empty() && (frame >= keyframes.front().frame)) {
+
+    index = animation->findKeyframe(frame);
+
+    if (keyframes[index].frame == frame) {
+      return index;
+    }
+
+    index++;
+  }
+
+  // The new keyframe takes the values that the animation already has.
+
+  auto state = animation->evaluate(frame);
+
+  Keyframe keyframe;
+
+  keyframe.frame = frame;
+  keyframe.translation = state.translation;
+  keyframe.scale = state.scale;
+
+  if (state.animated) {
+
+    keyframe.easing = state.from->easing;
+
+    auto pointCount = max(state.from->pointOffsets.size(), state.to->pointOffsets.size());
+
+    keyframe.pointOffsets.resize(pointCount);
+
+    for (std::size_t i = 0; i < pointCount; i++) {
+      keyframe.pointOffsets[i] = state.getPointOffset(i);
+    }
+  }
+
+  keyframes.emplace(keyframes.begin() + index, std::move(keyframe));
+
+  try {
+    animation->rebuildTables();
+  } catch (...) {
+    keyframes.erase(keyframes.begin() + index);
+    throw;
+  }
+
+  return index;
+}
+
+bool removeKeyframe(Animation* animation, std::size_t index)
+{
+  auto& keyframes = animation->keyframes;
+
+  if (index >= keyframes.size()) {
+    return false;
+  }
+
+  auto keyframe = std::move(keyframes[index]);
+
+  keyframes.erase(keyframes.begin() + index);
+
+  try {
+    animation->rebuildTables();
+  } catch (...) {
+    keyframes.emplace(keyframes.begin() + index, std::move(keyframe));
+    throw;
+  }
+
+  return true;
+}
+
+std::size_t getKeyframeCount(const Animation* animation) noexcept
+{
+  return animation->keyframes.size();
+}
+
+std::size_t getKeyframeFrame(const Animation* animation, std::size_t index)
+{
+  return animation->keyframes.at(index).frame;
+}
+
+bool setKeyframeTranslation(Animation* animation, std::size_t index, int x, int y) noexcept
+{
+  if (index >= animation->keyframes.size()) {
+    return false;
+  }
+
+  animation->keyframes[index].translation = Vec2 { x, y };
+
+  animation->updateTablesAround(index);
+
+  return true;
+}
+
+bool setKeyframeScale(Animation* animation, std::size_t index, float x, float y) noexcept
+{
+  if (index >= animation->keyframes.size()) {
+    return false;
+  }
+
+  animation->keyframes[index].scale = Vec2f { x, y };
+
+  animation->updateTablesAround(index);
+
+  return true;
+}
+
+bool setKeyframeEasing(Animation* animation, std::size_t index, Easing easing) noexcept
+{
+  if (index >= animation->keyframes.size()) {
+    return false;
+  }
+
+  animation->keyframes[index].easing = easing;
+
+  animation->updateTable(index);
+
+  return true;
+}
+
+bool setKeyframePointOffset(Animation* animation, std::size_t index, std::size_t point, int x, int y)
+{
+  if ((index >= animation->keyframes.size()) || (point >= maxPointOffsets)) {
+    return false;
+  }
+
+  auto& offsets = animation->keyframes[index].pointOffsets;
+
+  if (point >= offsets.size()) {
+    offsets.resize(point + 1, Vec2 { 0, 0 });
+  }
+
+  offsets[point] = Vec2 { x, y };
+
+  return true;
+}
+
+//===================//
+// Section: Geometry //
+//===================//
+
+namespace {
+
+//constexpr RGBA white() noexcept { return RGBA { 1, 1, 1, 1 }; }
+constexpr RGBA black() noexcept { return RGBA { 0, 0, 0, 1 }; }
+constexpr RGBA transparent() noexcept { return RGBA { 0, 0, 0, 0 }; }
+
+/// Used for visiting nodes in the scene graph.
+class NodeAccessor
+{
+public:
+  /// Just a stub.
+  virtual ~NodeAccessor() {}
+  virtual void access(const Ellipse& ellipse) noexcept = 0;
+  virtual void access(const Fill& fill) noexcept = 0;
+  virtual void access(const Line& line) noexcept = 0;
+  virtual void access(const Quad& quad) noexcept = 0;
+  virtual void access(const Bitmap& bitmap) noexcept = 0;
+  virtual void access(const Instance& instance) noexcept = 0;
+  virtual void access(const Polygon& polygon) noexcept = 0;
+};
+
+/// The number of values in @ref NodeType.
+constexpr std::size_t nodeTypeCount() noexcept
+{
+  return 7;
+}
+
+/// This is the base of any
+/// class that appears in the scene graph.
+struct Node
+{
+  /// The keyframes of the node.
+  AnimationPtr animation;
+  /// Just a stub.
+  virtual ~Node() {}
+  /// Allows a node accessor class access
+  /// to the derived node type.
+  virtual void accept(NodeAccessor& accessor) const noexcept = 0;
+  /// Copies the derived node.
+  virtual Node* copy() const = 0;
 };
 
 /// A type definition for a node smart pointer.
@@ -380,6 +1459,9 @@ struct StrokeNode : public Node
   BlendMode blendMode = BlendMode::Normal;
   /// The color that the stroke is drawn with.
   RGBA color = black();
+  /// The index of the palette color that the stroke is drawn
+  /// with instead of @ref color, or -1 if it has none.
+  int colorIndex = -1;
 };
 
 /// Evaluates a number to a safe pixel size.
@@ -391,10 +1473,34 @@ inline constexpr int safePixelSize(int in) noexcept
 
 } // namespace
 
+const char* getNodeTypeName(NodeType nodeType) noexcept
+{
+  switch (nodeType) {
+    case NodeType::Ellipse:
+      return "ellipse";
+    case NodeType::Fill:
+      return "fill";
+    case NodeType::Line:
+      return "line";
+    case NodeType::Quad:
+      return "quad";
+    case NodeType::Bitmap:
+      return "bitmap";
+    case NodeType::Instance:
+      return "instance";
+    case NodeType::Polygon:
+      return "polygon";
+  }
+
+  return "";
+}
+
 struct Ellipse final : public StrokeNode
 {
   Vec2 center = Vec2 { 0, 0 };
   Vec2 radius = Vec2 { 0, 0 };
+  /// Whether or not the inside of the ellipse is drawn.
+  bool filled = false;
 
   void accept(NodeAccessor& accessor) const noexcept override
   {
@@ -427,6 +1533,11 @@ void setColor(Ellipse* ellipse, float r, float g, float b, float a) noexcept
   ellipse->color = clip(RGBA { r, g, b, a });
 }
 
+void setColorIndex(Ellipse* ellipse, int index) noexcept
+{
+  ellipse->colorIndex = index;
+}
+
 void setPixelSize(Ellipse* ellipse, int pixelSize) noexcept
 {
   ellipse->pixelSize = safePixelSize(pixelSize);
@@ -444,6 +1555,11 @@ void resizeRect(Ellipse* ellipse, int x1, int y1, int x2, int y2) noexcept
   ellipse->radius = (pMax - pMin) / 2;
 }
 
+void setFilled(Ellipse* ellipse, bool filled) noexcept
+{
+  ellipse->filled = filled;
+}
+
 /// Represents a flood fill operation.
 struct Fill final : public Node
 {
@@ -451,6 +1567,9 @@ struct Fill final : public Node
   BlendMode blendMode = BlendMode::Normal;
   /// The color to fill the area with.
   RGBA color = black();
+  /// The index of the palette color that the area is
+  /// filled with instead of @ref color, or -1 if it has none.
+  int colorIndex = -1;
   /// The position on the image to start the fill operation at.
   /// All pixels connected to this point are filled.
   Vec2 origin = Vec2 { 0, 0 };
@@ -481,6 +1600,11 @@ void setColor(Fill* fill, float r, float g, float b, float a) noexcept
   fill->color = clip(RGBA { r, g, b, a });
 }
 
+void setColorIndex(Fill* fill, int index) noexcept
+{
+  fill->colorIndex = index;
+}
+
 /// Represents a series of straight line segments.
 struct Line final : public StrokeNode
 {
@@ -621,6 +1745,11 @@ void setColor(Line* line, float r, float g, float b, float a) noexcept
   line->color = clip(RGBA { r, g, b, a });
 }
 
+void setColorIndex(Line* line, int index) noexcept
+{
+  line->colorIndex = index;
+}
+
 /// Represents a quadrilateral shape.
 /// A quadrilateral shape differs from
 /// a rectangle in that the lines do not
@@ -629,6 +1758,8 @@ struct Quad final : public StrokeNode
 {
   /// The points making up the quadrilateral.
   Vec2 points[4] { Vec2 { 0, 0 }, Vec2 { 1, 0 }, Vec2 { 1, 1 }, Vec2 { 0, 1 } };
+  /// Whether or not the inside of the quadrilateral is drawn.
+  bool filled = false;
 
   void accept(NodeAccessor& accessor) const noexcept override
   {
@@ -660,15 +1791,474 @@ void setColor(Quad* quad, float r, float g, float b, float a) noexcept
   quad->color = clip(RGBA { r, g, b, a });
 }
 
+void setColorIndex(Quad* quad, int index) noexcept
+{
+  quad->colorIndex = index;
+}
+
 void setPixelSize(Quad* quad, int pixelSize) noexcept
 {
   quad->pixelSize = safePixelSize(pixelSize);
 }
 
-//=================//
-// Section: Layers //
-//=================//
-
+void setFilled(Quad* quad, bool filled) noexcept
+{
+  quad->filled = filled;
+}
+
+/// Represents a closed shape that is always filled.
+struct Polygon final : public StrokeNode
+{
+  /// The points making up the outline of the polygon.
+  std::vector<Vec2> points;
+
+  void accept(NodeAccessor& accessor) const noexcept override
+  {
+    accessor.access(*this);
+  }
+  Node* copy() const override
+  {
+    return new Polygon(*this);
+  }
+};
+
+void setBlendMode(Polygon* polygon, BlendMode blendMode) noexcept
+{
+  polygon->blendMode = blendMode;
+}
+
+void setColor(Polygon* polygon, float r, float g, float b, float a) noexcept
+{
+  polygon->color = clip(RGBA { r, g, b, a });
+}
+
+void setColorIndex(Polygon* polygon, int index) noexcept
+{
+  polygon->colorIndex = index;
+}
+
+void setPixelSize(Polygon* polygon, int pixelSize) noexcept
+{
+  polygon->pixelSize = safePixelSize(pixelSize);
+}
+
+void addPoint(Polygon* polygon, int x, int y)
+{
+  polygon->points.emplace_back(Vec2 { x, y });
+}
+
+std::size_t getPointCount(const Polygon* polygon) noexcept
+{
+  return polygon->points.size();
+}
+
+int getPointX(const Polygon* polygon, std::size_t index)
+{
+  return polygon->points.at(index)[0];
+}
+
+int getPointY(const Polygon* polygon, std::size_t index)
+{
+  return polygon->points.at(index)[1];
+}
+
+bool setPoint(Polygon* polygon, std::size_t index, int x, int y) noexcept
+{
+  if (index >= polygon->points.size()) {
+    return false;
+  } else {
+    polygon->points[index] = Vec2 { x, y };
+    return true;
+  }
+}
+
+namespace {
+
+/// A horizontal run of pixels with the same color.
+struct BitmapRun final
+{
+  /// The number of pixels in the run.
+  std::uint32_t length = 0;
+  /// The index of the color in @ref BitmapData::colors.
+  std::uint32_t color = 0;
+};
+
+/// The pixels of a bitmap, compressed into runs of each row.
+///
+/// Raster art has long runs of few colors, so each color is stored
+/// once and each run only refers to it. The data is never modified
+/// once it is built, which lets copies of a bitmap share it, such as
+/// the copies of a document kept for undoing changes.
+struct BitmapData final
+{
+  /// The width of the bitmap, in pixels.
+  std::size_t width = 0;
+  /// The height of the bitmap, in pixels.
+  std::size_t height = 0;
+  /// The distinct colors of the bitmap.
+  /// Transparent pixels are all the same color.
+  std::vector<RGBA> colors;
+  /// The runs of each row, from the top row to the bottom one.
+  /// Runs do not continue from one row to the next.
+  std::vector<BitmapRun> runs;
+  /// The index of the first run of each row,
+  /// followed by the total number of runs.
+  std::vector<std::size_t> rowStarts;
+};
+
+/// Compresses pixels into the runs of a bitmap.
+class BitmapBuilder final
+{
+  /// The data being built.
+  std::shared_ptr<BitmapData> data;
+  /// The index of each color added so far, by the bits of its channels.
+  std::map<std::array<std::uint32_t, 4>, std::uint32_t> colorIndices;
+  /// The number of pixels added so far.
+  std::size_t pixelCount = 0;
+public:
+  /// Prepares to build a bitmap.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  BitmapBuilder(std::size_t width, std::size_t height) : data(std::make_shared<BitmapData>())
+  {
+    data->width = width;
+    data->height = height;
+  }
+  /// Adds a run of pixels, which continues onto the
+  /// next rows if it's longer than the rest of the row.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param c The color of the pixels, which is not premultiplied.
+  /// @param length The number of pixels in the run.
+  ///
+  /// @return True on success, false if the run goes past the last pixel.
+  bool add(const RGBA& c, std::size_t length)
+  {
+    auto& d = *data;
+
+    if (length > ((d.width * d.height) - pixelCount)) {
+      return false;
+    }
+
+    if (!length) {
+      return true;
+    }
+
+    auto color = findColor((c[3] > 0) ? c : transparent());
+
+    while (length) {
+
+      auto x = pixelCount % d.width;
+
+      if (x == 0) {
+        d.rowStarts.emplace_back(d.runs.size());
+      } else if (d.runs.back().color == color) {
+        // Continues the last run, since neighboring
+        // runs of the same color are one run.
+        auto extra = min(length, d.width - x);
+        d.runs.back().length += std::uint32_t(extra);
+        pixelCount += extra;
+        length -= extra;
+        continue;
+      }
+
+      auto count = min(length, d.width - x);
+
+      BitmapRun run;
+      run.length = std::uint32_t(count);
+      run.color = color;
+
+      d.runs.emplace_back(run);
+
+      pixelCount += count;
+
+      length -= count;
+    }
+
+    return true;
+  }
+  /// Indicates whether every pixel of the bitmap has been added.
+  inline bool complete() const noexcept
+  {
+    return pixelCount == (data->width * data->height);
+  }
+  /// Finishes building the bitmap.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  std::shared_ptr<const BitmapData> finish()
+  {
+    data->rowStarts.resize(data->height, data->runs.size());
+    data->rowStarts.emplace_back(data->runs.size());
+    data->colors.shrink_to_fit();
+    data->runs.shrink_to_fit();
+    return std::move(data);
+  }
+protected:
+  /// Finds the index of a color, adding it if it's new.
+  std::uint32_t findColor(const RGBA& c)
+  {
+    std::array<std::uint32_t, 4> key;
+
+    std::memcpy(key.data(), c.data, sizeof(key));
+
+    auto it = colorIndices.find(key);
+    if (it != colorIndices.end()) {
+      return it->second;
+    }
+
+    auto index = std::uint32_t(data->colors.size());
+
+    data->colors.emplace_back(c);
+
+    colorIndices.emplace(key, index);
+
+    return index;
+  }
+};
+
+} // namespace
+
+/// A raster of pixels placed on the canvas,
+/// such as imported artwork or a baked layer.
+struct Bitmap final : public Node
+{
+  /// The blend mode of the bitmap.
+  BlendMode blendMode = BlendMode::Normal;
+  /// The position of the upper left pixel of the bitmap.
+  Vec2 position = Vec2 { 0, 0 };
+  /// The pixels of the bitmap, which are shared between
+  /// copies of the bitmap. This is null if it has no pixels.
+  std::shared_ptr<const BitmapData> data;
+
+  void accept(NodeAccessor& accessor) const noexcept override
+  {
+    accessor.access(*this);
+  }
+  Node* copy() const override
+  {
+    return new Bitmap(*this);
+  }
+};
+
+void setBlendMode(Bitmap* bitmap, BlendMode blendMode) noexcept
+{
+  bitmap->blendMode = blendMode;
+}
+
+void setPosition(Bitmap* bitmap, int x, int y) noexcept
+{
+  bitmap->position = Vec2 { x, y };
+}
+
+void setPixels(Bitmap* bitmap, const float* rgba, std::size_t w, std::size_t h)
+{
+  if ((w > maxBitmapSize) || (h > maxBitmapSize)) {
+    throw std::out_of_range("Bitmap size is out of range");
+  }
+
+  BitmapBuilder builder(w, h);
+
+  for (std::size_t i = 0; i < (w * h); ) {
+
+    const float* first = rgba + (i * 4);
+
+    // Runs are found here, so that the
+    // builder only looks up their colors.
+
+    auto end = i + 1;
+
+    while ((end < (w * h))
+        && ((end % w) != 0)
+        && std::equal(first, first + 4, rgba + (end * 4))) {
+      end++;
+    }
+
+    builder.add(clip(RGBA { first[0], first[1], first[2], first[3] }), end - i);
+
+    i = end;
+  }
+
+  bitmap->data = builder.finish();
+}
+
+void setPixels(Bitmap* bitmap, const unsigned char* rgba, std::size_t w, std::size_t h)
+{
+  if ((w > maxBitmapSize) || (h > maxBitmapSize)) {
+    throw std::out_of_range("Bitmap size is out of range");
+  }
+
+  BitmapBuilder builder(w, h);
+
+  for (std::size_t i = 0; i < (w * h); ) {
+
+    const unsigned char* first = rgba + (i * 4);
+
+    auto end = i + 1;
+
+    while ((end < (w * h))
+        && ((end % w) != 0)
+        && std::equal(first, first + 4, rgba + (end * 4))) {
+      end++;
+    }
+
+    builder.add(RGBA { first[0] / 255.0f, first[1] / 255.0f, first[2] / 255.0f, first[3] / 255.0f }, end - i);
+
+    i = end;
+  }
+
+  bitmap->data = builder.finish();
+}
+
+std::size_t getBitmapWidth(const Bitmap* bitmap) noexcept
+{
+  return bitmap->data ? bitmap->data->width : 0;
+}
+
+std::size_t getBitmapHeight(const Bitmap* bitmap) noexcept
+{
+  return bitmap->data ? bitmap->data->height : 0;
+}
+
+std::size_t getRunCount(const Bitmap* bitmap) noexcept
+{
+  return bitmap->data ? bitmap->data->runs.size() : 0;
+}
+
+/// Places the pixels of a symbol on the canvas.
+struct Instance final : public Node
+{
+  /// The index of the symbol being placed.
+  std::size_t symbol = 0;
+  /// Where the origin of the symbol is placed.
+  Vec2 position = Vec2 { 0, 0 };
+  /// The blend mode that the symbol is stamped with.
+  BlendMode blendMode = BlendMode::Normal;
+
+  void accept(NodeAccessor& accessor) const noexcept override
+  {
+    accessor.access(*this);
+  }
+  Node* copy() const override
+  {
+    return new Instance(*this);
+  }
+};
+
+void setSymbol(Instance* instance, std::size_t symbol) noexcept
+{
+  instance->symbol = symbol;
+}
+
+std::size_t getSymbol(const Instance* instance) noexcept
+{
+  return instance->symbol;
+}
+
+void setBlendMode(Instance* instance, BlendMode blendMode) noexcept
+{
+  instance->blendMode = blendMode;
+}
+
+void setPosition(Instance* instance, int x, int y) noexcept
+{
+  instance->position = Vec2 { x, y };
+}
+
+namespace {
+
+/// Calculates the box of pixels that a node may change.
+/// This is used to skip nodes that are not on the canvas.
+class BoundsCalculator final : public NodeAccessor
+{
+  /// The bounds of the last node that was accessed.
+  Box bounds;
+public:
+  /// Gets the bounds of a node.
+  ///
+  /// @param node The node to get the bounds of.
+  ///
+  /// @return The box of pixels that the node may change.
+  /// This box is empty if the node does not draw anything.
+  Box calculate(const Node& node) noexcept
+  {
+    bounds = Box();
+    node.accept(*this);
+    return bounds;
+  }
+  void access(const Ellipse& ellipse) noexcept override
+  {
+    if (!ellipse.radius[0] || !ellipse.radius[1]) {
+      return;
+    }
+
+    auto radius = absolute(ellipse.radius);
+
+    bounds.include(ellipse.center - radius);
+    bounds.include(ellipse.center + radius);
+
+    expandForPixelSize(ellipse);
+  }
+  void access(const Fill&) noexcept override
+  {
+    // A fill can reach any pixel on the canvas.
+    bounds = Box::unbounded();
+  }
+  void access(const Line& line) noexcept override
+  {
+    for (const auto& p : line.points) {
+      bounds.include(p);
+    }
+
+    expandForPixelSize(line);
+  }
+  void access(const Quad& quad) noexcept override
+  {
+    for (const auto& p : quad.points) {
+      bounds.include(p);
+    }
+
+    expandForPixelSize(quad);
+  }
+  void access(const Bitmap& bitmap) noexcept override
+  {
+    if (!bitmap.data || !bitmap.data->width || !bitmap.data->height) {
+      return;
+    }
+
+    bounds.include(bitmap.position);
+    bounds.include(bitmap.position + Vec2 { int(bitmap.data->width) - 1, int(bitmap.data->height) - 1 });
+  }
+  void access(const Instance&) noexcept override
+  {
+    // The size of a symbol isn't known until it's rendered.
+    bounds = Box::unbounded();
+  }
+  void access(const Polygon& polygon) noexcept override
+  {
+    for (const auto& p : polygon.points) {
+      bounds.include(p);
+    }
+
+    expandForPixelSize(polygon);
+  }
+protected:
+  /// Expands the bounds to include the pixel squares
+  /// that are drawn to the upper left of each point.
+  void expandForPixelSize(const StrokeNode& node) noexcept
+  {
+    if (!bounds.empty()) {
+      bounds.min = bounds.min - (int(node.pixelSize) - 1);
+    }
+  }
+};
+
+} // namespace
+
+//=================//
+// Section: Layers //
+//=================//
+
 /// A layer here is what it is in most image
 /// editing applications, a collection of 2D data
 /// that is meant for a certain Z index and opacity,
@@ -683,6 +2273,9 @@ struct Layer final
   bool visible = true;
   /// The nodes for this layer
   std::vector<NodePtr> nodes;
+  /// The keyframes of the layer, which
+  /// apply to every node in the layer.
+  AnimationPtr animation;
   /// Just a stub.
   Layer() {}
   /// Copies a layer.
@@ -691,6 +2284,7 @@ struct Layer final
     opacity = other.opacity;
     name = other.name;
     visible = other.visible;
+    animation = other.animation;
 
     for (const auto& otherNode : other.nodes) {
       nodes.emplace_back(otherNode->copy());
@@ -748,497 +2342,1330 @@ void setLayerVisibility(Layer* layer, bool visibility) noexcept
   layer->visible = visibility;
 }
 
-//================//
-// Section: Image //
-//================//
+//==================//
+// Section: Symbols //
+//==================//
 
-/// Contains basic image data.
-struct Image final
+/// A named group of nodes, which is placed on the canvas by instances.
+struct Symbol final
 {
-  /// The image colors, formatted
-  /// in the order of RGBA.
-  std::vector<float> colorBuffer;
-  /// The width of the image, in pixels.
-  std::size_t width = 0;
-  /// The height of the image, in pixels.
-  std::size_t height = 0;
+  /// Holds the name and the nodes of the symbol.
+  /// The opacity, visibility and animation of the layer aren't used.
+  Layer layer;
 };
 
-Image* createImage(std::size_t width, std::size_t height)
-{
-  auto image = std::make_unique<Image>(Image());
-
-  resizeImage(image.get(), width, height);
+/// A type definition for a symbol smart pointer.
+using SymbolPtr = std::unique_ptr<Symbol>;
 
-  return image.release();
+void setSymbolName(Symbol* symbol, const char* name)
+{
+  symbol->layer.name = name ? name : "";
 }
 
-void closeImage(Image* image) noexcept
+const char* getSymbolName(const Symbol* symbol) noexcept
 {
-  delete image;
+  return symbol->layer.name.c_str();
 }
 
-const float* getColorBuffer(const Image* image) noexcept
+Ellipse* addEllipse(Symbol* symbol)
 {
-  return image->colorBuffer.data();
+  return symbol->layer.addNode(new Ellipse());
 }
 
-bool getColor(const Image* image, std::size_t x, std::size_t y, float* rgba) noexcept
+Fill* addFill(Symbol* symbol)
 {
-  if ((x >= image->width)
-   || (y >= image->height)) {
-    return false;
-  }
+  return symbol->layer.addNode(new Fill());
+}
 
-  const auto* src = &image->colorBuffer[((y * image->width) + x) * 4];
+Line* addLine(Symbol* symbol)
+{
+  return symbol->layer.addNode(new Line());
+}
 
-  // TODO : Restore RGB before multiply
-  rgba[0] = src[0];
-  rgba[1] = src[1];
-  rgba[2] = src[2];
-  rgba[3] = src[3];
+Quad* addQuad(Symbol* symbol)
+{
+  return symbol->layer.addNode(new Quad());
+}
 
-  return true;
+Polygon* addPolygon(Symbol* symbol)
+{
+  return symbol->layer.addNode(new Polygon());
 }
 
-std::size_t getImageWidth(const Image* image) noexcept { return image->width; }
+Bitmap* addBitmap(Symbol* symbol)
+{
+  return symbol->layer.addNode(new Bitmap());
+}
 
-std::size_t getImageHeight(const Image* image) noexcept { return image->height; }
+//===========================//
+// Section: Frame Evaluation //
+//===========================//
 
-void resizeImage(Image* image, std::size_t w, std::size_t h)
+Animation* getAnimation(Layer* layer)
 {
-  image->colorBuffer.resize(w * h * 4);
-  image->width = w;
-  image->height = h;
+  return &layer->animation.get();
 }
 
-//=====================//
-// Section: Error List //
-//=====================//
+Animation* getAnimation(Ellipse* ellipse)
+{
+  return &ellipse->animation.get();
+}
 
-/// Contains information on a single error.
-struct Error final
+Animation* getAnimation(Fill* fill)
 {
-  /// The stream used to format the error.
-  /// This isn't seen by the end user but it can
-  /// be used to make error reporting easier.
-  std::ostringstream stream;
-  /// A human-readable description of the error.
-  std::string description;
-  /// The line that the error can be found at.
-  std::size_t line = 0;
-  /// The column that the error can be found at.
-  std::size_t column = 0;
-  /// The index within the file that the error begins at.
-  std::size_t index = 0;
-  /// The number of characters that the error pertains to.
-  std::size_t size = 0;
-};
+  return &fill->animation.get();
+}
 
-/// Prints an error to a stream.
-///
-/// @param stream The stream to print to.
-/// @param err The error to print.
-///
-/// @return A reference to @p stream.
-std::ostream& operator << (std::ostream& stream, const Error& err)
+Animation* getAnimation(Line* line)
 {
-  return stream << err.line << ':' << err.column << ": " << err.description.c_str();
+  return &line->animation.get();
 }
 
-struct ErrorList final
+Animation* getAnimation(Quad* quad)
 {
-  /// The path to the file that was opened.
-  std::string filename;
-  /// The source code that the errors pertain to.
-  /// This is all the source code in the original file.
-  std::string source;
-  /// The list of errors that were found.
-  std::vector<Error> errors;
-};
+  return &quad->animation.get();
+}
 
-void closeErrorList(ErrorList* errList) noexcept
+Animation* getAnimation(Polygon* polygon)
 {
-  delete errList;
+  return &polygon->animation.get();
 }
 
-void printErrorListToStderr(const ErrorList* errList) noexcept
+Animation* getAnimation(Bitmap* bitmap)
 {
-  if (!errList) {
-    return;
-  }
+  return &bitmap->animation.get();
+}
 
-  for (std::size_t i = 0; i < errList->errors.size(); i++) {
-    printErrorToStderr(errList, i);
-  }
+Animation* getAnimation(Instance* instance)
+{
+  return &instance->animation.get();
 }
 
-void printErrorToStderr(const ErrorList* errList, std::size_t index) noexcept
+namespace {
+
+/// Computes the geometry of nodes at a certain frame.
+///
+/// Nodes that aren't animated, on layers that aren't animated,
+/// are used as they are. The geometry of an animated node is put
+/// into a scratch node owned by the evaluator, which is reused for
+/// the next animated node of the same type. The scratch nodes keep
+/// their memory, so evaluating a frame again doesn't allocate.
+class FrameEvaluator final : public NodeAccessor
 {
-  if (!errList) {
-    return;
+  /// The frame being evaluated.
+  std::size_t frame = 0;
+  /// The state of the current layer.
+  AnimationState layerState;
+  /// The state of the node being evaluated.
+  AnimationState nodeState;
+  /// Scratch nodes for each type of node.
+  Ellipse ellipse;
+  Fill fill;
+  Line line;
+  Quad quad;
+  Bitmap bitmap;
+  Instance instance;
+  Polygon polygon;
+  /// The last node that was evaluated.
+  const Node* result = nullptr;
+public:
+  /// Sets the frame to evaluate nodes at.
+  inline void setFrame(std::size_t f) noexcept
+  {
+    frame = f;
   }
-
-  if (index >= errList->errors.size()) {
-    return;
+  /// Evaluates the animation of a layer,
+  /// before its nodes are evaluated.
+  inline void beginLayer(const Layer& layer) noexcept
+  {
+    layerState = layer.animation.evaluate(frame);
   }
+  /// Prepares to evaluate the nodes of a symbol, which are
+  /// moved by an offset in place of a layer animation.
+  ///
+  /// @param offset The distance to move the nodes by.
+  inline void beginSymbol(const Vec2& offset) noexcept
+  {
+    layerState = AnimationState();
+    layerState.animated = true;
+    layerState.translation = offset;
+  }
+  /// Evaluates a node of the current layer.
+  ///
+  /// @param node The node to evaluate.
+  ///
+  /// @return Either @p node or a scratch node, which stays valid
+  /// until the next node of the same type is evaluated. This is
+  /// null if memory for the scratch node could not be allocated.
+  const Node* evaluate(const Node& node) noexcept
+  {
+    if (!layerState.animated && !node.animation.animated()) {
+      return &node;
+    }
 
-  std::cerr << errList->filename << ':' << errList->errors[index] << std::endl;
-}
+    nodeState = node.animation.evaluate(frame);
 
-const char* getErrorSource(const ErrorList* errList) noexcept
-{
-  if (!errList) {
-    return "";
-  }
+    result = nullptr;
 
-  return errList->source.c_str();
-}
+    node.accept(*this);
 
-std::size_t getErrorSourceSize(const ErrorList* errList) noexcept
-{
-  if (!errList) {
-    return 0;
+    return result;
+  }
+  /// Gets the number of bytes of memory held by the scratch nodes.
+  std::size_t getScratchMemorySize() const noexcept
+  {
+    return (line.points.capacity() + polygon.points.capacity()) * sizeof(Vec2);
+  }
+  void access(const Ellipse& e) noexcept override
+  {
+    copyStroke(e, ellipse);
+    ellipse.center = transform(e.center, 0);
+    ellipse.radius = layerState.applyToSize(nodeState.applyToSize(e.radius + nodeState.getPointOffset(1)));
+    ellipse.filled = e.filled;
+    result = &ellipse;
   }
+  void access(const Fill& f) noexcept override
+  {
+    fill.blendMode = f.blendMode;
+    fill.color = f.color;
+    fill.colorIndex = f.colorIndex;
+    fill.origin = transform(f.origin, 0);
+    result = &fill;
+  }
+  void access(const Line& l) noexcept override
+  {
+    try {
+      line.points.resize(l.points.size());
+    } catch (...) {
+      return;
+    }
 
-  return errList->source.size();
-}
+    copyStroke(l, line);
 
-std::size_t getErrorCount(const ErrorList* errList) noexcept
-{
-  if (!errList) {
-    return 0;
+    for (std::size_t i = 0; i < l.points.size(); i++) {
+      line.points[i] = transform(l.points[i], i);
+    }
+
+    result = &line;
   }
+  void access(const Quad& q) noexcept override
+  {
+    copyStroke(q, quad);
 
-  return errList->errors.size();
-}
+    for (std::size_t i = 0; i < 4; i++) {
+      quad.points[i] = transform(q.points[i], i);
+    }
 
-std::size_t getErrorColumn(const ErrorList* errList, std::size_t error) noexcept
-{
-  if (!errList) {
-    return 0;
+    quad.filled = q.filled;
+
+    result = &quad;
+  }
+  void access(const Bitmap& b) noexcept override
+  {
+    // Bitmaps are moved by animations, but not scaled.
+    bitmap.blendMode = b.blendMode;
+    bitmap.position = transform(b.position, 0);
+    bitmap.data = b.data;
+    result = &bitmap;
+  }
+  void access(const Instance& i) noexcept override
+  {
+    // Instances are moved like bitmaps.
+    instance.symbol = i.symbol;
+    instance.position = transform(i.position, 0);
+    instance.blendMode = i.blendMode;
+    result = &instance;
   }
+  void access(const Polygon& p) noexcept override
+  {
+    try {
+      polygon.points.resize(p.points.size());
+    } catch (...) {
+      return;
+    }
 
-  if (error >= errList->errors.size()) {
-    return 0;
+    copyStroke(p, polygon);
+
+    for (std::size_t i = 0; i < p.points.size(); i++) {
+      polygon.points[i] = transform(p.points[i], i);
+    }
+
+    result = &polygon;
+  }
+protected:
+  /// Moves a point of the current node by its offset,
+  /// the node transform and the layer transform.
+  inline Vec2 transform(const Vec2& p, std::size_t pointIndex) const noexcept
+  {
+    return layerState.apply(nodeState.apply(p + nodeState.getPointOffset(pointIndex)));
+  }
+  /// Copies the stroke properties of a node into a scratch node.
+  static void copyStroke(const StrokeNode& src, StrokeNode& dst) noexcept
+  {
+    dst.pixelSize = src.pixelSize;
+    dst.blendMode = src.blendMode;
+    dst.color = src.color;
+    dst.colorIndex = src.colorIndex;
   }
+};
 
-  return errList->errors[error].column;
-}
+} // namespace
 
-std::size_t getErrorLine(const ErrorList* errList, std::size_t error) noexcept
+//================//
+// Section: Image //
+//================//
+
+/// Contains basic image data.
+struct Image final
 {
-  if (!errList) {
-    return 0;
+  /// The image colors, formatted in the order of RGBA.
+  /// This is not used by images that are mapped to a file.
+  std::vector<float> colorBuffer;
+  /// Points to the image colors, which are either
+  /// in @ref Image::colorBuffer or in a file mapping.
+  float* data = nullptr;
+  /// The width of the image, in pixels.
+  std::size_t width = 0;
+  /// The height of the image, in pixels.
+  std::size_t height = 0;
+  /// The file descriptor of the file that the image
+  /// is mapped to, or -1 if the image is in memory.
+  int fd = -1;
+  /// The number of bytes in the file mapping.
+  std::size_t mappingSize = 0;
+  Image() = default;
+  Image(const Image&) = delete;
+  ~Image()
+  {
+    unmap();
   }
+  /// Resizes the image, along with the file that it may be mapped to.
+  ///
+  /// @return True on success, false on failure. On failure,
+  /// errno is set and the image is left empty.
+  bool resize(std::size_t w, std::size_t h)
+  {
+    if (fd == -1) {
+      colorBuffer.resize(w * h * 4);
+      data = colorBuffer.data();
+      width = w;
+      height = h;
+      return true;
+    }
 
-  if (error >= errList->errors.size()) {
-    return 0;
-  }
+#ifdef LIBPX_HAVE_MMAP
 
-  return errList->errors[error].line;
-}
+    // Avoids remapping the file on every render.
+    if ((w == width) && (h == height) && mappingSize) {
+      return true;
+    }
 
-std::size_t getErrorPosition(const ErrorList* errList, std::size_t error) noexcept
-{
-  if (!errList) {
-    return 0;
+    if (mappingSize) {
+      ::munmap(data, mappingSize);
+    }
+
+    data = nullptr;
+    width = 0;
+    height = 0;
+    mappingSize = 0;
+
+    auto size = w * h * 4 * sizeof(float);
+
+    if (::ftruncate(fd, off_t(size)) != 0) {
+      return false;
+    }
+
+    // A mapping may not be empty.
+    if (!size) {
+      return true;
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+
+    data = static_cast<float*>(mapping);
+    width = w;
+    height = h;
+    mappingSize = size;
+
+    return true;
+
+#else
+    (void)w;
+    (void)h;
+    errno = ENOSYS;
+    return false;
+#endif
   }
+protected:
+  /// Releases the file mapping, if there is one.
+  void unmap() noexcept
+  {
+#ifdef LIBPX_HAVE_MMAP
+    if (mappingSize) {
+      ::munmap(data, mappingSize);
+    }
 
-  if (error >= errList->errors.size()) {
-    return 0;
+    if (fd != -1) {
+      ::close(fd);
+    }
+#endif
   }
+};
 
-  return errList->errors[error].index;
+Image* createImage(std::size_t width, std::size_t height)
+{
+  auto image = std::make_unique<Image>();
+
+  resizeImage(image.get(), width, height);
+
+  return image.release();
 }
 
-std::size_t getErrorSize(const ErrorList* errList, std::size_t error) noexcept
+Image* createImageMapped(const char* path, std::size_t width, std::size_t height, PixelFormat format) noexcept
 {
-  if (!errList) {
-    return 0;
+  if (format != PixelFormat::RGBA32F) {
+    errno = EINVAL;
+    return nullptr;
   }
 
-  if (error >= errList->errors.size()) {
-    return 0;
+#ifdef LIBPX_HAVE_MMAP
+
+  std::unique_ptr<Image> image;
+
+  try {
+    image.reset(new Image());
+  } catch (...) {
+    errno = ENOMEM;
+    return nullptr;
   }
 
-  return errList->errors[error].size;
-}
+  image->fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
 
-const char* getErrorDescription(const ErrorList* errList, std::size_t error) noexcept
-{
-  if (!errList) {
-    return "";
+  if (image->fd == -1) {
+    return nullptr;
   }
 
-  if (error >= errList->errors.size()) {
-    return 0;
+  if (!image->resize(width, height)) {
+    return nullptr;
   }
 
-  return errList->errors[error].description.c_str();
+  return image.release();
+
+#else
+  (void)path;
+  (void)width;
+  (void)height;
+  errno = ENOSYS;
+  return nullptr;
+#endif
 }
 
-//========================//
-// Section: Serialization //
-//========================//
+void closeImage(Image* image) noexcept
+{
+  delete image;
+}
 
-namespace {
+const float* getColorBuffer(const Image* image) noexcept
+{
+  return image->data;
+}
 
-/// This value indicates the resolution
-/// at which floating point colors are
-/// converting to integer values for encoding
-/// and decoding.
-constexpr std::size_t colorRes() noexcept
+float* getColorBuffer(Image* image) noexcept
 {
-  return 32768;
+  return image->data;
 }
 
-/// Prints an nth dimensional vector.
-///
-/// @tparam T The type used in the vector components.
-/// @tparam dims The number of dimensions in the vector.
-///
-/// @param v The vector to print.
-template <typename T, std::size_t dims>
-std::ostream& operator << (std::ostream& stream, const Vector<T, dims>& v)
+bool getColor(const Image* image, std::size_t x, std::size_t y, float* rgba) noexcept
 {
-  for (std::size_t i = 0; i < dims; i++) {
+  if ((x >= image->width)
+   || (y >= image->height)) {
+    return false;
+  }
 
-    stream << v[i];
+  const auto* src = &image->data[((y * image->width) + x) * 4];
 
-    if ((i + 1) < dims) {
-      stream << ' ';
-    }
-  }
+  // TODO : Restore RGB before multiply
+  rgba[0] = src[0];
+  rgba[1] = src[1];
+  rgba[2] = src[2];
+  rgba[3] = src[3];
 
-  return stream;
+  return true;
 }
 
-/// Prints an array of vectors.
-/// The appear as a single list of numbers this way.
-///
-/// @tparam T The type used in the vector components.
-/// @tparam dims The number of dimensions in the vector.
-///
-/// @param v The vector array to print.
-template <typename T, std::size_t dims>
-std::ostream& operator << (std::ostream& stream, const std::vector<Vector<T, dims>>& v)
+std::size_t getImageWidth(const Image* image) noexcept { return image->width; }
+
+std::size_t getImageHeight(const Image* image) noexcept { return image->height; }
+
+void resizeImage(Image* image, std::size_t w, std::size_t h)
 {
-  for (std::size_t i = 0; i < v.size(); i++) {
+  // Only mapped images fail without throwing, and errno
+  // tells the caller why their file could not be resized.
 
-    stream << v[i];
+  if (!image->resize(w, h)) {
+    throw std::system_error(errno, std::generic_category(), "Failed to resize the image file");
+  }
+}
 
-    if ((i + 1) < v.size()) {
-      stream << ' ';
-    }
+namespace {
+
+/// Resizes an image for the render functions that report errors by
+/// returning false.
+///
+/// @return True on success, false on failure. On failure, errno is set
+/// to indicate the error, which is ENOMEM if memory could not be allocated.
+bool tryResizeImage(Image* image, std::size_t w, std::size_t h) noexcept
+{
+  try {
+    return image->resize(w, h);
+  } catch (...) {
+    errno = ENOMEM;
+    return false;
   }
+}
 
-  return stream;
+} // namespace
+
+//======================//
+// Section: Tiled Image //
+//======================//
+
+namespace {
+
+/// The number of bits that a pixel coordinate
+/// is shifted by to get the coordinate of its tile.
+constexpr std::size_t tileShift() noexcept
+{
+  return 6;
 }
 
-/// Used for encoding documents into files.
-class Encoder final : public NodeAccessor
+/// The width and height of each tile, in pixels.
+constexpr std::size_t tileSize() noexcept
 {
-  /// The stream being written to.
-  std::ostream& stream;
-  /// The indentation level for the output file.
-  std::size_t indentation = 0;
-public:
-  Encoder(std::ostream& stream_) : stream(stream_) {}
-  /// Encodes a single color channel.
-  ///
-  /// @param name The name to give the channel.
-  /// @param value The value to encode.
-  void encodeColorChannel(const char* name, float value)
-  {
-    encodeSize(name, std::size_t(clip(value) * colorRes()));
-  }
-  /// Encodes a color.
-  ///
-  /// @param name The name to give the color.
-  /// @param c The color to encode.
-  void encodeColor(const char* name, const RGBA& c)
-  {
-    indent() << name << ' ' << convertColor(c) << std::endl;
-  }
-  /// Encodes a size field.
-  ///
-  /// @param name The name to give the field.
-  /// @param value The value to print.
-  void encodeSize(const char* name, std::size_t value)
-  {
-    indent() << name << ' ' << value << std::endl;
-  }
-  /// Encodes a boolean value.
-  ///
-  /// @param name The name of the value to encode.
-  /// @parma value The value to encode.
-  void encodeBool(const char* name, bool value)
+  return std::size_t(1) << tileShift();
+}
+
+/// Used to get the coordinate of a pixel within its tile.
+constexpr std::size_t tileMask() noexcept
+{
+  return tileSize() - 1;
+}
+
+/// The number of floats in the color buffer of a tile.
+constexpr std::size_t tileFloatCount() noexcept
+{
+  return tileSize() * tileSize() * 4;
+}
+
+/// A type definition for a tile color buffer.
+using TilePtr = std::unique_ptr<float[]>;
+
+} // namespace
+
+/// An image that is divided into tiles, which are
+/// allocated the first time they are drawn on.
+struct TiledImage final
+{
+  /// The width of the image, in pixels.
+  std::size_t width = 0;
+  /// The height of the image, in pixels.
+  std::size_t height = 0;
+  /// The number of tile columns.
+  std::size_t tileCountX = 0;
+  /// The number of tile rows.
+  std::size_t tileCountY = 0;
+  /// The tiles of the image, in row-major order.
+  /// A null tile has not been drawn on and
+  /// reads from the background tile instead.
+  std::vector<TilePtr> tiles;
+  /// Tiles released by the last clear, which are
+  /// reused before any new tiles get allocated.
+  std::vector<TilePtr> freeTiles;
+  /// The tile shared by every tile that has not been drawn on.
+  TilePtr backgroundTile;
+  /// Set when a tile could not be allocated during a render.
+  bool outOfMemory = false;
+  /// Constructs the tiled image with the shared background tile.
+  TiledImage() : backgroundTile(new float[tileFloatCount()]())
   {
-    indent() << name << ' ' << (value ? "true" : "false") << std::endl;
   }
-  /// Encodes a string onto the document.
+  /// Assigns a color to every pixel in the image.
+  /// The tiles that were drawn on are kept for the
+  /// next render, but no longer read from.
   ///
-  /// @param name The name to give the string field.
-  /// @param value The string value to add.
-  void encodeString(const char* name, const char* value)
+  /// @param c The premultiplied color to assign.
+  void clear(const RGBA& c) noexcept
   {
-    indent() << name << " \"";
-
-    for (std::size_t i = 0; value[i] != 0; i++) {
+    for (std::size_t i = 0; i < tileFloatCount(); i += 4) {
+      backgroundTile[i + 0] = c[0];
+      backgroundTile[i + 1] = c[1];
+      backgroundTile[i + 2] = c[2];
+      backgroundTile[i + 3] = c[3];
+    }
 
-      if ((value[i] == '\"') || (value[i] == '\\')) {
-        stream << '\\';
+    // The free list has room for every tile, so this does not allocate.
+    for (auto& tile : tiles) {
+      if (tile) {
+        freeTiles.emplace_back(std::move(tile));
       }
-
-      stream << value[i];
     }
 
-    stream << "\"" << std::endl;
+    outOfMemory = false;
   }
-  /// Encodes a layer.
-  void encodeLayer(const Layer& layer)
+  /// Gets the color buffer of a tile, for reading.
+  ///
+  /// @note This function does not perform bounds checking.
+  inline const float* getTile(std::size_t tileX, std::size_t tileY) const noexcept
   {
-    auto encoder = [this, &layer]() {
-      encodeString("name", layer.name.c_str());
-      encodeColorChannel("opacity", layer.opacity);
-      encodeBool("visible", layer.visible);
-      for (const auto& node : layer.nodes) {
-        node->accept(*this);
-      }
-    };
+    const auto& tile = tiles[(tileY * tileCountX) + tileX];
 
-    encodeStruct("layer", encoder);
+    return tile ? tile.get() : backgroundTile.get();
   }
-protected:
-  /// Encodes a blend mode.
+  /// Gets the color buffer of a tile, for writing.
+  /// If the tile has not been drawn on yet, it is
+  /// allocated and initialized with the background.
   ///
-  /// @param name The name to give the blend mode.
-  /// Unless there's more than one blend mode, this
-  /// can just be called "blend_mode."
-  /// @param blendMode The blend mode value to encode.
-  void encodeBlendMode(const char* name, BlendMode blendMode) noexcept
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @return The color buffer of the tile, or a null
+  /// pointer if the tile could not be allocated.
+  inline float* getWritableTile(std::size_t tileX, std::size_t tileY) noexcept
   {
-    indent() << name << ' ';
+    auto& tile = tiles[(tileY * tileCountX) + tileX];
 
-    switch (blendMode) {
-      case BlendMode::Normal:
-        stream << "normal";
-        break;
-      case BlendMode::Subtract:
-        stream << "subtract";
-        break;
+    if (!tile) {
+      allocateTile(tile);
     }
 
-    stream << std::endl;
-  }
-  /// Converts a color into a 4 dimensional integer vector.
-  ///
-  /// This is required to keep the parsing simple.
-  static Vector<int, 4> convertColor(const RGBA& c) noexcept
-  {
-    return Vector<int, 4> {
-      int(c[0] * colorRes()),
-      int(c[1] * colorRes()),
-      int(c[2] * colorRes()),
-      int(c[3] * colorRes())
-    };
-  }
-  /// Prints indentation.
-  std::ostream& indent() {
-    for (std::size_t i = 0; i < indentation; i++) {
-      stream << "  ";
-    }
-    return stream;
+    return tile.get();
   }
-  /// Encodes a structure.
-  /// The inner structure is printed with a lambda.
-  /// The indentation is increased before the lambda
-  /// is called and restored after the lambda.
-  template <typename Functor>
-  void encodeStruct(const char* name, Functor func)
+  /// Changes the size of the image.
+  /// All of the tiles are released.
+  void resize(std::size_t w, std::size_t h)
   {
-    indent() << name << std::endl;
-
-    indentation++;
+    std::size_t countX = (w + tileMask()) >> tileShift();
+    std::size_t countY = (h + tileMask()) >> tileShift();
 
-    func();
+    freeTiles.clear();
+    freeTiles.shrink_to_fit();
 
-    indentation--;
+    tiles.clear();
+    tiles.resize(countX * countY);
 
-    indent() << "end" << std::endl;
-  }
-  /// Encodes a stroke node.
-  /// This is used by all derived of this class,
-  /// so it must be called explicitly.
-  void encodeStrokeNode(const StrokeNode& strokeNode)
-  {
-    indent() << "pixel_size " << strokeNode.pixelSize << std::endl;
-    indent() << "color " << convertColor(strokeNode.color) << std::endl;
-    encodeBlendMode("blend_mode", strokeNode.blendMode);
-  }
-  void access(const Ellipse& ellipse) noexcept override
-  {
-    auto encoder = [this, ellipse] () {
-      encodeStrokeNode(ellipse);
-      indent() << "center " << ellipse.center << std::endl;
-      indent() << "radius " << ellipse.radius << std::endl;
-    };
+    freeTiles.reserve(tiles.size());
 
-    encodeStruct("ellipse", encoder);
-  }
-  void access(const Fill& fill) noexcept override
-  {
-    auto encoder = [this, fill] () {
-      indent() << "origin " << fill.origin << std::endl;
-      indent() << "color " << convertColor(fill.color) << std::endl;
-      encodeBlendMode("blend_mode", fill.blendMode);
-    };
+    tileCountX = countX;
+    tileCountY = countY;
 
-    encodeStruct("fill", encoder);
+    width = w;
+    height = h;
   }
-  void access(const Line& line) noexcept override
+protected:
+  /// Allocates a tile and copies the background into it.
+  void allocateTile(TilePtr& tile) noexcept
   {
-    auto encoder = [this, line] () {
-      encodeStrokeNode(line);
-      indent() << "points " << line.points << " end" << std::endl;
-    };
+    if (!freeTiles.empty()) {
+      tile = std::move(freeTiles.back());
+      freeTiles.pop_back();
+    } else {
+      tile.reset(new (std::nothrow) float[tileFloatCount()]);
+    }
 
-    encodeStruct("line", encoder);
-  }
-  void access(const Quad& quad) noexcept override
-  {
-    auto encoder = [this, quad] () {
-      encodeStrokeNode(quad);
-      indent();
-      stream << "points ";
-      stream << quad.points[0] << ' ';
-      stream << quad.points[1] << ' ';
-      stream << quad.points[2] << ' ';
-      stream << quad.points[3] << std::endl;
-    };
+    if (!tile) {
+      outOfMemory = true;
+      return;
+    }
 
-    encodeStruct("quad", encoder);
+    std::memcpy(tile.get(), backgroundTile.get(), tileFloatCount() * sizeof(float));
   }
 };
 
-} // namespace
+std::size_t getTileSize() noexcept
+{
+  return tileSize();
+}
 
-//==========================//
-// Section: Deserialization //
-//==========================//
+TiledImage* createTiledImage(std::size_t width, std::size_t height)
+{
+  auto image = std::make_unique<TiledImage>();
 
-namespace {
+  image->resize(width, height);
 
-/// Enumerates the several recognized tokens.
-enum class TokenType
+  return image.release();
+}
+
+void closeTiledImage(TiledImage* image) noexcept
 {
-  /// A placeholder until initialized.
-  None,
-  /// A single line comment beginning with '#'
-  Comment,
-  /// A boolean 'false' value.
-  False,
+  delete image;
+}
+
+void resizeTiledImage(TiledImage* image, std::size_t width, std::size_t height)
+{
+  image->resize(width, height);
+}
+
+std::size_t getImageWidth(const TiledImage* image) noexcept { return image->width; }
+
+std::size_t getImageHeight(const TiledImage* image) noexcept { return image->height; }
+
+std::size_t getTileCountX(const TiledImage* image) noexcept { return image->tileCountX; }
+
+std::size_t getTileCountY(const TiledImage* image) noexcept { return image->tileCountY; }
+
+std::size_t getAllocatedTileCount(const TiledImage* image) noexcept
+{
+  std::size_t count = 0;
+
+  for (const auto& tile : image->tiles) {
+    count += tile ? 1 : 0;
+  }
+
+  return count;
+}
+
+const float* getTile(const TiledImage* image, std::size_t tileX, std::size_t tileY) noexcept
+{
+  if ((tileX >= image->tileCountX)
+   || (tileY >= image->tileCountY)) {
+    return nullptr;
+  }
+
+  return image->getTile(tileX, tileY);
+}
+
+bool isBackgroundTile(const TiledImage* image, std::size_t tileX, std::size_t tileY) noexcept
+{
+  return getTile(image, tileX, tileY) == image->backgroundTile.get();
+}
+
+bool getColor(const TiledImage* image, std::size_t x, std::size_t y, float* rgba) noexcept
+{
+  if ((x >= image->width)
+   || (y >= image->height)) {
+    return false;
+  }
+
+  const auto* tile = image->getTile(x >> tileShift(), y >> tileShift());
+
+  const auto* src = &tile[(((y & tileMask()) * tileSize()) + (x & tileMask())) * 4];
+
+  rgba[0] = src[0];
+  rgba[1] = src[1];
+  rgba[2] = src[2];
+  rgba[3] = src[3];
+
+  return true;
+}
+
+//=====================//
+// Section: Error List //
+//=====================//
+
+/// Contains information on a single error.
+struct Error final
+{
+  /// The stream used to format the error.
+  /// This isn't seen by the end user but it can
+  /// be used to make error reporting easier.
+  std::ostringstream stream;
+  /// A human-readable description of the error.
+  std::string description;
+  /// The line that the error can be found at.
+  std::size_t line = 0;
+  /// The column that the error can be found at.
+  std::size_t column = 0;
+  /// The index within the file that the error begins at.
+  std::size_t index = 0;
+  /// The number of characters that the error pertains to.
+  std::size_t size = 0;
+};
+
+/// Prints an error to a stream.
+///
+/// @param stream The stream to print to.
+/// @param err The error to print.
+///
+/// @return A reference to @p stream.
+std::ostream& operator << (std::ostream& stream, const Error& err)
+{
+  return stream << err.line << ':' << err.column << ": " << err.description.c_str();
+}
+
+struct ErrorList final
+{
+  /// The path to the file that was opened.
+  std::string filename;
+  /// The source code that the errors pertain to.
+  /// This is all the source code in the original file.
+  std::string source;
+  /// The list of errors that were found.
+  std::vector<Error> errors;
+};
+
+void closeErrorList(ErrorList* errList) noexcept
+{
+  delete errList;
+}
+
+void printErrorListToStderr(const ErrorList* errList) noexcept
+{
+  if (!errList) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < errList->errors.size(); i++) {
+    printErrorToStderr(errList, i);
+  }
+}
+
+void printErrorToStderr(const ErrorList* errList, std::size_t index) noexcept
+{
+  if (!errList) {
+    return;
+  }
+
+  if (index >= errList->errors.size()) {
+    return;
+  }
+
+  std::cerr << errList->filename << ':' << errList->errors[index] << std::endl;
+}
+
+const char* getErrorSource(const ErrorList* errList) noexcept
+{
+  if (!errList) {
+    return "";
+  }
+
+  return errList->source.c_str();
+}
+
+std::size_t getErrorSourceSize(const ErrorList* errList) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  return errList->source.size();
+}
+
+std::size_t getErrorCount(const ErrorList* errList) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  return errList->errors.size();
+}
+
+std::size_t getErrorColumn(const ErrorList* errList, std::size_t error) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  if (error >= errList->errors.size()) {
+    return 0;
+  }
+
+  return errList->errors[error].column;
+}
+
+std::size_t getErrorLine(const ErrorList* errList, std::size_t error) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  if (error >= errList->errors.size()) {
+    return 0;
+  }
+
+  return errList->errors[error].line;
+}
+
+std::size_t getErrorPosition(const ErrorList* errList, std::size_t error) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  if (error >= errList->errors.size()) {
+    return 0;
+  }
+
+  return errList->errors[error].index;
+}
+
+std::size_t getErrorSize(const ErrorList* errList, std::size_t error) noexcept
+{
+  if (!errList) {
+    return 0;
+  }
+
+  if (error >= errList->errors.size()) {
+    return 0;
+  }
+
+  return errList->errors[error].size;
+}
+
+const char* getErrorDescription(const ErrorList* errList, std::size_t error) noexcept
+{
+  if (!errList) {
+    return "";
+  }
+
+  if (error >= errList->errors.size()) {
+    return 0;
+  }
+
+  return errList->errors[error].description.c_str();
+}
+
+//========================//
+// Section: Serialization //
+//========================//
+
+namespace {
+
+/// This value indicates the resolution
+/// at which floating point colors are
+/// converting to integer values for encoding
+/// and decoding.
+constexpr std::size_t colorRes() noexcept
+{
+  return 32768;
+}
+
+/// The resolution at which scale factors are
+/// converted to integer values for encoding and
+/// decoding, since the file format has no decimals.
+constexpr int scaleRes() noexcept
+{
+  return 1000;
+}
+
+/// Prints an nth dimensional vector.
+///
+/// @tparam T The type used in the vector components.
+/// @tparam dims The number of dimensions in the vector.
+///
+/// @param v The vector to print.
+template <typename T, std::size_t dims>
+std::ostream& operator << (std::ostream& stream, const Vector<T, dims>& v)
+{
+  for (std::size_t i = 0; i < dims; i++) {
+
+    stream << v[i];
+
+    if ((i + 1) < dims) {
+      stream << ' ';
+    }
+  }
+
+  return stream;
+}
+
+/// Prints an array of vectors.
+/// The appear as a single list of numbers this way.
+///
+/// @tparam T The type used in the vector components.
+/// @tparam dims The number of dimensions in the vector.
+///
+/// @param v The vector array to print.
+template <typename T, std::size_t dims>
+std::ostream& operator << (std::ostream& stream, const std::vector<Vector<T, dims>>& v)
+{
+  for (std::size_t i = 0; i < v.size(); i++) {
+
+    stream << v[i];
+
+    if ((i + 1) < v.size()) {
+      stream << ' ';
+    }
+  }
+
+  return stream;
+}
+
+/// Used for encoding documents into files.
+class Encoder final : public NodeAccessor
+{
+  /// The stream being written to.
+  std::ostream& stream;
+  /// The indentation level for the output file.
+  std::size_t indentation = 0;
+public:
+  Encoder(std::ostream& stream_) : stream(stream_) {}
+  /// Encodes a single color channel.
+  ///
+  /// @param name The name to give the channel.
+  /// @param value The value to encode.
+  void encodeColorChannel(const char* name, float value)
+  {
+    encodeSize(name, std::size_t(clip(value) * colorRes()));
+  }
+  /// Encodes a color.
+  ///
+  /// @param name The name to give the color.
+  /// @param c The color to encode.
+  void encodeColor(const char* name, const RGBA& c)
+  {
+    indent() << name << ' ' << convertColor(c) << std::endl;
+  }
+  /// Encodes a size field.
+  ///
+  /// @param name The name to give the field.
+  /// @param value The value to print.
+  void encodeSize(const char* name, std::size_t value)
+  {
+    indent() << name << ' ' << value << std::endl;
+  }
+  /// Encodes a boolean value.
+  ///
+  /// @param name The name of the value to encode.
+  /// @parma value The value to encode.
+  void encodeBool(const char* name, bool value)
+  {
+    indent() << name << ' ' << (value ? "true" : "false") << std::endl;
+  }
+  /// Encodes a string onto the document.
+  ///
+  /// @param name The name to give the string field.
+  /// @param value The string value to add.
+  void encodeString(const char* name, const char* value)
+  {
+    indent() << name << " \"";
+
+    for (std::size_t i = 0; value[i] != 0; i++) {
+
+      if ((value[i] == '\"') || (value[i] == '\\')) {
+        stream << '\\';
+      }
+
+      stream << value[i];
+    }
+
+    stream << "\"" << std::endl;
+  }
+  /// Encodes a layer.
+  void encodeLayer(const Layer& layer)
+  {
+    auto encoder = [this, &layer]() {
+      encodeString("name", layer.name.c_str());
+      encodeColorChannel("opacity", layer.opacity);
+      encodeBool("visible", layer.visible);
+      encodeAnimation(layer.animation);
+      for (const auto& node : layer.nodes) {
+        node->accept(*this);
+      }
+    };
+
+    encodeStruct("layer", encoder);
+  }
+  /// Encodes a symbol.
+  void encodeSymbol(const Symbol& symbol)
+  {
+    auto encoder = [this, &symbol]() {
+      encodeString("name", symbol.layer.name.c_str());
+      for (const auto& node : symbol.layer.nodes) {
+        node->accept(*this);
+      }
+    };
+
+    encodeStruct("symbol", encoder);
+  }
+protected:
+  /// Encodes the keyframes of a layer or node, if there are any.
+  void encodeAnimation(const AnimationPtr& animationPtr)
+  {
+    if (!animationPtr.animated()) {
+      return;
+    }
+
+    const auto& animation = *animationPtr;
+
+    auto encoder = [this, &animation]() {
+
+      indent() << "pivot " << animation.pivot << std::endl;
+
+      for (const auto& keyframe : animation.keyframes) {
+        encodeStruct("keyframe", [this, &keyframe]() {
+          encodeSize("frame", keyframe.frame);
+          encodeEasing("easing", keyframe.easing);
+          indent() << "translation " << keyframe.translation << std::endl;
+          indent() << "scale "
+                   << roundToInt(keyframe.scale[0] * scaleRes()) << ' '
+                   << roundToInt(keyframe.scale[1] * scaleRes()) << std::endl;
+          if (!keyframe.pointOffsets.empty()) {
+            indent() << "offsets " << keyframe.pointOffsets << " end" << std::endl;
+          }
+        });
+      }
+    };
+
+    encodeStruct("animation", encoder);
+  }
+  /// Encodes an easing curve.
+  void encodeEasing(const char* name, Easing easing)
+  {
+    indent() << name << ' ';
+
+    switch (easing) {
+      case Easing::Linear:
+        stream << "linear";
+        break;
+      case Easing::Step:
+        stream << "step";
+        break;
+      case Easing::EaseIn:
+        stream << "ease_in";
+        break;
+      case Easing::EaseOut:
+        stream << "ease_out";
+        break;
+      case Easing::EaseInOut:
+        stream << "ease_in_out";
+        break;
+    }
+
+    stream << std::endl;
+  }
+  /// Encodes a blend mode.
+  ///
+  /// @param name The name to give the blend mode.
+  /// Unless there's more than one blend mode, this
+  /// can just be called "blend_mode."
+  /// @param blendMode The blend mode value to encode.
+  void encodeBlendMode(const char* name, BlendMode blendMode) noexcept
+  {
+    indent() << name << ' ';
+
+    switch (blendMode) {
+      case BlendMode::Normal:
+        stream << "normal";
+        break;
+      case BlendMode::Subtract:
+        stream << "subtract";
+        break;
+    }
+
+    stream << std::endl;
+  }
+  /// Converts a color into a 4 dimensional integer vector.
+  ///
+  /// This is required to keep the parsing simple.
+  static Vector<int, 4> convertColor(const RGBA& c) noexcept
+  {
+    return Vector<int, 4> {
+      int(c[0] * colorRes()),
+      int(c[1] * colorRes()),
+      int(c[2] * colorRes()),
+      int(c[3] * colorRes())
+    };
+  }
+  /// Prints indentation.
+  std::ostream& indent() {
+    for (std::size_t i = 0; i < indentation; i++) {
+      stream << "  ";
+    }
+    return stream;
+  }
+  /// Encodes a structure.
+  /// The inner structure is printed with a lambda.
+  /// The indentation is increased before the lambda
+  /// is called and restored after the lambda.
+  template <typename Functor>
+  void encodeStruct(const char* name, Functor func)
+  {
+    indent() << name << std::endl;
+
+    indentation++;
+
+    func();
+
+    indentation--;
+
+    indent() << "end" << std::endl;
+  }
+  /// Encodes a stroke node.
+  /// This is used by all derived of this class,
+  /// so it must be called explicitly.
+  void encodeStrokeNode(const StrokeNode& strokeNode)
+  {
+    indent() << "pixel_size " << strokeNode.pixelSize << std::endl;
+    indent() << "color " << convertColor(strokeNode.color) << std::endl;
+    encodeColorIndex(strokeNode.colorIndex);
+    encodeBlendMode("blend_mode", strokeNode.blendMode);
+  }
+  /// Encodes the palette index of a node's color,
+  /// if the node takes its color from the palette.
+  void encodeColorIndex(int colorIndex)
+  {
+    if (colorIndex >= 0) {
+      indent() << "color_index " << colorIndex << std::endl;
+    }
+  }
+  void access(const Ellipse& ellipse) noexcept override
+  {
+    auto encoder = [this, &ellipse] () {
+      encodeStrokeNode(ellipse);
+      indent() << "center " << ellipse.center << std::endl;
+      indent() << "radius " << ellipse.radius << std::endl;
+      encodeFilled(ellipse.filled);
+      encodeAnimation(ellipse.animation);
+    };
+
+    encodeStruct("ellipse", encoder);
+  }
+  void access(const Fill& fill) noexcept override
+  {
+    auto encoder = [this, &fill] () {
+      indent() << "origin " << fill.origin << std::endl;
+      indent() << "color " << convertColor(fill.color) << std::endl;
+      encodeColorIndex(fill.colorIndex);
+      encodeBlendMode("blend_mode", fill.blendMode);
+      encodeAnimation(fill.animation);
+    };
+
+    encodeStruct("fill", encoder);
+  }
+  void access(const Line& line) noexcept override
+  {
+    auto encoder = [this, &line] () {
+      encodeStrokeNode(line);
+      indent() << "points " << line.points << " end" << std::endl;
+      encodeAnimation(line.animation);
+    };
+
+    encodeStruct("line", encoder);
+  }
+  void access(const Quad& quad) noexcept override
+  {
+    auto encoder = [this, &quad] () {
+      encodeStrokeNode(quad);
+      indent();
+      stream << "points ";
+      stream << quad.points[0] << ' ';
+      stream << quad.points[1] << ' ';
+      stream << quad.points[2] << ' ';
+      stream << quad.points[3] << std::endl;
+      encodeFilled(quad.filled);
+      encodeAnimation(quad.animation);
+    };
+
+    encodeStruct("quad", encoder);
+  }
+  void access(const Bitmap& bitmap) noexcept override
+  {
+    auto encoder = [this, &bitmap] () {
+      indent() << "position " << bitmap.position << std::endl;
+      encodeBlendMode("blend_mode", bitmap.blendMode);
+      if (bitmap.data) {
+        encodeBitmapData(*bitmap.data);
+      }
+      encodeAnimation(bitmap.animation);
+    };
+
+    encodeStruct("bitmap", encoder);
+  }
+  void access(const Instance& instance) noexcept override
+  {
+    auto encoder = [this, &instance] () {
+      encodeSize("symbol", instance.symbol);
+      indent() << "position " << instance.position << std::endl;
+      encodeBlendMode("blend_mode", instance.blendMode);
+      encodeAnimation(instance.animation);
+    };
+
+    encodeStruct("instance", encoder);
+  }
+  void access(const Polygon& polygon) noexcept override
+  {
+    auto encoder = [this, &polygon] () {
+      encodeStrokeNode(polygon);
+      indent() << "points " << polygon.points << " end" << std::endl;
+      encodeAnimation(polygon.animation);
+    };
+
+    encodeStruct("polygon", encoder);
+  }
+  /// Encodes whether a shape is filled. Outlines are the
+  /// default, so they're written the way they were before
+  /// shapes could be filled.
+  void encodeFilled(bool filled)
+  {
+    if (filled) {
+      encodeBool("filled", true);
+    }
+  }
+  /// Encodes the pixels of a bitmap.
+  ///
+  /// The runs are written as if the rows were one long row,
+  /// so runs of the same color at the end of one row and the
+  /// start of the next one, such as empty rows, are written once.
+  /// Runs that are too long to be read back as an int are split.
+  void encodeBitmapData(const BitmapData& data)
+  {
+    indent() << "size " << data.width << ' ' << data.height << std::endl;
+
+    indent() << "colors";
+
+    for (const auto& c : data.colors) {
+      stream << ' ' << convertColor(c);
+    }
+
+    stream << " end" << std::endl;
+
+    indent() << "runs";
+
+    for (std::size_t i = 0; i < data.runs.size(); ) {
+
+      auto color = data.runs[i].color;
+
+      std::size_t length = 0;
+
+      while ((i < data.runs.size()) && (data.runs[i].color == color)) {
+        length += data.runs[i].length;
+        i++;
+      }
+
+      constexpr std::size_t maxLength = std::numeric_limits<int>::max();
+
+      for (; length > maxLength; length -= maxLength) {
+        stream << ' ' << maxLength << ' ' << color;
+      }
+
+      stream << ' ' << length << ' ' << color;
+    }
+
+    stream << " end" << std::endl;
+  }
+
+};
+
+} // namespace
+
+//==========================//
+// Section: Deserialization //
+//==========================//
+
+namespace {
+
+/// Enumerates the several recognized tokens.
+enum class TokenType
+{
+  /// A placeholder until initialized.
+  None,
+  /// A single line comment beginning with '#'
+  Comment,
+  /// A boolean 'false' value.
+  False,
   /// A C-style identifier (a-zA-Z_)
   Identifier,
   /// An integer (with optional leading '-')
@@ -1253,1949 +3680,5862 @@ enum class TokenType
   Invalid
 };
 
-struct Token final
+struct Token final
+{
+  /// The data from the file.
+  const char* data = "";
+  /// The number of characters in the token.
+  std::size_t size = 0;
+  /// The position of the token in the original file.
+  std::size_t pos = 0;
+  /// The line that the token begins at.
+  std::size_t line = 0;
+  /// The column that the token begins at.
+  std::size_t column = 0;
+  /// The type of this token.
+  TokenType type = TokenType::None;
+  /// Indicates if the token is valid or not.
+  operator bool () const noexcept {
+    return type != TokenType::None;
+  }
+  /// Checks for equality with a certain string literal.
+  bool operator == (const char* id) noexcept
+  {
+    auto idSize = std::strlen(id);
+    if (idSize != size) {
+      return false;
+    }
+
+    return std::memcmp(id, data, size) == 0;
+  }
+  /// Checks for non-equality with a certain string literal.
+  bool operator != (const char* id) noexcept
+  {
+    return !(*this == id);
+  }
+  /// Checks for equality with another token type.
+  inline constexpr bool operator == (TokenType t) noexcept
+  {
+    return type == t;
+  }
+  /// Checks for non-equality with another token type.
+  inline constexpr bool operator != (TokenType t) noexcept
+  {
+    return type != t;
+  }
+};
+
+/// Prints the contents of a token into a stream.
+std::ostream& operator << (std::ostream& output, const Token& t)
+{
+  output << '"';
+  for (std::size_t i = 0; i < t.size; i++) {
+    output << t.data[i];
+  }
+  output << '"';
+  return output;
+}
+
+/// Scans a string for parse-able tokens.
+class Lexer final
+{
+  /// The string being parsed.
+  const char* data = "";
+  /// The size of the string.
+  std::size_t size = 0;
+  /// The current position of the lexer.
+  std::size_t pos = 0;
+  /// The current line the lexer is at.
+  std::size_t line = 1;
+  /// The current column the lexer is at.
+  std::size_t column = 1;
+public:
+  constexpr Lexer(const char* d, std::size_t s)
+    : data(d), size(s) {}
+  /// Scans the input for a token.
+  Token scan() noexcept
+  {
+    auto t = space();
+    if (t) {
+      return t;
+    }
+
+    t = booleanLiteral();
+    if (t) {
+      return t;
+    }
+
+    t = identifier();
+    if (t) {
+      return t;
+    }
+
+    t = number();
+    if (t) {
+      return t;
+    }
+
+    t = stringLiteral();
+    if (t) {
+      return t;
+    }
+
+    t = comment();
+    if (t) {
+      return t;
+    }
+
+    return fallbackToken();
+  }
+  /// Gets the current lexer position.
+  /// This value can be used to backtrack if necessary.
+  std::size_t getPosition() const noexcept { return pos; }
+  /// Indicates the total number of characters remaining.
+  inline constexpr std::size_t remaining() const noexcept
+  {
+    return (pos < size) ? (size - pos) : 0;
+  }
+  /// Assigns the position of the next scan operation.
+  void setPosition(std::size_t p) noexcept { pos = p; }
+protected:
+  /// Creates a token as a last resort for the caller.
+  /// If there is input, one character is used and is
+  /// considered to be "invalid." If there is no input,
+  /// then an empty token is returned.
+  Token fallbackToken() noexcept
+  {
+    if (remaining() > 0) {
+      return makeToken(TokenType::Invalid, 1);
+    } else {
+      return Token();
+    }
+  }
+  /// Parses for a boolean literal.
+  Token booleanLiteral() noexcept
+  {
+    if (isEqual(0, 't')
+     && isEqual(1, 'r')
+     && isEqual(2, 'u')
+     && isEqual(3, 'e')
+     && !isIdentifierChar(4)) {
+      return makeToken(TokenType::True, 4);
+    }
+
+    if (isEqual(0, 'f')
+     && isEqual(1, 'a')
+     && isEqual(2, 'l')
+     && isEqual(3, 's')
+     && isEqual(4, 'e')
+     && !isIdentifierChar(5)) {
+      return makeToken(TokenType::False, 5);
+    }
+
+    return Token();
+  }
+  /// Scans for a comment token.
+  Token comment() noexcept
+  {
+    std::size_t match = 0;
+
+    if (!isEqual(match, '#')) {
+      return Token();
+    } else {
+      match++;
+    }
+
+    while (inBounds(match) && !isEqual(match, '\n') && !isEqual(match, '\r')) {
+      match++;
+    }
+
+    return makeToken(TokenType::Comment, match);
+  }
+  /// Scans for an identifier token.
+  Token identifier() noexcept
+  {
+    std::size_t match = 0;
+
+    if (!isInRange(match, 'a', 'z')
+     && !isInRange(match, 'A', 'Z')
+     && !isEqual(match, '_')) {
+      return Token();
+    } else {
+      match++;
+    }
+
+    while (inBounds(match)) {
+      if (isIdentifierChar(match)) {
+        match++;
+      } else {
+        break;
+      }
+    }
+
+    if (match > 0) {
+      return makeToken(TokenType::Identifier, match);
+    } else {
+      return Token();
+    }
+  }
+  /// Scans for a number token.
+  Token number() noexcept
+  {
+    auto neg = false;
+
+    std::size_t match = 0;
+
+    if (isEqual(match, '-')) {
+      neg = true;
+      match++;
+    }
+
+    while (inBounds(match)) {
+      if (isInRange(match, '0', '9')) {
+        match++;
+      } else {
+        break;
+      }
+    }
+
+    if ((neg && (match > 1)) || (!neg && (match > 0))) {
+      return makeToken(TokenType::Integer, match);
+    } else {
+      return Token();
+    }
+  }
+  /// Scans for a space token.
+  Token space() noexcept
+  {
+    std::size_t match = 0;
+
+    while (inBounds(match)) {
+      if (isEqual(match, ' ')
+       || isEqual(match, '\t')
+       || isEqual(match, '\n')
+       || isEqual(match, '\r')) {
+        match++;
+      } else {
+        break;
+      }
+    }
+
+    if (match > 0) {
+      return makeToken(TokenType::Space, match);
+    } else {
+      return Token();
+    }
+  }
+  /// Scans for a double quoted string literal.
+  Token stringLiteral() noexcept
+  {
+    std::size_t match = 0;
+
+    if (!isEqual(match, '"')) {
+      return Token();
+    } else {
+      match++;
+    }
+
+    while (inBounds(match)) {
+
+      if (isEqual(match, '\\')) {
+        match++;
+      } else if (isEqual(match, '"')) {
+        break;
+      }
+
+      match++;
+    }
+
+    if (!isEqual(match, '"')) {
+      // We could either mark '"' as invalid by itself
+      // or everything up to this point. Marking everything
+      // up to this point reduces the amount of false errors
+      // to zero, so that's what we'll do.
+      return makeToken(TokenType::Invalid, match);
+    }
+
+    return makeToken(TokenType::StringLiteral, match + 1);
+  }
+  /// Creates a token of a certain type and size.
+  inline constexpr Token makeToken(TokenType type, std::size_t s) noexcept
+  {
+    Token token {
+      data + pos,
+      s,
+      pos,
+      line,
+      column,
+      type
+    };
+
+    next(s);
+
+    return token;
+  }
+  /// Checks if a character can be part of an identifier.
+  //
+  /// @note This does not take into account that a decimal digit
+  /// is not allowed in the first character of an identifier.
+  ///
+  /// @param offset The offset of the character to check.
+  ///
+  /// @return True if the character is an identifier character, false if it's not.
+  inline constexpr bool isIdentifierChar(std::size_t offset) const noexcept
+  {
+    auto c = look(offset);
+
+    return (((c >= 'a') && (c <= 'z'))
+         || ((c >= 'A') && (c <= 'Z'))
+         || ((c >= '0') && (c <= '9'))
+         || (c == '_'));
+  }
+  /// Indicates if a character is equal to another.
+  inline constexpr bool isEqual(std::size_t offset, char c) const noexcept
+  {
+    return look(offset) == c;
+  }
+  /// Indicates if a character is in a certain range.
+  inline constexpr bool isInRange(std::size_t offset, char begin, char end) const noexcept
+  {
+    char c = look(offset);
+    return (c >= begin) && (c <= end);
+  }
+  /// Indicates if an offset is out of bounds.
+  inline constexpr bool inBounds(std::size_t offset) const noexcept
+  {
+    return (pos + offset) < size;
+  }
+  /// Goes passed a certain number of characters.
+  inline constexpr void next(std::size_t count) noexcept
+  {
+    for (std::size_t i = 0; (i < count) && (pos < size); i++) {
+
+      auto c = data[pos];
+      if (c == '\n') {
+        line++;
+        column = 1;
+      } else if (c > 0) {
+        column++;
+      }
+
+      pos++;
+    }
+  }
+  /// Used for checking the contents of a character
+  /// a certain offset array from the current position.
+  inline constexpr char look(std::size_t offset = 0) const noexcept
+  {
+    return ((pos + offset) < size) ? data[pos + offset] : 0;
+  }
+};
+
+/// Used for storing optional results.
+/// Meant primarily for POD.
+template <typename T>
+struct Optional final
+{
+  T value = T();
+  bool valid = false;
+
+  constexpr Optional() {}
+  constexpr Optional(const T& v) : value(v), valid(true) {}
+};
+
+/// A recursive-decent parser for parsing
+/// document files. The parser fails immediately
+/// after finding the first error.
+class Parser final
+{
+  /// Suppressed error messages go here.
+  std::ostringstream suppressed;
+  /// The tokens found by the lexer.
+  std::vector<Token> tokens;
+  /// The position of the parser among the tokens.
+  std::size_t pos = 0;
+  /// Whether or not the parser has failed.
+  bool failedFlag = false;
+  /// The list of errors found by the parser.
+  ErrorList errorList;
+public:
+  /// Constructs a new parser instance.
+  /// This function will parse the string and
+  /// filter out any tokens that the parser
+  /// will not need.
+  ///
+  /// @param str The string to parse.
+  /// @param size The number of characters in @p str.
+  Parser(const char* str, std::size_t size)
+  {
+    TraceScope traceScope("lex", "bytes", double(size));
+
+    Lexer lexer(str, size);
+
+    while (lexer.remaining() && !failed()) {
+      auto t = lexer.scan();
+      if (t == TokenType::Invalid) {
+        formatError(t) << "Invalid token " << t;
+        break;
+      } else if (t == TokenType::None) {
+        break;
+      } else if ((t == TokenType::Space) || (t == TokenType::Comment)) {
+        continue;
+      } else {
+        tokens.emplace_back(t);
+      }
+    }
+  }
+  /// Indicates whether or not the parser failed.
+  inline constexpr bool failed() const noexcept { return failedFlag; }
+  /// Gets the error list found by the parser.
+  /// Future calls to this function will return
+  /// an empty error list.
+  ///
+  /// @param content The variable containing the origin source code.
+  /// This is assigned to the error list so that the context of the
+  /// error can be shown if needed.
+  ErrorList* getErrorList(const char* filename, std::string&& content)
+  {
+    // Resolve the stream contents to the descriptions.
+    for (auto& err : errorList.errors) {
+      err.description = err.stream.str();
+    }
+
+    errorList.filename = filename;
+    errorList.source = std::move(content);
+
+    return new ErrorList(std::move(errorList));
+  }
+  /// This can be called when nothing is available
+  /// to parse and there is still remaining tokens
+  /// in the parser. It emits an error message describing
+  /// the bad token and moves the parser past it.
+  void badToken()
+  {
+    auto tok = look();
+    formatError(tok) << "Invalid token " << tok;
+    next();
+  }
+  /// Attempts to parse a layer node.
+  ///
+  /// @return A pointer to a layer node, if one is found.
+  /// Otherwise, a null pointer is returned.
+  LayerPtr parseLayer()
+  {
+    auto firstTok = look();
+
+    if (!matchID("layer")) {
+      return LayerPtr();
+    }
+
+    LayerPtr layer(new Layer());
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto str = parseString("name");
+      if (str.valid) {
+        layer->name = str.value;
+        continue;
+      }
+
+      auto opacity = parseColorChannel("opacity");
+      if (opacity.valid) {
+        layer->opacity = opacity.value;
+        continue;
+      }
+
+      auto visibility = parseBool("visible");
+      if (visibility.valid) {
+        layer->visible = visibility.value;
+        continue;
+      }
+
+      if (parseAnimation(layer->animation)) {
+        continue;
+      }
+
+      auto node = parseNode();
+      if (node) {
+        layer->nodes.emplace_back(std::move(node));
+        continue;
+      }
+
+      if (failed()) {
+        return LayerPtr();
+      } else {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return LayerPtr();
+      }
+    }
+
+    return layer;
+  }
+  /// Parses for a node.
+  ///
+  /// @return On success, a pointer to a node.
+  /// On failure, a null pointer.
+  NodePtr parseNode()
+  {
+    auto node = parseLineNode();
+    if (node) {
+      return node;
+    }
+
+    node = parseEllipseNode();
+    if (node) {
+      return node;
+    }
+
+    node = parseQuadNode();
+    if (node) {
+      return node;
+    }
+
+    node = parseFillNode();
+    if (node) {
+      return node;
+    }
+
+    node = parseBitmapNode();
+    if (node) {
+      return node;
+    }
+
+    node = parseInstanceNode();
+    if (node) {
+      return node;
+    }
+
+    node = parsePolygonNode();
+    if (node) {
+      return node;
+    }
+
+    return NodePtr();
+  }
+  /// Attempts to parse a symbol.
+  ///
+  /// @return A pointer to a symbol, if one is found.
+  /// Otherwise, a null pointer is returned.
+  SymbolPtr parseSymbol()
+  {
+    auto firstTok = look();
+
+    if (!matchID("symbol")) {
+      return SymbolPtr();
+    }
+
+    SymbolPtr symbol(new Symbol());
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto str = parseString("name");
+      if (str.valid) {
+        symbol->layer.name = str.value;
+        continue;
+      }
+
+      auto node = parseNode();
+      if (node) {
+        symbol->layer.nodes.emplace_back(std::move(node));
+        continue;
+      }
+
+      if (failed()) {
+        return SymbolPtr();
+      } else {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return SymbolPtr();
+      }
+    }
+
+    return symbol;
+  }
+  /// Attempts to make a boolean value.
+  ///
+  /// @param name The name of the value to parse.
+  ///
+  /// @return Optionally returns a boolean value.
+  Optional<bool> parseBool(const char* name)
+  {
+    if (!matchID(name)) {
+      return Optional<bool>();
+    }
+
+    auto tok = look();
+    if (tok == TokenType::True) {
+      next();
+      return Optional<bool>(true);
+    } else if (tok == TokenType::False) {
+      next();
+      return Optional<bool>(false);
+    } else {
+      formatError(tok) << "Expected a boolean value, but got " << tok;
+      return Optional<bool>();
+    }
+  }
+  /// Parses for a blend mode.
+  ///
+  /// @param name The name of the blend mode to parse.
+  ///
+  /// @return Optionally returns a blend mode.
+  Optional<BlendMode> parseBlendMode(const char* name)
+  {
+    if (!matchID(name)) {
+      return Optional<BlendMode>();
+    }
+
+    auto tok = look();
+    if (tok != TokenType::Identifier) {
+      formatError(tok) << "Expected a blend mode identifier, but got " << tok;
+      return Optional<BlendMode>();
+    }
+
+    if (tok == "normal") {
+      next();
+      return Optional<BlendMode>(BlendMode::Normal);
+    } else if (tok == "subtract") {
+      next();
+      return Optional<BlendMode>(BlendMode::Subtract);
+    } else {
+      formatError(tok) << tok << " is not a blend mode.";
+      return Optional<BlendMode>();
+    }
+  }
+  /// Parses for a color value.
+  ///
+  /// @param name The name of the color value to parse for.
+  ///
+  /// @return Optionally returns a color if the correct one was found.
+  Optional<RGBA> parseColor(const char* name) noexcept
+  {
+    auto nameTok = look();
+
+    if (!matchID(name)) {
+      return Optional<RGBA>();
+    }
+
+    auto v = parseVector<4>();
+    if (!v.valid) {
+      formatError(nameTok) << "Failed to match color values following " << nameTok;
+      return Optional<RGBA>();
+    }
+
+    return Optional<RGBA>(toColor(v.value));
+  }
+  /// Attempts to parse a string.
+  ///
+  /// @param name The name of the string to parse.
+  ///
+  /// @return Optionally returns a string.
+  Optional<std::string> parseString(const char* name) noexcept
+  {
+    if (!matchID(name)) {
+      return Optional<std::string>();
+    }
+
+    auto str = parseString();
+    if (!str.valid) {
+      return Optional<std::string>();
+    }
+
+    return str;
+  }
+  /// Attempts to parse a color channel.
+  ///
+  /// @param name The name of the color channel value.
+  ///
+  /// @return Optionally returns a color channel value.
+  Optional<float> parseColorChannel(const char* name) noexcept
+  {
+    auto nameTok = look();
+
+    if (!matchID(name)) {
+      return Optional<float>();
+    }
+
+    auto i = parseInt();
+    if (!i.valid) {
+      formatError(nameTok) << "Failed to match color channel value following " << nameTok;
+      return Optional<float>();
+    }
+
+    return Optional<float>(float(i.value) / colorRes());
+  }
+  /// Parses for a string literal.
+  Optional<std::string> parseString()
+  {
+    auto tok = look();
+    if (tok != TokenType::StringLiteral) {
+      formatError(tok) << "Expected a string literal, but got " << tok;
+      return Optional<std::string>();
+    }
+
+    std::string result;
+
+    for (std::size_t i = 1; (i + 1) < tok.size; i++) {
+
+      auto c = tok.data[i];
+
+      if (c == '\\') {
+        if ((i + 1) >= tok.size) {
+          parserError(tok, __LINE__);
+          return Optional<std::string>();
+        }
+        auto next = tok.data[i + 1];
+        if (next == 'r') {
+          result += '\r';
+        } else if (next == 'n') {
+          result += '\n';
+        } else if (next == '\\') {
+          result += '\\';
+        } else if (next == '"') {
+          result += '"';
+        } else {
+          formatError(tok) << "Invalid escape character found.";
+          return Optional<std::string>();
+        }
+        i++;
+      } else {
+        result += c;
+      }
+    }
+
+    next();
+
+    return Optional<std::string>(std::move(result));
+  }
+  /// Parses for an integer vector.
+  ///
+  /// @tparam dims The number of dimensions used in the vector.
+  ///
+  /// @return Optionally returns the integer.
+  template <std::size_t dims>
+  Optional<Vector<int, dims>> parseVector() noexcept
+  {
+    using Result = Optional<Vector<int, dims>>;
+
+    auto memo = pos;
+
+    Vector<int, dims> out;
+
+    for (std::size_t i = 0; i < dims; i++) {
+      auto component = parseInt();
+      if (!component.valid) {
+        pos = memo;
+        return Result();
+      } else {
+        out[i] = component.value;
+      }
+    }
+
+    return Result(out);
+  }
+  /// Parses a named vector.
+  ///
+  /// @param name The name of the vector to parse.
+  ///
+  /// @return Optionally returns the vector if it is matched.
+  template <std::size_t dims>
+  Optional<Vector<int, dims>> parseVector(const char* name) noexcept
+  {
+    using Result = Optional<Vector<int, dims>>;
+
+    auto nameTok = look();
+
+    if (!matchID(name)) {
+      return Result();
+    }
+
+    auto v = parseVector<dims>();
+    if (!v.valid) {
+      formatError(nameTok) << "Failed to match vector following " << nameTok;
+      return Result();
+    }
+
+    return v;
+  }
+  /// Parses for a single integer value.
+  ///
+  /// @parame name The name of the value.
+  Optional<int> parseInt(const char* name) noexcept
+  {
+    auto firstTok = look();
+
+    if (!matchID(name)) {
+      return Optional<int>();
+    }
+
+    auto i = parseInt();
+    if (!i.valid) {
+      formatError(firstTok) << "Failed to parse integer following " << firstTok;
+      return Optional<int>();
+    }
+
+    return i;
+  }
+  /// Parses for an integer value from
+  /// the next token.
+  Optional<int> parseInt() noexcept
+  {
+    auto numberToken = look();
+    if (numberToken != TokenType::Integer) {
+      return Optional<int>();
+    }
+
+    next();
+
+    return parseInt(numberToken);
+  }
+  /// Parses a size value.
+  ///
+  /// @param name The name of the size value to parse.
+  ///
+  /// @return Optionally returns the size.
+  Optional<std::size_t> parseSize(const char* name) noexcept
+  {
+    auto tmp = parseInt(name);
+    if (!tmp.valid) {
+      return Optional<std::size_t>();
+    } else if (tmp.value < 0) {
+      formatError(previousTok()) << "Expected '" << name << "' to be positive.";
+      return Optional<std::size_t>();
+    }
+
+    return Optional<std::size_t>(tmp.value);
+  }
+  /// Indicates the number of tokens remaining to be parsed.
+  inline std::size_t remaining() const noexcept
+  {
+    return (pos < tokens.size()) ? tokens.size() - pos : 0;
+  }
+protected:
+  /// Parses for common data found in stroke node derived classes.
+  /// This is meant to be called in a loop that parses the derived class.
+  ///
+  /// @param node A reference to the node that should be assigned the parsed data.
+  ///
+  /// @return True on a match, false on no match.
+  /// False does not indicate an error occurred.
+  bool parseStrokeNode(StrokeNode& node)
+  {
+    auto pixelSize = parseInt("pixel_size");
+    if (pixelSize.valid) {
+      node.pixelSize = safePixelSize(pixelSize.value);
+      return true;
+    }
+
+    auto blendMode = parseBlendMode("blend_mode");
+    if (blendMode.valid) {
+      node.blendMode = blendMode.value;
+      return true;
+    }
+
+    auto color = parseColor("color");
+    if (color.valid) {
+      node.color = color.value;
+      return true;
+    }
+
+    auto colorIndex = parseInt("color_index");
+    if (colorIndex.valid) {
+      node.colorIndex = colorIndex.value;
+      return true;
+    }
+
+    return false;
+  }
+  /// Parses for the keyframes of a layer or node.
+  /// This is meant to be called in a loop that parses the layer or node.
+  ///
+  /// @param animation The animation to add the keyframes to.
+  ///
+  /// @return True on a match, false on no match.
+  /// False does not indicate an error occurred.
+  bool parseAnimation(AnimationPtr& animation)
+  {
+    auto firstTok = look();
+
+    if (!matchID("animation")) {
+      return false;
+    }
+
+    auto& anim = animation.get();
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto pivot = parseVector<2>("pivot");
+      if (pivot.valid) {
+        anim.pivot = pivot.value;
+        continue;
+      }
+
+      if (parseKeyframe(anim)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+      }
+    }
+
+    if (!failed()) {
+      anim.sortKeyframes();
+    }
+
+    return true;
+  }
+  /// Parses for a single keyframe.
+  ///
+  /// @param animation The animation to add the keyframe to.
+  ///
+  /// @return True on a match, false on no match.
+  bool parseKeyframe(Animation& animation)
+  {
+    auto firstTok = look();
+
+    if (!matchID("keyframe")) {
+      return false;
+    }
+
+    Keyframe keyframe;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto frame = parseSize("frame");
+      if (frame.valid && (frame.value >= maxFrameCount())) {
+        formatError(previousTok()) << "Expected 'frame' to be less than " << maxFrameCount() << ".";
+        break;
+      } else if (frame.valid) {
+        keyframe.frame = frame.value;
+        continue;
+      }
+
+      auto easing = parseEasing("easing");
+      if (easing.valid) {
+        keyframe.easing = easing.value;
+        continue;
+      }
+
+      auto translation = parseVector<2>("translation");
+      if (translation.valid) {
+        keyframe.translation = translation.value;
+        continue;
+      }
+
+      auto scale = parseVector<2>("scale");
+      if (scale.valid) {
+        keyframe.scale = Vec2f {
+          float(scale.value[0]) / scaleRes(),
+          float(scale.value[1]) / scaleRes()
+        };
+        continue;
+      }
+
+      if (parseVertices("offsets", keyframe.pointOffsets)) {
+        if (keyframe.pointOffsets.size() > maxPointOffsets) {
+          formatError(previousTok()) << "Expected at most " << maxPointOffsets << " offsets.";
+          break;
+        }
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+      }
+    }
+
+    if (!failed()) {
+      animation.keyframes.emplace_back(std::move(keyframe));
+    }
+
+    return true;
+  }
+  /// Parses for an easing curve.
+  ///
+  /// @param name The name of the easing curve to parse.
+  ///
+  /// @return Optionally returns an easing curve.
+  Optional<Easing> parseEasing(const char* name)
+  {
+    if (!matchID(name)) {
+      return Optional<Easing>();
+    }
+
+    auto tok = look();
+    if (tok != TokenType::Identifier) {
+      formatError(tok) << "Expected an easing identifier, but got " << tok;
+      return Optional<Easing>();
+    }
+
+    Easing easing = Easing::Linear;
+
+    if (tok == "linear") {
+      easing = Easing::Linear;
+    } else if (tok == "step") {
+      easing = Easing::Step;
+    } else if (tok == "ease_in") {
+      easing = Easing::EaseIn;
+    } else if (tok == "ease_out") {
+      easing = Easing::EaseOut;
+    } else if (tok == "ease_in_out") {
+      easing = Easing::EaseInOut;
+    } else {
+      formatError(tok) << tok << " is not an easing curve.";
+      return Optional<Easing>();
+    }
+
+    next();
+
+    return Optional<Easing>(easing);
+  }
+  /// Parses a list of vertices.
+  ///
+  /// @param name The name of the vertices.
+  /// @param vertices The array to put the vertices into.
+  ///
+  /// @return True on success, false on failure.
+  bool parseVertices(const char* name, std::vector<Vec2>& vertices)
+  {
+    if (!matchID(name)) {
+      return false;
+    }
+
+    while (remaining() && !failed()) {
+
+      if (matchID("end")) {
+        break;
+      }
+
+      auto v = parseVector<2>();
+      if (!v.valid) {
+        formatError(look()) << "Failed to parse vector";
+        return false;
+      } else {
+        vertices.emplace_back(v.value);
+      }
+    }
+
+    return true;
+  }
+  /// Parses for a set list of vertices.
+  bool parseVertices(const char* name, Vec2* vertices, std::size_t count) noexcept
+  {
+    auto firstTok = look();
+
+    if (!matchID(name)) {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+
+      auto v = parseVector<2>();
+      if (!v.valid) {
+        formatError(firstTok) << "Failed to match point " << i;
+        return false;
+      }
+
+      vertices[i] = v.value;
+    }
+
+    return true;
+  }
+  /// Attempts to parse a fill node.
+  NodePtr parseFillNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("fill")) {
+      return NodePtr();
+    }
+
+    Fill fill;
+
+    while (remaining() && !failed()) {
+
+      auto c = parseColor("color");
+      if (c.valid) {
+        fill.color = c.value;
+        continue;
+      }
+
+      auto colorIndex = parseInt("color_index");
+      if (colorIndex.valid) {
+        fill.colorIndex = colorIndex.value;
+        continue;
+      }
+
+      auto b = parseBlendMode("blend_mode");
+      if (b.valid) {
+        fill.blendMode = b.value;
+        continue;
+      }
+
+      auto v = parseVector<2>("origin");
+      if (v.valid) {
+        fill.origin = v.value;
+        continue;
+      }
+
+      if (parseAnimation(fill.animation)) {
+        continue;
+      }
+
+      if (matchID("end")) {
+        break;
+      } else if (failed()) {
+        return NodePtr();
+      } else {
+        formatError(firstTok) << "Missing 'end' statement";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Fill(std::move(fill)));
+    }
+  }
+  /// Attempts to parse an ellipse node.
+  NodePtr parseEllipseNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("ellipse")) {
+      return NodePtr();
+    }
+
+    Ellipse ellipse;
+
+    while (remaining() && !failed()) {
+
+      if (parseStrokeNode(ellipse)) {
+        continue;
+      }
+
+      auto v = parseVector<2>("center");
+      if (v.valid) {
+        ellipse.center = v.value;
+        continue;
+      }
+
+      v = parseVector<2>("radius");
+      if (v.valid) {
+        ellipse.radius = v.value;
+        continue;
+      }
+
+      auto filled = parseBool("filled");
+      if (filled.valid) {
+        ellipse.filled = filled.value;
+        continue;
+      }
+
+      if (parseAnimation(ellipse.animation)) {
+        continue;
+      }
+
+      if (matchID("end")) {
+        break;
+      } else if (failed()) {
+        break;
+      } else {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Ellipse(std::move(ellipse)));
+    }
+  }
+  /// Attempts to parse a line node.
+  NodePtr parseLineNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("line")) {
+      return NodePtr();
+    }
+
+    Line line;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      if (parseStrokeNode(line)) {
+        continue;
+      }
+
+      if (parseVertices("points", line.points)) {
+        continue;
+      }
+
+      if (parseAnimation(line.animation)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Line(std::move(line)));
+    }
+  }
+  /// Parses for a quadrilateral node.
+  NodePtr parseQuadNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("quad")) {
+      return NodePtr();
+    }
+
+    Quad quad;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      if (parseStrokeNode(quad)) {
+        continue;
+      }
+
+      if (parseVertices("points", quad.points, 4)) {
+        continue;
+      }
+
+      auto filled = parseBool("filled");
+      if (filled.valid) {
+        quad.filled = filled.value;
+        continue;
+      }
+
+      if (parseAnimation(quad.animation)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Quad(std::move(quad)));
+    }
+  }
+  /// Parses for a bitmap node.
+  NodePtr parseBitmapNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("bitmap")) {
+      return NodePtr();
+    }
+
+    Bitmap bitmap;
+
+    auto sizeTok = firstTok;
+
+    Optional<Vec2> size;
+
+    std::vector<RGBA> colors;
+
+    std::vector<Vec2> runs;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto blendMode = parseBlendMode("blend_mode");
+      if (blendMode.valid) {
+        bitmap.blendMode = blendMode.value;
+        continue;
+      }
+
+      auto position = parseVector<2>("position");
+      if (position.valid) {
+        bitmap.position = position.value;
+        continue;
+      }
+
+      sizeTok = look();
+
+      auto bitmapSize = parseVector<2>("size");
+      if (bitmapSize.valid) {
+        size = bitmapSize;
+        continue;
+      }
+
+      if (parseColors("colors", colors)) {
+        continue;
+      }
+
+      if (parseVertices("runs", runs)) {
+        continue;
+      }
+
+      if (parseAnimation(bitmap.animation)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    }
+
+    if (size.valid) {
+
+      if ((size.value[0] < 0) || (size.value[1] < 0)) {
+        formatError(sizeTok) << "Expected the size of the bitmap to be positive.";
+        return NodePtr();
+      } else if ((std::size_t(size.value[0]) > maxBitmapSize) || (std::size_t(size.value[1]) > maxBitmapSize)) {
+        formatError(sizeTok) << "Expected the size of the bitmap to be at most " << maxBitmapSize << '.';
+        return NodePtr();
+      }
+
+      BitmapBuilder builder(std::size_t(size.value[0]), std::size_t(size.value[1]));
+
+      for (const auto& run : runs) {
+
+        if ((run[1] < 0) || (std::size_t(run[1]) >= colors.size())) {
+          formatError(firstTok) << "Bitmap run refers to color " << run[1] << ", but there are " << colors.size() << " colors.";
+          return NodePtr();
+        }
+
+        if ((run[0] < 0) || !builder.add(colors[std::size_t(run[1])], std::size_t(run[0]))) {
+          formatError(firstTok) << "Bitmap runs do not fit within its size.";
+          return NodePtr();
+        }
+      }
+
+      if (!builder.complete()) {
+        formatError(firstTok) << "Bitmap runs do not cover every pixel.";
+        return NodePtr();
+      }
+
+      bitmap.data = builder.finish();
+    }
+
+    return NodePtr(new Bitmap(std::move(bitmap)));
+  }
+  /// Parses for an instance node.
+  NodePtr parseInstanceNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("instance")) {
+      return NodePtr();
+    }
+
+    Instance instance;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      auto symbol = parseSize("symbol");
+      if (symbol.valid) {
+        instance.symbol = symbol.value;
+        continue;
+      }
+
+      auto position = parseVector<2>("position");
+      if (position.valid) {
+        instance.position = position.value;
+        continue;
+      }
+
+      auto blendMode = parseBlendMode("blend_mode");
+      if (blendMode.valid) {
+        instance.blendMode = blendMode.value;
+        continue;
+      }
+
+      if (parseAnimation(instance.animation)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Instance(std::move(instance)));
+    }
+  }
+  /// Parses for a polygon node.
+  NodePtr parsePolygonNode()
+  {
+    auto firstTok = look();
+
+    if (!matchID("polygon")) {
+      return NodePtr();
+    }
+
+    Polygon polygon;
+
+    while (remaining() && !failed() && !matchID("end")) {
+
+      if (parseStrokeNode(polygon)) {
+        continue;
+      }
+
+      if (parseVertices("points", polygon.points)) {
+        continue;
+      }
+
+      if (parseAnimation(polygon.animation)) {
+        continue;
+      }
+
+      if (!failed()) {
+        formatError(firstTok) << "Missing 'end' statement.";
+        return NodePtr();
+      }
+    }
+
+    if (failed()) {
+      return NodePtr();
+    } else {
+      return NodePtr(new Polygon(std::move(polygon)));
+    }
+  }
+  /// Parses a list of colors.
+  ///
+  /// @param name The name of the color list.
+  /// @param colors The array to put the colors into.
+  ///
+  /// @return True on success, false on failure.
+  bool parseColors(const char* name, std::vector<RGBA>& colors)
+  {
+    if (!matchID(name)) {
+      return false;
+    }
+
+    while (remaining() && !failed()) {
+
+      if (matchID("end")) {
+        break;
+      }
+
+      auto v = parseVector<4>();
+      if (!v.valid) {
+        formatError(look()) << "Failed to parse color";
+        return false;
+      } else {
+        colors.emplace_back(clip(toColor(v.value)));
+      }
+    }
+
+    return true;
+  }
+  /// Converts an integer vector to a color value.
+  RGBA toColor(const Vector<int, 4>& v)
+  {
+    return RGBA {
+      float(v[0]) / colorRes(),
+      float(v[1]) / colorRes(),
+      float(v[2]) / colorRes(),
+      float(v[3]) / colorRes()
+    };
+  }
+  /// Attempts to match a name.
+  /// If a name is matched, then the
+  /// parser is moved passed its position.
+  ///
+  /// @param name The name to match.
+  ///
+  /// @return True if the name was found,
+  /// false if it was not.
+  bool matchID(const char* name) noexcept
+  {
+    auto nameToken = look();
+    if (nameToken != TokenType::Identifier) {
+      return false;
+    }
+
+    if (nameToken != name) {
+      return false;
+    }
+
+    next();
+
+    return true;
+  }
+  /// Parses a decimal integer from a string.
+  ///
+  /// @param tok The token containing the string to parse.
+  ///
+  /// @return On success, a valid integer instance is returned.
+  /// On failure, an optional container that evaluates to zero.
+  Optional<int> parseInt(const Token& tok) noexcept
+  {
+    const char* str = tok.data;
+    std::size_t s = tok.size;
+
+    if (!s) {
+      return Optional<int>();
+    }
+
+    std::size_t pos = 0;
+
+    bool neg = (str[0] == '-');
+    if (neg) {
+      pos++;
+    }
+
+    int value = 0;
+
+    auto isDec = [](char c) { return (c >= '0') && (c <= '9'); };
+
+    while (pos < s) {
+
+      if (!isDec(str[pos])) {
+        formatError(tok) << "Non-decimal character found in " << tok;
+        break;
+      }
+
+      value *= 10;
+      value += int(str[pos] - '0');
+
+      pos++;
+    }
+
+    return neg ? -value : value;
+  }
+  /// Gets a previous token that the parser
+  /// has moved passed.
+  Token previousTok(std::size_t offset = 1) const noexcept
+  {
+    if (offset > pos) {
+      return Token();
+    }
+
+    return tokens[pos - offset];
+  }
+  /// Goes to the next number of tokens.
+  ///
+  /// @param count The number of tokens to go passed.
+  void next(std::size_t count = 1) noexcept
+  {
+    pos += count;
+  }
+  /// Gets a token at a certain offset.
+  Token look(std::size_t offset = 0) const noexcept
+  {
+    if (inBounds(offset)) {
+      return tokens[pos + offset];
+    } else {
+      return Token();
+    }
+  }
+  /// Indicates if a certain offset is in bounds.
+  inline bool inBounds(std::size_t offset) const noexcept
+  {
+    return (pos + offset) < tokens.size();
+  }
+  /// Emits an error indicating that an internal parser
+  /// error has occurred.
+  void parserError(const Token& t, int line)
+  {
+    auto& stream = formatError(t);
+    stream << "Internal parser error occurred (";
+    stream << __FILE__;
+    stream << ':';
+    stream << line;
+    stream << "). Please report an issue!";
+  }
+  /// Creates an error and returns it for formatting.
+  ///
+  /// @param t The token that caused the error.
+  /// The position information is used to indicate
+  /// where the error occurred.
+  ///
+  /// @return A reference to the stream that can be
+  /// used to format the error.
+  std::ostream& formatError(const Token& t)
+  {
+    if (failedFlag) {
+      return suppressed;
+    }
+
+    failedFlag = true;
+
+    Error error {
+      std::ostringstream(),
+      std::string(),
+      t.line,
+      t.column,
+      t.pos,
+      t.size
+    };
+
+    errorList.errors.emplace_back(std::move(error));
+
+    return errorList.errors[errorList.errors.size() - 1].stream;
+  }
+};
+
+} // namespace
+
+//===================//
+// Section: Document //
+//===================//
+
+/// Contains the implementation data of the document class.
+struct Document final
+{
+  /// The layers of the document, each containing the
+  /// draw operations to be completed by the painer.
+  /// The first layer is returned first and is therefore
+  /// the "bottom" layer.
+  std::vector<LayerPtr> layers;
+  /// The width of the document, in pixels.
+  std::size_t width = 64;
+  /// The height of the document, in pixels.
+  std::size_t height = 64;
+  /// The default background color.
+  RGBA background = transparent();
+  /// The number of frames in the document.
+  std::size_t frameCount = 1;
+  /// The number of frames played per second.
+  std::size_t frameRate = 12;
+  /// The colors that nodes may refer to by index.
+  Palette palette;
+  /// The symbols that instances refer to by index.
+  std::vector<SymbolPtr> symbols;
+  /// Makes a new document.
+  Document()
+  {
+    addLayer(this);
+  }
+  /// Makes a copy of the document.
+  ///
+  /// @param other The document to copy.
+  Document(const Document& other)
+  {
+    width = other.width;
+    height = other.height;
+    background = other.background;
+    frameCount = other.frameCount;
+    frameRate = other.frameRate;
+    palette = other.palette;
+
+    for (const auto& otherLayer : other.layers) {
+      layers.emplace_back(new Layer(*otherLayer));
+    }
+
+    for (const auto& otherSymbol : other.symbols) {
+      symbols.emplace_back(new Symbol(*otherSymbol));
+    }
+  }
+  /// Resets back to initial state.
+  void reset()
+  {
+    *this = Document();
+  }
+  /// Moves a document to a new variable
+  /// via move semantics.
+  Document& operator = (Document&& other)
+  {
+    layers = std::move(other.layers);
+    width = other.width;
+    height = other.height;
+    background = other.background;
+    frameCount = other.frameCount;
+    frameRate = other.frameRate;
+    palette = std::move(other.palette);
+    symbols = std::move(other.symbols);
+    return *this;
+  }
+};
+
+namespace {
+
+/// Indicates if a layer name exists already.
+/// This is used when automatically naming layers,
+/// so that the automatically generated layer has a
+/// unique name (even though it doesn't need one.)
+///
+/// @param doc The document to check the layer names for.
+/// @param name The name to search for.
+///
+/// @return True if the name exists, false if it does not.
+bool layerNameExists(const Document* doc, const char* name) noexcept
+{
+  for (const auto& l : doc->layers) {
+    if (l->name == name) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Formats a layer name.
+///
+/// @param index The index to put into the layer name.
+///
+/// @return The formatted layer name.
+std::string formatLayerName(std::size_t index)
+{
+  std::stringstream stream;
+  stream << "Layer ";
+  stream << index;
+  return stream.str();
+}
+
+/// Generates a unique layer name.
+///
+/// @param doc The document to generate the layer name for.
+///
+/// @return The unique layer name.
+std::string uniqueLayerName(const Document* doc)
+{
+  for (std::size_t i = doc->layers.size() + 1; i < SIZE_MAX; i++) {
+
+    auto name = formatLayerName(i);
+    if (!layerNameExists(doc, name.c_str())) {
+      return name;
+    }
+  }
+
+  // It would be odd if this was reached.
+
+  return "";
+}
+
+} // namespace
+
+Document* createDoc()
+{
+  return new Document();
+}
+
+void closeDoc(Document* doc) noexcept
+{
+  delete doc;
+}
+
+Document* copyDoc(const Document* doc)
+{
+  TraceScope traceScope("copyDoc");
+
+  return new Document(*doc);
+}
+
+namespace {
+
+/// Parses the contents of a document file.
+///
+/// @param doc The document to assign the contents to.
+/// It must already be reset and without layers.
+/// @param filename The name given to the contents in error messages.
+/// @param content The contents of the file.
+/// @param errListPtr An optional pointer to assign the error list to.
+///
+/// @return Zero on success, EINVAL if there's a syntax error.
+int parseDoc(Document* doc, const char* filename, std::string&& content, ErrorList** errListPtr)
+{
+  Parser parser(content.data(), content.size());
+
+  TraceScope parseScope("parse", "tokens", double(parser.remaining()));
+
+  while (parser.remaining() && !parser.failed()) {
+
+    auto w = parser.parseSize("width");
+    if (w.valid) {
+      doc->width = w.value;
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto h = parser.parseSize("height");
+    if (h.valid) {
+      doc->height = h.value;
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto bg = parser.parseColor("background");
+    if (bg.valid) {
+      doc->background = bg.value;
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto paletteColor = parser.parseColor("palette_color");
+    if (paletteColor.valid) {
+      if (doc->palette.size() < maxPaletteSize()) {
+        doc->palette.emplace_back(paletteColor.value);
+      }
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto frameCount = parser.parseSize("frame_count");
+    if (frameCount.valid) {
+      setFrameCount(doc, frameCount.value);
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto frameRate = parser.parseSize("frame_rate");
+    if (frameRate.valid) {
+      setFrameRate(doc, frameRate.value);
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto node = parser.parseNode();
+    if (node) {
+      if (doc->layers.empty()) {
+        addLayer(doc);
+      }
+      doc->layers[0]->nodes.emplace_back(std::move(node));
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto layer = parser.parseLayer();
+    if (layer) {
+      doc->layers.emplace_back(std::move(layer));
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    auto symbol = parser.parseSymbol();
+    if (symbol) {
+      doc->symbols.emplace_back(std::move(symbol));
+      continue;
+    } else if (parser.failed()) {
+      break;
+    }
+
+    parser.badToken();
+    break;
+  }
+
+  if (parser.failed()) {
+
+    if (errListPtr) {
+      *errListPtr = parser.getErrorList(filename, std::move(content));
+    }
+
+    return EINVAL;
+  }
+
+  return 0;
+}
+
+} // namespace
+
+int openDoc(Document* doc, const char* filename, ErrorList** errListPtr)
+{
+  TraceScope traceScope("openDoc");
+
+  if (errListPtr) {
+    *errListPtr = nullptr;
+  }
+
+  *doc = Document();
+
+  doc->layers.clear();
+
+  if (!filename) {
+    return EFAULT;
+  }
+
+  errno = 0;
+
+  std::string content;
+
+  {
+    TraceScope readScope("read");
+
+    std::ifstream file(filename);
+    if (!file.good()) {
+      return errno;
+    }
+
+    std::stringstream buf;
+
+    buf << file.rdbuf();
+
+    content = buf.str();
+  }
+
+  return parseDoc(doc, filename, std::move(content), errListPtr);
+}
+
+int openDoc(Document* doc, const void* data, std::size_t size, ErrorList** errListPtr)
+{
+  TraceScope traceScope("openDoc", "bytes", double(size));
+
+  if (errListPtr) {
+    *errListPtr = nullptr;
+  }
+
+  *doc = Document();
+
+  doc->layers.clear();
+
+  if (!data && size) {
+    return EFAULT;
+  }
+
+  std::string content(static_cast<const char*>(data), size);
+
+  return parseDoc(doc, "", std::move(content), errListPtr);
+}
+
+namespace {
+
+/// Encodes the document onto a stream.
+///
+/// @param doc The document to encode.
+/// @param stream The stream to encode the document to.
+void encodeDoc(const Document* doc, std::ostream& stream)
+{
+  TraceScope traceScope("encode");
+
+  Encoder encoder(stream);
+
+  encoder.encodeSize("width", doc->width);
+  encoder.encodeSize("height", doc->height);
+  encoder.encodeColor("background", doc->background);
+
+  for (const auto& color : doc->palette) {
+    encoder.encodeColor("palette_color", color);
+  }
+
+  // Documents that aren't animated are written as they were before frames.
+
+  if (doc->frameCount != 1) {
+    encoder.encodeSize("frame_count", doc->frameCount);
+  }
+
+  if (doc->frameRate != 12) {
+    encoder.encodeSize("frame_rate", doc->frameRate);
+  }
+
+  // Symbols are written first, so that they're
+  // defined before the instances that refer to them.
+
+  for (const auto& symbol : doc->symbols) {
+    encoder.encodeSymbol(*symbol);
+  }
+
+  for (const auto& layer : doc->layers) {
+    encoder.encodeLayer(*layer);
+  }
+}
+
+} // namespace
+
+bool saveDoc(const Document* doc, const char* filename)
+{
+  TraceScope traceScope("saveDoc");
+
+  std::ofstream file(filename);
+  if (!file.good()) {
+    return false;
+  }
+
+  encodeDoc(doc, file);
+
+  return true;
+}
+
+void saveDoc(const Document* doc, void** data, std::size_t* size)
+{
+  TraceScope traceScope("saveDoc");
+
+  // Hardly the best approach but it's nice and simple.
+
+  std::ostringstream stream;
+
+  encodeDoc(doc, stream);
+
+  auto tmp = stream.str();
+
+  *data = std::malloc(tmp.size());
+  *size = tmp.size();
+
+  std::memcpy(*data, tmp.data(), tmp.size());
+}
+
+Layer* addLayer(Document* doc)
+{
+  LayerPtr layer(new Layer());
+
+  layer->name = uniqueLayerName(doc);
+
+  doc->layers.emplace_back(layer.get());
+
+  return layer.release();
+}
+
+void removeLayer(Document* doc, std::size_t layer)
+{
+  // std::vector::erase causes UB if the index
+  // is out of bounds, so we have to manually check
+  // and throw an exception if that's the case.
+
+  if (layer >= doc->layers.size()) {
+    throw std::out_of_range("Layer index is out of range");
+  }
+
+  doc->layers.erase(doc->layers.begin() + layer);
+}
+
+Layer* getLayer(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer).get();
+}
+
+const Layer* getLayer(const Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer).get();
+}
+
+std::size_t getLayerCount(const Document* doc) noexcept
+{
+  return doc->layers.size();
+}
+
+void moveLayer(Document* doc, std::size_t src, std::size_t dst)
+{
+  LayerPtr tmp = std::move(doc->layers.at(src));
+
+  for (std::size_t i = src; i < dst; i++) {
+    doc->layers.at(i) = std::move(doc->layers.at(i + 1));
+  }
+
+  for (std::size_t i = src; i > dst; i--) {
+    doc->layers.at(i) = std::move(doc->layers.at(i - 1));
+  }
+
+  doc->layers.at(dst) = std::move(tmp);
+}
+
+Ellipse* addEllipse(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Ellipse());
+}
+
+Fill* addFill(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Fill());
+}
+
+Line* addLine(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Line());
+}
+
+Quad* addQuad(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Quad());
+}
+
+Polygon* addPolygon(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Polygon());
+}
+
+Bitmap* addBitmap(Document* doc, std::size_t layer)
+{
+  return doc->layers.at(layer)->addNode(new Bitmap());
+}
+
+Instance* addInstance(Document* doc, std::size_t symbol, std::size_t layer)
+{
+  auto* instance = doc->layers.at(layer)->addNode(new Instance());
+
+  instance->symbol = symbol;
+
+  return instance;
+}
+
+Symbol* addSymbol(Document* doc)
+{
+  SymbolPtr symbol(new Symbol());
+
+  doc->symbols.emplace_back(std::move(symbol));
+
+  return doc->symbols.back().get();
+}
+
+std::size_t getSymbolCount(const Document* doc) noexcept
+{
+  return doc->symbols.size();
+}
+
+Symbol* getSymbol(Document* doc, std::size_t index)
+{
+  return doc->symbols.at(index).get();
+}
+
+const Symbol* getSymbol(const Document* doc, std::size_t index)
+{
+  return doc->symbols.at(index).get();
+}
+
+std::size_t getDocWidth(const Document* doc) noexcept { return doc->width; }
+
+std::size_t getDocHeight(const Document* doc) noexcept { return doc->height; }
+
+std::size_t getFrameCount(const Document* doc) noexcept { return doc->frameCount; }
+
+std::size_t getFrameRate(const Document* doc) noexcept { return doc->frameRate; }
+
+void setFrameCount(Document* doc, std::size_t frameCount) noexcept
+{
+  doc->frameCount = clip(frameCount, std::size_t(1), maxFrameCount());
+}
+
+void setFrameRate(Document* doc, std::size_t frameRate) noexcept
+{
+  doc->frameRate = max(frameRate, std::size_t(1));
+}
+
+std::size_t getPaletteSize(const Document* doc) noexcept
+{
+  return doc->palette.size();
+}
+
+bool resizePalette(Document* doc, std::size_t size)
+{
+  if (size > maxPaletteSize()) {
+    return false;
+  }
+
+  doc->palette.resize(size, black());
+
+  return true;
+}
+
+bool setPaletteColor(Document* doc, std::size_t index, float r, float g, float b, float a) noexcept
+{
+  if (index >= doc->palette.size()) {
+    return false;
+  }
+
+  doc->palette[index] = clip(RGBA { r, g, b, a });
+
+  return true;
+}
+
+bool getPaletteColor(const Document* doc, std::size_t index, float* rgba) noexcept
+{
+  if (index >= doc->palette.size()) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < 4; i++) {
+    rgba[i] = doc->palette[index][i];
+  }
+
+  return true;
+}
+
+void getBackground(const Document* doc, float* bg) noexcept
+{
+  bg[0] = doc->background[0];
+  bg[1] = doc->background[1];
+  bg[2] = doc->background[2];
+  bg[3] = doc->background[3];
+}
+
+void resizeDoc(Document* doc, std::size_t width, std::size_t height) noexcept
+{
+  doc->width = width;
+  doc->height = height;
+}
+
+void setBackground(Document* doc, float r, float g, float b, float a) noexcept
+{
+  doc->background = clip(RGBA { r, g, b, a });
+}
+
+//============================//
+// Section: Render Algorithms //
+//============================//
+
+/// This function is based on the algorithm
+/// described by John Kennedy on rasterizing
+/// an ellipse.
+///
+/// @param cx The center X component.
+/// @param cy The center Y component.
+/// @param xRadius The X radius
+/// @param yRadius The Y radius
+/// @param functor Receives the points to plot on the ellipse.
+template <typename Functor>
+void renderEllipse(int cx, int cy, int xRadius, int yRadius, Functor functor) noexcept
+{
+  if (!xRadius || !yRadius) {
+    return;
+  }
+
+  auto plot4 = [cx, cy, functor](int x, int y) {
+    functor(cx + x, cy + y);
+    functor(cx - x, cy + y);
+    functor(cx - x, cy - y);
+    functor(cx + x, cy - y);
+  };
+
+  int twoASquare = 2 * xRadius * xRadius;
+  int twoBSquare = 2 * yRadius * yRadius;
+
+  int x = xRadius;
+  int y = 0;
+
+  int xChange = yRadius * yRadius * (1 - (2 * xRadius));
+  int yChange = xRadius * xRadius;
+
+  int ellipseError = 0;
+
+  int stoppingX = twoBSquare * xRadius;
+  int stoppingY = 0;
+
+  while (stoppingX >= stoppingY) {
+
+    plot4(x, y);
+
+    y++;
+    stoppingY += twoASquare;
+    ellipseError += yChange;
+    yChange += twoASquare;
+
+    if (((2 * ellipseError) + xChange) > 0) {
+      x--;
+      stoppingX -= twoBSquare;
+      ellipseError += xChange;
+      xChange += twoBSquare;
+    }
+  }
+
+  x = 0;
+  y = yRadius;
+
+  xChange = yRadius * yRadius;
+  yChange = xRadius * xRadius * (1 - (2 * yRadius));
+
+  ellipseError = 0;
+
+  stoppingX = 0;
+  stoppingY = twoASquare * yRadius;
+
+  while (stoppingX <= stoppingY) {
+
+    plot4(x, y);
+
+    x++;
+    stoppingX += twoBSquare;
+    ellipseError += xChange;
+    xChange += twoBSquare;
+    if (((2 * ellipseError) + yChange) > 0) {
+      y--;
+      stoppingY -= twoASquare;
+      ellipseError += yChange;
+      yChange += twoASquare;
+    }
+  }
+
+  // 1st point set done
+}
+
+/// Rasterizes a line between two points,
+/// with Bresenham's line algorithm.
+///
+/// @param a The point that the line starts at.
+/// @param b The point that the line ends at.
+/// @param functor Receives the points to plot on the line.
+template <typename Functor>
+void renderLine(const Vec2& a, const Vec2& b, Functor functor) noexcept
+{
+  auto diff = absolute(a - b);
+
+  diff[1] = -diff[1];
+
+  int signX = (a[0] < b[0]) ? 1 : -1;
+  int signY = (a[1] < b[1]) ? 1 : -1;
+
+  int err = diff[0] + diff[1];
+
+  auto p = a;
+
+  for (;;) {
+
+    functor(p[0], p[1]);
+
+    if (p == b) {
+      break;
+    }
+
+    int err2 = 2 * err;
+
+    if (err2 >= diff[1]) {
+      err += diff[1];
+      p[0] += signX;
+    }
+
+    if (err2 <= diff[0]) {
+      err += diff[0];
+      p[1] += signY;
+    }
+  }
+}
+
+namespace {
+
+/// A horizontal run of pixels on one row.
+struct Span final
+{
+  /// The row of the span.
+  int y = 0;
+  /// The first pixel of the span.
+  int x0 = 0;
+  /// The pixel after the last one in the span.
+  int x1 = 0;
+};
+
+/// Converts filled shapes into spans of pixels, so that they
+/// can be drawn one span per row instead of flood filled.
+///
+/// The spans of a shape are sorted by row and merged, so that
+/// every pixel is in exactly one span and is only blended once.
+/// A shape is clipped to a box as it's converted, so the number
+/// of spans depends on the rows that are drawn on, rather than
+/// on the size of the shape.
+class SpanRasterizer final
+{
+  /// An edge of a polygon that crosses at least one row.
+  struct Edge final
+  {
+    /// The first row that the edge crosses.
+    int y0 = 0;
+    /// The row after the last one that the edge crosses.
+    int y1 = 0;
+    /// The X coordinate of the edge at @ref Edge::y0.
+    int x0 = 0;
+    /// The change in X from @ref Edge::y0 to @ref Edge::y1.
+    int dx = 0;
+  };
+  /// The edges of the polygon being converted, sorted by their first row.
+  std::vector<Edge> edges;
+  /// The edges that cross the current row.
+  std::vector<Edge> activeEdges;
+  /// Where the active edges cross the current row.
+  std::vector<double> crossings;
+  /// The spans of the shapes converted since the last call to @ref clear.
+  std::vector<Span> spans;
+  /// The spans after being widened by the pixel size.
+  std::vector<Span> widened;
+public:
+  /// Removes the spans of the previous shapes.
+  void clear() noexcept
+  {
+    spans.clear();
+  }
+  /// Converts a polygon into spans.
+  ///
+  /// The inside of the polygon is found with the even-odd rule, by
+  /// the crossings of its edges on each row. Edges include their
+  /// upper point but not their lower one, so that a vertex shared by
+  /// two edges is only crossed once. The outline is added along with
+  /// the inside, so that the polygon covers the same pixels as the
+  /// line through its points, including its horizontal edges.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param points The points of the polygon.
+  /// @param count The number of points in the polygon.
+  /// @param clipBox The pixels that spans may cover.
+  void addPolygon(const Vec2* points, std::size_t count, const Box& clipBox)
+  {
+    if (!count || clipBox.empty()) {
+      return;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+      renderLine(points[i], points[(i + 1) % count], [this, &clipBox](int x, int y) {
+        addSpan(y, x, x + 1, clipBox);
+      });
+    }
+
+    edges.clear();
+
+    for (std::size_t i = 0; i < count; i++) {
+
+      auto a = points[i];
+      auto b = points[(i + 1) % count];
+
+      if (a[1] == b[1]) {
+        continue;
+      } else if (a[1] > b[1]) {
+        std::swap(a, b);
+      }
+
+      Edge edge;
+      edge.y0 = a[1];
+      edge.y1 = b[1];
+      edge.x0 = a[0];
+      edge.dx = b[0] - a[0];
+      edges.emplace_back(edge);
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+      return a.y0 < b.y0;
+    });
+
+    if (edges.empty()) {
+      return;
+    }
+
+    activeEdges.clear();
+
+    std::size_t nextEdge = 0;
+
+    int yBegin = max(edges[0].y0, clipBox.min[1]);
+
+    for (int y = yBegin; y <= clipBox.max[1]; y++) {
+
+      while ((nextEdge < edges.size()) && (edges[nextEdge].y0 <= y)) {
+        activeEdges.emplace_back(edges[nextEdge++]);
+      }
+
+      activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(), [y](const Edge& edge) {
+        return edge.y1 <= y;
+      }), activeEdges.end());
+
+      if (activeEdges.empty()) {
+        if (nextEdge >= edges.size()) {
+          break;
+        }
+        continue;
+      }
+
+      crossings.clear();
+
+      for (const auto& edge : activeEdges) {
+        auto dy = double(edge.y1 - edge.y0);
+        crossings.emplace_back(edge.x0 + ((double(y - edge.y0) * edge.dx) / dy));
+      }
+
+      std::sort(crossings.begin(), crossings.end());
+
+      // Pixels whose centers are between a pair
+      // of crossings are inside of the polygon.
+
+      for (std::size_t i = 1; i < crossings.size(); i += 2) {
+
+        auto x0 = std::ceil(crossings[i - 1]);
+        auto x1 = std::floor(crossings[i]) + 1;
+
+        auto xMin = double(clipBox.min[0]);
+        auto xMax = double(clipBox.max[0]) + 1;
+
+        if ((x0 < x1) && (x0 < xMax) && (x1 > xMin)) {
+          addSpan(y, int(max(x0, xMin)), int(min(x1, xMax)), clipBox);
+        }
+      }
+    }
+  }
+  /// Converts a filled ellipse into spans. Each row of the
+  /// ellipse spans from the left of its outline to the right.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param clipBox The pixels that spans may cover.
+  void addEllipse(int cx, int cy, int xRadius, int yRadius, const Box& clipBox)
+  {
+    if ((xRadius <= 0) || (yRadius <= 0) || clipBox.empty()) {
+      return;
+    }
+
+    auto first = spans.size();
+
+    renderEllipse(cx, cy, xRadius, yRadius, [this, &clipBox](int x, int y) {
+      if ((y >= clipBox.min[1]) && (y <= clipBox.max[1])) {
+        spans.emplace_back(Span { y, x, x + 1 });
+      }
+    });
+
+    // The outline skips a row where its two halves meet, when the
+    // ellipse is narrow, so the pixels whose centers are inside of the
+    // ellipse are added as well. These are always within the outline.
+
+    auto a2 = std::int64_t(xRadius) * xRadius;
+    auto b2 = std::int64_t(yRadius) * yRadius;
+
+    int yBegin = max(cy - yRadius, clipBox.min[1]);
+    int yEnd = min(cy + yRadius, clipBox.max[1]);
+
+    for (int y = yBegin; y <= yEnd; y++) {
+
+      auto dy = std::int64_t(y - cy);
+
+      auto limit = (a2 * b2) - (dy * dy * a2);
+
+      auto dx = std::int64_t(std::sqrt(double(limit) / double(b2)));
+
+      while ((dx > 0) && ((dx * dx * b2) > limit)) {
+        dx--;
+      }
+
+      while (((dx + 1) * (dx + 1) * b2) <= limit) {
+        dx++;
+      }
+
+      spans.emplace_back(Span { y, int(cx - dx), int(cx + dx + 1) });
+    }
+
+    sort(first);
+
+    // Each row has a few points of the outline, of which only
+    // the outermost two bound the inside of the row.
+
+    auto last = first;
+
+    for (auto i = first; i < spans.size(); i++) {
+      if ((last > first) && (spans[last - 1].y == spans[i].y)) {
+        spans[last - 1].x1 = max(spans[last - 1].x1, spans[i].x1);
+      } else {
+        spans[last++] = spans[i];
+      }
+    }
+
+    spans.resize(last);
+
+    last = first;
+
+    for (auto i = first; i < spans.size(); i++) {
+
+      auto span = spans[i];
+
+      span.x0 = max(span.x0, clipBox.min[0]);
+      span.x1 = min(span.x1, clipBox.max[0] + 1);
+
+      if (span.x0 < span.x1) {
+        spans[last++] = span;
+      }
+    }
+
+    spans.resize(last);
+  }
+  /// Sorts and merges the spans of the shapes, and widens them to
+  /// the pixel size. Each pixel that was converted is widened into a
+  /// square to its upper left, like the points of a stroke are.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  ///
+  /// @param pixelSize The size of the squares that pixels are widened to.
+  ///
+  /// @return The spans, which don't overlap and are sorted by row.
+  const std::vector<Span>& finish(int pixelSize)
+  {
+    sort(0);
+
+    merge(spans);
+
+    if (pixelSize <= 1) {
+      return spans;
+    }
+
+    widened.clear();
+
+    for (const auto& span : spans) {
+      for (int i = 0; i < pixelSize; i++) {
+        widened.emplace_back(Span { span.y - i, span.x0 - (pixelSize - 1), span.x1 });
+      }
+    }
+
+    std::sort(widened.begin(), widened.end(), [](const Span& a, const Span& b) {
+      return (a.y != b.y) ? (a.y < b.y) : (a.x0 < b.x0);
+    });
+
+    merge(widened);
+
+    return widened;
+  }
+  /// Gets the number of bytes of scratch memory held by the rasterizer.
+  std::size_t getScratchMemorySize() const noexcept
+  {
+    return ((edges.capacity() + activeEdges.capacity()) * sizeof(Edge))
+         + (crossings.capacity() * sizeof(double))
+         + ((spans.capacity() + widened.capacity()) * sizeof(Span));
+  }
+protected:
+  /// Adds a span, if it's on a row within a box.
+  void addSpan(int y, int x0, int x1, const Box& clipBox)
+  {
+    if ((y >= clipBox.min[1]) && (y <= clipBox.max[1]) && (x0 <= clipBox.max[0]) && (x1 > clipBox.min[0])) {
+      spans.emplace_back(Span { y, max(x0, clipBox.min[0]), min(x1, clipBox.max[0] + 1) });
+    }
+  }
+  /// Sorts the spans from an index onward, by row and then by column.
+  void sort(std::size_t first) noexcept
+  {
+    std::sort(spans.begin() + first, spans.end(), [](const Span& a, const Span& b) {
+      return (a.y != b.y) ? (a.y < b.y) : (a.x0 < b.x0);
+    });
+  }
+  /// Merges sorted spans that overlap or touch on the same row.
+  static void merge(std::vector<Span>& sorted) noexcept
+  {
+    std::size_t last = 0;
+
+    for (std::size_t i = 0; i < sorted.size(); i++) {
+      if ((last > 0) && (sorted[last - 1].y == sorted[i].y) && (sorted[i].x0 <= sorted[last - 1].x1)) {
+        sorted[last - 1].x1 = max(sorted[last - 1].x1, sorted[i].x1);
+      } else {
+        sorted[last++] = sorted[i];
+      }
+    }
+
+    sorted.resize(last);
+  }
+};
+
+} // namespace
+
+//=========================//
+// Section: Render Context //
+//=========================//
+
+/// Contains the scratch memory used while rendering.
+/// None of the buffers are released between renders,
+/// so that once they are large enough for a document,
+/// rendering it again does not allocate any memory.
+struct RenderContext final
+{
+  /// The stack of seed points used by the flood fill.
+  std::vector<Vec2> fillStack;
+  /// Contains one bit per pixel, indicating whether or
+  /// not the current flood fill has visited the pixel.
+  std::vector<std::uint64_t> fillVisited;
+  /// Computes the geometry of animated nodes.
+  FrameEvaluator evaluator;
+  /// Converts filled shapes into spans.
+  SpanRasterizer rasterizer;
+  /// The pixels of a layer that is rendered on its own, before it's
+  /// mixed into the canvas. This only grows, so that it's allocated
+  /// once for the largest layer rather than once per layer.
+  std::vector<float> layerColors;
+  /// The bounds of the nodes of a layer that is mixed into the canvas,
+  /// when they weren't calculated before rendering.
+  std::vector<Box> layerNodeBounds;
+  /// Prepares the visited bitmap for a new flood fill.
+  ///
+  /// @param pixelCount The number of pixels in the color buffer.
+  void resetVisited(std::size_t pixelCount)
+  {
+    fillVisited.assign((pixelCount + 63) / 64, 0);
+  }
+  /// Indicates whether or not a pixel was visited by the current flood fill.
+  ///
+  /// @param index The index of the pixel within the color buffer.
+  inline bool isVisited(std::size_t index) const noexcept
+  {
+    return (fillVisited[index / 64] >> (index % 64)) & 1;
+  }
+  /// Marks a pixel as visited by the current flood fill.
+  ///
+  /// @param index The index of the pixel within the color buffer.
+  inline void markVisited(std::size_t index) noexcept
+  {
+    fillVisited[index / 64] |= std::uint64_t(1) << (index % 64);
+  }
+  /// Gets the number of bytes of scratch memory held by the context.
+  std::size_t getScratchMemorySize() const noexcept
+  {
+    return (fillStack.capacity() * sizeof(Vec2))
+         + (fillVisited.capacity() * sizeof(std::uint64_t))
+         + (layerColors.capacity() * sizeof(float))
+         + (layerNodeBounds.capacity() * sizeof(Box))
+         + evaluator.getScratchMemorySize()
+         + rasterizer.getScratchMemorySize();
+  }
+};
+
+RenderContext* createRenderContext()
+{
+  return new RenderContext();
+}
+
+void closeRenderContext(RenderContext* context) noexcept
+{
+  delete context;
+}
+
+std::size_t getScratchMemorySize(const RenderContext* context) noexcept
+{
+  return context->getScratchMemorySize();
+}
+
+//============================//
+// Section: Render Statistics //
+//============================//
+
+/// Contains the statistics collected while rendering a document.
+struct RenderStats final
+{
+  /// The time spent rendering the whole document, in seconds.
+  double renderTime = 0;
+  /// The time spent rendering each layer, in seconds.
+  std::vector<double> layerTimes;
+  /// The time spent rendering each type of node, in seconds.
+  double nodeTimes[nodeTypeCount()] {};
+  /// The number of nodes that were rendered.
+  std::size_t nodesVisited = 0;
+  /// The number of nodes that were skipped for being off the canvas.
+  std::size_t nodesCulled = 0;
+  /// The number of pixels that were blended.
+  std::size_t pixelsBlended = 0;
+  /// The number of spans blended by flood fills.
+  std::size_t fillSpans = 0;
+  /// The number of pixels examined by flood fills.
+  std::size_t fillPixelsVisited = 0;
+  /// The most scratch memory held by the render context, in bytes.
+  std::size_t peakScratchMemory = 0;
+  /// Resets the statistics for a new render.
+  ///
+  /// @param layerCount The number of layers in the document being rendered.
+  void reset(std::size_t layerCount)
+  {
+    *this = RenderStats();
+    layerTimes.resize(layerCount);
+  }
+};
+
+RenderStats* createRenderStats()
 {
-  /// The data from the file.
-  const char* data = "";
-  /// The number of characters in the token.
-  std::size_t size = 0;
-  /// The position of the token in the original file.
-  std::size_t pos = 0;
-  /// The line that the token begins at.
-  std::size_t line = 0;
-  /// The column that the token begins at.
-  std::size_t column = 0;
-  /// The type of this token.
-  TokenType type = TokenType::None;
-  /// Indicates if the token is valid or not.
-  operator bool () const noexcept {
-    return type != TokenType::None;
+  return new RenderStats();
+}
+
+void closeRenderStats(RenderStats* stats) noexcept
+{
+  delete stats;
+}
+
+double getRenderTime(const RenderStats* stats) noexcept
+{
+  return stats->renderTime;
+}
+
+std::size_t getLayerStatsCount(const RenderStats* stats) noexcept
+{
+  return stats->layerTimes.size();
+}
+
+double getLayerRenderTime(const RenderStats* stats, std::size_t layer) noexcept
+{
+  return (layer < stats->layerTimes.size()) ? stats->layerTimes[layer] : 0;
+}
+
+double getNodeRenderTime(const RenderStats* stats, NodeType nodeType) noexcept
+{
+  auto index = std::size_t(nodeType);
+
+  return (index < nodeTypeCount()) ? stats->nodeTimes[index] : 0;
+}
+
+std::size_t getNodesVisited(const RenderStats* stats) noexcept
+{
+  return stats->nodesVisited;
+}
+
+std::size_t getNodesCulled(const RenderStats* stats) noexcept
+{
+  return stats->nodesCulled;
+}
+
+std::size_t getPixelsBlended(const RenderStats* stats) noexcept
+{
+  return stats->pixelsBlended;
+}
+
+std::size_t getFillSpans(const RenderStats* stats) noexcept
+{
+  return stats->fillSpans;
+}
+
+std::size_t getFillPixelsVisited(const RenderStats* stats) noexcept
+{
+  return stats->fillPixelsVisited;
+}
+
+std::size_t getPeakScratchMemory(const RenderStats* stats) noexcept
+{
+  return stats->peakScratchMemory;
+}
+
+void printRenderStatsToStderr(const RenderStats* stats) noexcept
+{
+  if (!stats) {
+    return;
   }
-  /// Checks for equality with a certain string literal.
-  bool operator == (const char* id) noexcept
+
+  std::cerr << "render time: " << (stats->renderTime * 1000) << " ms" << std::endl;
+
+  for (std::size_t i = 0; i < stats->layerTimes.size(); i++) {
+    std::cerr << "layer " << i << " time: " << (stats->layerTimes[i] * 1000) << " ms" << std::endl;
+  }
+
+  for (std::size_t i = 0; i < nodeTypeCount(); i++) {
+    std::cerr << getNodeTypeName(NodeType(i)) << " time: " << (stats->nodeTimes[i] * 1000) << " ms" << std::endl;
+  }
+
+  std::cerr << "nodes visited: " << stats->nodesVisited << std::endl;
+  std::cerr << "nodes culled: " << stats->nodesCulled << std::endl;
+  std::cerr << "pixels blended: " << stats->pixelsBlended << std::endl;
+  std::cerr << "fill spans: " << stats->fillSpans << std::endl;
+  std::cerr << "fill pixels visited: " << stats->fillPixelsVisited << std::endl;
+  std::cerr << "peak scratch memory: " << stats->peakScratchMemory << " bytes" << std::endl;
+}
+
+namespace {
+
+/// Used by the painter when statistics are not being collected.
+/// All of the functions are empty, so that they compile away.
+class NullStats final
+{
+public:
+  /// An empty timer. The destructor is only declared so
+  /// that unused timer variables do not cause warnings.
+  struct Timer final { ~Timer() {} };
+  inline Timer timeLayer(std::size_t) noexcept { return Timer(); }
+  inline Timer timeNode(NodeType) noexcept { return Timer(); }
+  inline void countNodeVisited() noexcept {}
+  inline void countNodeCulled() noexcept {}
+  inline void countBlended(std::size_t) noexcept {}
+  inline void countFillSpan() noexcept {}
+  inline void countFillPixelVisited() noexcept {}
+};
+
+/// Used by the painter to collect statistics into @ref RenderStats.
+class ActiveStats final
+{
+  /// The statistics being collected.
+  RenderStats& stats;
+public:
+  /// Adds the time between its construction and
+  /// destruction to a certain statistic.
+  class Timer final
   {
-    auto idSize = std::strlen(id);
-    if (idSize != size) {
-      return false;
+    /// The statistic to add the time to.
+    /// This is null once the timer is moved.
+    double* total = nullptr;
+    /// The time that the timer started at.
+    std::chrono::steady_clock::time_point start;
+  public:
+    Timer(double& t) : total(&t), start(std::chrono::steady_clock::now()) {}
+    Timer(Timer&& other) noexcept : total(other.total), start(other.start)
+    {
+      other.total = nullptr;
+    }
+    ~Timer()
+    {
+      if (total) {
+        *total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
     }
+  };
+  ActiveStats(RenderStats& s) : stats(s) {}
+  /// Times the rendering of a layer.
+  inline Timer timeLayer(std::size_t index) noexcept { return Timer(stats.layerTimes[index]); }
+  /// Times the rendering of a node.
+  inline Timer timeNode(NodeType type) noexcept { return Timer(stats.nodeTimes[std::size_t(type)]); }
+  inline void countNodeVisited() noexcept { stats.nodesVisited++; }
+  inline void countNodeCulled() noexcept { stats.nodesCulled++; }
+  inline void countBlended(std::size_t pixels) noexcept { stats.pixelsBlended += pixels; }
+  inline void countFillSpan() noexcept { stats.fillSpans++; }
+  inline void countFillPixelVisited() noexcept { stats.fillPixelsVisited++; }
+};
 
-    return std::memcmp(id, data, size) == 0;
+} // namespace
+
+//==================//
+// Section: Painter //
+//==================//
+
+/// Mixes premultiplied colors toward other colors,
+/// which is how a layer is composited with its opacity.
+///
+/// @param dst The colors to mix.
+/// @param src The colors to mix toward.
+/// @param count The number of floats to mix.
+/// @param amount How far to mix toward @p src, from 0 to 1.
+inline void mix(float* dst, const float* src, std::size_t count, float amount) noexcept
+{
+  for (std::size_t i = 0; i < count; i++) {
+    dst[i] += (src[i] - dst[i]) * amount;
   }
-  /// Checks for non-equality with a certain string literal.
-  bool operator != (const char* id) noexcept
+}
+
+/// A render target that covers an RGBA color buffer,
+/// or a rectangle within a larger one.
+///
+/// Render targets are what the painter writes pixels to.
+/// The painter is instantiated once per target type, so that
+/// addressing the pixels gets inlined into the painter loops.
+class DenseTarget final
+{
+  /// The color buffer being rendered to.
+  float* colorBuffer = nullptr;
+  /// The width of the color buffer, in pixels.
+  std::size_t width = 0;
+  /// The height of the color buffer, in pixels.
+  std::size_t height = 0;
+  /// The number of pixels from the start of one row to the next.
+  std::size_t stride = 0;
+public:
+  /// Whether layers that aren't fully opaque are rendered on their own
+  /// and then mixed into the target, see @ref Painter::renderLayers.
+  static constexpr bool mixesLayers = true;
+  constexpr DenseTarget(float* c, std::size_t w, std::size_t h) noexcept
+    : colorBuffer(c), width(w), height(h), stride(w) {}
+  constexpr DenseTarget(float* c, std::size_t w, std::size_t h, std::size_t s) noexcept
+    : colorBuffer(c), width(w), height(h), stride(s) {}
+  /// Gets the width of the target, in pixels.
+  inline std::size_t getWidth() const noexcept { return width; }
+  /// Gets the height of the target, in pixels.
+  inline std::size_t getHeight() const noexcept { return height; }
+  /// Gets the first row that may be drawn on.
+  inline int getRowBegin() const noexcept { return 0; }
+  /// Gets the row after the last one that may be drawn on.
+  inline int getRowEnd() const noexcept { return int(height); }
+  /// Assigns a color to every pixel in the target.
+  ///
+  /// @param c The premultiplied color to assign.
+  void clear(const RGBA& c) noexcept
   {
-    return !(*this == id);
+    for (std::size_t y = 0; y < height; y++) {
+
+      float* row = colorBuffer + (y * stride * 4);
+
+      for (std::size_t i = 0; i < (width * 4); i += 4) {
+        row[i + 0] = c[0];
+        row[i + 1] = c[1];
+        row[i + 2] = c[2];
+        row[i + 3] = c[3];
+      }
+    }
   }
-  /// Checks for equality with another token type.
-  inline constexpr bool operator == (TokenType t) noexcept
+  /// Gets the color of a pixel.
+  ///
+  /// @note This function does not perform bounds checking.
+  inline RGBA getPixel(int x, int y) const noexcept
   {
-    return type == t;
+    const float* src = pixel(x, y);
+
+    return RGBA { src[0], src[1], src[2], src[3] };
   }
-  /// Checks for non-equality with another token type.
-  inline constexpr bool operator != (TokenType t) noexcept
+  /// Blends a horizontal span of pixels with a color.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param x0 The X coordinate of the first pixel in the span.
+  /// @param x1 The X coordinate that the span ends at (exclusive.)
+  /// @param y The Y coordinate of the span.
+  /// @param c The color to blend the span with.
+  template <typename Blender>
+  inline void blendSpan(int x0, int x1, int y, const Color& c) noexcept
   {
-    return type != t;
+    float* dst = pixel(x0, y);
+
+    for (int x = x0; x < x1; x++, dst += 4) {
+      Blender::apply(dst, c);
+    }
   }
-};
+  /// Copies a horizontal span of pixels.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @param dst The buffer to copy the premultiplied colors into.
+  inline void copySpan(int x0, int x1, int y, float* dst) const noexcept
+  {
+    const float* src = pixel(x0, y);
 
-/// Prints the contents of a token into a stream.
-std::ostream& operator << (std::ostream& output, const Token& t)
-{
-  output << '"';
-  for (std::size_t i = 0; i < t.size; i++) {
-    output << t.data[i];
+    std::copy(src, src + ((x1 - x0) * 4), dst);
   }
-  output << '"';
-  return output;
-}
+  /// Mixes a horizontal span of pixels toward other colors.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @param src The premultiplied colors to mix toward.
+  /// @param amount How far to mix toward @p src, from 0 to 1.
+  inline void mixSpan(int x0, int x1, int y, const float* src, float amount) noexcept
+  {
+    mix(pixel(x0, y), src, std::size_t(x1 - x0) * 4, amount);
+  }
+protected:
+  /// Gets the address of a pixel.
+  inline float* pixel(int x, int y) const noexcept
+  {
+    return colorBuffer + (((y * stride) + x) * 4);
+  }
+};
 
-/// Scans a string for parse-able tokens.
-class Lexer final
+/// A render target that covers a @ref TiledImage.
+///
+/// Tiles are allocated as spans are blended onto them,
+/// and reads from untouched tiles go to the background tile.
+class TiledTarget final
 {
-  /// The string being parsed.
-  const char* data = "";
-  /// The size of the string.
-  std::size_t size = 0;
-  /// The current position of the lexer.
-  std::size_t pos = 0;
-  /// The current line the lexer is at.
-  std::size_t line = 1;
-  /// The current column the lexer is at.
-  std::size_t column = 1;
+  /// The image being rendered to.
+  TiledImage* image = nullptr;
 public:
-  constexpr Lexer(const char* d, std::size_t s)
-    : data(d), size(s) {}
-  /// Scans the input for a token.
-  Token scan() noexcept
+  /// Whether layers that aren't fully opaque are rendered on their own
+  /// and then mixed into the target, see @ref Painter::renderLayers.
+  static constexpr bool mixesLayers = true;
+  constexpr TiledTarget(TiledImage* i) noexcept : image(i) {}
+  /// Gets the width of the target, in pixels.
+  inline std::size_t getWidth() const noexcept { return image->width; }
+  /// Gets the height of the target, in pixels.
+  inline std::size_t getHeight() const noexcept { return image->height; }
+  /// Gets the first row that may be drawn on.
+  inline int getRowBegin() const noexcept { return 0; }
+  /// Gets the row after the last one that may be drawn on.
+  inline int getRowEnd() const noexcept { return int(image->height); }
+  /// Assigns a color to every pixel in the target.
+  /// This releases every tile that was drawn on.
+  ///
+  /// @param c The premultiplied color to assign.
+  void clear(const RGBA& c) noexcept
   {
-    auto t = space();
-    if (t) {
-      return t;
+    image->clear(c);
+  }
+  /// Gets the color of a pixel.
+  ///
+  /// @note This function does not perform bounds checking.
+  inline RGBA getPixel(int x, int y) const noexcept
+  {
+    const float* tile = image->getTile(std::size_t(x) >> tileShift(), std::size_t(y) >> tileShift());
+
+    const float* src = tile + offset(x, y);
+
+    return RGBA { src[0], src[1], src[2], src[3] };
+  }
+  /// Blends a horizontal span of pixels with a color.
+  /// The span is split at tile boundaries.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param x0 The X coordinate of the first pixel in the span.
+  /// @param x1 The X coordinate that the span ends at (exclusive.)
+  /// @param y The Y coordinate of the span.
+  /// @param c The color to blend the span with.
+  template <typename Blender>
+  inline void blendSpan(int x0, int x1, int y, const Color& c) noexcept
+  {
+    auto tileY = std::size_t(y) >> tileShift();
+
+    while (x0 < x1) {
+
+      auto tileX = std::size_t(x0) >> tileShift();
+
+      int end = min(x1, int((tileX + 1) << tileShift()));
+
+      float* tile = image->getWritableTile(tileX, tileY);
+
+      if (tile) {
+
+        float* dst = tile + offset(x0, y);
+
+        for (int x = x0; x < end; x++, dst += 4) {
+          Blender::apply(dst, c);
+        }
+      }
+
+      x0 = end;
     }
+  }
+  /// Copies a horizontal span of pixels.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @param dst The buffer to copy the premultiplied colors into.
+  inline void copySpan(int x0, int x1, int y, float* dst) const noexcept
+  {
+    auto tileY = std::size_t(y) >> tileShift();
 
-    t = booleanLiteral();
-    if (t) {
-      return t;
+    while (x0 < x1) {
+
+      auto tileX = std::size_t(x0) >> tileShift();
+
+      int end = min(x1, int((tileX + 1) << tileShift()));
+
+      const float* src = image->getTile(tileX, tileY) + offset(x0, y);
+
+      dst = std::copy(src, src + ((end - x0) * 4), dst);
+
+      x0 = end;
     }
+  }
+  /// Mixes a horizontal span of pixels toward other colors. Tiles
+  /// are only allocated where the colors differ from the target.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @param src The premultiplied colors to mix toward.
+  /// @param amount How far to mix toward @p src, from 0 to 1.
+  inline void mixSpan(int x0, int x1, int y, const float* src, float amount) noexcept
+  {
+    auto tileY = std::size_t(y) >> tileShift();
 
-    t = identifier();
-    if (t) {
-      return t;
+    while (x0 < x1) {
+
+      auto tileX = std::size_t(x0) >> tileShift();
+
+      int end = min(x1, int((tileX + 1) << tileShift()));
+
+      auto count = std::size_t(end - x0) * 4;
+
+      const float* current = image->getTile(tileX, tileY) + offset(x0, y);
+
+      if (!std::equal(src, src + count, current)) {
+
+        float* tile = image->getWritableTile(tileX, tileY);
+
+        if (tile) {
+          mix(tile + offset(x0, y), src, count, amount);
+        }
+      }
+
+      src += count;
+
+      x0 = end;
     }
+  }
+protected:
+  /// Gets the offset of a pixel within its tile.
+  static inline std::size_t offset(int x, int y) noexcept
+  {
+    return (((std::size_t(y) & tileMask()) * tileSize()) + (std::size_t(x) & tileMask())) * 4;
+  }
+};
+
+/// A render target that covers a band of rows on the canvas.
+///
+/// The target has the size of the whole canvas, so that nodes are
+/// rasterized exactly as they are on a dense target, but only the
+/// rows of the band are stored and everything else is clipped.
+///
+/// @note Fill nodes need the pixels outside of the band,
+/// so this target must not be used for documents containing them.
+class BandTarget final
+{
+  /// The color buffer containing the rows of the band.
+  float* colorBuffer = nullptr;
+  /// The width of the canvas, in pixels.
+  std::size_t width = 0;
+  /// The height of the canvas, in pixels.
+  std::size_t height = 0;
+  /// The first row of the band.
+  int rowBegin = 0;
+  /// The row after the last one in the band.
+  int rowEnd = 0;
+public:
+  /// Whether layers that aren't fully opaque are rendered on their own
+  /// and then mixed into the target, see @ref Painter::renderLayers.
+  static constexpr bool mixesLayers = true;
+  constexpr BandTarget(float* c, std::size_t w, std::size_t h, int r0, int r1) noexcept
+    : colorBuffer(c), width(w), height(h), rowBegin(r0), rowEnd(r1) {}
+  /// Gets the width of the canvas, in pixels.
+  inline std::size_t getWidth() const noexcept { return width; }
+  /// Gets the height of the canvas, in pixels.
+  inline std::size_t getHeight() const noexcept { return height; }
+  /// Gets the first row of the band.
+  inline int getRowBegin() const noexcept { return rowBegin; }
+  /// Gets the row after the last one in the band.
+  inline int getRowEnd() const noexcept { return rowEnd; }
+  /// Assigns a color to every pixel in the band.
+  ///
+  /// @param c The premultiplied color to assign.
+  void clear(const RGBA& c) noexcept
+  {
+    std::size_t max = width * std::size_t(rowEnd - rowBegin) * 4;
 
-    t = number();
-    if (t) {
-      return t;
+    for (std::size_t i = 0; i < max; i += 4) {
+      colorBuffer[i + 0] = c[0];
+      colorBuffer[i + 1] = c[1];
+      colorBuffer[i + 2] = c[2];
+      colorBuffer[i + 3] = c[3];
     }
+  }
+  /// Gets the color of a pixel.
+  ///
+  /// @note This function does not perform bounds checking
+  /// and the pixel must be within the band.
+  inline RGBA getPixel(int x, int y) const noexcept
+  {
+    const float* src = pixel(x, y);
 
-    t = stringLiteral();
-    if (t) {
-      return t;
-    }
+    return RGBA { src[0], src[1], src[2], src[3] };
+  }
+  /// Blends a horizontal span of pixels with a color.
+  ///
+  /// @note This function does not perform bounds checking
+  /// and the span must be within the band.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param x0 The X coordinate of the first pixel in the span.
+  /// @param x1 The X coordinate that the span ends at (exclusive.)
+  /// @param y The Y coordinate of the span.
+  /// @param c The color to blend the span with.
+  template <typename Blender>
+  inline void blendSpan(int x0, int x1, int y, const Color& c) noexcept
+  {
+    float* dst = pixel(x0, y);
 
-    t = comment();
-    if (t) {
-      return t;
+    for (int x = x0; x < x1; x++, dst += 4) {
+      Blender::apply(dst, c);
     }
+  }
+  /// Copies a horizontal span of pixels.
+  ///
+  /// @note This function does not perform bounds checking
+  /// and the span must be within the band.
+  ///
+  /// @param dst The buffer to copy the premultiplied colors into.
+  inline void copySpan(int x0, int x1, int y, float* dst) const noexcept
+  {
+    const float* src = pixel(x0, y);
 
-    return fallbackToken();
+    std::copy(src, src + ((x1 - x0) * 4), dst);
   }
-  /// Gets the current lexer position.
-  /// This value can be used to backtrack if necessary.
-  std::size_t getPosition() const noexcept { return pos; }
-  /// Indicates the total number of characters remaining.
-  inline constexpr std::size_t remaining() const noexcept
+  /// Mixes a horizontal span of pixels toward other colors.
+  ///
+  /// @note This function does not perform bounds checking
+  /// and the span must be within the band.
+  ///
+  /// @param src The premultiplied colors to mix toward.
+  /// @param amount How far to mix toward @p src, from 0 to 1.
+  inline void mixSpan(int x0, int x1, int y, const float* src, float amount) noexcept
   {
-    return (pos < size) ? (size - pos) : 0;
+    mix(pixel(x0, y), src, std::size_t(x1 - x0) * 4, amount);
   }
-  /// Assigns the position of the next scan operation.
-  void setPosition(std::size_t p) noexcept { pos = p; }
 protected:
-  /// Creates a token as a last resort for the caller.
-  /// If there is input, one character is used and is
-  /// considered to be "invalid." If there is no input,
-  /// then an empty token is returned.
-  Token fallbackToken() noexcept
+  /// Gets the address of a pixel.
+  inline float* pixel(int x, int y) const noexcept
   {
-    if (remaining() > 0) {
-      return makeToken(TokenType::Invalid, 1);
-    } else {
-      return Token();
+    return colorBuffer + ((((y - rowBegin) * width) + x) * 4);
+  }
+};
+
+/// A render target of palette indices, with one byte per pixel.
+///
+/// Blending is done by the blend modes on the palette index of the
+/// color, rather than on the color itself. Colors that are not from the
+/// palette are drawn with the index of the nearest palette color.
+class IndexedTarget final
+{
+  /// The index buffer being rendered to.
+  unsigned char* indices = nullptr;
+  /// The width of the index buffer, in pixels.
+  std::size_t width = 0;
+  /// The height of the index buffer, in pixels.
+  std::size_t height = 0;
+  /// The palette that the indices refer to.
+  const Palette* palette = nullptr;
+  /// The last color that the nearest palette color was searched for.
+  /// Every span of a node has the same color, so the search is only
+  /// done again when the next node is drawn.
+  RGBA nearestColor = RGBA { -1, -1, -1, -1 };
+  /// The index of the palette color nearest to @ref nearestColor.
+  unsigned char nearestIndex = transparentIndex;
+public:
+  /// Indexed pixels are either covered or not, so the opacity of
+  /// a layer scales the alpha of each node that's drawn instead.
+  static constexpr bool mixesLayers = false;
+  IndexedTarget(unsigned char* i, std::size_t w, std::size_t h, const Palette& p) noexcept
+    : indices(i), width(w), height(h), palette(&p) {}
+  /// Gets the width of the target, in pixels.
+  inline std::size_t getWidth() const noexcept { return width; }
+  /// Gets the height of the target, in pixels.
+  inline std::size_t getHeight() const noexcept { return height; }
+  /// Gets the first row that may be drawn on.
+  inline int getRowBegin() const noexcept { return 0; }
+  /// Gets the row after the last one that may be drawn on.
+  inline int getRowEnd() const noexcept { return int(height); }
+  /// Makes every pixel in the target transparent.
+  /// The color is ignored, since the background is not in the palette.
+  void clear(const RGBA&) noexcept
+  {
+    std::fill(indices, indices + (width * height), transparentIndex);
+  }
+  /// Gets the premultiplied palette color of a pixel.
+  ///
+  /// @note This function does not perform bounds checking.
+  inline RGBA getPixel(int x, int y) const noexcept
+  {
+    auto index = indices[(std::size_t(y) * width) + std::size_t(x)];
+
+    return (index < palette->size()) ? premultiply((*palette)[index]) : transparent();
+  }
+  /// Blends a horizontal span of pixels with a color.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  template <typename Blender>
+  inline void blendSpan(int x0, int x1, int y, const Color& c) noexcept
+  {
+    auto index = (c.index >= 0) ? (unsigned char) c.index : findNearest(c.original);
+
+    unsigned char* dst = indices + (std::size_t(y) * width) + std::size_t(x0);
+
+    for (int x = x0; x < x1; x++, dst++) {
+      Blender::applyIndex(dst, index, c);
     }
   }
-  /// Parses for a boolean literal.
-  Token booleanLiteral() noexcept
+protected:
+  /// Finds the palette color nearest to a color, by red, green and blue.
+  ///
+  /// @return The index of the nearest color, or
+  /// @ref transparentIndex if the palette is empty.
+  unsigned char findNearest(const RGBA& c) noexcept
   {
-    if (isEqual(0, 't')
-     && isEqual(1, 'r')
-     && isEqual(2, 'u')
-     && isEqual(3, 'e')
-     && !isIdentifierChar(4)) {
-      return makeToken(TokenType::True, 4);
+    if (std::equal(c.data, c.data + 4, nearestColor.data)) {
+      return nearestIndex;
     }
 
-    if (isEqual(0, 'f')
-     && isEqual(1, 'a')
-     && isEqual(2, 'l')
-     && isEqual(3, 's')
-     && isEqual(4, 'e')
-     && !isIdentifierChar(5)) {
-      return makeToken(TokenType::False, 5);
+    nearestColor = c;
+    nearestIndex = transparentIndex;
+
+    auto nearestDistance = std::numeric_limits<float>::max();
+
+    for (std::size_t i = 0; i < palette->size(); i++) {
+
+      const auto& p = (*palette)[i];
+
+      auto distance = 0.0f;
+
+      for (std::size_t j = 0; j < 3; j++) {
+        distance += (c[j] - p[j]) * (c[j] - p[j]);
+      }
+
+      if (distance < nearestDistance) {
+        nearestIndex = (unsigned char) i;
+        nearestDistance = distance;
+      }
     }
 
-    return Token();
+    return nearestIndex;
   }
-  /// Scans for a comment token.
-  Token comment() noexcept
-  {
-    std::size_t match = 0;
+};
 
-    if (!isEqual(match, '#')) {
-      return Token();
-    } else {
-      match++;
+/// A render target that covers a box of the canvas, which is
+/// where a layer that isn't fully opaque is rendered before it's
+/// mixed into the canvas. The pixels are in a buffer of the render
+/// context, which holds the rows of the box.
+///
+/// Nodes are clipped to the box, which contains every node of the layer,
+/// and pixels outside of it are read as transparent.
+class LayerTarget final
+{
+  /// The color buffer holding the pixels of the box.
+  float* colorBuffer = nullptr;
+  /// The width of the canvas, in pixels.
+  std::size_t width = 0;
+  /// The height of the canvas, in pixels.
+  std::size_t height = 0;
+  /// The pixels of the canvas covered by the target.
+  Box box;
+public:
+  /// Layers aren't nested, so nothing is mixed into this target.
+  static constexpr bool mixesLayers = false;
+  constexpr LayerTarget(float* c, std::size_t w, std::size_t h, const Box& b) noexcept
+    : colorBuffer(c), width(w), height(h), box(b) {}
+  /// Gets the width of the canvas, in pixels.
+  inline std::size_t getWidth() const noexcept { return width; }
+  /// Gets the height of the canvas, in pixels.
+  inline std::size_t getHeight() const noexcept { return height; }
+  /// Gets the first row of the box.
+  inline int getRowBegin() const noexcept { return box.min[1]; }
+  /// Gets the row after the last one in the box.
+  inline int getRowEnd() const noexcept { return box.max[1] + 1; }
+  /// Gets the color of a pixel.
+  inline RGBA getPixel(int x, int y) const noexcept
+  {
+    if ((x < box.min[0]) || (x > box.max[0]) || (y < box.min[1]) || (y > box.max[1])) {
+      return transparent();
     }
 
-    while (inBounds(match) && !isEqual(match, '\n') && !isEqual(match, '\r')) {
-      match++;
-    }
+    const float* src = pixel(x, y);
 
-    return makeToken(TokenType::Comment, match);
+    return RGBA { src[0], src[1], src[2], src[3] };
   }
-  /// Scans for an identifier token.
-  Token identifier() noexcept
+  /// Blends the part of a horizontal span that is within the box.
+  ///
+  /// @note The row must be within the box.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  template <typename Blender>
+  inline void blendSpan(int x0, int x1, int y, const Color& c) noexcept
   {
-    std::size_t match = 0;
+    x0 = max(x0, box.min[0]);
+    x1 = min(x1, box.max[0] + 1);
 
-    if (!isInRange(match, 'a', 'z')
-     && !isInRange(match, 'A', 'Z')
-     && !isEqual(match, '_')) {
-      return Token();
-    } else {
-      match++;
+    if (x0 >= x1) {
+      return;
     }
 
-    while (inBounds(match)) {
-      if (isIdentifierChar(match)) {
-        match++;
-      } else {
-        break;
-      }
-    }
+    float* dst = pixel(x0, y);
 
-    if (match > 0) {
-      return makeToken(TokenType::Identifier, match);
-    } else {
-      return Token();
+    for (int x = x0; x < x1; x++, dst += 4) {
+      Blender::apply(dst, c);
     }
   }
-  /// Scans for a number token.
-  Token number() noexcept
+protected:
+  /// Gets the address of a pixel.
+  inline float* pixel(int x, int y) const noexcept
   {
-    auto neg = false;
+    auto boxWidth = std::size_t(box.max[0] - box.min[0] + 1);
 
-    std::size_t match = 0;
+    return colorBuffer + (((std::size_t(y - box.min[1]) * boxWidth) + std::size_t(x - box.min[0])) * 4);
+  }
+};
 
-    if (isEqual(match, '-')) {
-      neg = true;
-      match++;
-    }
+/// The largest number of pixels that a symbol may cover.
+/// Larger symbols are not drawn, since they're rendered whole.
+constexpr std::size_t maxSymbolPixels() noexcept
+{
+  return std::size_t(1) << 24;
+}
 
-    while (inBounds(match)) {
-      if (isInRange(match, '0', '9')) {
-        match++;
-      } else {
-        break;
+/// Holds the symbols of a document after they're rendered on their own,
+/// so that the painter can stamp their pixels at each instance of them.
+/// A symbol is rendered when it's first placed, and is kept for as long
+/// as the painter is, so that each symbol is rendered once per render.
+class SymbolCache final
+{
+  /// A symbol that may have been rendered.
+  struct Entry final
+  {
+    /// Whether or not rendering the symbol was attempted.
+    bool rendered = false;
+    /// The position of the upper left pixel, relative to the origin of the symbol.
+    Vec2 origin = Vec2 { 0, 0 };
+    /// The pixels of the symbol, which is null if it has none.
+    std::shared_ptr<const BitmapData> data;
+  };
+  /// The symbols of the document, or null if instances aren't drawn.
+  const std::vector<SymbolPtr>* symbols = nullptr;
+  /// The palette that the nodes of the symbols may take their color from.
+  const Palette& palette;
+  /// The symbols that were rendered, in the order of @ref symbols.
+  std::vector<Entry> entries;
+  /// The scratch memory used to render symbols. This is separate from
+  /// the one used by the painter, since a symbol is rendered while the
+  /// painter is partway through a layer.
+  std::unique_ptr<RenderContext> context;
+public:
+  SymbolCache(const std::vector<SymbolPtr>* s, const Palette& p) noexcept : symbols(s), palette(p) {}
+  /// Finds the pixels of a symbol, rendering it if needed.
+  ///
+  /// @param index The index of the symbol.
+  /// @param origin Assigned the position of the upper left
+  /// pixel, relative to the origin of the symbol.
+  ///
+  /// @return The pixels of the symbol, or null if it doesn't
+  /// exist, has no pixels or could not be rendered.
+  const BitmapData* find(std::size_t index, Vec2& origin) noexcept;
+protected:
+  /// Renders a symbol onto a transparent canvas that
+  /// is just large enough to hold the symbol's nodes.
+  ///
+  /// @exception std::bad_alloc If memory could not be allocated.
+  void render(const Symbol& symbol, Entry& entry);
+};
+
+/// Used for rasterizing the document.
+///
+/// The rasterization loops are templates of the type implementing
+/// the blend mode. The blend mode of a node is looked at once,
+/// by @ref dispatchBlendMode, and the rest of the node is drawn by
+/// the loops that were instantiated for it.
+///
+/// @tparam Target The type of render target being painted on.
+///
+/// @tparam Stats The type collecting render statistics.
+/// This is @ref NullStats unless statistics were requested.
+template <typename Target, typename Stats = NullStats>
+class Painter final : public NodeAccessor
+{
+  /// The current pixel size.
+  std::size_t pixelSize = 1;
+  /// The current material used to paint with.
+  Color primaryColor = RGBA { 0, 0, 0, 0 };
+  /// The current layer opacity.
+  float layerOpacity = 1.0f;
+  /// The target being rendered to.
+  Target target;
+  /// The palette that nodes may take their color from.
+  const Palette& palette;
+  /// The symbols placed by instances, unless they're shared with another painter.
+  SymbolCache ownSymbols;
+  /// The symbols placed by instances.
+  SymbolCache& symbols;
+  /// The scratch memory used by the painter.
+  RenderContext& context;
+  /// Collects the render statistics.
+  Stats stats;
+  /// Used to skip nodes that are not on the canvas.
+  BoundsCalculator boundsCalculator;
+public:
+  Painter(const Target& t, const Document& doc, RenderContext& ctx, const Stats& s = Stats())
+    : target(t), palette(doc.palette), ownSymbols(&doc.symbols, doc.palette), symbols(ownSymbols), context(ctx), stats(s) {}
+  /// Makes a painter that doesn't draw instances, which is used to render symbols.
+  Painter(const Target& t, const Palette& p, RenderContext& ctx, const Stats& s = Stats())
+    : target(t), palette(p), ownSymbols(nullptr, p), symbols(ownSymbols), context(ctx), stats(s) {}
+  /// Makes a painter that draws instances with the symbols of another
+  /// painter, which is used to render a layer on its own.
+  Painter(const Target& t, const Palette& p, SymbolCache& shared, RenderContext& ctx, const Stats& s = Stats())
+    : target(t), palette(p), ownSymbols(nullptr, p), symbols(shared), context(ctx), stats(s) {}
+  /// Renders an ellipse.
+  void access(const Ellipse& ellipse) noexcept override
+  {
+    auto timer = stats.timeNode(NodeType::Ellipse);
+
+    setPrimaryColor(ellipse.color, ellipse.colorIndex);
+
+    pixelSize = ellipse.pixelSize;
+
+    if (ellipse.filled) {
+
+      auto& rasterizer = context.rasterizer;
+
+      try {
+        rasterizer.clear();
+        rasterizer.addEllipse(ellipse.center[0], ellipse.center[1], ellipse.radius[0], ellipse.radius[1], getSpanClipBox());
+      } catch (...) {
+        return;
       }
-    }
 
-    if ((neg && (match > 1)) || (!neg && (match > 0))) {
-      return makeToken(TokenType::Integer, match);
-    } else {
-      return Token();
+      fillSpans(ellipse.blendMode);
+
+      return;
     }
+
+    dispatchBlendMode(ellipse.blendMode, [this, &ellipse](auto blender) {
+
+      auto functor = [this, blender] (int x, int y) {
+        plot(blender, x, y);
+      };
+
+      renderEllipse(ellipse.center[0],
+                    ellipse.center[1],
+                    ellipse.radius[0],
+                    ellipse.radius[1],
+                    functor);
+    });
   }
-  /// Scans for a space token.
-  Token space() noexcept
+  /// Fills an area on the image
+  /// with a certain color.
+  void access(const Fill& fill) noexcept override
   {
-    std::size_t match = 0;
+    auto timer = stats.timeNode(NodeType::Fill);
 
-    while (inBounds(match)) {
-      if (isEqual(match, ' ')
-       || isEqual(match, '\t')
-       || isEqual(match, '\n')
-       || isEqual(match, '\r')) {
-        match++;
-      } else {
-        break;
-      }
+    if (!inBounds(fill.origin)) {
+      return;
     }
 
-    if (match > 0) {
-      return makeToken(TokenType::Space, match);
-    } else {
-      return Token();
+    auto prev = getPixel(fill.origin);
+
+    setPrimaryColor(fill.color, fill.colorIndex);
+
+    if (almostEqual(prev, primaryColor.premultiplied)) {
+      return;
     }
+
+    TraceScope traceScope("fill");
+
+    dispatchBlendMode(fill.blendMode, [this, &fill, &prev](auto blender) {
+      try {
+        this->fill(blender, fill.origin, prev);
+      } catch (...) { }
+    });
   }
-  /// Scans for a double quoted string literal.
-  Token stringLiteral() noexcept
+  /// Renders a line.
+  void access(const Line& line) noexcept override
   {
-    std::size_t match = 0;
+    auto timer = stats.timeNode(NodeType::Line);
 
-    if (!isEqual(match, '"')) {
-      return Token();
-    } else {
-      match++;
-    }
+    setPrimaryColor(line.color, line.colorIndex);
 
-    while (inBounds(match)) {
+    pixelSize = line.pixelSize;
 
-      if (isEqual(match, '\\')) {
-        match++;
-      } else if (isEqual(match, '"')) {
-        break;
+    dispatchBlendMode(line.blendMode, [this, &line](auto blender) {
+
+      for (std::size_t i = 1; i < line.points.size(); i++) {
+        drawLine(blender, line.points[i - 1], line.points[i - 0]);
       }
 
-      match++;
+      if ((line.points.size() % 2) == 1) {
+        auto p = line.points[line.points.size() - 1];
+        drawLine(blender, p, p);
+      }
+    });
+  }
+  /// Draws a quadrilateral.
+  void access(const Quad& quad) noexcept override
+  {
+    auto timer = stats.timeNode(NodeType::Quad);
+
+    setPrimaryColor(quad.color, quad.colorIndex);
+
+    pixelSize = quad.pixelSize;
+
+    if (quad.filled) {
+      fillPolygon(quad.points, 4, quad.blendMode);
+      return;
     }
 
-    if (!isEqual(match, '"')) {
-      // We could either mark '"' as invalid by itself
-      // or everything up to this point. Marking everything
-      // up to this point reduces the amount of false errors
-      // to zero, so that's what we'll do.
-      return makeToken(TokenType::Invalid, match);
+    dispatchBlendMode(quad.blendMode, [this, &quad](auto blender) {
+      drawLine(blender, quad.points[0], quad.points[1]);
+      drawLine(blender, quad.points[1], quad.points[2]);
+      drawLine(blender, quad.points[2], quad.points[3]);
+      drawLine(blender, quad.points[3], quad.points[0]);
+    });
+  }
+  /// Draws the pixels of a bitmap.
+  void access(const Bitmap& bitmap) noexcept override
+  {
+    auto timer = stats.timeNode(NodeType::Bitmap);
+
+    if (!bitmap.data) {
+      return;
     }
 
-    return makeToken(TokenType::StringLiteral, match + 1);
+    dispatchBlendMode(bitmap.blendMode, [this, &bitmap](auto blender) {
+      blit(blender, bitmap.position, *bitmap.data);
+    });
   }
-  /// Creates a token of a certain type and size.
-  inline constexpr Token makeToken(TokenType type, std::size_t s) noexcept
+  /// Stamps the pixels of a symbol.
+  void access(const Instance& instance) noexcept override
   {
-    Token token {
-      data + pos,
-      s,
-      pos,
-      line,
-      column,
-      type
-    };
+    auto timer = stats.timeNode(NodeType::Instance);
 
-    next(s);
+    Vec2 origin { 0, 0 };
 
-    return token;
+    const auto* data = symbols.find(instance.symbol, origin);
+    if (!data) {
+      return;
+    }
+
+    dispatchBlendMode(instance.blendMode, [this, &instance, &origin, data](auto blender) {
+      blit(blender, instance.position + origin, *data);
+    });
   }
-  /// Checks if a character can be part of an identifier.
-  //
-  /// @note This does not take into account that a decimal digit
-  /// is not allowed in the first character of an identifier.
-  ///
-  /// @param offset The offset of the character to check.
-  ///
-  /// @return True if the character is an identifier character, false if it's not.
-  inline constexpr bool isIdentifierChar(std::size_t offset) const noexcept
+  /// Draws a polygon.
+  void access(const Polygon& polygon) noexcept override
   {
-    auto c = look(offset);
+    auto timer = stats.timeNode(NodeType::Polygon);
 
-    return (((c >= 'a') && (c <= 'z'))
-         || ((c >= 'A') && (c <= 'Z'))
-         || ((c >= '0') && (c <= '9'))
-         || (c == '_'));
+    setPrimaryColor(polygon.color, polygon.colorIndex);
+
+    pixelSize = polygon.pixelSize;
+
+    fillPolygon(polygon.points.data(), polygon.points.size(), polygon.blendMode);
   }
-  /// Indicates if a character is equal to another.
-  inline constexpr bool isEqual(std::size_t offset, char c) const noexcept
+  /// Changes the render target, such as to render the next band of
+  /// rows. Symbols that were already rendered are kept for the new one.
+  inline void setTarget(const Target& t) noexcept
   {
-    return look(offset) == c;
+    target = t;
   }
-  /// Indicates if a character is in a certain range.
-  inline constexpr bool isInRange(std::size_t offset, char begin, char end) const noexcept
+  /// Clears the contents of the render target.
+  ///
+  /// @param c The color to clear the render target with.
+  /// This is premultiplied within the function call.
+  void clear(const RGBA& c) noexcept
   {
-    char c = look(offset);
-    return (c >= begin) && (c <= end);
+    TraceScope traceScope("clear");
+
+    target.clear(premultiply(c));
   }
-  /// Indicates if an offset is out of bounds.
-  inline constexpr bool inBounds(std::size_t offset) const noexcept
+  /// Draws a line between two points.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  template <typename Blender>
+  void drawLine(Blender blender, const Vec2& a, const Vec2& b) noexcept
   {
-    return (pos + offset) < size;
+    renderLine(a, b, [this, blender](int x, int y) {
+      plot(blender, x, y);
+    });
   }
-  /// Goes passed a certain number of characters.
-  inline constexpr void next(std::size_t count) noexcept
+  /// Fills a polygon with the current color and pixel size.
+  ///
+  /// @param points The points of the polygon.
+  /// @param count The number of points in the polygon.
+  /// @param blendMode The blend mode to fill the polygon with.
+  void fillPolygon(const Vec2* points, std::size_t count, BlendMode blendMode) noexcept
   {
-    for (std::size_t i = 0; (i < count) && (pos < size); i++) {
-
-      auto c = data[pos];
-      if (c == '\n') {
-        line++;
-        column = 1;
-      } else if (c > 0) {
-        column++;
-      }
+    auto& rasterizer = context.rasterizer;
 
-      pos++;
+    try {
+      rasterizer.clear();
+      rasterizer.addPolygon(points, count, getSpanClipBox());
+    } catch (...) {
+      return;
     }
+
+    fillSpans(blendMode);
   }
-  /// Used for checking the contents of a character
-  /// a certain offset array from the current position.
-  inline constexpr char look(std::size_t offset = 0) const noexcept
+  /// Gets the pixels that a filled shape is converted within.
+  /// This is the target, extended to the lower right by the pixel
+  /// size, since pixels are widened to their upper left.
+  Box getSpanClipBox() const noexcept
   {
-    return ((pos + offset) < size) ? data[pos + offset] : 0;
+    auto size = int(pixelSize);
+
+    return Box {
+      Vec2 { 0, target.getRowBegin() },
+      Vec2 { int(target.getWidth()) + size - 2, target.getRowEnd() + size - 2 }
+    };
   }
-};
+  /// Blends the spans of the shapes in the rasterizer with the
+  /// current color, after widening them to the current pixel size.
+  ///
+  /// @param blendMode The blend mode to blend the spans with.
+  void fillSpans(BlendMode blendMode) noexcept
+  {
+    const std::vector<Span>* spans = nullptr;
 
-/// Used for storing optional results.
-/// Meant primarily for POD.
-template <typename T>
-struct Optional final
-{
-  T value = T();
-  bool valid = false;
+    try {
+      spans = &context.rasterizer.finish(int(pixelSize));
+    } catch (...) {
+      return;
+    }
 
-  constexpr Optional() {}
-  constexpr Optional(const T& v) : value(v), valid(true) {}
-};
+    int width = int(target.getWidth());
 
-/// A recursive-decent parser for parsing
-/// document files. The parser fails immediately
-/// after finding the first error.
-class Parser final
-{
-  /// Suppressed error messages go here.
-  std::ostringstream suppressed;
-  /// The tokens found by the lexer.
-  std::vector<Token> tokens;
-  /// The position of the parser among the tokens.
-  std::size_t pos = 0;
-  /// Whether or not the parser has failed.
-  bool failedFlag = false;
-  /// The list of errors found by the parser.
-  ErrorList errorList;
-public:
-  /// Constructs a new parser instance.
-  /// This function will parse the string and
-  /// filter out any tokens that the parser
-  /// will not need.
-  ///
-  /// @param str The string to parse.
-  /// @param size The number of characters in @p str.
-  Parser(const char* str, std::size_t size)
-  {
-    Lexer lexer(str, size);
+    int rowBegin = target.getRowBegin();
+    int rowEnd = target.getRowEnd();
 
-    while (lexer.remaining() && !failed()) {
-      auto t = lexer.scan();
-      if (t == TokenType::Invalid) {
-        formatError(t) << "Invalid token " << t;
-        break;
-      } else if (t == TokenType::None) {
-        break;
-      } else if ((t == TokenType::Space) || (t == TokenType::Comment)) {
-        continue;
-      } else {
-        tokens.emplace_back(t);
+    dispatchBlendMode(blendMode, [this, spans, width, rowBegin, rowEnd](auto blender) {
+
+      using Blender = decltype(blender);
+
+      for (const auto& span : *spans) {
+
+        int x0 = max(span.x0, 0);
+        int x1 = min(span.x1, width);
+
+        if ((span.y < rowBegin) || (span.y >= rowEnd) || (x0 >= x1)) {
+          continue;
+        }
+
+        stats.countBlended(std::size_t(x1 - x0));
+
+        target.template blendSpan<Blender>(x0, x1, span.y, primaryColor);
       }
-    }
+    });
   }
-  /// Indicates whether or not the parser failed.
-  inline constexpr bool failed() const noexcept { return failedFlag; }
-  /// Gets the error list found by the parser.
-  /// Future calls to this function will return
-  /// an empty error list.
+  /// Plots a point onto the render target.
+  /// The point is the bottom right corner of
+  /// a square the size of the current pixel size.
   ///
-  /// @param content The variable containing the origin source code.
-  /// This is assigned to the error list so that the context of the
-  /// error can be shown if needed.
-  ErrorList* getErrorList(const char* filename, std::string&& content)
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param x The X coordinate of the point to plot.
+  /// @param y The Y coordinate of the point to plot.
+  template <typename Blender>
+  inline void plot(Blender, int x, int y) noexcept
   {
-    // Resolve the stream contents to the descriptions.
-    for (auto& err : errorList.errors) {
-      err.description = err.stream.str();
-    }
+    // The square is clipped once here, instead
+    // of checking the bounds of every pixel.
 
-    errorList.filename = filename;
-    errorList.source = std::move(content);
+    int size = int(pixelSize);
 
-    return new ErrorList(std::move(errorList));
+    int x0 = max(x - size + 1, 0);
+    int y0 = max(y - size + 1, target.getRowBegin());
+    int x1 = min(x + 1, int(target.getWidth()));
+    int y1 = min(y + 1, target.getRowEnd());
+
+    if ((x0 < x1) && (y0 < y1)) {
+      stats.countBlended(std::size_t(x1 - x0) * std::size_t(y1 - y0));
+    }
+
+    for (int py = y0; py < y1; py++) {
+      target.template blendSpan<Blender>(x0, x1, py, primaryColor);
+    }
   }
-  /// This can be called when nothing is available
-  /// to parse and there is still remaining tokens
-  /// in the parser. It emits an error message describing
-  /// the bad token and moves the parser past it.
-  void badToken()
+  /// Blends the runs of a bitmap onto the render target,
+  /// one span per run, clipped to the target.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param position The position of the upper left pixel of the bitmap.
+  /// @param data The pixels of the bitmap.
+  template <typename Blender>
+  void blit(Blender, const Vec2& position, const BitmapData& data) noexcept
   {
-    auto tok = look();
-    formatError(tok) << "Invalid token " << tok;
-    next();
+    int width = int(target.getWidth());
+
+    int y0 = max(position[1], target.getRowBegin());
+    int y1 = min(position[1] + int(data.height), target.getRowEnd());
+
+    // Neighboring runs often alternate between a few colors,
+    // so the primary color is only changed when it has to be.
+    auto currentColor = std::numeric_limits<std::uint32_t>::max();
+
+    for (int y = y0; y < y1; y++) {
+
+      auto row = std::size_t(y - position[1]);
+
+      int x = position[0];
+
+      for (auto i = data.rowStarts[row]; (i < data.rowStarts[row + 1]) && (x < width); i++) {
+
+        const auto& run = data.runs[i];
+
+        int x0 = max(x, 0);
+
+        x += int(run.length);
+
+        int x1 = min(x, width);
+
+        // Transparent pixels don't change the target in any blend mode.
+        if ((x0 >= x1) || (data.colors[run.color][3] <= 0)) {
+          continue;
+        }
+
+        if (run.color != currentColor) {
+          setPrimaryColor(data.colors[run.color], -1);
+          currentColor = run.color;
+        }
+
+        stats.countBlended(std::size_t(x1 - x0));
+
+        target.template blendSpan<Blender>(x0, x1, y, primaryColor);
+      }
+    }
   }
-  /// Attempts to parse a layer node.
+  /// Renders a series of layers.
   ///
-  /// @return A pointer to a layer node, if one is found.
-  /// Otherwise, a null pointer is returned.
-  LayerPtr parseLayer()
+  /// A layer that is fully opaque is drawn directly onto the target.
+  /// Any other layer is drawn onto a copy of the pixels beneath it, which
+  /// is then mixed into the target by the opacity of the layer. This way,
+  /// the nodes of the layer cover each other as they would in an opaque
+  /// layer, rather than showing through each other, and fills still see
+  /// the layers beneath. Only the box around the nodes of the layer is
+  /// copied, into a buffer of the render context that is reused by every
+  /// layer. Indexed targets scale the alpha of each node instead.
+  ///
+  /// @param layers The layers to be rendered.
+  /// @param frame The frame to evaluate animated layers and nodes at.
+  /// @param nodeBounds An optional array containing the bounds of every
+  /// node in the visible layers at @p frame, in the order they are rendered.
+  /// When this is null, the bounds are calculated while rendering.
+  /// @param firstLayer The index of the first layer to render.
+  /// Layers below this one are assumed to already be on the target.
+  /// @param endLayer The index of the layer to stop rendering at.
+  void renderLayers(const std::vector<LayerPtr>& layers,
+                    std::size_t frame = 0,
+                    const Box* nodeBounds = nullptr,
+                    std::size_t firstLayer = 0,
+                    std::size_t endLayer = std::numeric_limits<std::size_t>::max())
   {
-    auto firstTok = look();
+    Box canvas {
+      Vec2 { 0, target.getRowBegin() },
+      Vec2 { int(target.getWidth()) - 1, target.getRowEnd() - 1 }
+    };
 
-    if (!matchID("layer")) {
-      return LayerPtr();
-    }
+    auto& evaluator = context.evaluator;
 
-    LayerPtr layer(new Layer());
+    evaluator.setFrame(frame);
 
-    while (remaining() && !failed() && !matchID("end")) {
+    endLayer = min(endLayer, layers.size());
 
-      auto str = parseString("name");
-      if (str.valid) {
-        layer->name = str.value;
-        continue;
-      }
+    for (std::size_t i = firstLayer; i < endLayer; i++) {
 
-      auto opacity = parseColorChannel("opacity");
-      if (opacity.valid) {
-        layer->opacity = opacity.value;
-        continue;
-      }
+      const auto& layer = layers[i];
 
-      auto visibility = parseBool("visible");
-      if (visibility.valid) {
-        layer->visible = visibility.value;
+      if (!layer->visible) {
         continue;
       }
 
-      auto node = parseNode();
-      if (node) {
-        layer->nodes.emplace_back(std::move(node));
-        continue;
-      }
+      auto timer = stats.timeLayer(i);
 
-      if (failed()) {
-        return LayerPtr();
+      TraceScope traceScope("layer", "index", double(i));
+
+      layerOpacity = layer->opacity;
+
+      evaluator.beginLayer(*layer);
+
+      if (layerOpacity < 1) {
+        renderMixedLayer(std::integral_constant<bool, Target::mixesLayers>(), *layer, canvas, nodeBounds);
       } else {
-        formatError(firstTok) << "Missing 'end' statement.";
-        return LayerPtr();
+        renderNodes(*layer, canvas, nodeBounds);
       }
     }
-
-    return layer;
   }
-  /// Parses for a node.
+  /// Renders a layer that isn't fully opaque onto a copy of
+  /// the pixels beneath it, and mixes it into the target.
   ///
-  /// @return On success, a pointer to a node.
-  /// On failure, a null pointer.
-  NodePtr parseNode()
+  /// @param layer The layer to render.
+  /// @param canvas The rows of the canvas that are being rendered.
+  /// @param nodeBounds The bounds of the nodes, as passed to @ref renderLayers.
+  void renderMixedLayer(std::true_type, const Layer& layer, const Box& canvas, const Box*& nodeBounds)
   {
-    auto node = parseLineNode();
-    if (node) {
-      return node;
+    if (layerOpacity <= 0) {
+      // Nothing of the layer would be mixed in, so its nodes are culled
+      // without drawing them or taking the buffer.
+      for (std::size_t i = 0; i < layer.nodes.size(); i++) {
+        stats.countNodeCulled();
+      }
+
+      if (nodeBounds) {
+        nodeBounds += layer.nodes.size();
+      }
+
+      return;
+    }
+
+    // The bounds of the nodes are used for both the box of the layer
+    // and culling, so they are only calculated once.
+
+    const Box* layerBounds = nodeBounds;
+
+    if (!layerBounds) {
+      try {
+        layerBounds = calculateNodeBounds(layer);
+      } catch (...) {
+        renderNodes(layer, canvas, nodeBounds);
+        return;
+      }
+    }
+
+    renderMixedNodes(layer, canvas, layerBounds);
+
+    if (nodeBounds) {
+      nodeBounds = layerBounds;
     }
+  }
+  /// Renders the nodes of a layer that isn't fully opaque onto a copy
+  /// of the pixels beneath them, and mixes them into the target.
+  ///
+  /// @param nodeBounds The bounds of the nodes of the layer,
+  /// which is advanced past them.
+  void renderMixedNodes(const Layer& layer, const Box& canvas, const Box*& nodeBounds)
+  {
+    auto box = getLayerBounds(layer, canvas, nodeBounds);
 
-    node = parseEllipseNode();
-    if (node) {
-      return node;
+    if (box.empty()) {
+      // Every node is culled, which is still counted.
+      renderNodes(layer, canvas, nodeBounds);
+      return;
     }
 
-    node = parseQuadNode();
-    if (node) {
-      return node;
+    auto boxWidth = std::size_t(box.max[0] - box.min[0] + 1);
+    auto boxHeight = std::size_t(box.max[1] - box.min[1] + 1);
+
+    auto& colors = context.layerColors;
+
+    try {
+      if (colors.size() < (boxWidth * boxHeight * 4)) {
+        colors.resize(boxWidth * boxHeight * 4);
+      }
+    } catch (...) {
+      // Without the memory, the opacity
+      // is applied to each node instead.
+      renderNodes(layer, canvas, nodeBounds);
+      return;
     }
 
-    node = parseFillNode();
-    if (node) {
-      return node;
+    TraceScope traceScope("mixLayer", "pixels", double(boxWidth * boxHeight));
+
+    for (int y = box.min[1]; y <= box.max[1]; y++) {
+      target.copySpan(box.min[0], box.max[0] + 1, y, colors.data() + (std::size_t(y - box.min[1]) * boxWidth * 4));
     }
 
-    return NodePtr();
+    LayerTarget layerTarget(colors.data(), target.getWidth(), target.getHeight(), box);
+
+    Painter<LayerTarget, Stats> layerPainter(layerTarget, palette, symbols, context, stats);
+
+    layerPainter.renderNodes(layer, box, nodeBounds);
+
+    for (int y = box.min[1]; y <= box.max[1]; y++) {
+      target.mixSpan(box.min[0], box.max[0] + 1, y, colors.data() + (std::size_t(y - box.min[1]) * boxWidth * 4), layerOpacity);
+    }
   }
-  /// Attempts to make a boolean value.
+  /// Renders a layer that isn't fully opaque onto a target that
+  /// can't mix layers, with its opacity applied to each node.
+  void renderMixedLayer(std::false_type, const Layer& layer, const Box& canvas, const Box*& nodeBounds)
+  {
+    renderNodes(layer, canvas, nodeBounds);
+  }
+  /// Calculates the bounds of the nodes of a layer, into
+  /// the scratch memory of the render context. The animation
+  /// of the layer must already be evaluated.
   ///
-  /// @param name The name of the value to parse.
+  /// @exception std::bad_alloc If memory could not be allocated.
   ///
-  /// @return Optionally returns a boolean value.
-  Optional<bool> parseBool(const char* name)
+  /// @return The bounds of the nodes, in the order they are rendered.
+  const Box* calculateNodeBounds(const Layer& layer)
   {
-    if (!matchID(name)) {
-      return Optional<bool>();
-    }
+    auto& bounds = context.layerNodeBounds;
 
-    auto tok = look();
-    if (tok == TokenType::True) {
-      next();
-      return Optional<bool>(true);
-    } else if (tok == TokenType::False) {
-      next();
-      return Optional<bool>(false);
-    } else {
-      formatError(tok) << "Expected a boolean value, but got " << tok;
-      return Optional<bool>();
+    bounds.resize(layer.nodes.size());
+
+    for (std::size_t i = 0; i < layer.nodes.size(); i++) {
+
+      const auto* node = context.evaluator.evaluate(*layer.nodes[i]);
+
+      bounds[i] = node ? boundsCalculator.calculate(*node) : Box();
     }
+
+    return bounds.data();
   }
-  /// Parses for a blend mode.
-  ///
-  /// @param name The name of the blend mode to parse.
+  /// Gets the box around the nodes of a layer, within the canvas.
   ///
-  /// @return Optionally returns a blend mode.
-  Optional<BlendMode> parseBlendMode(const char* name)
+  /// @param nodeBounds The bounds of the nodes of the layer.
+  /// This is not advanced past them.
+  Box getLayerBounds(const Layer& layer, const Box& canvas, const Box* nodeBounds) noexcept
   {
-    if (!matchID(name)) {
-      return Optional<BlendMode>();
-    }
+    Box layerBounds;
 
-    auto tok = look();
-    if (tok != TokenType::Identifier) {
-      formatError(tok) << "Expected a blend mode identifier, but got " << tok;
-      return Optional<BlendMode>();
-    }
+    for (std::size_t i = 0; i < layer.nodes.size(); i++) {
 
-    if (tok == "normal") {
-      next();
-      return Optional<BlendMode>(BlendMode::Normal);
-    } else if (tok == "subtract") {
-      next();
-      return Optional<BlendMode>(BlendMode::Subtract);
-    } else {
-      formatError(tok) << tok << " is not a blend mode.";
-      return Optional<BlendMode>();
+      const auto& bounds = nodeBounds[i];
+
+      if (bounds.intersects(canvas)) {
+        layerBounds.include(max(bounds.min, canvas.min));
+        layerBounds.include(min(bounds.max, canvas.max));
+      }
     }
+
+    return layerBounds;
   }
-  /// Parses for a color value.
-  ///
-  /// @param name The name of the color value to parse for.
+  /// Renders the nodes of one layer at full opacity, whether or
+  /// not the layer is visible. This is used to bake a layer, which
+  /// keeps its opacity and applies it to the baked pixels instead.
   ///
-  /// @return Optionally returns a color if the correct one was found.
-  Optional<RGBA> parseColor(const char* name) noexcept
+  /// @param layer The layer to render the nodes of.
+  /// @param frame The frame to evaluate animated nodes at.
+  void renderLayerNodes(const Layer& layer, std::size_t frame = 0)
   {
-    auto nameTok = look();
+    Box canvas {
+      Vec2 { 0, target.getRowBegin() },
+      Vec2 { int(target.getWidth()) - 1, target.getRowEnd() - 1 }
+    };
 
-    if (!matchID(name)) {
-      return Optional<RGBA>();
-    }
+    context.evaluator.setFrame(frame);
 
-    auto v = parseVector<4>();
-    if (!v.valid) {
-      formatError(nameTok) << "Failed to match color values following " << nameTok;
-      return Optional<RGBA>();
-    }
+    context.evaluator.beginLayer(layer);
 
-    return Optional<RGBA>(toColor(v.value));
+    layerOpacity = 1;
+
+    const Box* nodeBounds = nullptr;
+
+    renderNodes(layer, canvas, nodeBounds);
   }
-  /// Attempts to parse a string.
+  /// Renders the nodes of a symbol, as they are at the first frame.
   ///
-  /// @param name The name of the string to parse.
+  /// @param symbol The symbol to render the nodes of.
+  /// @param offset The distance to move the nodes by.
+  void renderSymbol(const Symbol& symbol, const Vec2& offset)
+  {
+    Box canvas {
+      Vec2 { 0, target.getRowBegin() },
+      Vec2 { int(target.getWidth()) - 1, target.getRowEnd() - 1 }
+    };
+
+    context.evaluator.setFrame(0);
+
+    context.evaluator.beginSymbol(offset);
+
+    layerOpacity = 1;
+
+    const Box* nodeBounds = nullptr;
+
+    renderNodes(symbol.layer, canvas, nodeBounds);
+  }
+  /// Renders the nodes of a layer, skipping those that are not on the canvas.
+  /// The animation of the layer must already be evaluated, by the caller.
   ///
-  /// @return Optionally returns a string.
-  Optional<std::string> parseString(const char* name) noexcept
+  /// @param layer The layer to render the nodes of.
+  /// @param canvas The rows of the canvas that are being rendered.
+  /// @param nodeBounds The bounds of the nodes, as passed to @ref renderLayers.
+  /// If this is not null, it's advanced past the bounds of the layer's nodes.
+  void renderNodes(const Layer& layer, const Box& canvas, const Box*& nodeBounds)
   {
-    if (!matchID(name)) {
-      return Optional<std::string>();
-    }
+    auto& evaluator = context.evaluator;
 
-    auto str = parseString();
-    if (!str.valid) {
-      return Optional<std::string>();
-    }
+    for (const auto& layerNode : layer.nodes) {
 
-    return str;
+      const auto* node = evaluator.evaluate(*layerNode);
+
+      auto bounds = nodeBounds ? *nodeBounds++ : (node ? boundsCalculator.calculate(*node) : Box());
+
+      if (!node || !bounds.intersects(canvas)) {
+        stats.countNodeCulled();
+        continue;
+      }
+
+      stats.countNodeVisited();
+
+      node->accept(*this);
+    }
   }
-  /// Attempts to parse a color channel.
+  /// Assigns the primary color being used by the painter.
   ///
-  /// @param name The name of the color channel value.
+  /// @note This function will premultiply the alpha channel of @p c.
   ///
-  /// @return Optionally returns a color channel value.
-  Optional<float> parseColorChannel(const char* name) noexcept
+  /// @param c The color to assign to the painter.
+  /// The alpha channel is ignored and the current
+  /// layer opacity is used in place of it.
+  /// @param index The index of the palette color to use in place
+  /// of @p c. This is ignored if it's not in the palette.
+  inline void setPrimaryColor(const RGBA& c, int index)
   {
-    auto nameTok = look();
+    auto inPalette = (index >= 0) && (std::size_t(index) < palette.size());
 
-    if (!matchID(name)) {
-      return Optional<float>();
-    }
+    const auto& rgba = inPalette ? palette[std::size_t(index)] : c;
 
-    auto i = parseInt();
-    if (!i.valid) {
-      formatError(nameTok) << "Failed to match color channel value following " << nameTok;
-      return Optional<float>();
-    }
+    primaryColor = Color(RGBA { rgba[0], rgba[1], rgba[2], layerOpacity * rgba[3] });
 
-    return Optional<float>(float(i.value) / colorRes());
+    primaryColor.index = inPalette ? index : -1;
   }
-  /// Parses for a string literal.
-  Optional<std::string> parseString()
+  /// Gets the color from a pixel at a certain point.
+  ///
+  /// @note This function does not perform bounds checking.
+  ///
+  /// @param p The point to get the pixel color from.
+  ///
+  /// @return The color at the specified point.
+  inline RGBA getPixel(const Vec2& p) const noexcept
   {
-    auto tok = look();
-    if (tok != TokenType::StringLiteral) {
-      formatError(tok) << "Expected a string literal, but got " << tok;
-      return Optional<std::string>();
+    return target.getPixel(p[0], p[1]);
+  }
+  /// Indicates if a point is in bounds or not.
+  ///
+  /// @param p The point to check.
+  ///
+  /// @return True on success, false on failure.
+  inline bool inBounds(const Vec2& p) const noexcept
+  {
+    return ((p[0] >= 0) && (std::size_t(p[0]) < target.getWidth()))
+        && ((p[1] >= 0) && (std::size_t(p[1]) < target.getHeight()));
+  }
+protected:
+  /// Fills an area on the image with a color.
+  /// The primary color is used as the fill color.
+  ///
+  /// @tparam Blender The type implementing the blend mode.
+  ///
+  /// @param origin The point to start at.
+  ///
+  /// @param prev The previous color.
+  template <typename Blender>
+  void fill(Blender, const Vec2& origin, const RGBA& prev)
+  {
+    if (!inBounds(origin)) {
+      return;
     }
 
-    std::string result;
+    std::size_t width = target.getWidth();
 
-    for (std::size_t i = 1; (i + 1) < tok.size; i++) {
+    int xMax = int(width);
+    int yMax = int(target.getHeight());
 
-      auto c = tok.data[i];
+    auto& stack = context.fillStack;
 
-      if (c == '\\') {
-        if ((i + 1) >= tok.size) {
-          parserError(tok, __LINE__);
-          return Optional<std::string>();
+    stack.clear();
+
+    // Blending does not always change the color of a pixel
+    // (for example, when the fill color is transparent) so the
+    // pixels that have already been filled are tracked explicitly.
+    context.resetVisited(width * target.getHeight());
+
+    stack.push_back(origin);
+
+    auto fillable = [this, width, &prev](int x, int y) {
+      stats.countFillPixelVisited();
+      return !context.isVisited((y * width) + x) && almostEqual(target.getPixel(x, y), prev);
+    };
+
+    while (!stack.empty()) {
+
+      auto p = stack.back();
+
+      stack.pop_back();
+
+      auto x1 = p[0];
+
+      while ((x1 >= 0) && fillable(x1, p[1])) {
+        x1--;
+      }
+
+      x1++;
+
+      auto spanAbove = false;
+      auto spanBelow = false;
+
+      // Only the rows above and below are examined while
+      // scanning, so the span is blended once it ends.
+      auto spanBegin = x1;
+
+      while ((x1 >= 0) && (x1 < xMax) && fillable(x1, p[1])) {
+
+        context.markVisited((p[1] * width) + x1);
+
+        if (!spanAbove && (p[1] > 0) && fillable(x1, p[1] - 1)) {
+          stack.push_back(Vec2 { x1, p[1] - 1 });
+          spanAbove = true;
+        } else if (spanAbove && (p[1] > 0) && !fillable(x1, p[1] - 1)) {
+          spanAbove = false;
         }
-        auto next = tok.data[i + 1];
-        if (next == 'r') {
-          result += '\r';
-        } else if (next == 'n') {
-          result += '\n';
-        } else if (next == '\\') {
-          result += '\\';
-        } else if (next == '"') {
-          result += '"';
-        } else {
-          formatError(tok) << "Invalid escape character found.";
-          return Optional<std::string>();
+
+        if (!spanBelow && (p[1] < (yMax - 1)) && fillable(x1, p[1] + 1)) {
+          stack.push_back(Vec2 { x1, p[1] + 1 });
+          spanBelow = true;
+        } else if (spanBelow && (p[1] < (yMax - 1)) && !fillable(x1, p[1] + 1)) {
+          spanBelow = false;
         }
-        i++;
-      } else {
-        result += c;
+
+        x1++;
       }
-    }
 
-    next();
+      if (spanBegin < x1) {
+        stats.countFillSpan();
+        stats.countBlended(std::size_t(x1 - spanBegin));
+      }
 
-    return Optional<std::string>(std::move(result));
+      target.template blendSpan<Blender>(spanBegin, x1, p[1], primaryColor);
+    }
   }
-  /// Parses for an integer vector.
-  ///
-  /// @tparam dims The number of dimensions used in the vector.
-  ///
-  /// @return Optionally returns the integer.
-  template <std::size_t dims>
-  Optional<Vector<int, dims>> parseVector() noexcept
-  {
-    using Result = Optional<Vector<int, dims>>;
+};
 
-    auto memo = pos;
+namespace {
 
-    Vector<int, dims> out;
+/// Converts a rectangle of rendered pixels into the pixels of a bitmap.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+///
+/// @param color The premultiplied color of the upper left pixel.
+/// @param w The width of the rectangle, in pixels.
+/// @param h The height of the rectangle, in pixels.
+/// @param stride The number of pixels from the start of one row to the next.
+///
+/// @return The pixels of the bitmap.
+std::shared_ptr<const BitmapData> toBitmapData(const float* color, std::size_t w, std::size_t h, std::size_t stride)
+{
+  std::vector<float> rgba(w * h * 4);
 
-    for (std::size_t i = 0; i < dims; i++) {
-      auto component = parseInt();
-      if (!component.valid) {
-        pos = memo;
-        return Result();
-      } else {
-        out[i] = component.value;
+  auto* dst = rgba.data();
+
+  for (std::size_t y = 0; y < h; y++) {
+
+    const float* src = color + (y * stride * 4);
+
+    for (std::size_t x = 0; x < w; x++, src += 4, dst += 4) {
+
+      // Bitmaps hold colors that are not premultiplied.
+
+      auto a = src[3];
+
+      if (a > 0) {
+        dst[0] = src[0] / a;
+        dst[1] = src[1] / a;
+        dst[2] = src[2] / a;
+        dst[3] = a;
       }
     }
-
-    return Result(out);
   }
-  /// Parses a named vector.
-  ///
-  /// @param name The name of the vector to parse.
-  ///
-  /// @return Optionally returns the vector if it is matched.
-  template <std::size_t dims>
-  Optional<Vector<int, dims>> parseVector(const char* name) noexcept
-  {
-    using Result = Optional<Vector<int, dims>>;
 
-    auto nameTok = look();
+  Bitmap bitmap;
 
-    if (!matchID(name)) {
-      return Result();
-    }
+  setPixels(&bitmap, rgba.data(), w, h);
 
-    auto v = parseVector<dims>();
-    if (!v.valid) {
-      formatError(nameTok) << "Failed to match vector following " << nameTok;
-      return Result();
-    }
+  return bitmap.data;
+}
 
-    return v;
+} // namespace
+
+const BitmapData* SymbolCache::find(std::size_t index, Vec2& origin) noexcept
+{
+  if (!symbols || (index >= symbols->size())) {
+    return nullptr;
   }
-  /// Parses for a single integer value.
-  ///
-  /// @parame name The name of the value.
-  Optional<int> parseInt(const char* name) noexcept
-  {
-    auto firstTok = look();
 
-    if (!matchID(name)) {
-      return Optional<int>();
-    }
+  try {
 
-    auto i = parseInt();
-    if (!i.valid) {
-      formatError(firstTok) << "Failed to parse integer following " << firstTok;
-      return Optional<int>();
-    }
+    entries.resize(symbols->size());
 
-    return i;
-  }
-  /// Parses for an integer value from
-  /// the next token.
-  Optional<int> parseInt() noexcept
-  {
-    auto numberToken = look();
-    if (numberToken != TokenType::Integer) {
-      return Optional<int>();
-    }
+    auto& entry = entries[index];
 
-    next();
+    // A symbol that could not be rendered isn't attempted again.
 
-    return parseInt(numberToken);
-  }
-  /// Parses a size value.
-  ///
-  /// @param name The name of the size value to parse.
-  ///
-  /// @return Optionally returns the size.
-  Optional<std::size_t> parseSize(const char* name) noexcept
-  {
-    auto tmp = parseInt(name);
-    if (!tmp.valid) {
-      return Optional<std::size_t>();
-    } else if (tmp.value < 0) {
-      formatError(previousTok()) << "Expected '" << name << "' to be positive.";
-      return Optional<std::size_t>();
+    if (!entry.rendered) {
+      entry.rendered = true;
+      render(*(*symbols)[index], entry);
     }
 
-    return Optional<std::size_t>(tmp.value);
+    origin = entry.origin;
+
+    return entry.data.get();
+
+  } catch (...) {
+    return nullptr;
   }
-  /// Indicates the number of tokens remaining to be parsed.
-  inline std::size_t remaining() const noexcept
-  {
-    return (pos < tokens.size()) ? tokens.size() - pos : 0;
+}
+
+void SymbolCache::render(const Symbol& symbol, Entry& entry)
+{
+  TraceScope traceScope("symbol");
+
+  if (!context) {
+    context.reset(new RenderContext());
   }
-protected:
-  /// Parses for common data found in stroke node derived classes.
-  /// This is meant to be called in a loop that parses the derived class.
-  ///
-  /// @param node A reference to the node that should be assigned the parsed data.
-  ///
-  /// @return True on a match, false on no match.
-  /// False does not indicate an error occurred.
-  bool parseStrokeNode(StrokeNode& node)
-  {
-    auto pixelSize = parseInt("pixel_size");
-    if (pixelSize.valid) {
-      node.pixelSize = safePixelSize(pixelSize.value);
-      return true;
-    }
 
-    auto blendMode = parseBlendMode("blend_mode");
-    if (blendMode.valid) {
-      node.blendMode = blendMode.value;
-      return true;
-    }
+  auto& evaluator = context->evaluator;
 
-    auto color = parseColor("color");
-    if (color.valid) {
-      node.color = color.value;
-      return true;
-    }
+  evaluator.setFrame(0);
 
-    return false;
-  }
-  /// Parses a list of vertices.
-  ///
-  /// @param name The name of the vertices.
-  /// @param vertices The array to put the vertices into.
-  ///
-  /// @return True on success, false on failure.
-  bool parseVertices(const char* name, std::vector<Vec2>& vertices)
-  {
-    if (!matchID(name)) {
-      return false;
-    }
+  evaluator.beginSymbol(Vec2 { 0, 0 });
 
-    while (remaining() && !failed()) {
+  // Fills and instances can reach any pixel, so they're left out of the
+  // box around the symbol, which confines fills to the other nodes.
 
-      if (matchID("end")) {
-        break;
-      }
+  BoundsCalculator boundsCalculator;
 
-      auto v = parseVector<2>();
-      if (!v.valid) {
-        formatError(look()) << "Failed to parse vector";
-        return false;
-      } else {
-        vertices.emplace_back(v.value);
-      }
-    }
+  Box box;
 
-    return true;
-  }
-  /// Parses for a set list of vertices.
-  bool parseVertices(const char* name, Vec2* vertices, std::size_t count) noexcept
-  {
-    auto firstTok = look();
+  for (const auto& symbolNode : symbol.layer.nodes) {
 
-    if (!matchID(name)) {
-      return false;
+    const auto* node = evaluator.evaluate(*symbolNode);
+
+    auto bounds = node ? boundsCalculator.calculate(*node) : Box();
+
+    if (bounds.empty() || (bounds.min == Box::unbounded().min)) {
+      continue;
     }
 
-    for (std::size_t i = 0; i < count; i++) {
+    box.include(bounds.min);
+    box.include(bounds.max);
+  }
 
-      auto v = parseVector<2>();
-      if (!v.valid) {
-        formatError(firstTok) << "Failed to match point " << i;
-        return false;
-      }
+  if (box.empty()) {
+    return;
+  }
 
-      vertices[i] = v.value;
-    }
+  auto w = std::uint64_t(std::int64_t(box.max[0]) - box.min[0] + 1);
+  auto h = std::uint64_t(std::int64_t(box.max[1]) - box.min[1] + 1);
 
-    return true;
+  if ((w * h) > maxSymbolPixels()) {
+    return;
   }
-  /// Attempts to parse a fill node.
-  NodePtr parseFillNode()
-  {
-    auto firstTok = look();
 
-    if (!matchID("fill")) {
-      return NodePtr();
-    }
+  std::vector<float> color(std::size_t(w * h * 4));
 
-    Fill fill;
+  Painter<DenseTarget> painter(DenseTarget(color.data(), std::size_t(w), std::size_t(h)), palette, *context);
 
-    while (remaining() && !failed()) {
+  painter.clear(transparent());
 
-      auto c = parseColor("color");
-      if (c.valid) {
-        fill.color = c.value;
-        continue;
-      }
+  painter.renderSymbol(symbol, Vec2 { 0, 0 } - box.min);
 
-      auto b = parseBlendMode("blend_mode");
-      if (b.valid) {
-        fill.blendMode = b.value;
-        continue;
-      }
+  entry.origin = box.min;
 
-      auto v = parseVector<2>("origin");
-      if (v.valid) {
-        fill.origin = v.value;
-        continue;
-      }
+  entry.data = toBitmapData(color.data(), std::size_t(w), std::size_t(h), std::size_t(w));
+}
 
-      if (matchID("end")) {
-        break;
-      } else if (failed()) {
-        return NodePtr();
-      } else {
-        formatError(firstTok) << "Missing 'end' statement";
-        return NodePtr();
-      }
-    }
+void render(const Document* doc, float* colorBuffer, std::size_t w, std::size_t h) noexcept
+{
+  RenderContext context;
 
-    if (failed()) {
-      return NodePtr();
-    } else {
-      return NodePtr(new Fill(std::move(fill)));
-    }
-  }
-  /// Attempts to parse an ellipse node.
-  NodePtr parseEllipseNode()
-  {
-    auto firstTok = look();
+  render(doc, colorBuffer, w, h, &context, nullptr);
+}
 
-    if (!matchID("ellipse")) {
-      return NodePtr();
+void render(const Document* doc, Image* image) noexcept
+{
+  render(doc, image->data, image->width, image->height);
+}
+
+namespace {
+
+/// Renders a document onto a render target.
+///
+/// @param doc The document to render.
+/// @param target The target to render the document onto.
+/// @param context The render context to take scratch memory from.
+/// @param stats The statistics to collect, which may be null.
+/// @param clear Whether or not to clear the target with the background first.
+/// @param frame The frame of the document to render.
+template <typename Target>
+void renderTo(const Document* doc,
+              const Target& target,
+              RenderContext& context,
+              RenderStats* stats,
+              bool clear = true,
+              std::size_t frame = 0) noexcept
+{
+  TraceScope traceScope("render", "pixels", double(target.getWidth() * target.getHeight()));
+
+  if (!stats) {
+
+    Painter<Target> painter(target, *doc, context);
+
+    if (clear) {
+      painter.clear(doc->background);
     }
 
-    Ellipse ellipse;
+    painter.renderLayers(doc->layers, frame);
 
-    while (remaining() && !failed()) {
+    return;
+  }
 
-      if (parseStrokeNode(ellipse)) {
-        continue;
-      }
+  try {
+    stats->reset(doc->layers.size());
+  } catch (...) {
+    return;
+  }
 
-      auto v = parseVector<2>("center");
-      if (v.valid) {
-        ellipse.center = v.value;
-        continue;
-      }
+  {
+    ActiveStats::Timer timer(stats->renderTime);
 
-      v = parseVector<2>("radius");
-      if (v.valid) {
-        ellipse.radius = v.value;
-        continue;
-      }
+    Painter<Target, ActiveStats> painter(target, *doc, context, ActiveStats(*stats));
 
-      if (matchID("end")) {
-        break;
-      } else if (failed()) {
-        break;
-      } else {
-        formatError(firstTok) << "Missing 'end' statement.";
-        return NodePtr();
-      }
+    if (clear) {
+      painter.clear(doc->background);
     }
 
-    if (failed()) {
-      return NodePtr();
-    } else {
-      return NodePtr(new Ellipse(std::move(ellipse)));
-    }
+    painter.renderLayers(doc->layers, frame);
   }
-  /// Attempts to parse a line node.
-  NodePtr parseLineNode()
-  {
-    auto firstTok = look();
 
-    if (!matchID("line")) {
-      return NodePtr();
-    }
+  stats->peakScratchMemory = context.getScratchMemorySize();
+}
+
+} // namespace
+
+void render(const Document* doc, float* colorBuffer, std::size_t w, std::size_t h, RenderContext* context, RenderStats* stats) noexcept
+{
+  renderTo(doc, DenseTarget(colorBuffer, w, h), *context, stats);
+}
+
+void render(const Document* doc,
+            float* colorBuffer,
+            std::size_t stride,
+            std::size_t x,
+            std::size_t y,
+            RenderContext* context,
+            bool clear,
+            RenderStats* stats) noexcept
+{
+  float* origin = colorBuffer + (((y * stride) + x) * 4);
 
-    Line line;
+  renderTo(doc, DenseTarget(origin, doc->width, doc->height, stride), *context, stats, clear);
+}
 
-    while (remaining() && !failed() && !matchID("end")) {
+bool render(const Document* doc, Image* image, RenderContext* context, RenderStats* stats) noexcept
+{
+  if (!tryResizeImage(image, doc->width, doc->height)) {
+    return false;
+  }
 
-      if (parseStrokeNode(line)) {
-        continue;
-      }
+  render(doc, image->data, image->width, image->height, context, stats);
 
-      if (parseVertices("points", line.points)) {
-        continue;
-      }
+  return true;
+}
 
-      if (!failed()) {
-        formatError(firstTok) << "Missing 'end' statement.";
-        return NodePtr();
-      }
-    }
+void renderFrame(const Document* doc,
+                 std::size_t frame,
+                 float* color,
+                 std::size_t w,
+                 std::size_t h,
+                 RenderContext* context,
+                 RenderStats* stats) noexcept
+{
+  renderTo(doc, DenseTarget(color, w, h), *context, stats, true, frame);
+}
 
-    if (failed()) {
-      return NodePtr();
-    } else {
-      return NodePtr(new Line(std::move(line)));
-    }
+bool renderFrame(const Document* doc, std::size_t frame, Image* image, RenderContext* context, RenderStats* stats) noexcept
+{
+  if (!tryResizeImage(image, doc->width, doc->height)) {
+    return false;
   }
-  /// Parses for a quadrilateral node.
-  NodePtr parseQuadNode()
-  {
-    auto firstTok = look();
 
-    if (!matchID("quad")) {
-      return NodePtr();
-    }
+  renderFrame(doc, frame, image->data, image->width, image->height, context, stats);
 
-    Quad quad;
+  return true;
+}
 
-    while (remaining() && !failed() && !matchID("end")) {
+void renderIndexed(const Document* doc,
+                   unsigned char* indices,
+                   std::size_t w,
+                   std::size_t h,
+                   RenderContext* context,
+                   std::size_t frame) noexcept
+{
+  renderTo(doc, IndexedTarget(indices, w, h, doc->palette), *context, nullptr, true, frame);
+}
 
-      if (parseStrokeNode(quad)) {
-        continue;
-      }
+namespace {
 
-      if (parseVertices("points", quad.points, 4)) {
-        continue;
-      }
+/// Converts palette indices into colors with a table of every index.
+///
+/// @param table The premultiplied color of each of the 256 indices,
+/// so that indices are looked up without checking their bounds.
+void remapIndices(const unsigned char* indices, std::size_t pixelCount, const RGBA* table, float* color) noexcept
+{
+  for (std::size_t i = 0; i < pixelCount; i++) {
 
-      if (!failed()) {
-        formatError(firstTok) << "Missing 'end' statement.";
-        return NodePtr();
-      }
-    }
+    const auto& c = table[indices[i]];
 
-    if (failed()) {
-      return NodePtr();
+    color[(i * 4) + 0] = c[0];
+    color[(i * 4) + 1] = c[1];
+    color[(i * 4) + 2] = c[2];
+    color[(i * 4) + 3] = c[3];
+  }
+}
+
+} // namespace
+
+void remapIndexed(const unsigned char* indices,
+                  std::size_t pixelCount,
+                  const float* palette,
+                  std::size_t paletteSize,
+                  float* color) noexcept
+{
+  RGBA table[256];
+
+  for (std::size_t i = 0; i < 256; i++) {
+    if (i < paletteSize) {
+      const float* c = palette + (i * 4);
+      table[i] = premultiply(clip(RGBA { c[0], c[1], c[2], c[3] }));
     } else {
-      return NodePtr(new Quad(std::move(quad)));
+      table[i] = transparent();
     }
   }
-  /// Converts an integer vector to a color value.
-  RGBA toColor(const Vector<int, 4>& v)
-  {
-    return RGBA {
-      float(v[0]) / colorRes(),
-      float(v[1]) / colorRes(),
-      float(v[2]) / colorRes(),
-      float(v[3]) / colorRes()
-    };
-  }
-  /// Attempts to match a name.
-  /// If a name is matched, then the
-  /// parser is moved passed its position.
-  ///
-  /// @param name The name to match.
-  ///
-  /// @return True if the name was found,
-  /// false if it was not.
-  bool matchID(const char* name) noexcept
-  {
-    auto nameToken = look();
-    if (nameToken != TokenType::Identifier) {
-      return false;
-    }
 
-    if (nameToken != name) {
-      return false;
-    }
+  remapIndices(indices, pixelCount, table, color);
+}
 
-    next();
+void remapIndexed(const Document* doc, const unsigned char* indices, std::size_t pixelCount, float* color) noexcept
+{
+  RGBA table[256];
 
-    return true;
+  for (std::size_t i = 0; i < 256; i++) {
+    table[i] = premultiply((i < doc->palette.size()) ? doc->palette[i] : doc->background);
   }
-  /// Parses a decimal integer from a string.
-  ///
-  /// @param tok The token containing the string to parse.
-  ///
-  /// @return On success, a valid integer instance is returned.
-  /// On failure, an optional container that evaluates to zero.
-  Optional<int> parseInt(const Token& tok) noexcept
-  {
-    const char* str = tok.data;
-    std::size_t s = tok.size;
 
-    if (!s) {
-      return Optional<int>();
-    }
+  remapIndices(indices, pixelCount, table, color);
+}
 
-    std::size_t pos = 0;
+namespace {
 
-    bool neg = (str[0] == '-');
-    if (neg) {
-      pos++;
-    }
+/// Detects nodes whose pixels depend on the pixels beneath them,
+/// which are fills and nodes that subtract from the canvas. A layer
+/// with these nodes can't be baked on its own without changing how
+/// it looks.
+class BackdropDetector final : public NodeAccessor
+{
+  /// Whether or not such a node was accessed.
+  bool found = false;
+public:
+  /// Indicates whether or not a layer contains such a node.
+  bool detect(const Layer& layer) noexcept
+  {
+    found = false;
 
-    int value = 0;
+    for (const auto& node : layer.nodes) {
+      node->accept(*this);
+    }
 
-    auto isDec = [](char c) { return (c >= '0') && (c <= '9'); };
+    return found;
+  }
+  void access(const Ellipse& e) noexcept override { found |= (e.blendMode != BlendMode::Normal); }
+  void access(const Fill&) noexcept override { found = true; }
+  void access(const Line& l) noexcept override { found |= (l.blendMode != BlendMode::Normal); }
+  void access(const Quad& q) noexcept override { found |= (q.blendMode != BlendMode::Normal); }
+  void access(const Bitmap& b) noexcept override { found |= (b.blendMode != BlendMode::Normal); }
+  void access(const Instance& i) noexcept override { found |= (i.blendMode != BlendMode::Normal); }
+  void access(const Polygon& p) noexcept override { found |= (p.blendMode != BlendMode::Normal); }
+};
 
-    while (pos < s) {
+} // namespace
 
-      if (!isDec(str[pos])) {
-        formatError(tok) << "Non-decimal character found in " << tok;
-        break;
-      }
+bool bakeLayer(Document* doc, std::size_t index)
+{
+  if (index >= doc->layers.size()) {
+    return false;
+  }
 
-      value *= 10;
-      value += int(str[pos] - '0');
+  auto& layer = *doc->layers[index];
 
-      pos++;
-    }
+  // A bitmap only holds one frame.
 
-    return neg ? -value : value;
+  if (layer.animation.animated()) {
+    return false;
   }
-  /// Gets a previous token that the parser
-  /// has moved passed.
-  Token previousTok(std::size_t offset = 1) const noexcept
-  {
-    if (offset > pos) {
-      return Token();
-    }
 
-    return tokens[pos - offset];
-  }
-  /// Goes to the next number of tokens.
-  ///
-  /// @param count The number of tokens to go passed.
-  void next(std::size_t count = 1) noexcept
-  {
-    pos += count;
-  }
-  /// Gets a token at a certain offset.
-  Token look(std::size_t offset = 0) const noexcept
-  {
-    if (inBounds(offset)) {
-      return tokens[pos + offset];
-    } else {
-      return Token();
+  for (const auto& node : layer.nodes) {
+    if (node->animation.animated()) {
+      return false;
     }
   }
-  /// Indicates if a certain offset is in bounds.
-  inline bool inBounds(std::size_t offset) const noexcept
-  {
-    return (pos + offset) < tokens.size();
-  }
-  /// Emits an error indicating that an internal parser
-  /// error has occurred.
-  void parserError(const Token& t, int line)
-  {
-    auto& stream = formatError(t);
-    stream << "Internal parser error occurred (";
-    stream << __FILE__;
-    stream << ':';
-    stream << line;
-    stream << "). Please report an issue!";
+
+  if (BackdropDetector().detect(layer)) {
+    return false;
   }
-  /// Creates an error and returns it for formatting.
-  ///
-  /// @param t The token that caused the error.
-  /// The position information is used to indicate
-  /// where the error occurred.
-  ///
-  /// @return A reference to the stream that can be
-  /// used to format the error.
-  std::ostream& formatError(const Token& t)
-  {
-    if (failedFlag) {
-      return suppressed;
-    }
 
-    failedFlag = true;
+  auto w = doc->width;
+  auto h = doc->height;
 
-    Error error {
-      std::ostringstream(),
-      std::string(),
-      t.line,
-      t.column,
-      t.pos,
-      t.size
-    };
+  std::vector<float> color(w * h * 4);
 
-    errorList.errors.emplace_back(std::move(error));
+  {
+    RenderContext context;
 
-    return errorList.errors[errorList.errors.size() - 1].stream;
+    Painter<DenseTarget> painter(DenseTarget(color.data(), w, h), *doc, context);
+
+    painter.clear(transparent());
+
+    painter.renderLayerNodes(layer);
   }
-};
 
-} // namespace
+  // The bitmap is cropped to the pixels that were painted,
+  // so that its rows don't begin and end with empty runs.
 
-//===================//
-// Section: Document //
-//===================//
+  std::size_t x0 = w;
+  std::size_t y0 = h;
+  std::size_t x1 = 0;
+  std::size_t y1 = 0;
 
-/// Contains the implementation data of the document class.
-struct Document final
-{
-  /// The layers of the document, each containing the
-  /// draw operations to be completed by the painer.
-  /// The first layer is returned first and is therefore
-  /// the "bottom" layer.
-  std::vector<LayerPtr> layers;
-  /// The width of the document, in pixels.
-  std::size_t width = 64;
-  /// The height of the document, in pixels.
-  std::size_t height = 64;
-  /// The default background color.
-  RGBA background = transparent();
-  /// Makes a new document.
-  Document()
-  {
-    addLayer(this);
+  for (std::size_t y = 0; y < h; y++) {
+    for (std::size_t x = 0; x < w; x++) {
+      if (color[(((y * w) + x) * 4) + 3] > 0) {
+        x0 = min(x0, x);
+        y0 = min(y0, y);
+        x1 = max(x1, x + 1);
+        y1 = max(y1, y + 1);
+      }
+    }
   }
-  /// Makes a copy of the document.
-  ///
-  /// @param other The document to copy.
-  Document(const Document& other)
-  {
-    width = other.width;
-    height = other.height;
-    background = other.background;
 
-    for (const auto& otherLayer : other.layers) {
-      layers.emplace_back(new Layer(*otherLayer));
-    }
+  if (((x1 - x0) > maxBitmapSize) || ((y1 - y0) > maxBitmapSize)) {
+    return false;
   }
-  /// Resets back to initial state.
-  void reset()
-  {
-    *this = Document();
+
+  std::unique_ptr<Bitmap> bitmap;
+
+  if (x0 < x1) {
+
+    bitmap.reset(new Bitmap());
+
+    bitmap->position = Vec2 { int(x0), int(y0) };
+
+    bitmap->data = toBitmapData(color.data() + (((y0 * w) + x0) * 4), x1 - x0, y1 - y0, w);
   }
-  /// Moves a document to a new variable
-  /// via move semantics.
-  Document& operator = (Document&& other)
-  {
-    layers = std::move(other.layers);
-    width = other.width;
-    height = other.height;
-    background = other.background;
-    return *this;
+
+  std::vector<NodePtr> nodes;
+
+  if (bitmap) {
+    nodes.emplace_back(std::move(bitmap));
   }
-};
 
-namespace {
+  layer.nodes.swap(nodes);
 
-/// Indicates if a layer name exists already.
-/// This is used when automatically naming layers,
-/// so that the automatically generated layer has a
-/// unique name (even though it doesn't need one.)
-///
-/// @param doc The document to check the layer names for.
-/// @param name The name to search for.
-///
-/// @return True if the name exists, false if it does not.
-bool layerNameExists(const Document* doc, const char* name) noexcept
+  return true;
+}
+
+bool render(const Document* doc, TiledImage* image, RenderContext* context, RenderStats* stats) noexcept
 {
-  for (const auto& l : doc->layers) {
-    if (l->name == name) {
-      return true;
+  if ((image->width != doc->width) || (image->height != doc->height)) {
+    try {
+      image->resize(doc->width, doc->height);
+    } catch (...) {
+      return false;
     }
   }
 
-  return false;
+  renderTo(doc, TiledTarget(image), *context, stats);
+
+  return !image->outOfMemory;
 }
 
-/// Formats a layer name.
-///
-/// @param index The index to put into the layer name.
-///
-/// @return The formatted layer name.
-std::string formatLayerName(std::size_t index)
+namespace {
+
+/// Used to find the fill nodes of a document.
+class FillDetector final : public NodeAccessor
 {
-  std::stringstream stream;
-  stream << "Layer ";
-  stream << index;
-  return stream.str();
-}
+  /// Whether or not a fill node was accessed.
+  bool found = false;
+public:
+  /// Indicates whether or not any visible layer of a document contains a fill.
+  bool detect(const Document& doc) noexcept
+  {
+    found = false;
 
-/// Generates a unique layer name.
-///
-/// @param doc The document to generate the layer name for.
+    for (const auto& layer : doc.layers) {
+
+      if (!layer->visible) {
+        continue;
+      }
+
+      for (const auto& node : layer->nodes) {
+        node->accept(*this);
+      }
+    }
+
+    return found;
+  }
+  void access(const Ellipse&) noexcept override {}
+  void access(const Fill&) noexcept override { found = true; }
+  void access(const Line&) noexcept override {}
+  void access(const Quad&) noexcept override {}
+  void access(const Bitmap&) noexcept override {}
+  void access(const Instance&) noexcept override {}
+  void access(const Polygon&) noexcept override {}
+};
+
+/// Renders a document onto a tiled image and
+/// passes the rows of the image to a row sink.
 ///
-/// @return The unique layer name.
-std::string uniqueLayerName(const Document* doc)
+/// This is used for documents containing fills,
+/// since a fill may depend on any pixel of the canvas.
+bool renderRowsTiled(const Document* doc, std::vector<float>& band, std::size_t bandHeight, RowSink sink, void* sinkData, RenderContext& context)
 {
-  for (std::size_t i = doc->layers.size() + 1; i < SIZE_MAX; i++) {
+  TiledImage image;
 
-    auto name = formatLayerName(i);
-    if (!layerNameExists(doc, name.c_str())) {
-      return name;
-    }
+  image.resize(doc->width, doc->height);
+
+  renderTo(doc, TiledTarget(&image), context, nullptr);
+
+  if (image.outOfMemory) {
+    return false;
   }
 
-  // It would be odd if this was reached.
+  for (std::size_t y0 = 0; y0 < doc->height; y0 += bandHeight) {
 
-  return "";
+    auto rows = min(bandHeight, doc->height - y0);
+
+    for (std::size_t y = y0; y < (y0 + rows); y++) {
+
+      float* dst = &band[(y - y0) * doc->width * 4];
+
+      for (std::size_t tileX = 0; tileX < image.tileCountX; tileX++) {
+
+        const float* tile = image.getTile(tileX, y >> tileShift());
+
+        const float* src = tile + ((y & tileMask()) * tileSize() * 4);
+
+        auto x0 = tileX << tileShift();
+
+        auto count = min(tileSize(), doc->width - x0);
+
+        std::memcpy(dst + (x0 * 4), src, count * 4 * sizeof(float));
+      }
+    }
+
+    if (!sink(sinkData, y0, rows, band.data())) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 } // namespace
 
-Document* createDoc()
+bool renderRows(const Document* doc, std::size_t bandHeight, RowSink sink, void* sinkData, RenderContext* context) noexcept
 {
-  return new Document();
-}
+  TraceScope traceScope("renderRows", "bandHeight", double(bandHeight));
 
-void closeDoc(Document* doc) noexcept
-{
-  delete doc;
-}
+  bandHeight = max(min(bandHeight, doc->height), std::size_t(1));
 
-Document* copyDoc(const Document* doc)
-{
-  return new Document(*doc);
-}
+  try {
 
-int openDoc(Document* doc, const char* filename, ErrorList** errListPtr)
-{
-  if (errListPtr) {
-    *errListPtr = nullptr;
+    std::vector<float> band(doc->width * bandHeight * 4);
+
+    if (FillDetector().detect(*doc)) {
+      return renderRowsTiled(doc, band, bandHeight, sink, sinkData, *context);
+    }
+
+    // The bounds of each node are calculated once
+    // here, instead of once per band by the painter.
+
+    std::vector<Box> nodeBounds;
+
+    BoundsCalculator boundsCalculator;
+
+    auto& evaluator = context->evaluator;
+
+    evaluator.setFrame(0);
+
+    for (const auto& layer : doc->layers) {
+
+      if (!layer->visible) {
+        continue;
+      }
+
+      evaluator.beginLayer(*layer);
+
+      for (const auto& layerNode : layer->nodes) {
+        const auto* node = evaluator.evaluate(*layerNode);
+        nodeBounds.push_back(node ? boundsCalculator.calculate(*node) : Box());
+      }
+    }
+
+    // One painter renders every band, so that
+    // symbols are only rendered for the first one.
+
+    Painter<BandTarget> painter(BandTarget(band.data(), doc->width, doc->height, 0, 0), *doc, *context);
+
+    for (std::size_t y0 = 0; y0 < doc->height; y0 += bandHeight) {
+
+      auto rows = min(bandHeight, doc->height - y0);
+
+      painter.setTarget(BandTarget(band.data(), doc->width, doc->height, int(y0), int(y0 + rows)));
+
+      painter.clear(doc->background);
+
+      painter.renderLayers(doc->layers, 0, nodeBounds.data());
+
+      if (!sink(sinkData, y0, rows, band.data())) {
+        return false;
+      }
+    }
+
+  } catch (...) {
+    return false;
   }
 
-  *doc = Document();
+  return true;
+}
 
-  doc->layers.clear();
+//==========================//
+// Section: Frame Rendering //
+//==========================//
 
-  if (!filename) {
-    return EFAULT;
+namespace {
+
+/// Adds values to a 64-bit FNV-1a hash.
+class Hasher final
+{
+  /// The hash of the values added so far.
+  std::uint64_t hash = 14695981039346656037ULL;
+public:
+  /// Adds the bytes of a value to the hash.
+  template <typename T>
+  void add(const T& value) noexcept
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be hashed.");
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
   }
+  /// Adds a list of points to the hash.
+  void add(const std::vector<Vec2>& points) noexcept
+  {
+    add(points.size());
 
-  errno = 0;
+    for (const auto& p : points) {
+      add(p);
+    }
+  }
+  /// Adds the colors of a palette to the hash.
+  void add(const Palette& palette) noexcept
+  {
+    add(palette.size());
 
-  std::ifstream file(filename);
-  if (!file.good()) {
-    return errno;
+    for (const auto& c : palette) {
+      add(c);
+    }
+  }
+  /// Gets the hash of the values added so far.
+  inline std::uint64_t get() const noexcept
+  {
+    return hash;
   }
+};
 
-  std::stringstream buf;
+/// The parts of a frame that are rendered and cached.
+enum class FramePart : int
+{
+  /// The background and every layer.
+  Whole,
+  /// The background and the static layers,
+  /// which is the same on every frame.
+  Static,
+  /// The layers above the static ones,
+  /// on a transparent background.
+  Animated
+};
 
-  buf << file.rdbuf();
+/// Splits a document into the layers that look the same on every frame,
+/// which are the visible ones below the first animated layer, and the
+/// layers above them.
+///
+/// Parts of frames are identified by a hash of everything that affects how
+/// they look. The document is hashed once, with the animations left out,
+/// and each frame only adds the states of the animations to that. Parts
+/// that look the same have the same hash, whether they're on different
+/// frames or in different versions of the document, so an edit only
+/// misses the cache on the frames that it changes.
+class FrameScene final : public NodeAccessor
+{
+  /// The document being rendered.
+  const Document& doc;
+  /// The number of layers below the first visible animated layer.
+  std::size_t staticLayers = 0;
+  /// The animations of the visible layers and nodes, in the order they're drawn.
+  std::vector<const AnimationPtr*> animations;
+  /// The hash of the background and the static layers.
+  std::uint64_t staticHash = 0;
+  /// The hash of the layers above the static ones.
+  std::uint64_t animatedHash = 0;
+  /// The hash that visited nodes are added to.
+  Hasher* hasher = nullptr;
+public:
+  /// Analyzes a document.
+  ///
+  /// @exception std::bad_alloc If the animations could not be listed.
+  explicit FrameScene(const Document& d) : doc(d)
+  {
+    const auto& layers = doc.layers;
 
-  std::string content(buf.str());
+    while ((staticLayers < layers.size())
+        && (!layers[staticLayers]->visible || !isAnimated(*layers[staticLayers]))) {
+      staticLayers++;
+    }
 
-  Parser parser(content.data(), content.size());
+    Hasher staticHasher;
+    staticHasher.add(doc.width);
+    staticHasher.add(doc.height);
+    staticHasher.add(doc.background);
+    staticHasher.add(doc.palette);
+    addSymbols(staticHasher);
+    addLayers(staticHasher, 0, staticLayers);
+    staticHash = staticHasher.get();
+
+    Hasher animatedHasher;
+    animatedHasher.add(doc.width);
+    animatedHasher.add(doc.height);
+    animatedHasher.add(doc.palette);
+    addSymbols(animatedHasher);
+    addLayers(animatedHasher, staticLayers, layers.size());
+    animatedHash = animatedHasher.get();
+  }
+  /// Gets the document being rendered.
+  inline const Document& getDocument() const noexcept
+  {
+    return doc;
+  }
+  /// Gets the number of layers that look the same on every frame.
+  inline std::size_t getStaticLayers() const noexcept
+  {
+    return staticLayers;
+  }
+  /// Identifies a part of a frame, for the frame cache.
+  std::uint64_t identify(std::size_t frame, FramePart part) const noexcept
+  {
+    Hasher h;
 
-  while (parser.remaining() && !parser.failed()) {
+    h.add(part);
 
-    auto w = parser.parseSize("width");
-    if (w.valid) {
-      doc->width = w.value;
-      continue;
-    } else if (parser.failed()) {
-      break;
+    if (part != FramePart::Animated) {
+      h.add(staticHash);
     }
 
-    auto h = parser.parseSize("height");
-    if (h.valid) {
-      doc->height = h.value;
-      continue;
-    } else if (parser.failed()) {
-      break;
+    if (part == FramePart::Static) {
+      return h.get();
     }
 
-    auto bg = parser.parseColor("background");
-    if (bg.valid) {
-      doc->background = bg.value;
-      continue;
-    } else if (parser.failed()) {
-      break;
+    h.add(animatedHash);
+
+    for (const auto* animation : animations) {
+      addState(h, animation->evaluate(frame));
     }
 
-    auto node = parser.parseNode();
-    if (node) {
-      if (doc->layers.empty()) {
-        addLayer(doc);
+    return h.get();
+  }
+  /// Indicates whether or not every animation is in the same state on two frames.
+  bool sameFrame(std::size_t a, std::size_t b) const noexcept
+  {
+    for (const auto* animation : animations) {
+      if (!animation->evaluate(a).sameAs(animation->evaluate(b))) {
+        return false;
       }
-      doc->layers[0]->nodes.emplace_back(std::move(node));
-      continue;
-    } else if (parser.failed()) {
-      break;
     }
 
-    auto layer = parser.parseLayer();
-    if (layer) {
-      doc->layers.emplace_back(std::move(layer));
-      continue;
-    } else if (parser.failed()) {
-      break;
+    return true;
+  }
+  /// Renders a part of a frame.
+  ///
+  /// @param frame The frame to render.
+  /// @param part The part of the frame to render.
+  /// @param base The static part, which the whole frame is rendered on top
+  /// of. This is only used for the whole frame, when there are static layers.
+  /// @param colors The color buffer to render into.
+  /// @param context The render context to take scratch memory from.
+  void render(std::size_t frame,
+              FramePart part,
+              const std::vector<float>* base,
+              float* colors,
+              RenderContext& context) const noexcept
+  {
+    Painter<DenseTarget> painter(DenseTarget(colors, doc.width, doc.height), doc, context);
+
+    switch (part) {
+      case FramePart::Whole:
+        if (staticLayers) {
+          std::copy(base->begin(), base->end(), colors);
+        } else {
+          painter.clear(doc.background);
+        }
+        painter.renderLayers(doc.layers, frame, nullptr, staticLayers);
+        break;
+      case FramePart::Static:
+        painter.clear(doc.background);
+        painter.renderLayers(doc.layers, frame, nullptr, 0, staticLayers);
+        break;
+      case FramePart::Animated:
+        painter.clear(transparent());
+        painter.renderLayers(doc.layers, frame, nullptr, staticLayers);
+        break;
+    }
+  }
+  void access(const Ellipse& ellipse) noexcept override
+  {
+    hasher->add(NodeType::Ellipse);
+    addStroke(ellipse);
+    hasher->add(ellipse.center);
+    hasher->add(ellipse.radius);
+    hasher->add(ellipse.filled);
+  }
+  void access(const Fill& fill) noexcept override
+  {
+    hasher->add(NodeType::Fill);
+    hasher->add(fill.blendMode);
+    hasher->add(fill.color);
+    hasher->add(fill.colorIndex);
+    hasher->add(fill.origin);
+  }
+  void access(const Line& line) noexcept override
+  {
+    hasher->add(NodeType::Line);
+    addStroke(line);
+    hasher->add(line.points);
+  }
+  void access(const Quad& quad) noexcept override
+  {
+    hasher->add(NodeType::Quad);
+    addStroke(quad);
+    hasher->add(quad.points);
+    hasher->add(quad.filled);
+  }
+  void access(const Bitmap& bitmap) noexcept override
+  {
+    hasher->add(NodeType::Bitmap);
+    hasher->add(bitmap.blendMode);
+    hasher->add(bitmap.position);
+
+    if (!bitmap.data) {
+      return;
+    }
+
+    hasher->add(bitmap.data->width);
+    hasher->add(bitmap.data->height);
+    hasher->add(bitmap.data->colors);
+
+    for (const auto& run : bitmap.data->runs) {
+      hasher->add(run);
+    }
+  }
+  void access(const Instance& instance) noexcept override
+  {
+    hasher->add(NodeType::Instance);
+    hasher->add(instance.symbol);
+    hasher->add(instance.position);
+    hasher->add(instance.blendMode);
+  }
+  void access(const Polygon& polygon) noexcept override
+  {
+    hasher->add(NodeType::Polygon);
+    addStroke(polygon);
+    hasher->add(polygon.points);
+  }
+protected:
+  /// Indicates whether or not a layer, or any of its nodes, has keyframes.
+  static bool isAnimated(const Layer& layer) noexcept
+  {
+    if (layer.animation.animated()) {
+      return true;
+    }
+
+    for (const auto& node : layer.nodes) {
+      if (node->animation.animated()) {
+        return true;
+      }
     }
 
-    parser.badToken();
-    break;
+    return false;
   }
+  /// Adds a range of layers to a hash and lists their animations.
+  /// Only the presence of an animation is added to the hash,
+  /// since its state is added for each frame.
+  void addLayers(Hasher& h, std::size_t first, std::size_t last)
+  {
+    hasher = &h;
 
-  if (parser.failed()) {
+    for (std::size_t i = first; i < last; i++) {
 
-    if (errListPtr) {
-      *errListPtr = parser.getErrorList(filename, std::move(content));
+      const auto& layer = *doc.layers[i];
+
+      h.add(layer.visible);
+
+      if (!layer.visible) {
+        continue;
+      }
+
+      h.add(layer.opacity);
+      h.add(addAnimation(layer.animation));
+      h.add(layer.nodes.size());
+
+      for (const auto& node : layer.nodes) {
+        h.add(addAnimation(node->animation));
+        node->accept(*this);
+      }
     }
 
-    return EINVAL;
+    hasher = nullptr;
   }
+  /// Adds the symbols to a hash. Since symbols are drawn as they
+  /// are at the first frame, their nodes are added in that state.
+  void addSymbols(Hasher& h) noexcept
+  {
+    hasher = &h;
 
-  return 0;
-}
+    FrameEvaluator evaluator;
 
-namespace {
+    evaluator.setFrame(0);
 
-/// Encodes the document onto a stream.
-///
-/// @param doc The document to encode.
-/// @param stream The stream to encode the document to.
-void encodeDoc(const Document* doc, std::ostream& stream)
-{
-  Encoder encoder(stream);
+    h.add(doc.symbols.size());
 
-  encoder.encodeSize("width", doc->width);
-  encoder.encodeSize("height", doc->height);
-  encoder.encodeColor("background", doc->background);
+    for (const auto& symbol : doc.symbols) {
 
-  for (const auto& layer : doc->layers) {
-    encoder.encodeLayer(*layer);
-  }
-}
+      evaluator.beginSymbol(Vec2 { 0, 0 });
 
-} // namespace
+      h.add(symbol->layer.nodes.size());
 
-bool saveDoc(const Document* doc, const char* filename)
-{
-  std::ofstream file(filename);
-  if (!file.good()) {
-    return false;
-  }
+      for (const auto& symbolNode : symbol->layer.nodes) {
 
-  encodeDoc(doc, file);
+        const auto* node = evaluator.evaluate(*symbolNode);
 
-  return true;
-}
+        h.add(node != nullptr);
 
-void saveDoc(const Document* doc, void** data, std::size_t* size)
-{
-  // Hardly the best approach but it's nice and simple.
+        if (node) {
+          node->accept(*this);
+        }
+      }
+    }
 
-  std::ostringstream stream;
+    hasher = nullptr;
+  }
+  /// Lists an animation, if it has keyframes.
+  ///
+  /// @return Whether or not the animation was listed.
+  bool addAnimation(const AnimationPtr& animation)
+  {
+    if (!animation.animated()) {
+      return false;
+    }
 
-  encodeDoc(doc, stream);
+    animations.push_back(&animation);
 
-  auto tmp = stream.str();
+    return true;
+  }
+  /// Adds the state of an animation to a hash.
+  static void addState(Hasher& h, const AnimationState& state) noexcept
+  {
+    h.add(state.pivot);
+    h.add(state.translation);
+    h.add(state.scale);
+    h.add(state.weight);
+    h.add(state.from->pointOffsets);
+    h.add(state.to->pointOffsets);
+  }
+  /// Adds the stroke properties of a node to the hash.
+  void addStroke(const StrokeNode& strokeNode) noexcept
+  {
+    hasher->add(strokeNode.pixelSize);
+    hasher->add(strokeNode.blendMode);
+    hasher->add(strokeNode.color);
+    hasher->add(strokeNode.colorIndex);
+  }
+};
 
-  *data = std::malloc(tmp.size());
-  *size = tmp.size();
+/// The colors of a rendered frame, which are shared
+/// between the frame cache and the frames reusing them.
+using FrameColors = std::shared_ptr<const std::vector<float>>;
 
-  std::memcpy(*data, tmp.data(), tmp.size());
-}
+} // namespace
 
-Layer* addLayer(Document* doc)
+/// Holds recently rendered frames, up to a memory budget.
+struct FrameCache final
 {
-  LayerPtr layer(new Layer());
-
-  layer->name = uniqueLayerName(doc);
+  /// A cached frame.
+  struct Entry final
+  {
+    /// The hash that identifies the frame.
+    std::uint64_t key = 0;
+    /// The colors of the frame.
+    FrameColors colors;
+  };
+  /// The cached frames, from the most recently used to the least.
+  std::list<Entry> entries;
+  /// Used to find frames in @ref FrameCache::entries by their keys.
+  std::map<std::uint64_t, std::list<Entry>::iterator> lookup;
+  /// The most memory that the frames may use, in bytes.
+  std::size_t budget = 0;
+  /// The memory used by the frames, in bytes.
+  std::size_t size = 0;
+  /// The number of frames that were found.
+  std::size_t hits = 0;
+  /// The number of frames that were not found.
+  std::size_t misses = 0;
+  /// Guards the cache, so that renders on several threads may share it.
+  mutable std::mutex mutex;
+  /// Gets the size of a frame, in bytes.
+  static std::size_t sizeOf(const FrameColors& colors) noexcept
+  {
+    return colors->size() * sizeof(float);
+  }
+  /// Finds a frame and marks it as the most recently used one.
+  ///
+  /// @return The colors of the frame, or null if it isn't cached.
+  FrameColors find(std::uint64_t key) noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex);
 
-  doc->layers.emplace_back(layer.get());
+    auto it = lookup.find(key);
+    if (it == lookup.end()) {
+      misses++;
+      return FrameColors();
+    }
 
-  return layer.release();
-}
+    hits++;
 
-void removeLayer(Document* doc, std::size_t layer)
-{
-  // std::vector::erase causes UB if the index
-  // is out of bounds, so we have to manually check
-  // and throw an exception if that's the case.
+    entries.splice(entries.begin(), entries, it->second);
 
-  if (layer >= doc->layers.size()) {
-    throw std::out_of_range("Layer index is out of range");
+    return it->second->colors;
   }
+  /// Adds a frame, evicting the least recently used ones to make room.
+  /// Frames larger than the whole budget are not added.
+  void insert(std::uint64_t key, const FrameColors& colors)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
 
-  doc->layers.erase(doc->layers.begin() + layer);
-}
+    auto frameSize = sizeOf(colors);
 
-Layer* getLayer(Document* doc, std::size_t layer)
-{
-  return doc->layers.at(layer).get();
-}
+    if ((frameSize > budget) || (lookup.find(key) != lookup.end())) {
+      return;
+    }
 
-const Layer* getLayer(const Document* doc, std::size_t layer)
-{
-  return doc->layers.at(layer).get();
-}
+    evict(budget - frameSize);
 
-std::size_t getLayerCount(const Document* doc) noexcept
-{
-  return doc->layers.size();
-}
+    entries.push_front(Entry { key, colors });
 
-void moveLayer(Document* doc, std::size_t src, std::size_t dst)
-{
-  LayerPtr tmp = std::move(doc->layers.at(src));
+    try {
+      lookup.emplace(key, entries.begin());
+    } catch (...) {
+      entries.pop_front();
+      throw;
+    }
 
-  for (std::size_t i = src; i < dst; i++) {
-    doc->layers.at(i) = std::move(doc->layers.at(i + 1));
+    size += frameSize;
   }
-
-  for (std::size_t i = src; i > dst; i--) {
-    doc->layers.at(i) = std::move(doc->layers.at(i - 1));
+  /// Evicts the least recently used frames until the memory fits in a
+  /// limit. The mutex must be locked by the caller.
+  void evict(std::size_t limit) noexcept
+  {
+    while (!entries.empty() && (size > limit)) {
+      size -= sizeOf(entries.back().colors);
+      lookup.erase(entries.back().key);
+      entries.pop_back();
+    }
   }
+};
 
-  doc->layers.at(dst) = std::move(tmp);
-}
-
-Ellipse* addEllipse(Document* doc, std::size_t layer)
+FrameCache* createFrameCache(std::size_t memoryBudget)
 {
-  return doc->layers.at(layer)->addNode(new Ellipse());
+  auto* cache = new FrameCache();
+  cache->budget = memoryBudget;
+  return cache;
 }
 
-Fill* addFill(Document* doc, std::size_t layer)
+void closeFrameCache(FrameCache* cache) noexcept
 {
-  return doc->layers.at(layer)->addNode(new Fill());
+  delete cache;
 }
 
-Line* addLine(Document* doc, std::size_t layer)
+void setFrameCacheBudget(FrameCache* cache, std::size_t memoryBudget) noexcept
 {
-  return doc->layers.at(layer)->addNode(new Line());
+  std::lock_guard<std::mutex> lock(cache->mutex);
+  cache->budget = memoryBudget;
+  cache->evict(memoryBudget);
 }
 
-Quad* addQuad(Document* doc, std::size_t layer)
+void clearFrameCache(FrameCache* cache) noexcept
 {
-  return doc->layers.at(layer)->addNode(new Quad());
+  std::lock_guard<std::mutex> lock(cache->mutex);
+  cache->evict(0);
 }
 
-std::size_t getDocWidth(const Document* doc) noexcept { return doc->width; }
-
-std::size_t getDocHeight(const Document* doc) noexcept { return doc->height; }
-
-void getBackground(const Document* doc, float* bg) noexcept
+std::size_t getFrameCacheSize(const FrameCache* cache) noexcept
 {
-  bg[0] = doc->background[0];
-  bg[1] = doc->background[1];
-  bg[2] = doc->background[2];
-  bg[3] = doc->background[3];
+  std::lock_guard<std::mutex> lock(cache->mutex);
+  return cache->size;
 }
 
-void resizeDoc(Document* doc, std::size_t width, std::size_t height) noexcept
+std::size_t getFrameCacheHits(const FrameCache* cache) noexcept
 {
-  doc->width = width;
-  doc->height = height;
+  std::lock_guard<std::mutex> lock(cache->mutex);
+  return cache->hits;
 }
 
-void setBackground(Document* doc, float r, float g, float b, float a) noexcept
+std::size_t getFrameCacheMisses(const FrameCache* cache) noexcept
 {
-  doc->background = clip(RGBA { r, g, b, a });
+  std::lock_guard<std::mutex> lock(cache->mutex);
+  return cache->misses;
 }
 
-//============================//
-// Section: Render Algorithms //
-//============================//
+namespace {
 
-/// This function is based on the algorithm
-/// described by John Kennedy on rasterizing
-/// an ellipse.
-///
-/// @param cx The center X component.
-/// @param cy The center Y component.
-/// @param xRadius The X radius
-/// @param yRadius The Y radius
-/// @param functor Receives the points to plot on the ellipse.
-template <typename Functor>
-void renderEllipse(int cx, int cy, int xRadius, int yRadius, Functor functor) noexcept
+/// Renders a part of a list of frames on a set of threads,
+/// for the calling thread to pass on in order.
+class FrameRenderer final
 {
-  if (!xRadius || !yRadius) {
-    return;
-  }
-
-  auto plot4 = [cx, cy, functor](int x, int y) {
-    functor(cx + x, cy + y);
-    functor(cx - x, cy + y);
-    functor(cx - x, cy - y);
-    functor(cx + x, cy - y);
-  };
-
-  int twoASquare = 2 * xRadius * xRadius;
-  int twoBSquare = 2 * yRadius * yRadius;
-
-  int x = xRadius;
-  int y = 0;
-
-  int xChange = yRadius * yRadius * (1 - (2 * xRadius));
-  int yChange = xRadius * xRadius;
-
-  int ellipseError = 0;
-
-  int stoppingX = twoBSquare * xRadius;
-  int stoppingY = 0;
-
-  while (stoppingX >= stoppingY) {
-
-    plot4(x, y);
+  /// The document being rendered.
+  const FrameScene& scene;
+  /// The part of the frames being rendered.
+  FramePart part = FramePart::Whole;
+  /// The frames to render, in the order they're passed on.
+  const std::vector<std::size_t>& frameList;
+  /// The cache to look up frames in and add frames to, which may be null.
+  FrameCache* cache = nullptr;
+  /// The static part that whole frames are rendered on top of.
+  FrameColors base;
+  /// The frames that were taken from the cache or rendered,
+  /// by their index in the list, until they're passed on.
+  std::vector<FrameColors> frames;
+  /// The indices of the frames that need to be rendered, in order.
+  std::vector<std::size_t> jobs;
+  /// The index of the next job to start.
+  std::size_t nextJob = 0;
+  /// The number of frames that were passed on.
+  std::size_t delivered = 0;
+  /// How far ahead of the delivered frames that the threads may render.
+  std::size_t window = 0;
+  /// Set when the threads should stop.
+  bool stopping = false;
+  /// Set when a frame could not be rendered.
+  bool failed = false;
+  /// Protects the members shared with the threads.
+  std::mutex mutex;
+  /// Signaled when a frame is rendered.
+  std::condition_variable frameReady;
+  /// Signaled when a frame is passed on, making room for another.
+  std::condition_variable frameDelivered;
+  /// The threads rendering the frames.
+  std::vector<std::thread> threads;
+public:
+  FrameRenderer(const FrameScene& s, FramePart p, const std::vector<std::size_t>& f, FrameCache* c) noexcept
+    : scene(s), part(p), frameList(f), cache(c) {}
+  FrameRenderer(const FrameRenderer&) = delete;
+  /// Stops and joins the threads, if they were started.
+  ~FrameRenderer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
 
-    y++;
-    stoppingY += twoASquare;
-    ellipseError += yChange;
-    yChange += twoASquare;
+    frameDelivered.notify_all();
 
-    if (((2 * ellipseError) + xChange) > 0) {
-      x--;
-      stoppingX -= twoBSquare;
-      ellipseError += xChange;
-      xChange += twoBSquare;
+    for (auto& thread : threads) {
+      thread.join();
     }
   }
+  /// Renders the frames and passes them on.
+  ///
+  /// @param deliver The function to pass the frames to, which is given the
+  /// index of the frame in the list and its colors. It returns false to stop.
+  /// @param threadCount The number of threads to render on.
+  ///
+  /// @return True on success, false if @p deliver returned
+  /// false or if a frame could not be rendered.
+  template <typename Deliver>
+  bool run(Deliver deliver, std::size_t threadCount)
+  {
+    const auto frameCount = frameList.size();
 
-  x = 0;
-  y = yRadius;
-
-  xChange = yRadius * yRadius;
-  yChange = xRadius * xRadius * (1 - (2 * yRadius));
-
-  ellipseError = 0;
-
-  stoppingX = 0;
-  stoppingY = twoASquare * yRadius;
-
-  while (stoppingX <= stoppingY) {
-
-    plot4(x, y);
+    frames.resize(frameCount);
 
-    x++;
-    stoppingX += twoBSquare;
-    ellipseError += xChange;
-    xChange += twoBSquare;
-    if (((2 * ellipseError) + yChange) > 0) {
-      y--;
-      stoppingY -= twoASquare;
-      ellipseError += yChange;
-      yChange += twoASquare;
-    }
-  }
+    // Frames that look like the one before them are not rendered.
 
-  // 1st point set done
-}
+    std::vector<bool> repeated(frameCount, false);
 
-//==================//
-// Section: Painter //
-//==================//
+    for (std::size_t i = 0; i < frameCount; i++) {
 
-/// Used for rasterizing the document.
-class Painter final : public NodeAccessor
-{
-  /// The current pixel size.
-  std::size_t pixelSize = 1;
-  /// The blend mode of the painter.
-  BlendMode blendMode = BlendMode::Normal;
-  /// The current material used to paint with.
-  Color primaryColor = RGBA { 0, 0, 0, 0 };
-  /// The current layer opacity.
-  float layerOpacity = 1.0f;
-  /// The color buffer being rendered to.
-  float* colorBuffer = nullptr;
-  /// The width of the color buffer, in pixels.
-  std::size_t width = 0;
-  /// The height of the color buffer, in pixels.
-  std::size_t height = 0;
-public:
-  Painter(float* c, std::size_t w, std::size_t h) : colorBuffer(c), width(w), height(h) {}
-  /// Renders an ellipse.
-  void access(const Ellipse& ellipse) noexcept override
-  {
-    setPrimaryColor(ellipse.color);
+      if (cache) {
+        frames[i] = cache->find(scene.identify(frameList[i], part));
+        if (frames[i]) {
+          continue;
+        }
+      }
 
-    blendMode = ellipse.blendMode;
-    pixelSize = ellipse.pixelSize;
+      if ((i > 0) && scene.sameFrame(frameList[i], frameList[i - 1])) {
+        repeated[i] = true;
+        continue;
+      }
 
-    auto functor = [this] (int x, int y) {
-      plot(x, y);
-    };
+      jobs.push_back(i);
+    }
 
-    renderEllipse(ellipse.center[0],
-                  ellipse.center[1],
-                  ellipse.radius[0],
-                  ellipse.radius[1],
-                  functor);
-  }
-  /// Fills an area on the image
-  /// with a certain color.
-  void access(const Fill& fill) noexcept override
-  {
-    if (!inBounds(fill.origin)) {
-      return;
+    if (!jobs.empty() && (part == FramePart::Whole) && scene.getStaticLayers()) {
+      base = renderStatic(scene, cache);
     }
 
-    blendMode = fill.blendMode;
+    startThreads(threadCount);
 
-    auto prev = getPixel(fill.origin);
+    RenderContext context;
 
-    setPrimaryColor(fill.color);
+    FrameColors previous;
 
-    if (almostEqual(prev, primaryColor.premultiplied)) {
-      return;
+    for (std::size_t i = 0; i < frameCount; i++) {
+
+      FrameColors colors;
+
+      if (repeated[i]) {
+        colors = previous;
+      } else if (threads.empty() && !frames[i]) {
+        colors = render(frameList[i], context);
+      } else {
+        colors = waitForFrame(i);
+      }
+
+      if (!colors) {
+        return false;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames[i].reset();
+        delivered = i + 1;
+      }
+
+      frameDelivered.notify_all();
+
+      if (!deliver(i, colors)) {
+        return false;
+      }
+
+      if (cache) {
+        cache->insert(scene.identify(frameList[i], part), colors);
+      }
+
+      previous = std::move(colors);
     }
 
-    try {
-      this->fill(fill.origin, prev);
-    } catch (...) { }
+    return true;
   }
-  /// Renders a line.
-  void access(const Line& line) noexcept override
+  /// Gets the static part of the frames, from the cache if it's there.
+  ///
+  /// @exception std::bad_alloc If the colors could not be allocated.
+  static FrameColors renderStatic(const FrameScene& scene, FrameCache* cache)
   {
-    setPrimaryColor(line.color);
-
-    blendMode = line.blendMode;
-    pixelSize = line.pixelSize;
+    auto key = scene.identify(0, FramePart::Static);
 
-    for (std::size_t i = 1; i < line.points.size(); i++) {
-      drawLine(line.points[i - 1], line.points[i - 0]);
+    if (cache) {
+      auto colors = cache->find(key);
+      if (colors) {
+        return colors;
+      }
     }
 
-    if ((line.points.size() % 2) == 1) {
-      auto p = line.points[line.points.size() - 1];
-      drawLine(p, p);
+    TraceScope traceScope("renderStatic", "count", double(scene.getStaticLayers()));
+
+    const auto& doc = scene.getDocument();
+
+    std::shared_ptr<std::vector<float>> colors(new std::vector<float>(doc.width * doc.height * 4));
+
+    RenderContext context;
+
+    scene.render(0, FramePart::Static, nullptr, colors->data(), context);
+
+    if (cache) {
+      cache->insert(key, colors);
     }
+
+    return colors;
   }
-  /// Draws a quadrilateral.
-  void access(const Quad& quad) noexcept override
+protected:
+  /// Renders a frame.
+  FrameColors render(std::size_t frame, RenderContext& context)
   {
-    setPrimaryColor(quad.color);
+    TraceScope traceScope("frame", "index", double(frame));
 
-    blendMode = quad.blendMode;
-    pixelSize = quad.pixelSize;
+    const auto& doc = scene.getDocument();
 
-    drawLine(quad.points[0], quad.points[1]);
-    drawLine(quad.points[1], quad.points[2]);
-    drawLine(quad.points[2], quad.points[3]);
-    drawLine(quad.points[3], quad.points[0]);
-  }
-  /// Clears the contents of the color buffer.
-  ///
-  /// @param c The color to clear the color buffer with.
-  /// This is premultiplied within the function call.
-  void clear(const RGBA& c) noexcept
-  {
-    std::size_t max = width * height * 4;
+    std::shared_ptr<std::vector<float>> colors(new std::vector<float>(doc.width * doc.height * 4));
 
-    RGBA bg = premultiply(c);
+    scene.render(frame, part, base.get(), colors->data(), context);
 
-    for (std::size_t i = 0; i < max; i += 4) {
-      colorBuffer[i + 0] = bg[0];
-      colorBuffer[i + 1] = bg[1];
-      colorBuffer[i + 2] = bg[2];
-      colorBuffer[i + 3] = bg[3];
-    }
+    return colors;
   }
-  void drawLine(const Vec2& a, const Vec2& b) noexcept
+  /// Starts the threads that render the jobs. No threads are started
+  /// when there's only one to use, or if they can't be started at all,
+  /// in which case the calling thread renders the frames instead.
+  void startThreads(std::size_t threadCount)
   {
-    auto diff = absolute(a - b);
+    if (!threadCount) {
+      threadCount = max(std::size_t(std::thread::hardware_concurrency()), std::size_t(1));
+    }
+
+    threadCount = min(threadCount, jobs.size());
 
-    diff[1] = -diff[1];
+    if (threadCount < 2) {
+      return;
+    }
 
-    int signX = (a[0] < b[0]) ? 1 : -1;
-    int signY = (a[1] < b[1]) ? 1 : -1;
+    window = threadCount * 2;
 
-    int err = diff[0] + diff[1];
+    for (std::size_t i = 0; i < threadCount; i++) {
+      try {
+        threads.emplace_back(&FrameRenderer::work, this);
+      } catch (const std::system_error&) {
+        break;
+      }
+    }
+  }
+  /// Renders jobs until there are none left or the renderer is stopped.
+  void work()
+  {
+    RenderContext context;
 
-    auto p = a;
+    std::unique_lock<std::mutex> lock(mutex);
 
     for (;;) {
 
-      plot(p[0], p[1]);
+      frameDelivered.wait(lock, [this]() {
+        return stopping || (nextJob >= jobs.size()) || (jobs[nextJob] < (delivered + window));
+      });
 
-      if (p == b) {
+      if (stopping || (nextJob >= jobs.size())) {
         break;
       }
 
-      int err2 = 2 * err;
+      auto index = jobs[nextJob++];
+
+      lock.unlock();
 
-      if (err2 >= diff[1]) {
-        err += diff[1];
-        p[0] += signX;
+      FrameColors colors;
+
+      try {
+        colors = render(frameList[index], context);
+      } catch (...) {
       }
 
-      if (err2 <= diff[0]) {
-        err += diff[0];
-        p[1] += signY;
+      lock.lock();
+
+      if (colors) {
+        frames[index] = std::move(colors);
+      } else {
+        failed = true;
       }
+
+      frameReady.notify_all();
     }
   }
-  /// Plots a point onto the color buffer.
+  /// Waits for a frame to be taken from the cache or rendered.
   ///
-  /// @param x The X coordinate of the point to plot.
-  /// @param y The Y coordinate of the point to plot.
-  inline void plot(int x, int y) { plot(Vec2 { x, y }); }
-  /// Plots a point onto the color buffer.
-  ///
-  /// @param p The point to plot within the color buffer.
-  void plot(const Vec2& p)
+  /// @return The colors of the frame, or null if a frame could not be rendered.
+  FrameColors waitForFrame(std::size_t index)
   {
-    Vec2 min { p - (int(pixelSize) - 1) };
-    Vec2 max = p;
+    std::unique_lock<std::mutex> lock(mutex);
 
-    for (int y = min[1]; y <= max[1]; y++) {
-      for (int x = min[0]; x <= max[0]; x++) {
-        blend(x, y, primaryColor);
-      }
+    frameReady.wait(lock, [this, index]() {
+      return frames[index] || failed;
+    });
+
+    return frames[index];
+  }
+};
+
+} // namespace
+
+bool renderFrames(const Document* doc,
+                  std::size_t first,
+                  std::size_t last,
+                  FrameSink sink,
+                  void* sinkData,
+                  FrameCache* cache,
+                  std::size_t threadCount) noexcept
+{
+  if (first > last) {
+    return true;
+  }
+
+  TraceScope traceScope("renderFrames", "frames", double(last - first + 1));
+
+  try {
+
+    FrameScene scene(*doc);
+
+    std::vector<std::size_t> frameList((last - first) + 1);
+
+    for (std::size_t i = 0; i < frameList.size(); i++) {
+      frameList[i] = first + i;
     }
+
+    FrameRenderer renderer(scene, FramePart::Whole, frameList, cache);
+
+    auto deliver = [doc, sink, sinkData, &frameList](std::size_t index, const FrameColors& colors) {
+      return sink(sinkData, frameList[index], colors->data(), doc->width, doc->height);
+    };
+
+    return renderer.run(deliver, threadCount);
+
+  } catch (...) {
+    return false;
   }
-  /// Renders a series of layers.
-  ///
-  /// @param layers The layers to be rendered.
-  void renderLayers(const std::vector<LayerPtr>& layers)
-  {
-    for (const auto& layer : layers) {
+}
 
-      if (!layer->visible) {
-        continue;
-      }
+//======================//
+// Section: Onion Skins //
+//======================//
 
-      layerOpacity = layer->opacity;
+namespace {
 
-      for (const auto& node : layer->nodes) {
-        node->accept(*this);
+/// A neighboring frame that is shown under the current one.
+struct Ghost final
+{
+  /// The distance from the current frame.
+  int offset = 0;
+  /// The color that the frame is tinted towards.
+  RGBA tint { 1, 1, 1, 1 };
+  /// The opacity of the frame.
+  float opacity = 1;
+};
+
+} // namespace
+
+/// Contains the neighboring frames shown by @ref renderOnionSkin.
+struct OnionSkin final
+{
+  /// The neighboring frames, in the order they were added.
+  std::vector<Ghost> ghosts;
+};
+
+OnionSkin* createOnionSkin()
+{
+  return new OnionSkin();
+}
+
+void closeOnionSkin(OnionSkin* onionSkin) noexcept
+{
+  delete onionSkin;
+}
+
+void addOnionSkinFrame(OnionSkin* onionSkin, int offset, float r, float g, float b, float opacity)
+{
+  Ghost ghost;
+  ghost.offset = offset;
+  ghost.tint = clip(RGBA { r, g, b, 1 });
+  ghost.opacity = clip(opacity);
+  onionSkin->ghosts.push_back(ghost);
+}
+
+void clearOnionSkinFrames(OnionSkin* onionSkin) noexcept
+{
+  onionSkin->ghosts.clear();
+}
+
+std::size_t getOnionSkinFrameCount(const OnionSkin* onionSkin) noexcept
+{
+  return onionSkin->ghosts.size();
+}
+
+bool renderOnionSkin(const Document* doc,
+                     std::size_t frame,
+                     const OnionSkin* onionSkin,
+                     Image* image,
+                     FrameCache* cache,
+                     std::size_t threadCount) noexcept
+{
+  TraceScope traceScope("renderOnionSkin", "frame", double(frame));
+
+  if (!tryResizeImage(image, doc->width, doc->height)) {
+    return false;
+  }
+
+  try {
+
+    // The farthest frames are composited first, so the nearest ones are on top.
+
+    std::vector<const Ghost*> ghosts;
+
+    for (const auto& ghost : onionSkin->ghosts) {
+
+      auto ghostFrame = std::int64_t(frame) + ghost.offset;
+
+      if (ghost.offset && (ghostFrame >= 0) && (std::uint64_t(ghostFrame) < doc->frameCount)) {
+        ghosts.push_back(&ghost);
       }
     }
-  }
-  /// Sets the value of a pixel.
-  ///
-  /// @note This function does not perform bounds checking.
-  ///
-  /// @param x The X coordinate of the pixel to set.
-  /// @param y The Y coordinate of the pixel to set.
-  /// @param c The color to assign the pixel.
-  void blend(int x, int y, const Color& c) noexcept
-  {
-    if ((std::size_t(x) >= width)
-     || (std::size_t(y) >= height)) {
-      return;
+
+    std::stable_sort(ghosts.begin(), ghosts.end(), [](const Ghost* a, const Ghost* b) {
+      return std::abs(a->offset) > std::abs(b->offset);
+    });
+
+    std::vector<std::size_t> frameList;
+
+    for (const auto* ghost : ghosts) {
+      frameList.push_back(std::size_t(std::int64_t(frame) + ghost->offset));
     }
 
-    auto* dst = &colorBuffer[((y * width) + x) * 4];
+    frameList.push_back(frame);
 
-    auto result = px::blend(blendMode, dst, c);
+    FrameScene scene(*doc);
 
-    dst[0] = result[0];
-    dst[1] = result[1];
-    dst[2] = result[2];
-    dst[3] = result[3];
-  }
-  /// Sets the value of a pixel.
-  ///
-  /// @note This function does not perform bounds checking.
-  ///
-  /// @param p The position of the pixel to set.
-  /// @param c The color to assign the pixel.
-  inline void blend(const Vec2& p, const RGBA& c)
-  {
-    return blend(p[0], p[1], c);
-  }
-  /// Assigns the primary color being used by the painter.
-  ///
-  /// @note This function will premultiply the alpha channel of @p c.
-  ///
-  /// @param c The color to assign to the painter.
-  /// The alpha channel is ignored and the current
-  /// layer opacity is used in place of it.
-  inline void setPrimaryColor(const RGBA& c)
-  {
-    primaryColor = Color(RGBA { c[0], c[1], c[2], layerOpacity * c[3] });
-  }
-  /// Gets the color from a pixel at a certain point.
-  ///
-  /// @note This function does not perform bounds checking.
-  ///
-  /// @param p The point to get the pixel color from.
-  ///
-  /// @return The color at the specified point.
-  inline RGBA getPixel(const Vec2& p) const noexcept
-  {
-    return getPixel(p[0], p[1]);
-  }
-  /// Gets the color from a pixel at a certain point.
-  ///
-  /// @note This function does not perform bounds checking.
-  ///
-  /// @param x The X coordinate of the pixel to get.
-  /// @param y The Y coordinate of the pixel to get.
-  ///
-  /// @return The color at the specified point.
-  inline RGBA getPixel(int x, int y) const noexcept
-  {
-    const float* src = &colorBuffer[((y * width) + x) * 4];
+    std::vector<FrameColors> layers(frameList.size());
 
-    return RGBA { src[0], src[1], src[2], src[3] };
-  }
-  /// Indicates if a point is in bounds or not.
-  ///
-  /// @param p The point to check.
-  ///
-  /// @return True on success, false on failure.
-  inline bool inBounds(const Vec2& p) const noexcept
-  {
-    return ((p[0] >= 0) && (std::size_t(p[0]) < width))
-        && ((p[1] >= 0) && (std::size_t(p[1]) < height));
-  }
-protected:
-  /// Fills an area on the image with a color.
-  /// The primary color is used as the fill color.
-  ///
-  /// @param origin The point to start at.
-  ///
-  /// @param prev The previous color.
-  void fill(const Vec2& origin, const RGBA& prev)
-  {
-    if (!inBounds(origin)) {
-      return;
+    FrameRenderer renderer(scene, FramePart::Animated, frameList, cache);
+
+    auto deliver = [&layers](std::size_t index, const FrameColors& colors) {
+      layers[index] = colors;
+      return true;
+    };
+
+    if (!renderer.run(deliver, threadCount)) {
+      return false;
     }
 
-    int xMax = int(width);
-    int yMax = int(height);
+    // The current frame is rendered exactly, as renderFrame does,
+    // and the ghosts are only built from the parts of their frames.
 
-    std::vector<Vec2> stack;
+    std::vector<std::size_t> wholeList { frame };
 
-    stack.push_back(origin);
+    FrameColors whole;
+
+    FrameRenderer wholeRenderer(scene, FramePart::Whole, wholeList, cache);
 
-    auto pop = [](std::vector<Vec2>& stk) {
-      auto poppedItem = stk[stk.size() - 1];
-      stk.pop_back();
-      return poppedItem;
+    auto deliverWhole = [&whole](std::size_t, const FrameColors& colors) {
+      whole = colors;
+      return true;
     };
 
-    while (!stack.empty()) {
+    if (!wholeRenderer.run(deliverWhole, threadCount)) {
+      return false;
+    }
 
-      auto p = pop(stack);
+    auto base = FrameRenderer::renderStatic(scene, cache);
 
-      auto x1 = p[0];
+    // Colors are premultiplied, so the ghosts are blended with "source over",
+    // onto a transparent background first.
 
-      while ((x1 >= 0) && almostEqual(getPixel(x1, p[1]), prev)) {
-        x1--;
-      }
+    const auto pixelCount = doc->width * doc->height;
 
-      x1++;
+    auto* out = image->data;
 
-      auto spanAbove = false;
-      auto spanBelow = false;
+    std::fill(out, out + (pixelCount * 4), 0.0f);
 
-      while ((x1 >= 0) && (x1 < xMax) && almostEqual(getPixel(x1, p[1]), prev)) {
+    for (std::size_t i = 0; i < ghosts.size(); i++) {
 
-        blend(x1, p[1], primaryColor);
+      const auto& tint = ghosts[i]->tint;
 
-        if (!spanAbove && (p[1] > 0) && almostEqual(getPixel(x1, p[1] - 1), prev)) {
-          stack.push_back(Vec2 { x1, p[1] - 1 });
-          spanAbove = true;
-        } else if (spanAbove && (p[1] > 0) && !almostEqual(getPixel(x1, p[1] - 1), prev)) {
-          spanAbove = false;
+      const auto opacity = ghosts[i]->opacity;
+
+      const auto* in = layers[i]->data();
+
+      for (std::size_t j = 0; j < pixelCount; j++) {
+
+        const auto* src = in + (j * 4);
+
+        auto* dst = out + (j * 4);
+
+        auto a = src[3] * opacity;
+
+        if (a <= 0) {
+          continue;
         }
 
-        if (!spanBelow && (p[1] < (yMax - 1)) && almostEqual(getPixel(x1, p[1] + 1), prev)) {
-          stack.push_back(Vec2 { x1, p[1] + 1 });
-          spanBelow = true;
-        } else if (spanBelow && (p[1] < (yMax - 1)) && !almostEqual(getPixel(x1, p[1] + 1), prev)) {
-          spanBelow = false;
+        // The ghost is tinted halfway, so that its details stay visible.
+
+        for (int k = 0; k < 3; k++) {
+          dst[k] = (((src[k] + (tint[k] * src[3])) * 0.5f) * opacity) + (dst[k] * (1 - a));
         }
 
-        x1++;
+        dst[3] = a + (dst[3] * (1 - a));
       }
     }
-  }
-};
 
-void render(const Document* doc, float* colorBuffer, std::size_t w, std::size_t h) noexcept
-{
-  Painter painter(colorBuffer, w, h);
+    // The ghosts go between the static layers and the animated layers of
+    // the current frame. Where the animated layers are normally blended,
+    // the whole frame is the animated layers over the static ones, so the
+    // ghosts are added by the difference they make to the static layers,
+    // in proportion to how much the animated layers let through. Pixels
+    // without ghosts are left exactly as the whole frame has them.
 
-  painter.clear(doc->background);
+    const auto* current = layers.back()->data();
 
-  painter.renderLayers(doc->layers);
-}
+    const auto* staticColors = base->data();
 
-void render(const Document* doc, Image* image) noexcept
-{
-  render(doc, image->colorBuffer.data(), image->width, image->height);
+    const auto* exact = whole->data();
+
+    for (std::size_t j = 0; j < (pixelCount * 4); j += 4) {
+
+      auto ghostAlpha = out[j + 3];
+
+      auto through = 1 - current[j + 3];
+
+      for (int k = 0; k < 4; k++) {
+        out[j + k] = exact[j + k] + ((out[j + k] - (staticColors[j + k] * ghostAlpha)) * through);
+      }
+    }
+
+  } catch (...) {
+    return false;
+  }
+
+  return true;
 }
 
 } // namespace px
@@ -57,14 +57,24 @@
 /// library are put into this namespace.
 namespace px {
 
+struct Animation;
+struct Bitmap;
 struct Document;
 struct Ellipse;
 struct ErrorList;
 struct Fill;
+struct FrameCache;
 struct Image;
+struct Instance;
 struct Layer;
 struct Line;
+struct OnionSkin;
+struct Polygon;
 struct Quad;
+struct RenderContext;
+struct RenderStats;
+struct Symbol;
+struct TiledImage;
 
 /// Describes how two colors are combined.
 enum class BlendMode
@@ -80,6 +90,68 @@ enum class BlendMode
   Subtract
 };
 
+/// Enumerates the curves that an animation
+/// may follow from one keyframe to the next.
+enum class Easing
+{
+  /// Moves at a constant speed.
+  Linear,
+  /// Holds the keyframe until the next one is reached.
+  Step,
+  /// Starts slowly and speeds up.
+  EaseIn,
+  /// Starts quickly and slows down.
+  EaseOut,
+  /// Starts and ends slowly.
+  EaseInOut
+};
+
+/// Enumerates the formats that image pixels may be stored in.
+enum class PixelFormat
+{
+  /// Four 32-bit floats per pixel, in the order of RGBA.
+  /// The RGB components are premultiplied.
+  RGBA32F
+};
+
+/// Enumerates the types of nodes that a document is made of.
+enum class NodeType
+{
+  /// See @ref pxEllipseApi
+  Ellipse,
+  /// See @ref pxFillApi
+  Fill,
+  /// See @ref pxLineApi
+  Line,
+  /// See @ref pxQuadApi
+  Quad,
+  /// See @ref pxBitmapApi
+  Bitmap,
+  /// See @ref pxInstanceApi
+  Instance,
+  /// See @ref pxPolygonApi
+  Polygon
+};
+
+/// Gets a human-readable name of a node type.
+///
+/// @param nodeType The node type to get the name of.
+///
+/// @return The name of the node type, in lower case.
+const char* getNodeTypeName(NodeType nodeType) noexcept;
+
+/// The value of an indexed pixel that has no palette entry, because
+/// nothing was drawn on it or it was erased. See @ref renderIndexed
+constexpr unsigned char transparentIndex = 255;
+
+/// The most pixels that a bitmap may have in each direction.
+/// See @ref setPixels
+constexpr std::size_t maxBitmapSize = 65536;
+
+/// The most points that a keyframe may offset.
+/// See @ref setKeyframePointOffset
+constexpr std::size_t maxPointOffsets = 65536;
+
 /// @defgroup pxImageApi Image API
 ///
 /// @brief Contains all declarations related to the image API.
@@ -97,6 +169,32 @@ enum class BlendMode
 /// @ingroup pxImageApi
 Image* createImage(std::size_t width, std::size_t height);
 
+/// Creates a new image that is stored in a file, instead of in memory.
+///
+/// The file is mapped into memory and shared with other processes,
+/// so @ref render writes the pixels straight into the page cache and
+/// other processes that map or read the file see them without a copy.
+/// The file is resized to fit the image and contains nothing but the
+/// pixels, in rows from top to bottom. Resizing the image, including
+/// the resize done by the @ref render overload taking a render context,
+/// resizes the file as well.
+///
+/// @note This is only available on POSIX systems.
+///
+/// @param path The path of the file to store the image in.
+/// The file is created if it does not exist.
+/// @param width The width to give the image, in pixels.
+/// @param height The height to give the image, in pixels.
+/// @param format The format of the pixels in the file.
+/// Currently, this must be @ref PixelFormat::RGBA32F.
+///
+/// @return A pointer to a new image instance, which is
+/// released with @ref closeImage. On failure, a null pointer
+/// is returned and errno is set to indicate the error.
+///
+/// @ingroup pxImageApi
+Image* createImageMapped(const char* path, std::size_t width, std::size_t height, PixelFormat format = PixelFormat::RGBA32F) noexcept;
+
 /// Releases memory allocated by an image.
 ///
 /// @param image A pointer to the image
@@ -117,6 +215,17 @@ void closeImage(Image* image) noexcept;
 /// @ingroup pxImageApi
 const float* getColorBuffer(const Image* image) noexcept;
 
+/// Accesses the color buffer of an image, for writing.
+/// This is useful for copying frames into an image, such
+/// as the ones passed to a @ref FrameSink.
+///
+/// @param image The image to get the color buffer of.
+///
+/// @return A pointer to the image color buffer.
+///
+/// @ingroup pxImageApi
+float* getColorBuffer(Image* image) noexcept;
+
 /// Gets a color from a specific pixel on the image.
 ///
 /// @param image The image to get the color from.
@@ -151,6 +260,8 @@ std::size_t getImageHeight(const Image* image) noexcept;
 /// Resizes an image.
 ///
 /// @exception std::bad_alloc If the color buffer resize fails.
+/// @exception std::system_error If the file of a mapped image could
+/// not be resized or mapped. The error code is the errno value.
 ///
 /// @param image A pointer to an image returned by @ref createImage.
 /// @param width The new width to assign the image.
@@ -159,6 +270,274 @@ std::size_t getImageHeight(const Image* image) noexcept;
 /// @ingroup pxImageApi
 void resizeImage(Image* image, std::size_t width, std::size_t height);
 
+/// @defgroup pxTiledImageApi Tiled Image API
+///
+/// @brief Used for rendering canvases that are too large for @ref Image.
+///
+/// A tiled image divides its pixels into square tiles, which are
+/// only allocated once something is drawn on them. Every tile that
+/// has not been drawn on shares a single tile holding the document
+/// background, so the memory of an image is proportional to the
+/// area covered by nodes rather than to the size of the canvas.
+///
+/// Tiles may be visited one at a time with @ref getTile, which lets
+/// exporters stream an image out without a dense copy of it.
+///
+/// @note A fill node allocates every tile that it spreads to,
+/// so a fill over a mostly empty canvas is as large as a dense image.
+
+/// Gets the width and height of each tile, in pixels.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getTileSize() noexcept;
+
+/// Creates a new tiled image.
+/// None of the tiles are allocated until they are drawn on.
+///
+/// @exception std::bad_alloc If the image allocation fails.
+///
+/// @param width The width to give the image, in pixels.
+/// @param height The height to give the image, in pixels.
+///
+/// @return A pointer to a new tiled image.
+///
+/// @ingroup pxTiledImageApi
+TiledImage* createTiledImage(std::size_t width, std::size_t height);
+
+/// Releases memory allocated by a tiled image.
+///
+/// @param image The tiled image to release.
+/// This parameter may be a null pointer.
+///
+/// @ingroup pxTiledImageApi
+void closeTiledImage(TiledImage* image) noexcept;
+
+/// Resizes a tiled image.
+/// The contents of the image are discarded.
+///
+/// @exception std::bad_alloc If the tile table could not be resized.
+///
+/// @param image The tiled image to resize.
+/// @param width The new width of the image, in pixels.
+/// @param height The new height of the image, in pixels.
+///
+/// @ingroup pxTiledImageApi
+void resizeTiledImage(TiledImage* image, std::size_t width, std::size_t height);
+
+/// Accesses the width of a tiled image.
+///
+/// @param image The tiled image to get the width of.
+///
+/// @return The width of the image, in pixels.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getImageWidth(const TiledImage* image) noexcept;
+
+/// Accesses the height of a tiled image.
+///
+/// @param image The tiled image to get the height of.
+///
+/// @return The height of the image, in pixels.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getImageHeight(const TiledImage* image) noexcept;
+
+/// Gets the number of tile columns in a tiled image.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getTileCountX(const TiledImage* image) noexcept;
+
+/// Gets the number of tile rows in a tiled image.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getTileCountY(const TiledImage* image) noexcept;
+
+/// Gets the number of tiles that have been allocated.
+/// This does not include the shared background tile.
+///
+/// @ingroup pxTiledImageApi
+std::size_t getAllocatedTileCount(const TiledImage* image) noexcept;
+
+/// Accesses the color buffer of a tile.
+///
+/// @param image The tiled image containing the tile.
+/// @param tileX The column of the tile.
+/// @param tileY The row of the tile.
+///
+/// @return The color buffer of the tile, which contains
+/// @ref getTileSize squared RGBA colors in row-major order.
+/// The RGB components are premultiplied. Tiles on the right
+/// and bottom edges of the image extend past the image and
+/// the colors outside of it should be ignored. If the tile
+/// is out of bounds, a null pointer is returned.
+///
+/// @ingroup pxTiledImageApi
+const float* getTile(const TiledImage* image, std::size_t tileX, std::size_t tileY) noexcept;
+
+/// Indicates whether or not a tile is the shared background tile.
+/// Exporters may use this to write background tiles more efficiently.
+///
+/// @param image The tiled image containing the tile.
+/// @param tileX The column of the tile.
+/// @param tileY The row of the tile.
+///
+/// @return True if nothing has been drawn on the tile, false otherwise.
+///
+/// @ingroup pxTiledImageApi
+bool isBackgroundTile(const TiledImage* image, std::size_t tileX, std::size_t tileY) noexcept;
+
+/// Gets a color from a specific pixel on a tiled image.
+///
+/// @param image The tiled image to get the color from.
+/// @param x The X coordinate of the pixel.
+/// @param y The Y coordinate of the pixel.
+/// @param rgba A pointer to a 4-float storage variable that gets the color.
+///
+/// @return True on success, false of @p x or @p y were out of bounds.
+///
+/// @ingroup pxTiledImageApi
+bool getColor(const TiledImage* image, std::size_t x, std::size_t y, float* rgba) noexcept;
+
+/// @defgroup pxRenderContextApi Render Context API
+///
+/// @brief Contains all declarations related to render contexts.
+
+/// Creates a new render context.
+///
+/// A render context owns the scratch memory that is
+/// used while rendering a document, such as the flood
+/// fill stacks. The memory is kept between calls to
+/// @ref render and only grows when a document needs more
+/// of it, so rendering the same document repeatedly does
+/// not allocate memory once the context has warmed up.
+///
+/// A render context may only be used by one thread at a time.
+///
+/// @exception std::bad_alloc If the context allocation fails.
+///
+/// @return A pointer to a new render context.
+///
+/// @ingroup pxRenderContextApi
+RenderContext* createRenderContext();
+
+/// Releases memory allocated by a render context.
+///
+/// @param context The render context to release.
+/// This parameter may be a null pointer.
+///
+/// @ingroup pxRenderContextApi
+void closeRenderContext(RenderContext* context) noexcept;
+
+/// Gets the amount of scratch memory held by a render context.
+///
+/// @param context The render context to get the memory size of.
+///
+/// @return The number of bytes of scratch memory held by @p context.
+///
+/// @ingroup pxRenderContextApi
+std::size_t getScratchMemorySize(const RenderContext* context) noexcept;
+
+/// @defgroup pxRenderStatsApi Render Statistics API
+///
+/// @brief Used for examining where the time of a render goes.
+///
+/// Statistics are only collected when an instance of
+/// @ref RenderStats is passed to @ref render. When it
+/// is not, the render does not pay for any of it.
+
+/// Creates a new render statistics instance.
+///
+/// @exception std::bad_alloc If the allocation fails.
+///
+/// @return A pointer to a new render statistics instance.
+///
+/// @ingroup pxRenderStatsApi
+RenderStats* createRenderStats();
+
+/// Releases memory allocated by render statistics.
+///
+/// @param stats The statistics to release. This may be a null pointer.
+///
+/// @ingroup pxRenderStatsApi
+void closeRenderStats(RenderStats* stats) noexcept;
+
+/// Gets the time it took to render the whole document.
+///
+/// @return The render time, in seconds.
+///
+/// @ingroup pxRenderStatsApi
+double getRenderTime(const RenderStats* stats) noexcept;
+
+/// Gets the number of layers that have a render time.
+/// This is the number of layers in the rendered document.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getLayerStatsCount(const RenderStats* stats) noexcept;
+
+/// Gets the time it took to render a layer.
+///
+/// @param stats The statistics to get the time from.
+/// @param layer The index of the layer to get the time of.
+///
+/// @return The render time of the layer, in seconds.
+/// If the layer was hidden or @p layer is out of bounds, zero is returned.
+///
+/// @ingroup pxRenderStatsApi
+double getLayerRenderTime(const RenderStats* stats, std::size_t layer) noexcept;
+
+/// Gets the total time it took to render all nodes of a certain type.
+///
+/// @param stats The statistics to get the time from.
+/// @param nodeType The type of node to get the time of.
+///
+/// @return The total render time, in seconds.
+///
+/// @ingroup pxRenderStatsApi
+double getNodeRenderTime(const RenderStats* stats, NodeType nodeType) noexcept;
+
+/// Gets the number of nodes that were rendered.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getNodesVisited(const RenderStats* stats) noexcept;
+
+/// Gets the number of nodes that were skipped
+/// because they were entirely off the canvas.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getNodesCulled(const RenderStats* stats) noexcept;
+
+/// Gets the number of pixels that were blended.
+/// Pixels that were blended more than once are counted more than once.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getPixelsBlended(const RenderStats* stats) noexcept;
+
+/// Gets the number of horizontal spans filled by flood fills.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getFillSpans(const RenderStats* stats) noexcept;
+
+/// Gets the number of pixels examined by flood fills.
+/// This is usually a few times the number of pixels they filled.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getFillPixelsVisited(const RenderStats* stats) noexcept;
+
+/// Gets the amount of scratch memory used by the render.
+///
+/// @return The most scratch memory held by the
+/// render context during the render, in bytes.
+///
+/// @ingroup pxRenderStatsApi
+std::size_t getPeakScratchMemory(const RenderStats* stats) noexcept;
+
+/// Prints render statistics to the standard error file.
+///
+/// @param stats The statistics to print. This may be a null pointer.
+///
+/// @ingroup pxRenderStatsApi
+void printRenderStatsToStderr(const RenderStats* stats) noexcept;
+
 /// @defgroup pxDocumentApi Document API
 ///
 /// @brief Contains all declarations related to the document object.
@@ -189,6 +568,21 @@ Document* createDoc();
 /// the pointer before calling any of the functions in @ref pxErrorApi
 int openDoc(Document* doc, const char* filename, ErrorList** errList = nullptr);
 
+/// Imports data from the contents of a document file
+/// that is already in memory, such as one read by the caller.
+///
+/// @param doc A pointer to a document returned from @ref createDoc
+/// @param data The contents of the document file.
+/// @param size The number of bytes in @p data.
+/// @param errList An optional parameter to store the error list at.
+/// The error list has an empty filename.
+///
+/// @return Zero if the document was opened properly,
+/// or EINVAL if a syntax error was found.
+///
+/// @ingroup pxDocumentApi
+int openDoc(Document* doc, const void* data, std::size_t size, ErrorList** errList = nullptr);
+
 /// Saves a document to a file.
 ///
 /// @param doc The document to save.
@@ -291,6 +685,39 @@ const Layer* getLayer(const Document* doc, std::size_t);
 /// @ingroup pxDocumentApi
 void moveLayer(Document* doc, std::size_t src, std::size_t dst);
 
+/// Bakes the nodes of a layer into a single bitmap.
+///
+/// Layers that are rendered every frame but never edited, such as
+/// backgrounds made of many strokes, can be baked so that rendering
+/// them blits one bitmap instead of drawing every node. The layer
+/// keeps its name, opacity and visibility.
+///
+/// The nodes are rendered on their own, onto a transparent canvas
+/// the size of the document, and the bitmap is cropped to the pixels
+/// that were painted. Pixels outside of the canvas are lost. The
+/// opacity of the layer applies to the bitmap as a whole, as it
+/// does to the nodes of a layer that isn't baked.
+///
+/// The bitmap holds colors, not palette indices. Nodes that take their
+/// color from the palette are baked with the color it has at the time,
+/// so later changes to the palette no longer recolor the baked layer.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+/// The layer is not changed if this happens.
+///
+/// @param doc The document containing the layer.
+/// @param index The index of the layer to bake.
+///
+/// @return True on success, false if @p index is out of range or the
+/// layer can't be baked. Layers can't be baked if they or their nodes
+/// are animated, since a bitmap only holds one frame, or if they have
+/// fills or subtracting nodes, since those depend on the layers
+/// beneath them. They also can't be baked if the painted pixels are
+/// more than @ref maxBitmapSize across.
+///
+/// @ingroup pxDocumentApi
+bool bakeLayer(Document* doc, std::size_t index);
+
 /// Adds a line to a document.
 ///
 /// @param layer The index of the layer to add the line to.
@@ -335,6 +762,76 @@ Fill* addFill(Document* doc, std::size_t layer = 0);
 /// @ingroup pxDocumentApi
 Quad* addQuad(Document* doc, std::size_t layer = 0);
 
+/// Adds a polygon to the document.
+///
+/// @exception std::bad_alloc If the polygon allocation fails.
+///
+/// @exception std::out_of_range If @p layer is out of range.
+///
+/// @param doc The document to add the polygon to.
+/// @param layer The index of the layer to add the polygon to.
+///
+/// @return A pointer to the new polygon, which has no points.
+///
+/// @ingroup pxDocumentApi
+Polygon* addPolygon(Document* doc, std::size_t layer = 0);
+
+/// Adds a bitmap to the document.
+/// The bitmap has no pixels until @ref setPixels is called.
+///
+/// @exception std::bad_alloc If the bitmap allocation fails.
+///
+/// @param doc The document to add the bitmap to.
+/// @param layer The index of the layer to add the bitmap to.
+///
+/// @return A pointer to the new bitmap.
+///
+/// @ingroup pxDocumentApi
+Bitmap* addBitmap(Document* doc, std::size_t layer = 0);
+
+/// Adds an instance of a symbol to the document.
+///
+/// @exception std::bad_alloc If the instance allocation fails.
+///
+/// @exception std::out_of_range If @p layer is out of range.
+///
+/// @param doc The document to add the instance to.
+/// @param symbol The index of the symbol to place.
+/// @param layer The index of the layer to add the instance to.
+///
+/// @return A pointer to the new instance.
+///
+/// @ingroup pxDocumentApi
+Instance* addInstance(Document* doc, std::size_t symbol, std::size_t layer = 0);
+
+/// Adds a symbol to the document, which has no nodes until
+/// they are added to it. Symbols are numbered in the order
+/// they are added, starting at zero.
+///
+/// @exception std::bad_alloc If the symbol allocation fails.
+///
+/// @param doc The document to add the symbol to.
+///
+/// @return A pointer to the new symbol.
+///
+/// @ingroup pxDocumentApi
+Symbol* addSymbol(Document* doc);
+
+/// Gets the number of symbols in a document.
+///
+/// @ingroup pxDocumentApi
+std::size_t getSymbolCount(const Document* doc) noexcept;
+
+/// Gets a symbol of a document.
+///
+/// @exception std::out_of_range If @p index is out of range.
+///
+/// @ingroup pxDocumentApi
+Symbol* getSymbol(Document* doc, std::size_t index);
+
+/// @copydoc getSymbol
+const Symbol* getSymbol(const Document* doc, std::size_t index);
+
 /// Gets the width of the document, in pixels.
 ///
 /// @param doc The document to get the width of.
@@ -379,6 +876,80 @@ void resizeDoc(Document* doc, std::size_t width, std::size_t height) noexcept;
 /// @ingroup pxDocumentApi
 void setBackground(Document* doc, float r, float g, float b, float a) noexcept;
 
+/// Gets the number of frames in the document.
+/// Documents that aren't animated have one frame.
+///
+/// @ingroup pxDocumentApi
+std::size_t getFrameCount(const Document* doc) noexcept;
+
+/// Sets the number of frames in the document.
+///
+/// @param doc The document to set the frame count of.
+/// @param frameCount The number of frames.
+/// This is raised to one if it is zero,
+/// and lowered to 65536 if it is more than that.
+///
+/// @ingroup pxDocumentApi
+void setFrameCount(Document* doc, std::size_t frameCount) noexcept;
+
+/// Gets the number of frames per second that the document is played at.
+///
+/// @ingroup pxDocumentApi
+std::size_t getFrameRate(const Document* doc) noexcept;
+
+/// Sets the number of frames per second that the document is played at.
+///
+/// @param doc The document to set the frame rate of.
+/// @param frameRate The frames per second.
+/// This is raised to one if it is zero.
+///
+/// @ingroup pxDocumentApi
+void setFrameRate(Document* doc, std::size_t frameRate) noexcept;
+
+/// Gets the number of colors in the palette of the document.
+/// Documents don't have a palette unless one is added to them.
+///
+/// @ingroup pxDocumentApi
+std::size_t getPaletteSize(const Document* doc) noexcept;
+
+/// Resizes the palette of a document.
+/// Colors added to the palette are opaque black.
+///
+/// @exception std::bad_alloc If the palette could not be grown.
+///
+/// @param doc The document to resize the palette of.
+/// @param size The number of colors in the palette,
+/// which may be no more than 255.
+///
+/// @return True on success, false if @p size is too large.
+///
+/// @ingroup pxDocumentApi
+bool resizePalette(Document* doc, std::size_t size);
+
+/// Sets a color of the palette of a document.
+/// Every node that refers to the color is drawn with the new one,
+/// which is how the colors of a document are swapped.
+///
+/// @param doc The document to set the palette color of.
+/// @param index The index of the color in the palette.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxDocumentApi
+bool setPaletteColor(Document* doc, std::size_t index, float r, float g, float b, float a = 1) noexcept;
+
+/// Gets a color of the palette of a document.
+///
+/// @param doc The document to get the palette color of.
+/// @param index The index of the color in the palette.
+/// @param rgba The array to put the color into.
+/// This must be able to hold four floats.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxDocumentApi
+bool getPaletteColor(const Document* doc, std::size_t index, float* rgba) noexcept;
+
 /// @defgroup pxLayerApi Layer API
 ///
 /// @brief Contains all declarations for layers.
@@ -427,6 +998,13 @@ bool getLayerVisibility(const Layer* layer) noexcept;
 
 /// Sets the opacity of the layer.
 ///
+/// The opacity applies to the layer as a whole, so where its nodes
+/// overlap, they cover each other as they would in an opaque layer.
+/// A layer that isn't fully opaque is rendered onto a copy of the box
+/// of pixels around its nodes, which is then mixed into the canvas,
+/// so it costs about one more write per pixel of that box. Fills and
+/// instances reach the whole canvas, so a layer with them copies it.
+///
 /// @param layer The layer to set the opacity of.
 /// @param opacity The opacity to assign the layer.
 /// This value should be between 0 and 1.
@@ -444,6 +1022,79 @@ void setLayerOpacity(Layer* layer, float opacity) noexcept;
 /// @ingroup pxLayerApi
 void setLayerVisibility(Layer* layer, bool visibility) noexcept;
 
+/// @defgroup pxSymbolApi Symbol API
+///
+/// @brief Contains all declarations for symbols.
+///
+/// A symbol is a named group of nodes, such as a tile or a motif
+/// that repeats across the canvas, which is placed by instances.
+/// Each symbol that is placed is rendered once per render, on its
+/// own, and its pixels are stamped at every instance of it, so the
+/// time spent drawing nodes depends on the number of symbols rather
+/// than the number of times they're placed.
+///
+/// Since a symbol is rendered on its own, its fills and subtracting
+/// nodes only affect its own pixels, and fills stay within the box
+/// around its other nodes. The opacity of the layer that an instance
+/// is on applies to the symbol as a whole, rather than to each of its
+/// nodes. Symbols are drawn as they are at the first frame, and are not
+/// drawn if they cover more than 16777216 pixels. Instances within
+/// symbols are not drawn.
+
+/// Renames a symbol.
+///
+/// @exception std::bad_alloc If the name could not be copied.
+///
+/// @ingroup pxSymbolApi
+void setSymbolName(Symbol* symbol, const char* name);
+
+/// Gets the name of a symbol.
+///
+/// @ingroup pxSymbolApi
+const char* getSymbolName(const Symbol* symbol) noexcept;
+
+/// Adds an ellipse to a symbol.
+///
+/// @exception std::bad_alloc If the ellipse allocation fails.
+///
+/// @ingroup pxSymbolApi
+Ellipse* addEllipse(Symbol* symbol);
+
+/// Adds a fill to a symbol.
+///
+/// @exception std::bad_alloc If the fill allocation fails.
+///
+/// @ingroup pxSymbolApi
+Fill* addFill(Symbol* symbol);
+
+/// Adds a line to a symbol.
+///
+/// @exception std::bad_alloc If the line allocation fails.
+///
+/// @ingroup pxSymbolApi
+Line* addLine(Symbol* symbol);
+
+/// Adds a quadrilateral to a symbol.
+///
+/// @exception std::bad_alloc If the quad allocation fails.
+///
+/// @ingroup pxSymbolApi
+Quad* addQuad(Symbol* symbol);
+
+/// Adds a polygon to a symbol.
+///
+/// @exception std::bad_alloc If the polygon allocation fails.
+///
+/// @ingroup pxSymbolApi
+Polygon* addPolygon(Symbol* symbol);
+
+/// Adds a bitmap to a symbol.
+///
+/// @exception std::bad_alloc If the bitmap allocation fails.
+///
+/// @ingroup pxSymbolApi
+Bitmap* addBitmap(Symbol* symbol);
+
 /// @defgroup pxEllipseApi Ellipse API
 ///
 /// @brief Contains all declarations for ellipses.
@@ -455,6 +1106,15 @@ void setLayerVisibility(Layer* layer, bool visibility) noexcept;
 /// @ingroup pxEllipseApi
 void setColor(Ellipse* ellipse, float r, float g, float b, float a = 1) noexcept;
 
+/// Makes an ellipse take its color from the palette of the document.
+///
+/// @param ellipse The ellipse to set the color index of.
+/// @param index The index of the palette color. If this is negative or
+/// not in the palette, the color given to @ref setColor is used instead.
+///
+/// @ingroup pxEllipseApi
+void setColorIndex(Ellipse* ellipse, int index) noexcept;
+
 /// Sets the blend mode of the ellipse.
 ///
 /// @param ellipse The ellipse to modify the blend mode of.
@@ -501,10 +1161,20 @@ void setPixelSize(Ellipse* ellipse, int pixelSize) noexcept;
 /// @ingroup pxEllipseApi
 void resizeRect(Ellipse* ellipse, int x1, int y1, int x2, int y2) noexcept;
 
-/// @defgroup pxFillApi Flood Fill API
+/// Sets whether an ellipse is filled, rather than only outlined.
+/// A filled ellipse is drawn one span per row, and each of its
+/// pixels is blended once, so it doesn't need a flood fill.
 ///
-/// @brief Contains all declarations for flood fills.
-
+/// @param ellipse The ellipse to fill.
+/// @param filled Whether or not to fill the ellipse.
+///
+/// @ingroup pxEllipseApi
+void setFilled(Ellipse* ellipse, bool filled) noexcept;
+
+/// @defgroup pxFillApi Flood Fill API
+///
+/// @brief Contains all declarations for flood fills.
+
 /// Sets the blend mode of the fill operation.
 ///
 /// @param fill The fill operation to set the blend mode of.
@@ -532,6 +1202,15 @@ void setFillOrigin(Fill* fill, int x, int y) noexcept;
 /// @ingroup pxFillApi
 void setColor(Fill* fill, float r, float g, float b, float a = 1) noexcept;
 
+/// Makes a fill operation take its color from the palette of the document.
+///
+/// @param fill The fill operation to set the color index of.
+/// @param index The index of the palette color. If this is negative or
+/// not in the palette, the color given to @ref setColor is used instead.
+///
+/// @ingroup pxFillApi
+void setColorIndex(Fill* fill, int index) noexcept;
+
 /// @defgroup pxLineApi Line API
 ///
 /// @brief Contains all declarations for lines.
@@ -552,6 +1231,15 @@ void setBlendMode(Line* line, BlendMode mode) noexcept;
 /// @ingroup pxLineApi
 void setColor(Line* line, float r, float g, float b, float a = 1) noexcept;
 
+/// Makes a line take its color from the palette of the document.
+///
+/// @param line The line to set the color index of.
+/// @param index The index of the palette color. If this is negative or
+/// not in the palette, the color given to @ref setColor is used instead.
+///
+/// @ingroup pxLineApi
+void setColorIndex(Line* line, int index) noexcept;
+
 /// Adds a point to a line.
 ///
 /// @param line The line to add the point to.
@@ -657,6 +1345,15 @@ void setBlendMode(Quad* quad, BlendMode mode) noexcept;
 /// @ingroup pxQuadApi
 void setColor(Quad* quad, float r, float g, float b, float a = 1) noexcept;
 
+/// Makes a quadrilateral take its color from the palette of the document.
+///
+/// @param quad The quadrilateral to set the color index of.
+/// @param index The index of the palette color. If this is negative or
+/// not in the palette, the color given to @ref setColor is used instead.
+///
+/// @ingroup pxQuadApi
+void setColorIndex(Quad* quad, int index) noexcept;
+
 /// Sets a point within a quadrilateral.
 ///
 /// @param quad The quadrilateral to set the point of.
@@ -673,6 +1370,390 @@ bool setPoint(Quad* quad, std::size_t index, int x, int y) noexcept;
 /// @ingroup pxQuadApi
 void setPixelSize(Quad* quad, int pixelSize) noexcept;
 
+/// Sets whether a quadrilateral is filled, rather than only outlined.
+/// A filled quadrilateral is drawn like a @ref pxPolygonApi "polygon".
+///
+/// @param quad The quadrilateral to fill.
+/// @param filled Whether or not to fill the quadrilateral.
+///
+/// @ingroup pxQuadApi
+void setFilled(Quad* quad, bool filled) noexcept;
+
+/// @defgroup pxPolygonApi Polygon API
+///
+/// @brief Contains all declarations for polygons.
+///
+/// A polygon is a closed, filled shape with any number of points.
+/// Its outline is drawn like a line through its points, back to the
+/// first one, and the pixels inside of it are drawn one span per row.
+/// Where the outline crosses itself, the parts that are inside of it
+/// an even number of times are left unfilled. Each pixel of a polygon
+/// is blended once, so translucent polygons don't darken at their
+/// edges, and none of the pixels are compared with the ones beneath.
+
+/// Sets the blend mode of a polygon.
+///
+/// @param polygon The polygon to set the blend mode of.
+/// @param mode The blend mode to assign the polygon.
+///
+/// @ingroup pxPolygonApi
+void setBlendMode(Polygon* polygon, BlendMode mode) noexcept;
+
+/// Sets the color of a polygon.
+///
+/// @param polygon The polygon to set the color of.
+///
+/// @ingroup pxPolygonApi
+void setColor(Polygon* polygon, float r, float g, float b, float a = 1) noexcept;
+
+/// Makes a polygon take its color from the palette of the document.
+///
+/// @param polygon The polygon to set the color index of.
+/// @param index The index of the palette color. If this is negative or
+/// not in the palette, the color given to @ref setColor is used instead.
+///
+/// @ingroup pxPolygonApi
+void setColorIndex(Polygon* polygon, int index) noexcept;
+
+/// Sets the pixel size of a polygon, which
+/// widens its outline to the upper left.
+///
+/// @param polygon The polygon to set the pixel size of.
+/// @param pixelSize The pixel size to assign.
+///
+/// @ingroup pxPolygonApi
+void setPixelSize(Polygon* polygon, int pixelSize) noexcept;
+
+/// Adds a point to a polygon.
+///
+/// @exception std::bad_alloc If the point could not be added.
+///
+/// @param polygon The polygon to add the point to.
+/// @param x The X coordinate of the point to add.
+/// @param y The Y coordinate of the point to add.
+///
+/// @ingroup pxPolygonApi
+void addPoint(Polygon* polygon, int x, int y);
+
+/// Gets the number of points in a polygon.
+///
+/// @ingroup pxPolygonApi
+std::size_t getPointCount(const Polygon* polygon) noexcept;
+
+/// Gets the X coordinate of a point in a polygon.
+///
+/// @exception std::out_of_range If @p index is out of bounds.
+///
+/// @ingroup pxPolygonApi
+int getPointX(const Polygon* polygon, std::size_t index);
+
+/// Gets the Y coordinate of a point in a polygon.
+///
+/// @exception std::out_of_range If @p index is out of bounds.
+///
+/// @ingroup pxPolygonApi
+int getPointY(const Polygon* polygon, std::size_t index);
+
+/// Sets the position of an existing point in a polygon.
+///
+/// @param polygon The polygon to modify the point of.
+/// @param index The index of the point to modify.
+/// @param x The X coordinate to assign the point.
+/// @param y The Y coordinate to assign the point.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxPolygonApi
+bool setPoint(Polygon* polygon, std::size_t index, int x, int y) noexcept;
+
+/// @defgroup pxBitmapApi Bitmap API
+///
+/// @brief Contains all declarations for bitmaps.
+///
+/// A bitmap is a raster of pixels placed on the canvas, such as
+/// imported artwork. Its pixels are stored as runs of each row,
+/// with each distinct color stored once, and it is drawn one span
+/// per run. Copies of a bitmap share its pixels, so copying a
+/// document doesn't copy them.
+
+/// Sets the blend mode of a bitmap.
+///
+/// @param bitmap The bitmap to set the blend mode of.
+/// @param mode The blend mode to assign the bitmap.
+///
+/// @ingroup pxBitmapApi
+void setBlendMode(Bitmap* bitmap, BlendMode mode) noexcept;
+
+/// Sets the position of a bitmap.
+///
+/// @param bitmap The bitmap to move.
+/// @param x The X coordinate of the upper left pixel of the bitmap.
+/// @param y The Y coordinate of the upper left pixel of the bitmap.
+///
+/// @ingroup pxBitmapApi
+void setPosition(Bitmap* bitmap, int x, int y) noexcept;
+
+/// Replaces the pixels of a bitmap.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+/// @exception std::out_of_range If @p w or @p h is more than
+/// @ref maxBitmapSize.
+///
+/// @param bitmap The bitmap to set the pixels of.
+/// @param rgba The colors of the pixels, in rows from top to bottom.
+/// There must be four floats per pixel, in the order of RGBA, and the
+/// RGB components are not premultiplied.
+/// @param w The width of the bitmap, in pixels.
+/// @param h The height of the bitmap, in pixels.
+///
+/// @ingroup pxBitmapApi
+void setPixels(Bitmap* bitmap, const float* rgba, std::size_t w, std::size_t h);
+
+/// Replaces the pixels of a bitmap with 8-bit colors,
+/// such as those decoded from an image file.
+///
+/// @exception std::bad_alloc If memory could not be allocated.
+/// @exception std::out_of_range If @p w or @p h is more than
+/// @ref maxBitmapSize.
+///
+/// @param bitmap The bitmap to set the pixels of.
+/// @param rgba The colors of the pixels, with four bytes per pixel.
+/// The RGB components are not premultiplied.
+/// @param w The width of the bitmap, in pixels.
+/// @param h The height of the bitmap, in pixels.
+///
+/// @ingroup pxBitmapApi
+void setPixels(Bitmap* bitmap, const unsigned char* rgba, std::size_t w, std::size_t h);
+
+/// Gets the width of a bitmap, in pixels.
+///
+/// @ingroup pxBitmapApi
+std::size_t getBitmapWidth(const Bitmap* bitmap) noexcept;
+
+/// Gets the height of a bitmap, in pixels.
+///
+/// @ingroup pxBitmapApi
+std::size_t getBitmapHeight(const Bitmap* bitmap) noexcept;
+
+/// Gets the number of runs that the pixels of a bitmap are stored as.
+/// This is a measure of how well the bitmap is compressed, and of
+/// how long it takes to draw.
+///
+/// @ingroup pxBitmapApi
+std::size_t getRunCount(const Bitmap* bitmap) noexcept;
+
+/// @defgroup pxInstanceApi Instance API
+///
+/// @brief Contains all declarations for instances.
+///
+/// An instance places the pixels of a symbol on the canvas. See @ref pxSymbolApi.
+
+/// Sets the symbol that an instance places.
+/// Instances of symbols that don't exist are not drawn.
+///
+/// @ingroup pxInstanceApi
+void setSymbol(Instance* instance, std::size_t symbol) noexcept;
+
+/// Gets the index of the symbol that an instance places.
+///
+/// @ingroup pxInstanceApi
+std::size_t getSymbol(const Instance* instance) noexcept;
+
+/// Sets the blend mode that an instance stamps its symbol with.
+///
+/// @ingroup pxInstanceApi
+void setBlendMode(Instance* instance, BlendMode mode) noexcept;
+
+/// Sets the position of an instance, which is
+/// where the origin of its symbol is placed.
+///
+/// @ingroup pxInstanceApi
+void setPosition(Instance* instance, int x, int y) noexcept;
+
+/// @defgroup pxAnimationApi Animation API
+///
+/// @brief Contains all declarations for animating layers and nodes.
+///
+/// Layers and nodes are animated with keyframes, which are placed on
+/// whole frames. Each keyframe has a translation, a scale and an
+/// offset for each point of the node. Between two keyframes, these
+/// are interpolated along the easing curve of the first keyframe.
+/// Before the first keyframe and after the last one, the nearest
+/// keyframe is held.
+///
+/// At a given frame, a point of a node is first moved by its offset,
+/// then scaled about the pivot of the node and translated. The same
+/// is then done by the layer, without the offset. The points of
+/// an ellipse are its center (0) and its radius (1), and the
+/// point of a fill is its origin (0).
+///
+/// The interpolation is precomputed whenever the keyframes change,
+/// so a frame is evaluated while it is being rendered and only the
+/// animated layers and nodes cost anything to evaluate. Since there
+/// is one precomputed sample per frame, keyframes must be placed
+/// before frame 65536, and files with keyframes after that fail
+/// to open.
+
+/// Gets the animation of a layer.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Layer* layer);
+
+/// Gets the animation of an ellipse.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Ellipse* ellipse);
+
+/// Gets the animation of a fill.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Fill* fill);
+
+/// Gets the animation of a line.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Line* line);
+
+/// Gets the animation of a quadrilateral.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Quad* quad);
+
+/// Gets the animation of a polygon.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Polygon* polygon);
+
+/// Gets the animation of a bitmap.
+/// Bitmaps are moved by their animation, but not scaled.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Bitmap* bitmap);
+
+/// Gets the animation of an instance.
+/// Instances are moved by their animation, but not scaled.
+///
+/// @exception std::bad_alloc If the animation is accessed
+/// for the first time and can't be allocated.
+///
+/// @ingroup pxAnimationApi
+Animation* getAnimation(Instance* instance);
+
+/// Sets the point that an animation scales about.
+///
+/// @param animation The animation to set the pivot of.
+/// @param x The X coordinate of the pivot.
+/// @param y The Y coordinate of the pivot.
+///
+/// @ingroup pxAnimationApi
+void setPivot(Animation* animation, int x, int y) noexcept;
+
+/// Adds a keyframe to an animation. The keyframe starts with the
+/// values that the animation already has at that frame, so adding
+/// a keyframe doesn't change how the animation looks.
+///
+/// @exception std::bad_alloc If the keyframe can't be allocated.
+/// @exception std::out_of_range If @p frame is not less than 65536,
+/// which is the most frames that a document may have.
+///
+/// @param animation The animation to add the keyframe to.
+/// @param frame The frame to put the keyframe at.
+///
+/// @return The index of the keyframe. If there already is a keyframe
+/// at @p frame, then the index of that keyframe is returned instead.
+///
+/// @ingroup pxAnimationApi
+std::size_t addKeyframe(Animation* animation, std::size_t frame);
+
+/// Removes a keyframe from an animation.
+///
+/// @exception std::bad_alloc If the interpolation
+/// tables can't be rebuilt.
+///
+/// @param animation The animation to remove the keyframe from.
+/// @param index The index of the keyframe to remove.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxAnimationApi
+bool removeKeyframe(Animation* animation, std::size_t index);
+
+/// Gets the number of keyframes in an animation.
+///
+/// @ingroup pxAnimationApi
+std::size_t getKeyframeCount(const Animation* animation) noexcept;
+
+/// Gets the frame that a keyframe is placed on.
+///
+/// @exception std::out_of_range If @p index is out of bounds.
+///
+/// @ingroup pxAnimationApi
+std::size_t getKeyframeFrame(const Animation* animation, std::size_t index);
+
+/// Sets the translation of a keyframe.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxAnimationApi
+bool setKeyframeTranslation(Animation* animation, std::size_t index, int x, int y) noexcept;
+
+/// Sets the scale of a keyframe.
+///
+/// @param animation The animation containing the keyframe.
+/// @param index The index of the keyframe.
+/// @param x The scale factor along the X axis.
+/// @param y The scale factor along the Y axis.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxAnimationApi
+bool setKeyframeScale(Animation* animation, std::size_t index, float x, float y) noexcept;
+
+/// Sets the easing curve from a keyframe to the next one.
+///
+/// @return True on success, false if @p index is out of bounds.
+///
+/// @ingroup pxAnimationApi
+bool setKeyframeEasing(Animation* animation, std::size_t index, Easing easing) noexcept;
+
+/// Sets the offset of a point at a keyframe.
+///
+/// @exception std::bad_alloc If the offsets can't be allocated.
+///
+/// @param animation The animation containing the keyframe.
+/// @param index The index of the keyframe.
+/// @param point The index of the point to offset.
+/// This must be less than @ref maxPointOffsets.
+/// @param x The X offset of the point.
+/// @param y The Y offset of the point.
+///
+/// @return True on success, false if @p index is out of bounds
+/// or @p point is not less than @ref maxPointOffsets.
+///
+/// @ingroup pxAnimationApi
+bool setKeyframePointOffset(Animation* animation, std::size_t index, std::size_t point, int x, int y);
+
 /// Renders the document onto a color buffer.
 ///
 /// @param doc The document to be rendered.
@@ -693,6 +1774,502 @@ void render(const Document* doc, float* color, std::size_t w, std::size_t h) noe
 /// This can be generated with @ref createImage
 void render(const Document* doc, Image* image) noexcept;
 
+/// Renders the document onto a color buffer,
+/// using the scratch memory of a render context.
+///
+/// @param doc The document to be rendered.
+/// @param color The color buffer to render to.
+/// There must be 4 floats per color, since the
+/// color format is RGBA.
+/// @param w The width of the color buffer.
+/// @param h The height of the color buffer.
+/// @param context The render context to take scratch memory from.
+/// See @ref createRenderContext for more information.
+/// @param stats An optional pointer to the statistics to collect.
+/// See @ref pxRenderStatsApi for more information.
+void render(const Document* doc,
+            float* color,
+            std::size_t w,
+            std::size_t h,
+            RenderContext* context,
+            RenderStats* stats = nullptr) noexcept;
+
+/// Renders the document into a rectangle of a larger color buffer,
+/// such as a sprite atlas. The rectangle has the size of the document
+/// and its upper left corner is at @p x and @p y within the buffer.
+/// Nothing outside of the rectangle is modified.
+///
+/// @param doc The document to be rendered.
+/// @param color The color buffer to render to. There must be
+/// 4 floats per color, since the color format is RGBA.
+/// @param stride The number of pixels from the start of one row
+/// of the color buffer to the next. This is usually the width
+/// of the whole buffer.
+/// @param x The X coordinate of the rectangle within the buffer.
+/// @param y The Y coordinate of the rectangle within the buffer.
+/// @param context The render context to take scratch memory from.
+/// @param clear Whether or not to clear the rectangle with the document
+/// background first. When this is false, the document is drawn over
+/// the colors already in the buffer and fills spread over them as well.
+/// @param stats An optional pointer to the statistics to collect.
+void render(const Document* doc,
+            float* color,
+            std::size_t stride,
+            std::size_t x,
+            std::size_t y,
+            RenderContext* context,
+            bool clear = true,
+            RenderStats* stats = nullptr) noexcept;
+
+/// Renders the document onto an instance of @ref Image,
+/// using the scratch memory of a render context.
+///
+/// Unlike the other overload, the image is first resized
+/// to match the size of the document. Since images keep
+/// their memory when they shrink, this only allocates
+/// when the document grows beyond any size previously rendered.
+///
+/// @param doc The document to be rendered.
+/// @param image The image to render the document onto.
+/// @param context The render context to take scratch memory from.
+/// @param stats An optional pointer to the statistics to collect.
+///
+/// @return True on success, false if the image could not be resized.
+/// On failure, errno is set to indicate the error, which is ENOMEM if
+/// memory could not be allocated.
+bool render(const Document* doc, Image* image, RenderContext* context, RenderStats* stats = nullptr) noexcept;
+
+/// Renders the document onto a tiled image.
+///
+/// The image is resized to match the size of the document
+/// and only the tiles that nodes are drawn on are allocated.
+///
+/// @param doc The document to be rendered.
+/// @param image The tiled image to render the document onto.
+/// @param context The render context to take scratch memory from.
+/// @param stats An optional pointer to the statistics to collect.
+///
+/// @return True on success, false if memory for the tiles could not be
+/// allocated. In that case, the image only contains part of the document.
+bool render(const Document* doc, TiledImage* image, RenderContext* context, RenderStats* stats = nullptr) noexcept;
+
+/// Renders a frame of the document onto a color buffer.
+///
+/// Only the animated layers and nodes are evaluated for the frame,
+/// and the document is not modified, so several frames of one document
+/// may be rendered at once by different threads with their own contexts.
+/// The other render functions render the first frame.
+///
+/// @param doc The document to be rendered.
+/// @param frame The frame to render. This may be beyond the frame
+/// count of the document, in which case the last keyframes are held.
+/// @param color The color buffer to render to. There must be
+/// 4 floats per color, since the color format is RGBA.
+/// @param w The width of the color buffer.
+/// @param h The height of the color buffer.
+/// @param context The render context to take scratch memory from.
+/// @param stats An optional pointer to the statistics to collect.
+///
+/// @ingroup pxAnimationApi
+void renderFrame(const Document* doc,
+                 std::size_t frame,
+                 float* color,
+                 std::size_t w,
+                 std::size_t h,
+                 RenderContext* context,
+                 RenderStats* stats = nullptr) noexcept;
+
+/// Renders a frame of the document onto an instance of @ref Image.
+/// The image is resized to match the size of the document.
+///
+/// @param doc The document to be rendered.
+/// @param frame The frame to render.
+/// @param image The image to render the frame onto.
+/// @param context The render context to take scratch memory from.
+/// @param stats An optional pointer to the statistics to collect.
+///
+/// @return True on success, false if the image could not be resized.
+/// On failure, errno is set to indicate the error, which is ENOMEM if
+/// memory could not be allocated.
+///
+/// @ingroup pxAnimationApi
+bool renderFrame(const Document* doc, std::size_t frame, Image* image, RenderContext* context, RenderStats* stats = nullptr) noexcept;
+
+/// Renders a frame of the document onto a buffer of palette indices,
+/// which takes a sixteenth of the memory of a color buffer.
+///
+/// Nodes that take their color from the palette write its index and
+/// other nodes write the index of the nearest palette color. Since an
+/// indexed pixel is either covered or not, nodes are only drawn where
+/// they are at least half opaque, after the opacity of their layer is
+/// applied, and subtracting erases pixels. Pixels that are not drawn on
+/// are @ref transparentIndex, since the background is not in the palette.
+///
+/// One indexed render can be turned into any number of color variants
+/// with @ref remapIndexed, without rendering the document again.
+///
+/// @param doc The document to be rendered.
+/// @param indices The buffer to render to, with one byte per pixel.
+/// @param w The width of the buffer.
+/// @param h The height of the buffer.
+/// @param context The render context to take scratch memory from.
+/// @param frame The frame to render.
+void renderIndexed(const Document* doc,
+                   unsigned char* indices,
+                   std::size_t w,
+                   std::size_t h,
+                   RenderContext* context,
+                   std::size_t frame = 0) noexcept;
+
+/// Converts palette indices into colors.
+///
+/// @param indices The palette indices to convert, such as
+/// those rendered by @ref renderIndexed.
+/// @param pixelCount The number of indices to convert.
+/// @param palette The colors to use for each index. There must be
+/// four floats per color, in the order of RGBA, not premultiplied.
+/// This is usually a variant of the document palette, such as one
+/// with different skin or clothing colors.
+/// @param paletteSize The number of colors in @p palette. Indices beyond
+/// the palette become transparent, which includes @ref transparentIndex
+/// unless the palette has 256 colors.
+/// @param color The color buffer to write to. There must be
+/// 4 floats per color and the RGB components are premultiplied,
+/// the same as a color buffer given to @ref render.
+void remapIndexed(const unsigned char* indices,
+                  std::size_t pixelCount,
+                  const float* palette,
+                  std::size_t paletteSize,
+                  float* color) noexcept;
+
+/// Converts palette indices into colors with the palette of a document.
+/// Indices beyond the palette, such as @ref transparentIndex,
+/// become the background color of the document.
+///
+/// @param doc The document to get the palette and background of.
+/// @param indices The palette indices to convert.
+/// @param pixelCount The number of indices to convert.
+/// @param color The color buffer to write to. There must be 4 floats
+/// per color and the RGB components are premultiplied.
+void remapIndexed(const Document* doc, const unsigned char* indices, std::size_t pixelCount, float* color) noexcept;
+
+/// Creates a cache for the frames rendered by @ref renderFrames.
+///
+/// Frames are cached by a hash of everything that affects how they
+/// look, so the cache does not need to be cleared after editing. An
+/// edit only causes the frames that it changes to be rendered again,
+/// such as the frames between the neighbors of a moved keyframe.
+/// Frames that are no longer used are evicted as the budget runs
+/// out, least recently used first, which lets undoing an edit hit
+/// the cache.
+///
+/// A cache may be shared by calls to @ref renderFrames on several
+/// threads at once, such as one rendering the frame being shown and
+/// another rendering the frames after it ahead of time. The cache
+/// is only locked while a frame is looked up or added.
+///
+/// @exception std::bad_alloc If the cache allocation fails.
+///
+/// @param memoryBudget The most memory that the cached frames may use, in bytes.
+///
+/// @return A pointer to a new frame cache.
+///
+/// @ingroup pxAnimationApi
+FrameCache* createFrameCache(std::size_t memoryBudget);
+
+/// Releases the memory allocated by a frame cache.
+///
+/// @param cache The cache to release. This may be null.
+///
+/// @ingroup pxAnimationApi
+void closeFrameCache(FrameCache* cache) noexcept;
+
+/// Changes the memory budget of a frame cache,
+/// evicting frames if it no longer fits in it.
+///
+/// @param cache The cache to change the budget of.
+/// @param memoryBudget The most memory that the cached frames may use, in bytes.
+///
+/// @ingroup pxAnimationApi
+void setFrameCacheBudget(FrameCache* cache, std::size_t memoryBudget) noexcept;
+
+/// Evicts every frame from a frame cache.
+///
+/// @param cache The cache to clear.
+///
+/// @ingroup pxAnimationApi
+void clearFrameCache(FrameCache* cache) noexcept;
+
+/// Gets the memory used by the frames in a cache.
+///
+/// @param cache The cache to get the memory usage of.
+///
+/// @return The number of bytes used by the cached frames.
+///
+/// @ingroup pxAnimationApi
+std::size_t getFrameCacheSize(const FrameCache* cache) noexcept;
+
+/// Gets the number of frames that were found in a cache.
+///
+/// @param cache The cache to get the hit count of.
+///
+/// @ingroup pxAnimationApi
+std::size_t getFrameCacheHits(const FrameCache* cache) noexcept;
+
+/// Gets the number of frames that were looked for
+/// in a cache but had to be rendered.
+///
+/// @param cache The cache to get the miss count of.
+///
+/// @ingroup pxAnimationApi
+std::size_t getFrameCacheMisses(const FrameCache* cache) noexcept;
+
+/// The type of function that receives the frames of @ref renderFrames.
+///
+/// @param data The user data that was passed to @ref renderFrames.
+/// @param frame The index of the frame.
+/// @param colors The colors of the frame, which are tightly packed RGBA
+/// colors in the same format as the color buffer of @ref Image. These
+/// are only valid until the function returns.
+/// @param width The width of the frame, in pixels.
+/// @param height The height of the frame, in pixels.
+///
+/// @return True to continue rendering, false to stop.
+///
+/// @ingroup pxAnimationApi
+using FrameSink = bool (*)(void* data, std::size_t frame, const float* colors, std::size_t width, std::size_t height);
+
+/// Renders a range of frames, passing each one to a function in order.
+///
+/// The frames are rendered at once on several threads, while the
+/// calling thread passes the finished ones to @p sink. A few frames
+/// are rendered ahead of the one being passed to @p sink, so the
+/// memory used does not depend on the number of frames in the range.
+///
+/// Work that does not change from one frame to the next is not done
+/// again. The visible layers below the first animated one are rendered
+/// once for the whole range, and a frame in which no animated layer or
+/// node moves is not rendered at all, its previous frame is reused.
+///
+/// @param doc The document to render the frames of.
+/// @param first The first frame to render.
+/// @param last The last frame to render, which is included in the range.
+/// @param sink The function to pass the frames to.
+/// @param sinkData User data to pass to @p sink.
+/// @param cache An optional cache to look up frames in and add new frames to.
+/// @param threadCount The number of threads to render on.
+/// If this is zero, one thread per processor is used.
+///
+/// @return True on success, false if memory could not
+/// be allocated or if @p sink returned false.
+///
+/// @ingroup pxAnimationApi
+bool renderFrames(const Document* doc,
+                  std::size_t first,
+                  std::size_t last,
+                  FrameSink sink,
+                  void* sinkData,
+                  FrameCache* cache = nullptr,
+                  std::size_t threadCount = 0) noexcept;
+
+/// Creates an onion skin, which shows the neighbors of a frame
+/// under it while animating. It starts without any frames to show.
+///
+/// @exception std::bad_alloc If the allocation fails.
+///
+/// @return A pointer to a new onion skin.
+///
+/// @ingroup pxAnimationApi
+OnionSkin* createOnionSkin();
+
+/// Releases the memory allocated by an onion skin.
+///
+/// @param onionSkin The onion skin to release. This may be null.
+///
+/// @ingroup pxAnimationApi
+void closeOnionSkin(OnionSkin* onionSkin) noexcept;
+
+/// Adds a neighboring frame to show under the current one.
+///
+/// @exception std::bad_alloc If the frame could not be added.
+///
+/// @param onionSkin The onion skin to add the frame to.
+/// @param offset The distance from the current frame, which is
+/// negative for the frames before it and positive for the ones after it.
+/// @param r The red channel of the color to tint the frame towards.
+/// @param g The green channel of the color to tint the frame towards.
+/// @param b The blue channel of the color to tint the frame towards.
+/// @param opacity The opacity of the frame.
+///
+/// @ingroup pxAnimationApi
+void addOnionSkinFrame(OnionSkin* onionSkin, int offset, float r, float g, float b, float opacity);
+
+/// Removes the frames shown by an onion skin.
+///
+/// @param onionSkin The onion skin to remove the frames from.
+///
+/// @ingroup pxAnimationApi
+void clearOnionSkinFrames(OnionSkin* onionSkin) noexcept;
+
+/// Gets the number of frames shown by an onion skin.
+///
+/// @param onionSkin The onion skin to get the frame count of.
+///
+/// @ingroup pxAnimationApi
+std::size_t getOnionSkinFrameCount(const OnionSkin* onionSkin) noexcept;
+
+/// Renders a frame with its neighbors shown under it, tinted and faded.
+///
+/// The static layers (the visible ones below the first animated layer)
+/// are drawn first, then the neighboring frames of the layers above them
+/// from the farthest to the nearest, then the current frame. Neighbors
+/// outside of the frame count of the document are not shown.
+///
+/// Each part is taken from @p cache when it's there, so moving to the next
+/// frame only renders the frame that came into view. A part is only
+/// rendered again once an edit changes how it looks.
+///
+/// The current frame is rendered whole, so wherever no neighbor shows,
+/// the image is the same as the one from @ref renderFrame.
+///
+/// @note The neighbors are rendered onto a transparent background, so a
+/// fill or a subtracted node in them that reaches the static layers may
+/// look different than it does in their own frames.
+///
+/// @param doc The document to render.
+/// @param frame The current frame.
+/// @param onionSkin The neighboring frames to show.
+/// @param image The image to render onto, which is resized to the document.
+/// @param cache An optional cache to look up parts of frames in and add them to.
+/// @param threadCount The number of threads to render on.
+/// If this is zero, one thread per processor is used.
+///
+/// @return True on success, false if memory could not be allocated
+/// or the image could not be resized. If the image could not be
+/// resized, errno is set to indicate the error.
+///
+/// @ingroup pxAnimationApi
+bool renderOnionSkin(const Document* doc,
+                     std::size_t frame,
+                     const OnionSkin* onionSkin,
+                     Image* image,
+                     FrameCache* cache = nullptr,
+                     std::size_t threadCount = 0) noexcept;
+
+/// The type of function that receives the rows of @ref renderRows.
+///
+/// @param data The user data that was passed to @ref renderRows.
+/// @param y The Y coordinate of the first row.
+/// @param rowCount The number of rows in @p colors.
+/// @param colors The colors of the rows, which are tightly packed
+/// RGBA colors in the same format as the color buffer of @ref Image.
+/// This buffer is reused for the next rows once the function returns.
+///
+/// @return True to continue rendering, false to stop.
+using RowSink = bool (*)(void* data, std::size_t y, std::size_t rowCount, const float* colors);
+
+/// Renders the document a band of rows at a time,
+/// passing each band to a function once it is finished.
+///
+/// This is meant for exporting documents that are too large to keep
+/// in memory, such as by streaming the rows into an image encoder.
+/// Only one band of rows is kept in memory, so the memory used
+/// is proportional to the width of the document times @p bandHeight.
+/// The colors are the same as the ones given by @ref render.
+///
+/// @note A fill node may depend on any pixel of the canvas, so a
+/// document with a fill in a visible layer is first rendered onto a
+/// @ref TiledImage and then passed to @p sink a band at a time. In
+/// that case, the memory used is proportional to the area of the
+/// canvas covered by nodes instead (see @ref pxTiledImageApi.)
+///
+/// @param doc The document to be rendered.
+/// @param bandHeight The number of rows in each band.
+/// The last band may have fewer rows than this.
+/// @param sink The function to pass each band of rows to.
+/// @param sinkData User data to pass to @p sink.
+/// @param context The render context to take scratch memory from.
+///
+/// @return True on success, false if the band could not be
+/// allocated or if @p sink returned false.
+bool renderRows(const Document* doc, std::size_t bandHeight, RowSink sink, void* sinkData, RenderContext* context) noexcept;
+
+/// @defgroup pxTraceApi Tracing API
+///
+/// @brief Used for recording where time is spent, across threads.
+///
+/// When tracing is enabled, the library records the beginning and
+/// end of the work done while opening, copying, rendering and saving
+/// documents. Users may add their own events with @ref beginTraceEvent
+/// and @ref endTraceEvent. Each thread records into its own ring buffer
+/// without taking any locks, and the oldest events of a thread are
+/// overwritten once its buffer fills up. When a thread exits, its buffer
+/// is reused by the next thread that records an event, so the memory
+/// used grows with the number of threads recording at the same time,
+/// rather than with the number of threads ever started.
+///
+/// The events can be saved with @ref saveTrace, in the Chrome trace
+/// event format, which can be viewed with chrome://tracing or Perfetto.
+
+/// Enables or disables the recording of trace events.
+/// Tracing is disabled by default, in which case
+/// recording an event costs a single atomic load.
+///
+/// @param enabled True to record events, false to stop recording them.
+///
+/// @ingroup pxTraceApi
+void setTracingEnabled(bool enabled) noexcept;
+
+/// Indicates whether or not trace events are being recorded.
+///
+/// @ingroup pxTraceApi
+bool isTracingEnabled() noexcept;
+
+/// Records the beginning of an event on the calling thread.
+///
+/// @param name The name of the event. This must
+/// point to a string that outlives the trace, such as
+/// a string literal, since only the pointer is recorded.
+/// @param argName An optional name of a numeric argument
+/// to attach to the event. This has the same lifetime
+/// requirements as @p name.
+/// @param argValue The value of the numeric argument.
+///
+/// @ingroup pxTraceApi
+void beginTraceEvent(const char* name, const char* argName = nullptr, double argValue = 0) noexcept;
+
+/// Records the end of an event on the calling thread.
+///
+/// @param name The name of the event that was passed to @ref beginTraceEvent.
+///
+/// @ingroup pxTraceApi
+void endTraceEvent(const char* name) noexcept;
+
+/// Discards all of the events that were recorded so far.
+///
+/// @ingroup pxTraceApi
+void clearTrace() noexcept;
+
+/// Saves the recorded events to a file,
+/// in the Chrome trace event JSON format.
+///
+/// @param filename The path to save the trace at.
+///
+/// @return True on success, false on failure.
+///
+/// @ingroup pxTraceApi
+bool saveTrace(const char* filename);
+
+/// Saves the recorded events to a memory buffer,
+/// in the Chrome trace event JSON format.
+///
+/// @param data Is assigned memory allocated with malloc() that
+/// contains the trace data.
+/// @param size Is assigned the number of bytes allocated in @p data.
+///
+/// @ingroup pxTraceApi
+void saveTrace(void** data, std::size_t* size);
+
 /// @defgroup pxErrorListApi Error List API
 ///
 /// @brief Used for examining errors reporting from opening a file.